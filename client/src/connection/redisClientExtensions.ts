@@ -42,21 +42,28 @@ const selva_commands = [
   'selva.hierarchy.listconstraints',
   'selva.hierarchy.aggregate',
   'selva.hierarchy.aggregatein',
+  'selva.hierarchy.aliases',
   'selva.hierarchy.children',
   'selva.hierarchy.del',
   'selva.hierarchy.edgeget',
   'selva.hierarchy.edgegetmetadata',
   'selva.hierarchy.edgelist',
   'selva.hierarchy.find',
+  'selva.hierarchy.khop',
   'selva.hierarchy.parents',
+  'selva.hierarchy.path',
   'selva.hierarchy.compress',
   'selva.hierarchy.listcompressed',
+  'selva.hierarchy.memusage',
+  'selva.hierarchy.export',
+  'selva.hierarchy.import',
   'selva.hierarchy.types.add',
   'selva.hierarchy.types.clear',
   'selva.hierarchy.types.list',
   'selva.hierarchy.ver',
   'selva.inherit',
   'selva.resolve.nodeid',
+  'selva.resolve.nodeids',
   'selva.subscriptions.add',
   'selva.subscriptions.addalias',
   'selva.subscriptions.addmissing',
@@ -75,6 +82,9 @@ const selva_commands = [
   'selva.rpn.evalstring',
   'selva.log.dbg',
   'selva.log.dbglist',
+  'selva.trace.dump',
+  'selva.trace.enable',
+  'selva.memory.stats',
 ]
 
 redis.RedisClient.prototype.on_info_cmd = function (err, res) {
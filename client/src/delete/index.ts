@@ -6,7 +6,7 @@ async function deleteItem(
   payload: DeleteOptions
 ): Promise<number | string[]> {
   const db = typeof payload === 'string' ? 'default' : payload.$db || 'default'
-  const flags = typeof payload === 'string' ? '' : `${payload.$recursive && 'F' || ''}${payload.$returnIds && 'I' || ''}`
+  const flags = typeof payload === 'string' ? '' : `${payload.$recursive && 'F' || ''}${payload.$returnIds && 'I' || ''}${payload.$lazy && 'L' || ''}`
 
   return client.redis.selva_hierarchy_del(
     { name: db, type: 'origin' },
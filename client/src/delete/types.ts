@@ -5,4 +5,5 @@ export type DeleteOptions =
       $id: string
       $recursive?: boolean
       $returnIds?: boolean
+      $lazy?: boolean
     }
@@ -28,6 +28,7 @@ const FN_TO_ENUM = {
   avg: '3',
   min: '4',
   max: '5',
+  countUniqueApprox: '6',
 }
 
 // TODO: implement recursive version
@@ -41,15 +41,21 @@ redis.add_command('selva.hierarchy.addconstraint')
 redis.add_command('selva.hierarchy.listconstraints')
 redis.add_command('selva.hierarchy.aggregate')
 redis.add_command('selva.hierarchy.aggregatein')
+redis.add_command('selva.hierarchy.aliases')
 redis.add_command('selva.hierarchy.children')
 redis.add_command('selva.hierarchy.del')
 redis.add_command('selva.hierarchy.edgeget')
 redis.add_command('selva.hierarchy.edgegetmetadata')
 redis.add_command('selva.hierarchy.edgelist')
 redis.add_command('selva.hierarchy.find')
+redis.add_command('selva.hierarchy.khop')
 redis.add_command('selva.hierarchy.parents')
+redis.add_command('selva.hierarchy.path')
 redis.add_command('selva.hierarchy.compress')
 redis.add_command('selva.hierarchy.listcompressed')
+redis.add_command('selva.hierarchy.memusage')
+redis.add_command('selva.hierarchy.export')
+redis.add_command('selva.hierarchy.import')
 redis.add_command('selva.hierarchy.types.add')
 redis.add_command('selva.hierarchy.types.clear')
 redis.add_command('selva.hierarchy.types.list')
@@ -58,6 +64,7 @@ redis.add_command('selva.inherit')
 redis.add_command('selva.modify')
 redis.add_command('selva.update')
 redis.add_command('selva.resolve.nodeid')
+redis.add_command('selva.resolve.nodeids')
 redis.add_command('selva.object.del')
 redis.add_command('selva.object.exists')
 redis.add_command('selva.object.get')
@@ -84,6 +91,9 @@ redis.add_command('selva.rpn.evaldouble')
 redis.add_command('selva.rpn.evalstring')
 redis.add_command('selva.log.dbg')
 redis.add_command('selva.log.dbglist')
+redis.add_command('selva.trace.dump')
+redis.add_command('selva.trace.enable')
+redis.add_command('selva.memory.stats')
 const proto = redis.RedisClient.prototype
 for (const key in redis.RedisClient.prototype) {
   if (/[A-Z]/.test(key[0]) && typeof proto[key] === 'function') {
@@ -4931,6 +4931,31 @@ abstract class RedisMethods {
     }
   }
 
+  async selva_hierarchy_aliases(
+    opts: ServerSelector,
+    ...args: args
+  ): Promise<any>
+  async selva_hierarchy_aliases(...args: args): Promise<any>
+  async selva_hierarchy_aliases(opts: any, ...args: args): Promise<any> {
+    if (typeof opts === 'object') {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue(
+          { command: 'selva_hierarchy_aliases', args, resolve, reject },
+          opts
+        )
+      })
+    } else {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue({
+          command: 'selva_hierarchy_aliases',
+          args: [opts, ...args],
+          resolve,
+          reject,
+        })
+      })
+    }
+  }
+
   async selva_hierarchy_children(
     opts: ServerSelector,
     ...args: args
@@ -5078,6 +5103,28 @@ abstract class RedisMethods {
     }
   }
 
+  async selva_hierarchy_khop(opts: ServerSelector, ...args: args): Promise<any>
+  async selva_hierarchy_khop(...args: args): Promise<any>
+  async selva_hierarchy_khop(opts: any, ...args: args): Promise<any> {
+    if (typeof opts === 'object') {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue(
+          { command: 'selva_hierarchy_khop', args, resolve, reject },
+          opts
+        )
+      })
+    } else {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue({
+          command: 'selva_hierarchy_khop',
+          args: [opts, ...args],
+          resolve,
+          reject,
+        })
+      })
+    }
+  }
+
   async selva_hierarchy_parents(
     opts: ServerSelector,
     ...args: args
@@ -5103,6 +5150,28 @@ abstract class RedisMethods {
     }
   }
 
+  async selva_hierarchy_path(opts: ServerSelector, ...args: args): Promise<any>
+  async selva_hierarchy_path(...args: args): Promise<any>
+  async selva_hierarchy_path(opts: any, ...args: args): Promise<any> {
+    if (typeof opts === 'object') {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue(
+          { command: 'selva_hierarchy_path', args, resolve, reject },
+          opts
+        )
+      })
+    } else {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue({
+          command: 'selva_hierarchy_path',
+          args: [opts, ...args],
+          resolve,
+          reject,
+        })
+      })
+    }
+  }
+
   async selva_hierarchy_compress(
     opts: ServerSelector,
     ...args: args
@@ -5153,6 +5222,78 @@ abstract class RedisMethods {
     }
   }
 
+  async selva_hierarchy_memusage(opts: ServerSelector, ...args: args): Promise<any>
+  async selva_hierarchy_memusage(...args: args): Promise<any>
+  async selva_hierarchy_memusage(opts: any, ...args: args): Promise<any> {
+    if (typeof opts === 'object') {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue(
+          { command: 'selva_hierarchy_memusage', args, resolve, reject },
+          opts
+        )
+      })
+    } else {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue({
+          command: 'selva_hierarchy_memusage',
+          args: [opts, ...args],
+          resolve,
+          reject,
+        })
+      })
+    }
+  }
+
+  async selva_hierarchy_export(
+    opts: ServerSelector,
+    ...args: args
+  ): Promise<any>
+  async selva_hierarchy_export(...args: args): Promise<any>
+  async selva_hierarchy_export(opts: any, ...args: args): Promise<any> {
+    if (typeof opts === 'object') {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue(
+          { command: 'selva_hierarchy_export', args, resolve, reject },
+          opts
+        )
+      })
+    } else {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue({
+          command: 'selva_hierarchy_export',
+          args: [opts, ...args],
+          resolve,
+          reject,
+        })
+      })
+    }
+  }
+
+  async selva_hierarchy_import(
+    opts: ServerSelector,
+    ...args: args
+  ): Promise<any>
+  async selva_hierarchy_import(...args: args): Promise<any>
+  async selva_hierarchy_import(opts: any, ...args: args): Promise<any> {
+    if (typeof opts === 'object') {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue(
+          { command: 'selva_hierarchy_import', args, resolve, reject },
+          opts
+        )
+      })
+    } else {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue({
+          command: 'selva_hierarchy_import',
+          args: [opts, ...args],
+          resolve,
+          reject,
+        })
+      })
+    }
+  }
+
   async selva_hierarchy_types_add(
     opts: ServerSelector,
     ...args: args
@@ -5338,6 +5479,28 @@ abstract class RedisMethods {
     }
   }
 
+  async selva_resolve_nodeids(opts: ServerSelector, ...args: args): Promise<any>
+  async selva_resolve_nodeids(...args: args): Promise<any>
+  async selva_resolve_nodeids(opts: any, ...args: args): Promise<any> {
+    if (typeof opts === 'object') {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue(
+          { command: 'selva_resolve_nodeids', args, resolve, reject },
+          opts
+        )
+      })
+    } else {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue({
+          command: 'selva_resolve_nodeids',
+          args: [opts, ...args],
+          resolve,
+          reject,
+        })
+      })
+    }
+  }
+
   async selva_object_del(opts: ServerSelector, ...args: args): Promise<any>
   async selva_object_del(...args: args): Promise<any>
   async selva_object_del(opts: any, ...args: args): Promise<any> {
@@ -5947,6 +6110,72 @@ abstract class RedisMethods {
       })
     }
   }
+
+  async selva_trace_dump(opts: ServerSelector, ...args: args): Promise<any>
+  async selva_trace_dump(...args: args): Promise<any>
+  async selva_trace_dump(opts: any, ...args: args): Promise<any> {
+    if (typeof opts === 'object') {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue(
+          { command: 'selva_trace_dump', args, resolve, reject },
+          opts
+        )
+      })
+    } else {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue({
+          command: 'selva_trace_dump',
+          args: [opts, ...args],
+          resolve,
+          reject,
+        })
+      })
+    }
+  }
+
+  async selva_trace_enable(opts: ServerSelector, ...args: args): Promise<any>
+  async selva_trace_enable(...args: args): Promise<any>
+  async selva_trace_enable(opts: any, ...args: args): Promise<any> {
+    if (typeof opts === 'object') {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue(
+          { command: 'selva_trace_enable', args, resolve, reject },
+          opts
+        )
+      })
+    } else {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue({
+          command: 'selva_trace_enable',
+          args: [opts, ...args],
+          resolve,
+          reject,
+        })
+      })
+    }
+  }
+
+  async selva_memory_stats(opts: ServerSelector, ...args: args): Promise<any>
+  async selva_memory_stats(...args: args): Promise<any>
+  async selva_memory_stats(opts: any, ...args: args): Promise<any> {
+    if (typeof opts === 'object') {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue(
+          { command: 'selva_memory_stats', args, resolve, reject },
+          opts
+        )
+      })
+    } else {
+      return new Promise((resolve, reject) => {
+        this.addCommandToQueue({
+          command: 'selva_memory_stats',
+          args: [opts, ...args],
+          resolve,
+          reject,
+        })
+      })
+    }
+  }
 }
 
 export default RedisMethods
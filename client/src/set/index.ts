@@ -108,7 +108,11 @@ async function set(
     }
 
     for (const alias of aliases) {
-      const id = await client.redis.hget(`___selva_aliases`, alias)
+      const id = await client.redis.selva_resolve_nodeid(
+        '___selva_hierarchy',
+        '',
+        alias
+      )
       if (id) {
         payload.$id = id
         break
@@ -147,7 +151,11 @@ async function setWithMeta(
     }
 
     for (const alias of aliases) {
-      const id = await client.redis.hget(`___selva_aliases`, alias)
+      const id = await client.redis.selva_resolve_nodeid(
+        '___selva_hierarchy',
+        '',
+        alias
+      )
       if (id) {
         payload.$id = id
         break
@@ -29,7 +29,11 @@ async function update(
     }
 
     for (const alias of aliases) {
-      const id = await client.redis.hget(`___selva_aliases`, alias)
+      const id = await client.redis.selva_resolve_nodeid(
+        '___selva_hierarchy',
+        '',
+        alias
+      )
       if (id) {
         payload.$id = id
         break
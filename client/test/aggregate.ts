@@ -383,6 +383,30 @@ test.serial('simple aggregate', async (t) => {
     }),
     { id: 'root', value: 2 }
   )
+  t.deepEqualIgnoreOrder(
+    await client.get({
+      $id: 'root',
+      id: true,
+      value: {
+        $aggregate: {
+          $function: { $name: 'countUniqueApprox', $args: ['value'] },
+          $traverse: 'descendants',
+          $filter: [
+            {
+              $field: 'type',
+              $operator: '=',
+              $value: 'match',
+            },
+            {
+              $field: 'value',
+              $operator: 'exists',
+            },
+          ],
+        },
+      },
+    }),
+    { id: 'root', value: 4 }
+  )
 
   let err = await t.throwsAsync(
     client.get({
@@ -763,3 +787,79 @@ test.serial('sorted aggregate', async (t) => {
   await client.delete('root')
   await client.destroy()
 })
+
+test.serial('aggregate group_by', async (t) => {
+  const client = connect({ port: port }, { loglevel: 'info' })
+
+  for (let i = 0; i < 12; i++) {
+    await client.set({
+      $id: 'ma' + i,
+      type: 'match',
+      name: `match ${i}`,
+      value: i,
+      status: i % 3,
+    })
+  }
+  await client.set({
+    type: 'match',
+    name: 'match 999',
+  })
+  await client.set({
+    $id: 'ma99',
+    type: 'match',
+    name: 'match 99',
+    status: 3,
+  })
+
+  const toObj = (res: any[]) => {
+    const o = {}
+    for (let i = 0; i < res.length; i += 2) {
+      o[res[i]] = Number(res[i + 1])
+    }
+    return o
+  }
+  const aggregate = async (fn: string, field: string) =>
+    toObj(
+      await client.redis.selva_hierarchy_aggregate(
+        '',
+        '___selva_hierarchy',
+        fn,
+        'descendants',
+        'fields',
+        field,
+        'group_by',
+        'status',
+        'root',
+        '"ma" e'
+      )
+    )
+
+  // The sum, avg, min and max of a group without values are skipped.
+  t.deepEqual(await aggregate('0', ''), { 0: 4, 1: 4, 2: 4, 3: 1 })
+  t.deepEqual(await aggregate('1', 'value'), { 0: 4, 1: 4, 2: 4, 3: 0 })
+  t.deepEqual(await aggregate('2', 'value'), { 0: 18, 1: 22, 2: 26 })
+  t.deepEqual(await aggregate('3', 'value'), { 0: 4.5, 1: 5.5, 2: 6.5 })
+  t.deepEqual(await aggregate('4', 'value'), { 0: 0, 1: 1, 2: 2 })
+  t.deepEqual(await aggregate('5', 'value'), { 0: 9, 1: 10, 2: 11 })
+  t.deepEqual(await aggregate('6', 'value'), { 0: 4, 1: 4, 2: 4, 3: 0 })
+
+  // The avg, min and max of nothing are null.
+  for (const fn of ['3', '4', '5']) {
+    t.is(
+      await client.redis.selva_hierarchy_aggregate(
+        '',
+        '___selva_hierarchy',
+        fn,
+        'descendants',
+        'fields',
+        'value',
+        'root',
+        '"xx" e'
+      ),
+      null
+    )
+  }
+
+  await client.delete('root')
+  await client.destroy()
+})
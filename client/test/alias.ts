@@ -8,6 +8,17 @@ import { wait } from '@saulx/utils'
 let srv
 let port: number
 
+async function getAliases(client) {
+  const res = await client.redis.selva_hierarchy_aliases('___selva_hierarchy')
+  const aliases = {}
+
+  for (let i = 0; i < res.length; i += 2) {
+    aliases[res[i]] = res[i + 1]
+  }
+
+  return aliases
+}
+
 test.before(async (t) => {
   port = await getPort()
   srv = await start({
@@ -175,7 +186,7 @@ test.serial('set alias and get by $alias', async (t) => {
     }
   )
 
-  t.deepEqualIgnoreOrder(await client.redis.hgetall('___selva_aliases'), {
+  t.deepEqualIgnoreOrder(await getAliases(client), {
     nice_match: match1,
   })
 
@@ -218,7 +229,7 @@ test.serial('set alias and get by $alias', async (t) => {
     }
   )
 
-  t.deepEqualIgnoreOrder(await client.redis.hgetall('___selva_aliases'), {
+  t.deepEqualIgnoreOrder(await getAliases(client), {
     nice_match: match2,
     very_nice_match: match2,
   })
@@ -273,7 +284,7 @@ test.serial('set alias and get by $alias', async (t) => {
     }
   )
 
-  t.deepEqualIgnoreOrder(await client.redis.hgetall('___selva_aliases'), {
+  t.deepEqualIgnoreOrder(await getAliases(client), {
     ok_match: match1,
     nice_match: match2,
   })
@@ -316,7 +327,7 @@ test.serial('set new entry with alias', async (t) => {
     }
   )
 
-  t.deepEqualIgnoreOrder(await client.redis.hgetall('___selva_aliases'), {
+  t.deepEqualIgnoreOrder(await getAliases(client), {
     nice_match: match1,
   })
 
@@ -329,6 +340,33 @@ test.serial('set new entry with alias', async (t) => {
   await client.destroy()
 })
 
+test.serial('resolve many ids and aliases at once', async (t) => {
+  const client = connect({ port }, { loglevel: 'info' })
+
+  const match1 = await client.set({
+    type: 'match',
+    aliases: ['match_one'],
+  })
+  const match2 = await client.set({
+    type: 'match',
+  })
+
+  t.deepEqual(
+    await client.redis.selva_resolve_nodeids(
+      '___selva_hierarchy',
+      match2,
+      'match_one',
+      'manone',
+      'a_long_alias_that_is_not_an_id',
+      match1
+    ),
+    [match2, match1, null, null, match1]
+  )
+
+  await client.delete('root')
+  await client.destroy()
+})
+
 test.serial('set existing entry with alias', async (t) => {
   const client = connect({ port }, { loglevel: 'info' })
 
@@ -597,7 +635,7 @@ test.serial('delete all aliases of a node', async (t) => {
     }
   )
 
-  t.deepEqual(await client.redis.hgetall('___selva_aliases'), null)
+  t.deepEqual(await getAliases(client), {})
 
   await client.delete('root')
   await client.destroy()
@@ -626,7 +664,7 @@ test.serial('alias and merge = false', async (t) => {
     //aliases: [],
   })
 
-  t.deepEqual(await client.redis.hgetall('___selva_aliases'), {
+  t.deepEqual(await getAliases(client), {
     nice_match: match1,
     nicer_match: match2,
   })
@@ -674,7 +712,7 @@ test.serial('ways to clear aliases', async (t) => {
     aliases: [],
   })
 
-  t.deepEqual(await client.redis.hgetall('___selva_aliases'), null)
+  t.deepEqual(await getAliases(client), {})
   t.deepEqual(await client.redis.selva_object_get('', match1, 'aliases'), null)
   t.deepEqual(await client.redis.selva_object_get('', match2, 'aliases'), null)
 
@@ -29,6 +29,7 @@ export const getIndexingState = async (client: SelvaClient) => {
       tot_max_ave: l[i + 1][1],
       ind_take_max_ave: l[i + 1][2],
       card: l[i + 1][3],
+      valid_pct: l[i + 1][4],
     }
 
     stateMap[l[i]] = state
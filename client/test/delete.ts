@@ -343,3 +343,55 @@ test.serial('return the ids of deleted nodes', async (t) => {
     'root',
   ])
 })
+
+test.serial('lazy delete', async (t) => {
+  const client = connect(
+    {
+      port,
+    },
+    { loglevel: 'info' }
+  )
+
+  const a = await client.set({
+    type: 'someTestThing',
+    title: { en: 'a' },
+    children: [...Array(100)].map((_, i) => ({
+      type: 'someTestThing',
+      title: { en: `x${i}` },
+      things: ['a', 'b', 'c'],
+    })),
+  })
+  const b = await client.set({
+    type: 'someTestThing',
+    title: { en: 'b' },
+  })
+
+  const nrDeleted = await client.delete({
+    $id: a,
+    $lazy: true,
+  })
+  t.deepEqual(nrDeleted, 101)
+
+  const res = await client.get({
+    $id: 'root',
+    $language: 'en',
+    things: {
+      id: true,
+      $list: {
+        $find: {
+          $traverse: 'descendants',
+        },
+      },
+    },
+  })
+  t.deepEqual(res, { things: [{ id: b }] })
+
+  await wait(100)
+  const info: string = await client.redis.info('selva')
+  const m = info.match(/lazy_free_pending=(\d+),lazy_free_freed=(\d+)/)
+  t.truthy(m)
+  t.deepEqual(Number(m[1]), 0)
+  t.true(Number(m[2]) >= 101)
+
+  await client.destroy()
+})
@@ -1293,3 +1293,67 @@ test.serial('wildcard find with exclusions', async (t) => {
     ]
   )
 })
+
+test.serial('shortest path and k-hop over edge fields', async (t) => {
+  const client = connect({ port })
+
+  // Create nodes
+  await client.redis.selva_modify('root', '', '0', 'o.a', 'hello')
+  await client.redis.selva_modify('ma1', '', '0', 'o.a', 'hello')
+  await client.redis.selva_modify('ma2', '', '0', 'o.a', 'hello')
+  await client.redis.selva_modify('ma3', '', '0', 'o.a', 'hello')
+  await client.redis.selva_modify('ma4', '', '0', 'o.a', 'hello')
+  await client.redis.selva_modify('ma5', '', '0', 'o.a', 'hello')
+
+  // Create edges
+  await client.redis.selva_modify('ma1', '', '5', 'a', createRecord(setRecordDefCstring, {
+    op_set_type: 1,
+    delete_all: 0,
+    constraint_id: 0,
+    $add: joinIds(['ma2', 'ma3']),
+    $delete: null,
+    $value: null,
+  }))
+  await client.redis.selva_modify('ma2', '', '5', 'a', createRecord(setRecordDefCstring, {
+    op_set_type: 1,
+    delete_all: 0,
+    constraint_id: 0,
+    $add: joinIds(['ma4']),
+    $delete: null,
+    $value: null,
+  }))
+  await client.redis.selva_modify('ma4', '', '5', 'b', createRecord(setRecordDefCstring, {
+    op_set_type: 1,
+    delete_all: 0,
+    constraint_id: 0,
+    $add: joinIds(['ma5']),
+    $delete: null,
+    $value: null,
+  }))
+
+  t.deepEqual(
+    await client.redis.selva_hierarchy_path('___selva_hierarchy', 'ma1', 'ma5', 'a\nb'),
+    [ 'ma1', 'ma2', 'ma4', 'ma5' ]
+  )
+  t.deepEqual(
+    await client.redis.selva_hierarchy_path('___selva_hierarchy', 'ma1', 'ma5', 'a'),
+    []
+  )
+  t.deepEqual(
+    await client.redis.selva_hierarchy_path('___selva_hierarchy', 'edge_filter', '$0 "ma2" d L', 'ma1', 'ma4', 'a\nb'),
+    []
+  )
+
+  t.deepEqual(
+    await client.redis.selva_hierarchy_khop('___selva_hierarchy', 'ma1', '2', 'a\nb'),
+    [ 'ma2', 'ma3', 'ma4' ]
+  )
+  t.deepEqual(
+    await client.redis.selva_hierarchy_khop('___selva_hierarchy', 'count', 'ma1', '3', 'a\nb'),
+    4
+  )
+  t.deepEqual(
+    await client.redis.selva_hierarchy_khop('___selva_hierarchy', 'limit', '1', 'ma1', '3', 'a\nb'),
+    [ 'ma2' ]
+  )
+})
@@ -0,0 +1,169 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async (t) => {
+  port = await getPort()
+  srv = await start({
+    port,
+    selvaOptions: ['FIND_CACHE_MAX_BYTES', '1048576'],
+  })
+
+  await wait(100)
+})
+
+test.beforeEach(async (t) => {
+  const client = connect({ port }, { loglevel: 'info' })
+
+  await client.redis.flushall()
+  await client.updateSchema({
+    languages: ['en'],
+    types: {
+      match: {
+        prefix: 'ma',
+        fields: {
+          title: { type: 'string' },
+          value: { type: 'number' },
+          ref: { type: 'reference' },
+        },
+      },
+    },
+  })
+
+  // A small delay is needed after setting the schema
+  await wait(100)
+
+  await client.destroy()
+})
+
+test.after(async (t) => {
+  const client = connect({ port })
+  await client.delete('root')
+  await client.destroy()
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+const getStat = async (client, name: string) => {
+  const info: string = await client.redis.info('selva')
+  const m = info.match(new RegExp(`selva_find_cache:.*${name}=(\\d+)`))
+  return m ? Number(m[1]) : 0
+}
+
+test.serial('cached find results are invalidated by changes', async (t) => {
+  const client = connect({ port })
+
+  await client.set({ $id: 'ma1', title: 'a', value: 1 })
+  await client.set({ $id: 'ma2', title: 'b', value: 2 })
+
+  const find = () =>
+    client.redis.selva_hierarchy_find(
+      '',
+      '___selva_hierarchy',
+      'descendants',
+      'order',
+      'value',
+      'asc',
+      'fields',
+      'title',
+      'root',
+      '#1 "value" g I'
+    )
+
+  t.deepEqual(await find(), [['ma2', ['title', 'b']]])
+  const hits = await getStat(client, 'hits')
+  t.deepEqual(await find(), [['ma2', ['title', 'b']]])
+  t.is(await getStat(client, 'hits'), hits + 1)
+
+  // A field change in the result.
+  await client.set({ $id: 'ma2', title: 'c' })
+  t.deepEqual(await find(), [['ma2', ['title', 'c']]])
+
+  // A node starts matching the filter.
+  await client.set({ $id: 'ma1', value: 3 })
+  t.deepEqual(await find(), [
+    ['ma2', ['title', 'c']],
+    ['ma1', ['title', 'a']],
+  ])
+
+  // A new node.
+  await client.set({ $id: 'ma3', title: 'd', value: 4 })
+  t.deepEqual(await find(), [
+    ['ma2', ['title', 'c']],
+    ['ma1', ['title', 'a']],
+    ['ma3', ['title', 'd']],
+  ])
+
+  // A deleted node.
+  await client.delete('ma1')
+  t.deepEqual(await find(), [
+    ['ma2', ['title', 'c']],
+    ['ma3', ['title', 'd']],
+  ])
+
+  t.true((await getStat(client, 'invalidations')) >= 4)
+
+  await client.destroy()
+})
+
+test.serial('filter arguments are part of the cache key', async (t) => {
+  const client = connect({ port })
+
+  await client.set({ $id: 'ma1', title: 'a', value: 1 })
+  await client.set({ $id: 'ma2', title: 'b', value: 2 })
+
+  const find = (v: string) =>
+    client.redis.selva_hierarchy_find(
+      '',
+      '___selva_hierarchy',
+      'descendants',
+      'root',
+      '"value" g @1 F',
+      v
+    )
+
+  t.deepEqual(await find('1'), ['ma1'])
+  t.deepEqual(await find('2'), ['ma2'])
+  t.deepEqual(await find('1'), ['ma1'])
+
+  await client.set({ $id: 'ma2', value: 1 })
+  t.deepEqual((await find('1')).sort(), ['ma1', 'ma2'])
+  t.deepEqual(await find('2'), [])
+
+  await client.destroy()
+})
+
+test.serial('finds dereferencing other nodes are not cached', async (t) => {
+  const client = connect({ port })
+
+  await client.set({ $id: 'ma1', title: 'a' })
+  await client.set({ $id: 'ma2', title: 'b' })
+  await client.set({ $id: 'ma3', parents: ['ma2'], ref: 'ma1' })
+
+  const find = () =>
+    client.redis.selva_hierarchy_find(
+      '',
+      '___selva_hierarchy',
+      'children',
+      'fields',
+      'ref.title',
+      'ma2'
+    )
+
+  t.true(JSON.stringify(await find()).includes('"a"'))
+  const hits = await getStat(client, 'hits')
+  await find()
+  t.is(await getStat(client, 'hits'), hits)
+
+  // ma1 isn't traversed by the find.
+  await client.set({ $id: 'ma1', title: 'c' })
+  t.true(JSON.stringify(await find()).includes('"c"'))
+
+  await client.destroy()
+})
@@ -0,0 +1,291 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async (t) => {
+  port = await getPort()
+  srv = await start({
+    port,
+  })
+  await wait(100)
+})
+
+test.beforeEach(async (t) => {
+  const client = connect({ port }, { loglevel: 'info' })
+
+  await client.redis.flushall()
+  await client.updateSchema({
+    languages: ['en'],
+    rootType: {
+      fields: {
+      },
+    },
+    types: {
+      match: {
+        prefix: 'ma',
+        fields: {
+          name: { type: 'string' },
+          value: { type: 'number' },
+        },
+      },
+    },
+  })
+
+  await client.destroy()
+})
+
+test.after(async (t) => {
+  const client = connect({ port })
+  await client.delete('root')
+  await client.destroy()
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+test.serial('paginate an unordered find with a cursor', async (t) => {
+  const client = connect({ port })
+
+  for (let i = 0; i < 10; i++) {
+    await client.set({
+      $id: `ma${i}`,
+      value: i,
+    })
+  }
+
+  const ids = []
+  let cursor = ''
+  let pages = 0
+  do {
+    const [res, next] = await client.redis.selva_hierarchy_find(
+      '',
+      '___selva_hierarchy',
+      'descendants',
+      'limit',
+      3,
+      'cursor',
+      cursor,
+      'root'
+    )
+    t.true(res.length <= 3)
+    ids.push(...res)
+    cursor = next
+    pages++
+  } while (cursor)
+
+  t.is(pages, 4)
+  t.deepEqualIgnoreOrder(ids, [...Array(10).keys()].map((i) => `ma${i}`))
+
+  await client.destroy()
+})
+
+test.serial('paginate an unordered find over multiple heads', async (t) => {
+  const client = connect({ port })
+
+  await client.set({ $id: 'ma0', value: 0 })
+  await client.set({ $id: 'ma1', value: 1 })
+  for (let i = 0; i < 4; i++) {
+    await client.set({ $id: `ma0${i}`, parents: ['ma0'] })
+  }
+  for (let i = 0; i < 3; i++) {
+    await client.set({ $id: `ma1${i}`, parents: ['ma1'] })
+  }
+
+  const ids = []
+  let cursor = ''
+  let pages = 0
+  do {
+    const [res, next] = await client.redis.selva_hierarchy_find(
+      '',
+      '___selva_hierarchy',
+      'children',
+      'limit',
+      3,
+      'cursor',
+      cursor,
+      'ma0'.padEnd(10, '\0') + 'ma1'.padEnd(10, '\0')
+    )
+    t.true(res.length <= 3)
+    ids.push(...res)
+    cursor = next
+    pages++
+  } while (cursor)
+
+  t.is(pages, 3)
+  t.deepEqualIgnoreOrder(ids, [
+    'ma00',
+    'ma01',
+    'ma02',
+    'ma03',
+    'ma10',
+    'ma11',
+    'ma12',
+  ])
+
+  await client.destroy()
+})
+
+test.serial('unordered cursor expires on removal', async (t) => {
+  const client = connect({ port })
+
+  for (let i = 0; i < 5; i++) {
+    await client.set({
+      $id: `ma${i}`,
+      value: i,
+    })
+  }
+
+  const [res, cursor] = await client.redis.selva_hierarchy_find(
+    '',
+    '___selva_hierarchy',
+    'descendants',
+    'limit',
+    2,
+    'cursor',
+    '',
+    'root'
+  )
+  t.is(res.length, 2)
+  t.truthy(cursor)
+
+  // Adding a node doesn't expire the cursor.
+  await client.set({
+    $id: 'ma5',
+    value: 5,
+  })
+
+  // The same page can be fetched again until the next page is fetched.
+  const page1 = await client.redis.selva_hierarchy_find(
+    '',
+    '___selva_hierarchy',
+    'descendants',
+    'limit',
+    2,
+    'cursor',
+    cursor,
+    'root'
+  )
+  const page2 = await client.redis.selva_hierarchy_find(
+    '',
+    '___selva_hierarchy',
+    'descendants',
+    'limit',
+    2,
+    'cursor',
+    cursor,
+    'root'
+  )
+  t.deepEqual(page1[0], page2[0])
+  t.truthy(page2[1])
+
+  await client.delete('ma5')
+
+  await t.throwsAsync(
+    client.redis.selva_hierarchy_find(
+      '',
+      '___selva_hierarchy',
+      'descendants',
+      'limit',
+      2,
+      'cursor',
+      cursor,
+      'root'
+    ),
+    { message: /cursor expired/ }
+  )
+
+  await client.destroy()
+})
+
+test.serial('paginate an ordered find with a cursor', async (t) => {
+  const client = connect({ port })
+
+  for (let i = 0; i < 10; i++) {
+    await client.set({
+      $id: `ma${i}`,
+      value: i * 10,
+    })
+  }
+
+  const first = await client.redis.selva_hierarchy_find(
+    '',
+    '___selva_hierarchy',
+    'descendants',
+    'order',
+    'value',
+    'asc',
+    'limit',
+    4,
+    'cursor',
+    '',
+    'root'
+  )
+  t.deepEqual(first[0], ['ma0', 'ma1', 'ma2', 'ma3'])
+  t.truthy(first[1])
+
+  // The cursor remains valid after modifications.
+  await client.set({
+    $id: 'maa',
+    value: 15,
+  })
+  await client.set({
+    $id: 'mab',
+    value: 45,
+  })
+
+  const second = await client.redis.selva_hierarchy_find(
+    '',
+    '___selva_hierarchy',
+    'descendants',
+    'order',
+    'value',
+    'asc',
+    'limit',
+    4,
+    'cursor',
+    first[1],
+    'root'
+  )
+  t.deepEqual(second[0], ['ma4', 'mab', 'ma5', 'ma6'])
+  t.truthy(second[1])
+
+  const third = await client.redis.selva_hierarchy_find(
+    '',
+    '___selva_hierarchy',
+    'descendants',
+    'order',
+    'value',
+    'asc',
+    'limit',
+    4,
+    'cursor',
+    second[1],
+    'root'
+  )
+  t.deepEqual(third[0], ['ma7', 'ma8', 'ma9'])
+  t.is(third[1], null)
+
+  await client.destroy()
+})
+
+test.serial('cursor requires a limit', async (t) => {
+  const client = connect({ port })
+
+  await t.throwsAsync(
+    client.redis.selva_hierarchy_find(
+      '',
+      '___selva_hierarchy',
+      'descendants',
+      'cursor',
+      '',
+      'root'
+    )
+  )
+
+  await client.destroy()
+})
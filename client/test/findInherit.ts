@@ -326,3 +326,106 @@ test.serial('find - inherit by type', async (t) => {
 
   await client.destroy()
 })
+
+test.serial('find - inherit - resolution cache', async (t) => {
+  const client = connect({ port: port }, { loglevel: 'info' })
+
+  await client.updateSchema({
+    languages: ['en'],
+    types: {
+      genre: {
+        prefix: 'ge',
+        fields: {
+          name: { type: 'string' },
+          icon: { type: 'string' },
+        },
+      },
+      book: {
+        prefix: 'bk',
+        fields: {
+          name: { type: 'string' },
+        },
+      },
+    },
+  })
+
+  // A small delay is needed after setting the schema
+  await wait(100)
+
+  // A chain of genres with a book at the bottom of each genre.
+  await client.set({
+    type: 'genre',
+    $id: 'ge1',
+    icon: 'ge1.png',
+    children: [
+      {
+        type: 'genre',
+        $id: 'ge2',
+        children: [
+          {
+            type: 'genre',
+            $id: 'ge3',
+            children: [
+              { type: 'book', $id: 'bk1', name: 'Book 1' },
+              { type: 'book', $id: 'bk2', name: 'Book 2' },
+            ],
+          },
+          { type: 'book', $id: 'bk3', name: 'Book 3' },
+        ],
+      },
+    ],
+  })
+
+  const find = () =>
+    client.redis.selva_hierarchy_find(
+      '',
+      '___selva_hierarchy',
+      'descendants',
+      'order',
+      'name',
+      'asc',
+      'inherit_rpn',
+      '{"name","^ge:icon"}',
+      'root',
+      '"bk" e'
+    )
+  const getHits = async () => {
+    const info: string = await client.redis.info('selva')
+    const m = info.match(/selva_inherit:cache_hits=(\d+)/)
+    return m ? Number(m[1]) : 0
+  }
+
+  t.deepEqual(await find(), [
+    ['bk1', ['name', 'Book 1', 'icon', ['ge1', 'ge1.png']]],
+    ['bk2', ['name', 'Book 2', 'icon', ['ge1', 'ge1.png']]],
+    ['bk3', ['name', 'Book 3', 'icon', ['ge1', 'ge1.png']]],
+  ])
+
+  const hits = await getHits()
+  await find()
+  t.true((await getHits()) > hits)
+
+  // A field change must invalidate the cached resolutions.
+  await client.set({
+    $id: 'ge3',
+    icon: 'ge3.png',
+  })
+  t.deepEqual(await find(), [
+    ['bk1', ['name', 'Book 1', 'icon', ['ge3', 'ge3.png']]],
+    ['bk2', ['name', 'Book 2', 'icon', ['ge3', 'ge3.png']]],
+    ['bk3', ['name', 'Book 3', 'icon', ['ge1', 'ge1.png']]],
+  ])
+
+  // And so must a hierarchy change.
+  await client.set({
+    $id: 'bk3',
+    parents: ['ge3'],
+  })
+  t.deepEqual(await find(), [
+    ['bk1', ['name', 'Book 1', 'icon', ['ge3', 'ge3.png']]],
+    ['bk2', ['name', 'Book 2', 'icon', ['ge3', 'ge3.png']]],
+    ['bk3', ['name', 'Book 3', 'icon', ['ge3', 'ge3.png']]],
+  ])
+
+  await client.destroy()
+})
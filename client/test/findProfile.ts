@@ -0,0 +1,153 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async (t) => {
+  port = await getPort()
+  srv = await start({
+    port,
+  })
+
+  await wait(100)
+})
+
+test.beforeEach(async (t) => {
+  const client = connect({ port }, { loglevel: 'info' })
+
+  await client.redis.flushall()
+  await client.updateSchema({
+    languages: ['en'],
+    types: {
+      match: {
+        prefix: 'ma',
+        fields: {
+          title: { type: 'string' },
+          value: { type: 'number' },
+        },
+      },
+    },
+  })
+
+  // A small delay is needed after setting the schema
+  await wait(100)
+
+  await client.destroy()
+})
+
+test.after(async (t) => {
+  const client = connect({ port })
+  await client.delete('root')
+  await client.destroy()
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+const toObj = (l: any[]) => {
+  const o = {}
+  for (let i = 0; i < l.length; i += 2) {
+    o[l[i]] = Number(l[i + 1])
+  }
+  return o
+}
+
+test.serial('profile a find', async (t) => {
+  const client = connect({ port })
+
+  for (let i = 0; i < 10; i++) {
+    await client.set({ $id: `ma${i}`, title: `m${i}`, value: i })
+  }
+
+  const [res, profile] = await client.redis.selva_hierarchy_find(
+    '',
+    '___selva_hierarchy',
+    'descendants',
+    'order',
+    'value',
+    'asc',
+    'fields',
+    'title',
+    'profile',
+    'root',
+    '"value" g #5 I'
+  )
+  t.deepEqual(res, [
+    ['ma0', ['title', 'm0']],
+    ['ma1', ['title', 'm1']],
+    ['ma2', ['title', 'm2']],
+    ['ma3', ['title', 'm3']],
+    ['ma4', ['title', 'm4']],
+  ])
+
+  const p = toObj(profile)
+  t.is(p.visited, 10)
+  t.is(p.taken, 5)
+  t.is(p.restored, 0)
+  t.is(p.indexed, 0)
+  t.true(p.filter_us > 0)
+  t.true(p.sort_us > 0)
+  t.true(p.reply_us > 0)
+  t.true(p.bytes > 0)
+
+  await client.destroy()
+})
+
+test.serial('profile a find narrowed by a descendant constraint', async (t) => {
+  const client = connect({ port })
+
+  await client.set({ $id: 'maa', title: 'a' })
+  await client.set({ $id: 'mab', title: 'b' })
+  for (let i = 0; i < 5; i++) {
+    await client.set({ $id: `maa${i}`, parents: ['maa'], value: i })
+    await client.set({ $id: `mab${i}`, parents: ['mab'], value: i })
+  }
+
+  const [res, profile] = await client.redis.selva_hierarchy_find(
+    '',
+    '___selva_hierarchy',
+    'descendants',
+    'profile',
+    'root',
+    '"maa" p'
+  )
+  t.deepEqualIgnoreOrder(res, ['maa0', 'maa1', 'maa2', 'maa3', 'maa4'])
+
+  // Only the subtree of maa is traversed.
+  const p = toObj(profile)
+  t.is(p.visited, 6)
+  t.is(p.taken, 5)
+
+  await client.destroy()
+})
+
+test.serial('profile an aggregate', async (t) => {
+  const client = connect({ port })
+
+  for (let i = 0; i < 10; i++) {
+    await client.set({ $id: `ma${i}`, title: `m${i}`, value: i })
+  }
+
+  const [res, profile] = await client.redis.selva_hierarchy_aggregate(
+    '',
+    '___selva_hierarchy',
+    '2',
+    'descendants',
+    'fields',
+    'value',
+    'profile',
+    'root',
+    '"value" g #5 I'
+  )
+  t.is(Number(res), 10)
+
+  const p = toObj(profile)
+  t.is(p.visited, 10)
+  t.is(p.taken, 5)
+
+  await client.destroy()
+})
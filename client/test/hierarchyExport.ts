@@ -0,0 +1,158 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+import { tmpdir } from 'os'
+import { join } from 'path'
+import { unlinkSync } from 'fs'
+
+let srv
+let port: number
+let dir: string
+let exportPath: string
+
+test.before(async (t) => {
+  port = await getPort()
+  dir = join(tmpdir(), `selva-export-${port}`)
+  exportPath = 'export.bin'
+  srv = await start({
+    port,
+    dir,
+  })
+  await wait(100)
+})
+
+test.beforeEach(async (t) => {
+  const client = connect({ port }, { loglevel: 'info' })
+
+  await client.redis.flushall()
+  await client.updateSchema({
+    languages: ['en', 'de', 'nl'],
+    rootType: {
+      fields: {
+      },
+    },
+    types: {
+      match: {
+        prefix: 'ma',
+        fields: {
+          title: { type: 'text' },
+          value: { type: 'number' },
+          ref: { type: 'reference' },
+        },
+      },
+    },
+  })
+
+  await client.destroy()
+})
+
+test.after(async (t) => {
+  const client = connect({ port })
+  await client.delete('root')
+  await client.destroy()
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+  try {
+    unlinkSync(join(dir, exportPath))
+  } catch (e) {}
+})
+
+async function waitExport(client) {
+  for (let i = 0; i < 100; i++) {
+    const info: string = await client.redis.info('selva')
+    const m = info.match(/export_child_pid=(\d+),export_last_status=([^\r\n]*)/)
+    if (m && m[1] === '0') {
+      return m[2]
+    }
+    await wait(50)
+  }
+  return null
+}
+
+test.serial('export and import a subtree', async (t) => {
+  const client = connect({ port })
+
+  await client.set({
+    $id: 'ma1',
+    title: { en: 'hello' },
+    value: 10,
+    children: [
+      {
+        $id: 'ma2',
+        title: { en: 'hallo' },
+        value: 11,
+        ref: 'ma3',
+      },
+      {
+        $id: 'ma3',
+        title: { en: 'hoi' },
+        value: 12,
+      }
+    ],
+  })
+
+  const pid = await client.redis.selva_hierarchy_export('___selva_hierarchy', exportPath, 'ma1')
+  t.true(pid > 0)
+  t.truthy(await waitExport(client))
+
+  await client.delete({ $id: 'ma1' })
+  t.deepEqual(await client.get({ $id: 'ma1', id: true }), { $isNull: true })
+
+  t.deepEqual(await client.redis.selva_hierarchy_import('___selva_hierarchy', 'FILE', exportPath), 1)
+
+  t.deepEqual(
+    await client.get({
+      $id: 'ma1',
+      id: true,
+      title: true,
+      value: true,
+      d: {
+        $list: {
+          $sort: { $field: 'value', $order: 'asc' },
+          $find: {
+            $traverse: 'descendants',
+          }
+        },
+        id: true,
+        title: true,
+        value: true,
+        ref: true,
+      },
+    }),
+    {
+      id: 'ma1',
+      title: { en: 'hello' },
+      value: 10,
+      d: [
+        { id: 'ma2', title: { en: 'hallo' }, value: 11, ref: 'ma3' },
+        { id: 'ma3', title: { en: 'hoi' }, value: 12 },
+      ],
+    }
+  )
+
+  await client.destroy()
+})
+
+test.serial('import fails with a missing file', async (t) => {
+  const client = connect({ port })
+
+  await t.throwsAsync(client.redis.selva_hierarchy_import('___selva_hierarchy', 'FILE', `${exportPath}.nonexistent`))
+
+  await client.destroy()
+})
+
+test.serial('export and import reject paths outside of the Redis dir', async (t) => {
+  const client = connect({ port })
+
+  await client.set({ $id: 'ma1', value: 1 })
+
+  for (const path of [join(tmpdir(), 'selva-export.bin'), '../export.bin', '..', '']) {
+    await t.throwsAsync(client.redis.selva_hierarchy_export('___selva_hierarchy', path, 'ma1'))
+    await t.throwsAsync(client.redis.selva_hierarchy_import('___selva_hierarchy', 'FILE', path))
+  }
+
+  await client.destroy()
+})
@@ -0,0 +1,149 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async (t) => {
+  port = await getPort()
+  srv = await start({
+    port,
+  })
+
+  await wait(100)
+})
+
+test.beforeEach(async (t) => {
+  const client = connect({ port }, { loglevel: 'info' })
+
+  await client.redis.flushall()
+  await client.updateSchema({
+    languages: ['en'],
+    types: {
+      match: {
+        prefix: 'ma',
+        fields: {
+          title: { type: 'string' },
+          value: { type: 'number' },
+        },
+      },
+    },
+  })
+
+  // A small delay is needed after setting the schema
+  await wait(100)
+
+  await client.destroy()
+})
+
+test.after(async (t) => {
+  const client = connect({ port })
+  await client.delete('root')
+  await client.destroy()
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+const toObject = (reply: any[]) => {
+  const o: any = {}
+  for (let i = 0; i < reply.length; i += 2) {
+    o[reply[i]] = reply[i + 1]
+  }
+  return o
+}
+
+test.serial('subtree memory usage', async (t) => {
+  const client = connect({ port })
+
+  await client.set({
+    $id: 'ma1',
+    title: 'match 1',
+    value: 1,
+    children: [
+      { $id: 'ma2', title: 'match 2', value: 2 },
+      { $id: 'ma3', title: 'match 3', value: 3 },
+    ],
+  })
+
+  const usage = toObject(
+    await client.redis.selva_hierarchy_memusage('___selva_hierarchy', 'ma1')
+  )
+  t.is(usage.nodes, 3)
+  t.is(usage.detached, 0)
+  t.true(usage.node > 0)
+  t.true(usage.strings > 0)
+  t.is(
+    usage.total,
+    usage.node +
+      usage.objects +
+      usage.strings +
+      usage.sets +
+      usage.arrays +
+      usage.edges +
+      usage.markers
+  )
+  t.true(usage.age_min <= usage.age_mean)
+  t.true(usage.age_mean <= usage.age_max)
+
+  const types = toObject(usage.types)
+  t.deepEqual(Object.keys(types), ['ma'])
+  t.is(toObject(types.ma).nodes, 3)
+  t.is(toObject(types.ma).bytes, usage.total)
+
+  const head = toObject(
+    await client.redis.selva_hierarchy_memusage('___selva_hierarchy', 'ma1', 0)
+  )
+  t.is(head.nodes, 1)
+  t.true(head.total < usage.total)
+
+  await t.throwsAsync(
+    client.redis.selva_hierarchy_memusage('___selva_hierarchy', 'ma1', -1)
+  )
+  await t.throwsAsync(
+    client.redis.selva_hierarchy_memusage('___selva_hierarchy', 'ma99')
+  )
+
+  await client.destroy()
+})
+
+test.serial('memory usage does not restore compressed subtrees', async (t) => {
+  const client = connect({ port })
+
+  await client.set({
+    $id: 'ma1',
+    title: 'match 1',
+    value: 1,
+    children: [
+      { $id: 'ma2', title: 'match 2', value: 2 },
+      { $id: 'ma3', title: 'match 3', value: 3 },
+    ],
+  })
+
+  t.deepEqual(
+    await client.redis.selva_hierarchy_compress('___selva_hierarchy', 'ma1'),
+    1
+  )
+
+  const usage = toObject(
+    await client.redis.selva_hierarchy_memusage('___selva_hierarchy', 'root')
+  )
+  t.is(usage.nodes, 2)
+  t.is(usage.detached, 1)
+
+  const inner = toObject(
+    await client.redis.selva_hierarchy_memusage('___selva_hierarchy', 'ma2')
+  )
+  t.is(inner.nodes, 1)
+  t.is(inner.detached, 1)
+
+  t.deepEqualIgnoreOrder(
+    await client.redis.selva_hierarchy_listcompressed('___selva_hierarchy'),
+    ['ma1', 'ma2', 'ma3']
+  )
+
+  await client.destroy()
+})
@@ -210,3 +210,40 @@ test.serial('create max number of indices', async (t) => {
 
   t.pass()
 })
+
+test.serial('explain the query plan', async (t) => {
+  const client = connect({ port })
+  const q = ['', '___selva_hierarchy', 'descendants', 'index', '"value" g #20 I', 'index', '"value" g #50 I', 'explain', 'root', '"value" g #20 I']
+
+  for (let i = 0; i < 100; i++) {
+    await client.set({
+      type: 'match',
+      title: { en: 'a', de: 'b', nl: 'c' },
+      value: i,
+      strValue: `${i % 10}`,
+    })
+  }
+
+  const [[id, type, names, cost, rows, traverseCost]] = await client.redis.selva_hierarchy_find(...q)
+  t.deepEqual(id, 'root')
+  t.deepEqual(type, 'traverse')
+  t.deepEqual(names, [])
+  t.deepEqual(Number(cost), Number(traverseCost))
+  t.true(Number(rows) >= 0)
+
+  for (let i = 0; i < 500; i++) {
+    await client.redis.selva_hierarchy_find(...q.filter((v) => v !== 'explain'))
+  }
+  await wait(2e3)
+  for (let i = 0; i < 500; i++) {
+    await client.redis.selva_hierarchy_find(...q.filter((v) => v !== 'explain'))
+  }
+
+  const [[, type2, names2, cost2, , traverseCost2]] = await client.redis.selva_hierarchy_find(...q)
+  t.true(['index', 'intersect'].includes(type2))
+  t.true(names2.includes('root.J.InZhbHVlIiBnICMyMCBJ'))
+  t.true(Number(cost2) < Number(traverseCost2))
+
+  const r = await client.redis.selva_hierarchy_find(...q.filter((v) => v !== 'explain'))
+  t.deepEqual(r.length, 20)
+})
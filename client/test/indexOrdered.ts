@@ -492,3 +492,84 @@ test.serial('change the sorted field value', async (t) => {
 
   await client.destroy()
 })
+
+test.serial('reposition and delete nodes without rebuilding the index', async (t) => {
+  const client = connect({ port: port }, { loglevel: 'info' })
+
+  await client.set({
+    type: 'league',
+    name: 'league 0',
+  })
+  for (let i = 0; i < chars.length; i++) {
+    await client.set({
+      $id: `le${i + 1}`,
+      type: 'league',
+      name: `league ${i + 1}`,
+      thing: `${chars.charAt(i)}`,
+    })
+  }
+
+  const q = {
+    $id: 'root',
+    id: true,
+    items: {
+      name: true,
+      $list: {
+        $sort: { $field: 'thing', $order: 'asc' },
+        $find: {
+          $traverse: 'descendants',
+          $filter: [
+            {
+              $field: 'type',
+              $operator: '=',
+              $value: 'league',
+            },
+            {
+              $field: 'thing',
+              $operator: 'exists',
+            },
+          ],
+        },
+      },
+    },
+  }
+  const names = Array(chars.length).fill(null).map((_, i) => ({ name: `league ${i + 1}` }))
+
+  for (let i = 0; i < 300; i++) {
+    t.deepEqual(await client.get(q), { id: 'root', items: names })
+    await wait(1)
+  }
+
+  const getCards = async () => (await client.redis.selva_index_list('___selva_hierarchy')).map((v, i) => i % 2 === 0 ? v : v[3])
+  t.deepEqual(await getCards(), [
+    'root.J.B.dGhpbmc=.ImxlIiBl',
+    '36',
+    'root.J.B.dGhpbmc=.InRoaW5nIiBo',
+    '35',
+  ])
+
+  // Move the first node to the end of the ordered index.
+  await client.set({ $id: 'le1', thing: 'ZZ' })
+  t.deepEqual(await client.get(q), { id: 'root', items: [ ...names.slice(1), names[0] ] })
+  t.deepEqual(await getCards(), [
+    'root.J.B.dGhpbmc=.ImxlIiBl',
+    '36',
+    'root.J.B.dGhpbmc=.InRoaW5nIiBo',
+    '35',
+  ])
+
+  // Delete a leaf node.
+  await client.delete('le2')
+  t.deepEqual(await client.get(q), { id: 'root', items: [ ...names.slice(2), names[0] ] })
+  t.deepEqual(await getCards(), [
+    'root.J.B.dGhpbmc=.ImxlIiBl',
+    '35',
+    'root.J.B.dGhpbmc=.InRoaW5nIiBo',
+    '34',
+  ])
+
+  const validPct = (await client.redis.selva_index_list('___selva_hierarchy')).filter((_, i) => i % 2 === 1).map((v) => Number(v[4]))
+  t.true(validPct.every((v) => v > 0 && v <= 100))
+
+  await client.destroy()
+})
@@ -0,0 +1,79 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async (t) => {
+  port = await getPort()
+  srv = await start({
+    port,
+  })
+
+  await wait(100)
+})
+
+test.beforeEach(async (t) => {
+  const client = connect({ port }, { loglevel: 'info' })
+
+  await client.redis.flushall()
+  await client.updateSchema({
+    languages: ['en'],
+    types: {
+      match: {
+        prefix: 'ma',
+        fields: {
+          title: { type: 'string' },
+          value: { type: 'number' },
+        },
+      },
+    },
+  })
+
+  // A small delay is needed after setting the schema
+  await wait(100)
+
+  await client.destroy()
+})
+
+test.after(async (t) => {
+  const client = connect({ port })
+  await client.delete('root')
+  await client.destroy()
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+test.serial('memory stats per arena', async (t) => {
+  const client = connect({ port })
+
+  for (let i = 0; i < 100; i++) {
+    await client.set({ $id: `ma${i}`, title: `match ${i}`, value: i })
+  }
+
+  const stats = await client.redis.selva_memory_stats()
+  const names = stats.filter((_: any, i: number) => i % 2 === 0)
+  t.deepEqual(names, [
+    'default',
+    'hierarchy',
+    'object',
+    'subscriptions',
+    'find_index',
+    'query',
+  ])
+  for (let i = 0; i < stats.length; i += 2) {
+    const [, allocated, , active, , fragmentation] = stats[i + 1]
+    t.true(allocated >= 0)
+    t.true(active >= 0)
+    t.is(fragmentation, Math.max(active - allocated, 0))
+  }
+
+  const [, objectAllocated] = stats[names.indexOf('object') * 2 + 1]
+  t.true(objectAllocated > 0)
+
+  await client.destroy()
+})
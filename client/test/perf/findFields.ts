@@ -0,0 +1,121 @@
+import test from 'ava'
+import { performance } from 'perf_hooks'
+import { connect } from '../../src/index'
+import { start } from '@saulx/selva-server'
+import { wait } from '../assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async (t) => {
+  port = await getPort()
+  srv = await start({
+    port,
+  })
+
+  await wait(500)
+})
+
+test.beforeEach(async (t) => {
+  const client = connect({ port })
+
+  await client.redis.flushall()
+  await client.updateSchema({
+    languages: ['en'],
+    types: {
+      match: {
+        prefix: 'ma',
+        fields: {
+          title: { type: 'text' },
+          description: { type: 'string' },
+          value: { type: 'number' },
+          status: { type: 'int' },
+          tags: { type: 'set', items: { type: 'string' } },
+          scores: { type: 'array', items: { type: 'number' } },
+          venue: {
+            type: 'object',
+            properties: {
+              name: { type: 'string' },
+              city: { type: 'string' },
+              capacity: { type: 'int' },
+            },
+          },
+        },
+      },
+    },
+  })
+
+  const amount = 10000
+  const batch = 1000
+  for (let s = 0; s < amount; s += batch) {
+    const ch = []
+    for (let i = s; i < s + batch; i++) {
+      ch.push({
+        type: 'match',
+        title: { en: 'match ' + i },
+        description: 'A rather long description of the match number ' + i,
+        value: i / 3,
+        status: i % 7,
+        tags: ['tag' + (i % 10), 'tag' + (i % 13), 'tag' + (i % 17)],
+        scores: [i, i + 0.5, i + 1],
+        venue: {
+          name: 'venue ' + (i % 100),
+          city: 'city ' + (i % 20),
+          capacity: 1000 + i,
+        },
+      })
+    }
+
+    await client.set({
+      $id: 'root',
+      children: { $add: ch },
+    })
+  }
+
+  await wait(600)
+  await client.destroy()
+})
+
+test.after(async (t) => {
+  const client = connect({ port })
+  await client.delete('root')
+  await client.destroy()
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+const getOutputBytes = async (client) => {
+  const info: string = await client.redis.info('stats')
+  const m = info.match(/total_net_output_bytes:(\d+)/)
+  return m ? Number(m[1]) : 0
+}
+
+test.serial.failing('perf: find with many fields', async (t) => {
+  const client = connect({ port }, { loglevel: 'info' })
+  const loops = 20
+
+  const bytesStart = await getOutputBytes(client)
+  const start = performance.now()
+  for (let i = 0; i < loops; i++) {
+    const res = await client.redis.selva_hierarchy_find(
+      'en',
+      '___selva_hierarchy',
+      'descendants',
+      'fields',
+      '*',
+      'root'
+    )
+    t.is(res.length, 10000)
+  }
+  const time = performance.now() - start
+  const bytes = (await getOutputBytes(client)) - bytesStart
+
+  console.info(
+    `${loops} finds in ${Math.round(time)} ms, ${Math.round(
+      bytes / (time / 1000) / 1048576
+    )} MiB/s`
+  )
+
+  await client.destroy()
+})
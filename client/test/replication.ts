@@ -19,6 +19,16 @@ import {
   setRecordDefInt64,
 } from '../src/set/modifyDataRecords'
 
+function pairsToObject(arr: string[]) {
+  const obj = {}
+
+  for (let i = 0; i < arr.length; i += 2) {
+    obj[arr[i]] = arr[i + 1]
+  }
+
+  return obj
+}
+
 const SELVA_MODIFY_ARG_DEFAULT_STRING = '2' // Set a string value if unset.
 const SELVA_MODIFY_ARG_STRING = '0' // Value is a string.
 const SELVA_MODIFY_ARG_STRING_ARRAY = '6' // Array of C-strings.
@@ -315,6 +325,81 @@ test.serial('modify command is replicated ignoring errors', async (t) => {
   )
 })
 
+const MODIFY_STREAM_VERSION = 1
+const MODIFY_STREAM_FLAGS = { N: 0x01, M: 0x02, C: 0x04, U: 0x08 }
+
+function encodeModifyBatch(records: string[][]): Buffer {
+  const header = Buffer.alloc(4)
+  header.writeUInt8(MODIFY_STREAM_VERSION, 0)
+  header.writeUInt16LE(0, 2) // No field table
+  const bufs: Buffer[] = [header]
+
+  for (const [id, flags, ...ops] of records) {
+    const rec = Buffer.alloc(10 + 1 + 4)
+    rec.write(id, 0, 10, 'latin1')
+    rec.writeUInt8(
+      [...flags].reduce((acc, f) => acc | MODIFY_STREAM_FLAGS[f], 0),
+      10
+    )
+    rec.writeUInt32LE(ops.length / 3, 11)
+    bufs.push(rec)
+
+    for (let i = 0; i < ops.length; i += 3) {
+      const field = Buffer.from(ops[i + 1])
+      const value = Buffer.from(ops[i + 2])
+      const op = Buffer.alloc(1 + 2 + field.length + 4)
+      op.write(ops[i], 0, 1, 'latin1')
+      op.writeUInt16LE(field.length, 1)
+      field.copy(op, 3)
+      op.writeUInt32LE(value.length, 3 + field.length)
+      bufs.push(op, value)
+    }
+  }
+
+  return Buffer.concat(bufs)
+}
+
+test.serial('modify.batch command is replicated', async (t) => {
+  const res1 = await new Promise((resolve, reject) =>
+    rclientOrigin.send_command(
+      'selva.modify.batch',
+      [
+        '___selva_hierarchy',
+        encodeModifyBatch([
+          ['grphnode_a', '', '0', 'value', '5', '0', 'value1', '100'],
+          ['grphnode_b', '', '0', 'value', '6'],
+          ['grphnode_a', '', '0', 'value', '5', '0', 'value1', '2'],
+          ['grphnode_c', 'U', '0', 'value', '7'],
+        ]),
+      ],
+      (err, res) => (err ? reject(err) : resolve(res))
+    )
+  )
+  t.deepEqual(res1, [
+    ['grphnode_a', 'UPDATED', 'UPDATED'],
+    ['grphnode_b', 'UPDATED'],
+    ['grphnode_a', 'OK', 'UPDATED'],
+    null,
+  ])
+  await wait(200)
+
+  for (const rclient of [rclientOrigin, rclientReplica]) {
+    t.deepEqual(
+      await new Promise((resolve, reject) =>
+        rclient.send_command(
+          'selva.hierarchy.find',
+          ['', '___selva_hierarchy', 'descendants', 'fields', '*\n!updatedAt\n!createdAt', 'root'],
+          (err, res) => (err ? reject(err) : resolve(res))
+        )
+      ),
+      [
+        ['grphnode_a', ['id', 'grphnode_a', 'value', '5', 'value1', '2']],
+        ['grphnode_b', ['id', 'grphnode_b', 'value', '6']],
+      ]
+    )
+  }
+})
+
 test.serial('modify all cases are replicated', async (t) => {
   t.deepEqual(
     await new Promise((resolve, reject) =>
@@ -2469,8 +2554,10 @@ test.serial('modify aliases is replicated', async (t) => {
     [rclientOrigin, rclientReplica].map(async (r) => {
       t.deepEqual(
         await new Promise((resolve, reject) =>
-          r.send_command('hgetall', ['___selva_aliases'], (err, res) =>
-            err ? reject(err) : resolve(res)
+          r.send_command(
+            'selva.hierarchy.aliases',
+            ['___selva_hierarchy'],
+            (err, res) => (err ? reject(err) : resolve(pairsToObject(res)))
           )
         ),
         {
@@ -2525,8 +2612,10 @@ test.serial('modify aliases is replicated', async (t) => {
     [rclientOrigin, rclientReplica].map(async (r) => {
       t.deepEqual(
         await new Promise((resolve, reject) =>
-          r.send_command('hgetall', ['___selva_aliases'], (err, res) =>
-            err ? reject(err) : resolve(res)
+          r.send_command(
+            'selva.hierarchy.aliases',
+            ['___selva_hierarchy'],
+            (err, res) => (err ? reject(err) : resolve(pairsToObject(res)))
           )
         ),
         {
@@ -2585,8 +2674,10 @@ test.serial('modify $alias query is replicated', async (t) => {
     [rclientOrigin, rclientReplica].map(async (r) => {
       t.deepEqual(
         await new Promise((resolve, reject) =>
-          r.send_command('hgetall', ['___selva_aliases'], (err, res) =>
-            err ? reject(err) : resolve(res)
+          r.send_command(
+            'selva.hierarchy.aliases',
+            ['___selva_hierarchy'],
+            (err, res) => (err ? reject(err) : resolve(pairsToObject(res)))
           )
         ),
         {
@@ -2636,8 +2727,10 @@ test.serial('modify $alias query is replicated', async (t) => {
     [rclientOrigin, rclientReplica].map(async (r) => {
       t.deepEqual(
         await new Promise((resolve, reject) =>
-          r.send_command('hgetall', ['___selva_aliases'], (err, res) =>
-            err ? reject(err) : resolve(res)
+          r.send_command(
+            'selva.hierarchy.aliases',
+            ['___selva_hierarchy'],
+            (err, res) => (err ? reject(err) : resolve(pairsToObject(res)))
           )
         ),
         {
@@ -0,0 +1,85 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async (t) => {
+  port = await getPort()
+  srv = await start({
+    port,
+  })
+
+  await wait(100)
+})
+
+test.beforeEach(async (t) => {
+  const client = connect({ port }, { loglevel: 'info' })
+
+  await client.redis.flushall()
+  await client.updateSchema({
+    languages: ['en'],
+    types: {
+      match: {
+        prefix: 'ma',
+        fields: {
+          title: { type: 'string' },
+          value: { type: 'number' },
+        },
+      },
+    },
+  })
+
+  // A small delay is needed after setting the schema
+  await wait(100)
+
+  await client.destroy()
+})
+
+test.after(async (t) => {
+  const client = connect({ port })
+  await client.delete('root')
+  await client.destroy()
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+test.serial('latency histograms', async (t) => {
+  const client = connect({ port })
+
+  await client.redis.selva_trace_enable('1')
+  await client.redis.selva_trace_dump('reset')
+
+  for (let i = 0; i < 10; i++) {
+    await client.set({ $id: `ma${i}`, title: `match ${i}`, value: i })
+  }
+  await client.redis.selva_hierarchy_find(
+    '',
+    '___selva_hierarchy',
+    'descendants',
+    'root'
+  )
+
+  const dump = await client.redis.selva_trace_dump()
+  t.true(dump.length > 0)
+  for (let i = 0; i < dump.length; i += 2) {
+    const [, count, , mean, , p50, , p90, , p99, , p999, , max] = dump[i + 1]
+    t.true(count > 0)
+    t.true(mean <= max)
+    t.true(p50 <= p90 && p90 <= p99 && p99 <= p999 && p999 <= max)
+  }
+
+  const info: string = await client.redis.info('selva')
+  t.truthy(info.match(/selva_trace:.*enabled=1/))
+
+  t.is(await client.redis.selva_trace_enable('0'), 1)
+  await client.redis.selva_trace_dump('reset')
+  await client.set({ $id: 'ma1', value: 100 })
+  t.deepEqual(await client.redis.selva_trace_dump(), [])
+
+  await client.destroy()
+})
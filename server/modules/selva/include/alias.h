@@ -6,32 +6,81 @@
 #ifndef SELVA_ALIAS_H
 #define SELVA_ALIAS_H
 
+#include <stddef.h>
+#include "selva.h"
+#include "tree.h"
+
 struct RedisModuleCtx;
-struct RedisModuleKey;
+struct RedisModuleIO;
 struct RedisModuleString;
 struct SelvaHierarchy;
+struct SelvaObject;
 struct SelvaSet;
 
 /**
- * Open the aliases key.
+ * An alias in the alias index of a hierarchy.
+ * The alias points to a node by its nodeId rather than by a pointer because
+ * nodes can be freed and recreated by subtree compression while the alias is
+ * still valid.
+ */
+struct SelvaAlias {
+    RB_ENTRY(SelvaAlias) _entry;
+    Selva_NodeId dest; /*!< The node the alias is pointing to. */
+    size_t name_len;
+    const char *name; /*!< Points to name_buf unless it's a search key. */
+    char name_buf[];
+};
+
+RB_HEAD(hierarchy_alias_tree, SelvaAlias);
+
+/**
+ * Alias index of a hierarchy.
+ * The back-references from nodes to the aliases are stored in the
+ * SELVA_ALIASES_FIELD set of each node.
+ */
+struct SelvaAliases {
+    struct hierarchy_alias_tree head;
+    size_t nr_aliases;
+};
+
+void SelvaAliases_Init(struct SelvaAliases *aliases);
+void SelvaAliases_Destroy(struct SelvaAliases *aliases);
+
+/**
+ * Get the nodeId an alias is pointing to.
+ * This function doesn't allocate any memory.
+ * @returns 0 if the alias was found; Otherwise SELVA_ENOENT.
  */
-struct RedisModuleKey *open_aliases_key(struct RedisModuleCtx *ctx);
+int get_alias(struct SelvaHierarchy *hierarchy, const char *name_str, size_t name_len, Selva_NodeId node_id);
 
 /**
  * Remove aliases listed in set.
+ * Only the aliases that are pointing to node_id are removed.
  * Caller must update the node aliases if necessary.
  */
-int delete_aliases(struct RedisModuleKey *aliases_key, struct SelvaSet *set);
+int delete_aliases(struct SelvaHierarchy *hierarchy, const Selva_NodeId node_id, struct SelvaSet *set);
+
+/**
+ * Remove an alias from the alias index.
+ */
+int delete_alias(struct SelvaHierarchy *hierarchy, struct RedisModuleString *ref);
 
 /**
- * Update alias into the aliases key and remove the previous alias.
+ * Update alias into the alias index and remove the previous alias.
  * Caller must set the alias to the new node.
  */
 void update_alias(
-        struct RedisModuleCtx *ctx,
         struct SelvaHierarchy *hierarchy,
-        struct RedisModuleKey *alias_key,
         const Selva_NodeId node_id,
         struct RedisModuleString *ref);
 
+/**
+ * Add all the aliases in the SELVA_ALIASES_FIELD of a node object to the index.
+ * Used for rebuilding the index from the node objects.
+ */
+void add_node_aliases(struct SelvaHierarchy *hierarchy, const Selva_NodeId node_id, struct SelvaObject *obj);
+
+void SelvaAliases_RdbSave(struct RedisModuleIO *io, struct SelvaAliases *aliases);
+int SelvaAliases_RdbLoad(struct RedisModuleIO *io, int encver, struct SelvaHierarchy *hierarchy);
+
 #endif /* SELVA_ALIAS_H */
@@ -19,11 +19,17 @@ struct selva_glob_config {
     int hierarchy_compression_level;
     int hierarchy_auto_compress_period_ms;
     int hierarchy_auto_compress_old_age_lim;
+    int hierarchy_lazy_free_period_ms;
+    size_t hierarchy_lazy_free_slice;
+    size_t inherit_cache_max;
+    int aggregate_workers;
+    int aggregate_hll_precision;
     int find_indices_max;
     int find_indexing_threshold;
     int find_indexing_icb_update_interval;
     int find_indexing_interval;
     int find_indexing_popularity_ave_period;
+    size_t find_cache_max_bytes;
 };
 
 extern struct selva_glob_config selva_glob_config;
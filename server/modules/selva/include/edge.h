@@ -266,6 +266,14 @@ int Edge_DeleteField(
  */
 size_t Edge_Refcount(struct SelvaHierarchyNode *node);
 
+/**
+ * Get the memory usage of the edge fields of node.
+ * The size includes the edges and origins objects, the EdgeField structures
+ * and the edge metadata.
+ * @returns Returns the memory usage in bytes.
+ */
+size_t Edge_MemUsage(const struct SelvaHierarchyNode *node);
+
 void replyWithEdgeField(struct RedisModuleCtx *ctx, struct EdgeField *edge_field);
 
 int Edge_RdbLoad(struct RedisModuleIO *io, int encver, struct SelvaHierarchy *hierarchy, struct SelvaHierarchyNode *node);
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#ifndef _FIND_CACHE_H_
+#define _FIND_CACHE_H_
+
+#include "selva.h"
+#include "traversal.h"
+
+struct RedisModuleCtx;
+struct RedisModuleString;
+struct SelvaHierarchy;
+
+/**
+ * Description of the traversal of a find query.
+ * Used to create the subscription markers invalidating a cached result.
+ */
+struct SelvaFindCacheQuery {
+    enum SelvaTraversal dir;
+    const char *dir_field; /*!< Field name for field traversals. */
+    const char *dir_expression; /*!< Traversal expression for expression traversals. */
+    const char *edge_filter; /*!< Optional edge filter expression. */
+    const char *filter; /*!< Optional filter expression. */
+    int filter_has_args; /*!< The filter uses register arguments. */
+    const Selva_NodeId *node_ids; /*!< Head nodes. Empty ids are skipped. */
+    size_t nr_node_ids;
+};
+
+/**
+ * Initialize the find result cache of a hierarchy.
+ */
+void SelvaFindCache_Init(struct SelvaHierarchy *hierarchy);
+
+/**
+ * Free all the memory used by the find result cache of a hierarchy.
+ * The subscriptions of the hierarchy must have been destroyed before calling
+ * this function.
+ */
+void SelvaFindCache_Destroy(struct SelvaHierarchy *hierarchy);
+
+/**
+ * Invalidate all cached find results of a hierarchy.
+ * This should be called when the node objects are changed without sending
+ * subscription events.
+ */
+void SelvaFindCache_InvalidateAll(struct RedisModuleCtx *ctx, struct SelvaHierarchy *hierarchy);
+
+/**
+ * Reply to a find command through the find result cache.
+ * On a cache hit the cached reply is sent; On a miss the command is executed
+ * and the reply is sent and cached.
+ * @param argv is the argv of the find command.
+ * @param query describes the traversal of the find command.
+ * @returns 1 if the command was replied; 0 if the caller must execute the
+ *          command normally.
+ */
+int SelvaFindCache_Reply(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct RedisModuleString **argv,
+        int argc,
+        const struct SelvaFindCacheQuery *query);
+
+#endif /* _FIND_CACHE_H_ */
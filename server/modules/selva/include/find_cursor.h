@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#ifndef SELVA_FIND_CURSOR_H
+#define SELVA_FIND_CURSOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct TraversalOrderItem;
+
+/**
+ * Find cursor.
+ * A cursor is an opaque continuation token returned by the find command
+ * for resuming a paginated query from where the previous page ended.
+ *
+ * The cursor is sent to the client base64 encoded. All integers are little
+ * endian and unaligned.
+ *
+ * ```
+ * CURSOR := VERSION:u8 TYPE:u8 GENERATION:u64 (POS | KEY)
+ * POS := STATE:u64 HEAD:u64
+ * KEY := ITEM_TYPE:u8 D:f64 NODE_ID:u8[SELVA_NODE_ID_SIZE] DATA
+ * ```
+ *
+ * STATE is the id of a traversal saved with SelvaHierarchy_SaveResumable() or
+ * 0 if the traversal of HEAD hasn't been started yet. HEAD is the index of the
+ * head node in the find arguments.
+ *
+ * DATA is the nul-terminated sort key of an ORDER_ITEM_TYPE_TEXT item.
+ */
+
+#define FIND_CURSOR_VERSION 2
+
+enum FindCursorType {
+    /**
+     * Saved state of an unordered traversal.
+     * The cursor is only valid as long as no nodes or edges are removed
+     * from the hierarchy and the saved traversal is not dropped.
+     */
+    FIND_CURSOR_TYPE_POS = 'P',
+    /**
+     * The last item of an ordered result.
+     * The cursor stays valid across modifications.
+     */
+    FIND_CURSOR_TYPE_KEY = 'K',
+};
+
+struct FindCursor {
+    enum FindCursorType type;
+    uint64_t generation; /*!< Removal generation of the hierarchy at the time the cursor was created. */
+    uint64_t state_id; /*!< Id of the saved traversal or 0. Only for FIND_CURSOR_TYPE_POS. */
+    size_t head; /*!< Index of the head node of the traversal. Only for FIND_CURSOR_TYPE_POS. */
+    struct TraversalOrderItem *item; /*!< The last item sent. Only for FIND_CURSOR_TYPE_KEY. */
+};
+
+/**
+ * Encode a traversal state cursor.
+ * @returns A nul-terminated string that must be freed with selva_free().
+ */
+char *FindCursor_EncodePos(uint64_t generation, uint64_t state_id, size_t head, size_t *out_len);
+
+/**
+ * Encode an order key cursor.
+ * @returns A nul-terminated string that must be freed with selva_free().
+ */
+char *FindCursor_EncodeKey(uint64_t generation, const struct TraversalOrderItem *item, size_t *out_len);
+
+/**
+ * Decode a cursor string.
+ * The cursor must be destroyed with FindCursor_Destroy().
+ * @returns 0 if succeed; SELVA_ENOTSUP if the version is not supported; SELVA_EINVAL if the cursor is malformed.
+ */
+int FindCursor_Decode(struct FindCursor *cursor, const char *str, size_t len);
+
+/**
+ * Free the resources held by a decoded cursor.
+ */
+void FindCursor_Destroy(struct FindCursor *cursor);
+
+#define FIND_CURSOR_AUTOFREE(name) \
+    __attribute__((cleanup(FindCursor_Destroy))) struct FindCursor name = { .item = NULL }
+
+#endif /* SELVA_FIND_CURSOR_H */
@@ -11,6 +11,7 @@
 struct RedisModuleCtx;
 struct RedisModuleString;
 struct SelvaHierarchy;
+struct SelvaHierarchyNode;
 struct SelvaSet;
 struct SelvaFindIndexControlBlock;
 struct indexing_timer_args;
@@ -53,6 +54,81 @@ int SelvaFindIndex_AutoMulti(
         size_t nr_index_hints,
         struct SelvaFindIndexControlBlock *ind_icb_out[]);
 
+/**
+ * Get the existing indices of the index hints.
+ * Unlike SelvaFindIndex_AutoMulti(), this function doesn't create new ICBs
+ * for the hints, and thus doesn't affect the indexing decisions.
+ * @returns the index of the smallest valid index in ind_icb_out or -1.
+ */
+int SelvaFindIndex_LookupMulti(
+        struct SelvaHierarchy *hierarchy,
+        enum SelvaTraversal dir, struct RedisModuleString *dir_expression,
+        const Selva_NodeId node_id,
+        enum SelvaResultOrder order,
+        struct RedisModuleString *order_field,
+        struct RedisModuleString *index_hints[],
+        size_t nr_index_hints,
+        struct SelvaFindIndexControlBlock *ind_icb_out[]);
+
+/**
+ * Find query execution plan types.
+ */
+enum SelvaFindIndexPlanType {
+    SELVA_FIND_PLAN_TRAVERSE = 0, /*!< Traverse the hierarchy. */
+    SELVA_FIND_PLAN_INDEX, /*!< Iterate a single index. */
+    SELVA_FIND_PLAN_INTERSECT, /*!< Iterate an index and probe the other indices for each node. */
+};
+
+/**
+ * The part of a find query relevant for planning.
+ */
+struct SelvaFindIndexPlanQuery {
+    const struct SelvaHierarchyNode *head; /*!< The head node or NULL if it doesn't exist. */
+    enum SelvaTraversal dir;
+    enum SelvaResultOrder order;
+    struct RedisModuleString *order_field;
+    struct RedisModuleString *filter; /*!< The filter expression of the find or NULL. */
+    ssize_t limit; /*!< The number of results needed including the offset or -1. */
+    int ordered_ok; /*!< An ordered index can be used to skip sorting. */
+};
+
+/**
+ * Find query execution plan.
+ */
+struct SelvaFindIndexPlan {
+    enum SelvaFindIndexPlanType type;
+    int ind_select; /*!< The index iterated or -1 if the hierarchy is traversed. */
+    int nr_probes;
+    int probes[FIND_INDICES_MAX_HINTS_FIND]; /*!< Indices probed for each node, the most selective first. */
+    double est_visit; /*!< Estimated number of nodes visited. */
+    double est_rows; /*!< Estimated number of nodes in the result. */
+    double cost; /*!< Estimated cost of the plan. */
+    double traverse_cost; /*!< Estimated cost of traversing the hierarchy. */
+};
+
+/**
+ * Plan the execution of a find query using the indices found by
+ * SelvaFindIndex_AutoMulti() or SelvaFindIndex_LookupMulti().
+ * The plan is based on the find accounting of the indices and the fan-out of
+ * the head node. Indices that wouldn't make the query cheaper than a traversal
+ * are skipped, and multiple indices are intersected if probing them is
+ * cheaper than filtering the nodes.
+ */
+void SelvaFindIndex_Plan(
+        const struct SelvaFindIndexPlanQuery *query,
+        struct SelvaFindIndexControlBlock *ind_icb[],
+        size_t nr_index_hints,
+        struct SelvaFindIndexPlan *plan);
+
+/**
+ * Reply with a plan.
+ * [type, [index names...], cost, rows, traverse_cost]
+ */
+void SelvaFindIndex_ReplyWithPlan(
+        struct RedisModuleCtx *ctx,
+        struct SelvaFindIndexControlBlock *ind_icb[],
+        const struct SelvaFindIndexPlan *plan);
+
 /**
  * Check whether an ICB is created as an ordered.
  * This function doesn't check whether the index is actually valid.
@@ -69,6 +145,18 @@ int SelvaFindIndex_Traverse(
         SelvaHierarchyNodeCallback node_cb,
         void *node_arg);
 
+/**
+ * Traverse the indices selected by a plan.
+ * The plan type must not be SELVA_FIND_PLAN_TRAVERSE.
+ */
+int SelvaFindIndex_TraversePlan(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaFindIndexControlBlock *ind_icb[],
+        const struct SelvaFindIndexPlan *plan,
+        SelvaHierarchyNodeCallback node_cb,
+        void *node_arg);
+
 /**
  * Update indexing accounting.
  * @param acc_take is the number of nodes taken from the original set.
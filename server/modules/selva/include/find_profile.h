@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#ifndef _FIND_PROFILE_H_
+#define _FIND_PROFILE_H_
+
+#include "timestamp.h"
+
+struct RedisModuleCtx;
+struct RedisModuleString;
+
+/**
+ * Per-query profile of a find or aggregate command.
+ */
+struct SelvaFindProfile {
+    size_t visited; /*!< Number of nodes visited. */
+    size_t taken; /*!< Number of nodes taken to the result. */
+    size_t restored; /*!< Number of detached subtrees restored. */
+    size_t indexed; /*!< Number of head nodes served from an index. */
+    long long filter_ns; /*!< Time spent in the filter expression. */
+    long long sort_ns; /*!< Time spent in sorting the result. */
+    long long reply_ns; /*!< Time spent in serializing the reply. */
+};
+
+/**
+ * The profile of the command currently executing under
+ * SelvaFindProfile_Reply(); Otherwise NULL.
+ */
+extern struct SelvaFindProfile *selva_find_profile;
+
+/**
+ * Start measuring time for a profile field.
+ * The measurement is only taken if a command is being profiled.
+ */
+#define SELVA_FIND_PROFILE_BEGIN(name) \
+    const long long _find_profile_##name = selva_find_profile ? ts_monotonic_ns() : 0
+
+/**
+ * Add the time since SELVA_FIND_PROFILE_BEGIN(name) to a profile field.
+ */
+#define SELVA_FIND_PROFILE_END(name, field) \
+    if (selva_find_profile) selva_find_profile->field += ts_monotonic_ns() - _find_profile_##name
+
+/**
+ * Execute a command with profiling and reply with `[result, profile]`.
+ * The command is executed through RedisModule_Call() so that the size of the
+ * reply can be measured. The profile is a flat list of names and values.
+ * @param cmd is the name of the command.
+ * @param argv is the argv of the command.
+ * @param profile_arg is the index of the profile option in argv. It's removed
+ *                    from the argv of the executed command.
+ */
+int SelvaFindProfile_Reply(
+        struct RedisModuleCtx *ctx,
+        const char *cmd,
+        struct RedisModuleString **argv,
+        int argc,
+        int profile_arg);
+
+#endif /* _FIND_PROFILE_H_ */
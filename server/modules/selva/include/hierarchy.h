@@ -8,9 +8,11 @@
 
 #include "redismodule.h"
 #include "linker_set.h"
+#include "alias.h"
 #include "selva.h"
 #include "svector.h"
 #include "mempool.h"
+#include "queue.h"
 #include "tree.h"
 #include "trx.h"
 #include "edge.h"
@@ -19,13 +21,14 @@
 #include "selva_set.h"
 #include "subscriptions.h"
 
-#define HIERARCHY_ENCODING_VERSION  5
+#define HIERARCHY_ENCODING_VERSION  6
 
 /* Forward declarations */
 struct RedisModuleCtx;
 struct RedisModuleString;
 struct SelvaHierarchy;
 struct SelvaHierarchyNode;
+struct SelvaHierarchyResumable;
 struct Selva_Subscription;
 struct ida;
 /* End of forward declarations */
@@ -72,6 +75,10 @@ typedef void SelvaHierarchyMetadataDestructorHook(
 
 RB_HEAD(hierarchy_index_tree, SelvaHierarchyNode);
 RB_HEAD(hierarchy_subscriptions_tree, Selva_Subscription);
+RB_HEAD(hierarchy_inherit_cache_tree, InheritCacheEntry);
+RB_HEAD(hierarchy_find_cache_tree, SelvaFindCacheEntry);
+TAILQ_HEAD(hierarchy_find_cache_lru, SelvaFindCacheEntry);
+TAILQ_HEAD(hierarchy_resumable_list, SelvaHierarchyResumable);
 
 struct SelvaHierarchy {
     /**
@@ -90,6 +97,12 @@ struct SelvaHierarchy {
      */
     SVector heads;
 
+    /**
+     * Alias index.
+     * Maps aliases to nodeIds. See alias.c.
+     */
+    struct SelvaAliases aliases;
+
     /**
      * Node types.
      */
@@ -180,6 +193,78 @@ struct SelvaHierarchy {
         RedisModuleTimerID auto_compress_timer;
     } inactive;
 
+    /**
+     * State for lazy freeing of deleted nodes.
+     * Nodes deleted with DEL_HIERARCHY_NODE_LAZY are unlinked from the
+     * hierarchy immediately but the memory is reclaimed in small slices
+     * by a timer.
+     */
+    struct {
+        SVector nodes; /*!< Unlinked nodes waiting to be freed. */
+        int timer_active; /*!< The lazy free timer is active. */
+        RedisModuleTimerID timer_id; /*!< The lazy free timer id. */
+    } lazy_free;
+
+    /**
+     * Hierarchy generation.
+     * Incremented on every structural change, i.e. when a node is removed or
+     * a hierarchy or edge relationship changes.
+     * Used to invalidate the inherit cache.
+     */
+    uint64_t generation;
+
+    /**
+     * Inherit resolution cache.
+     * Maps (node, field, types, lang) to the node the field is inherited
+     * from. See inherit_cache.c.
+     */
+    struct {
+        struct hierarchy_inherit_cache_tree head;
+        size_t nr_entries;
+        uint64_t generation; /*!< The hierarchy generation the entries were created for. */
+    } inherit_cache;
+
+    /**
+     * Find result cache.
+     * Maps find command arguments to serialized replies. See find_cache.c.
+     */
+    struct {
+        struct hierarchy_find_cache_tree head;
+        struct hierarchy_find_cache_lru lru; /*!< Most recently used first. */
+        SVector stale; /*!< Invalidated entries waiting for marker removal. */
+        size_t nr_entries;
+        size_t bytes; /*!< Total size of the entries. */
+        Selva_SubscriptionMarkerId next_marker_id;
+    } find_cache;
+
+    /**
+     * Saved traversals of paginated finds.
+     * See SelvaHierarchy_SaveResumable().
+     */
+    struct {
+        struct hierarchy_resumable_list head; /*!< Most recently saved first. */
+        size_t nr_saved;
+        uint64_t next_id;
+        /**
+         * Incremented when a node or an edge is removed.
+         * A saved traversal refers to the nodes by pointer and it could
+         * also skip nodes if the edges it depends on are removed, but nodes
+         * and edges added meanwhile are just not visited.
+         */
+        uint64_t generation;
+    } resumable;
+
+    /**
+     * Ancestor reachability labels.
+     * Used to answer descendant/ancestor tests without traversing the
+     * hierarchy. See SelvaHierarchy_IsDescendantOf().
+     */
+    struct {
+        uint64_t next; /*!< Start of the free label space for new heads. */
+        size_t nr_exceptions; /*!< Number of nodes having parents not covered by the labels. */
+        int dirty; /*!< The labels must be rebuilt before the next query. */
+    } reach;
+
     /**
      * Storage descriptor for detached nodes.
      * It's possible to determine if a node exists in a detached subtree and restore
@@ -193,6 +278,7 @@ struct SelvaHierarchy {
          * subtree string.
          */
         struct SelvaObject *obj;
+        size_t nr_restored; /*!< Number of subtrees restored. */
     } detached;
 };
 
@@ -233,6 +319,7 @@ enum SelvaModify_DelHierarchyNodeFlag {
     DEL_HIERARCHY_NODE_FORCE = 0x01, /*!< Force delete regardless of existing parents and external edge references. */
     DEL_HIERARCHY_NODE_DETACH = 0x02, /*!< Delete, mark as detached. Note that this doesn't disable sending subscription events. */
     DEL_HIERARCHY_NODE_REPLY_IDS = 0x04, /*!< Send the deleted nodeIds as a reply to the client. */
+    DEL_HIERARCHY_NODE_LAZY = 0x08, /*!< Unlink the nodes immediately but free the memory later in the background. */
 };
 
 /**
@@ -454,6 +541,27 @@ int SelvaModify_DelHierarchyNode(
  */
 struct SelvaHierarchyNode *SelvaHierarchy_FindNode(SelvaHierarchy *hierarchy, const Selva_NodeId id);
 
+/**
+ * Find multiple nodes at once.
+ * The lookups are interleaved to hide the memory latency of the index, which
+ * makes this considerably faster than calling SelvaHierarchy_FindNode() for
+ * each nodeId when the number of nodeIds is large.
+ * @param[out] nodes is an array of nr_ids pointers that will be set to the
+ *                   node found for each nodeId or NULL if it doesn't exist.
+ * @returns The number of nodes found.
+ */
+size_t SelvaHierarchy_FindNodes(SelvaHierarchy *hierarchy, const Selva_NodeId *ids, size_t nr_ids, struct SelvaHierarchyNode **nodes);
+
+/**
+ * Check whether multiple nodes exist.
+ * The lookups are interleaved like in SelvaHierarchy_FindNodes() but detached
+ * subtrees are not restored.
+ * @param[out] exists is an array of nr_ids flags that will be set to 1 if the
+ *                    corresponding nodeId exists; Otherwise 0.
+ * @returns The number of nodes that exist.
+ */
+size_t SelvaHierarchy_NodesExist(SelvaHierarchy *hierarchy, const Selva_NodeId *ids, size_t nr_ids, char *exists);
+
 /**
  * Check if node exists.
  */
@@ -476,6 +584,23 @@ void SelvaHierarchy_TraverseParents(
         struct SelvaHierarchy *hierarchy,
         struct SelvaHierarchyNode *node,
         const struct SelvaHierarchyCallback *cb);
+/**
+ * Get the parent of a node that has exactly one parent.
+ * @returns a pointer to the parent node; NULL if the node has no parents or more than one parent.
+ */
+struct SelvaHierarchyNode *SelvaHierarchy_GetSingleParent(const struct SelvaHierarchyNode *node);
+
+/**
+ * Test if node is a descendant of ancestor.
+ * The test is normally answered from the reachability labels maintained by
+ * the hierarchy without traversing the ancestors of node.
+ * @returns 1 if ancestor is an ancestor of node; Otherwise 0.
+ */
+int SelvaHierarchy_IsDescendantOf(
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyNode *node,
+        struct SelvaHierarchyNode *ancestor);
+
 int SelvaHierarchy_TraverseBFSAncestors(
         struct RedisModuleCtx *ctx,
         struct SelvaHierarchy *hierarchy,
@@ -492,6 +617,16 @@ int SelvaHierarchy_Traverse(
         const Selva_NodeId id,
         enum SelvaTraversal dir,
         const struct SelvaHierarchyCallback *cb);
+/**
+ * Same as SelvaHierarchy_Traverse() but the head node is given by a pointer.
+ * head can be NULL if dir is SELVA_HIERARCHY_TRAVERSAL_DFS_FULL.
+ */
+int SelvaHierarchy_TraverseByPtr(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyNode *head,
+        enum SelvaTraversal dir,
+        const struct SelvaHierarchyCallback *cb);
 int SelvaHierarchy_TraverseField(
         struct RedisModuleCtx *ctx,
         struct SelvaHierarchy *hierarchy,
@@ -518,6 +653,98 @@ int SelvaHierarchy_TraverseExpressionBfs(
         struct rpn_ctx *edge_filter_ctx,
         const struct rpn_expression *edge_filter,
         const struct SelvaHierarchyCallback *cb);
+
+/**
+ * Arguments of a resumed traversal.
+ * Only the arguments used by the traversal direction need to be set.
+ */
+struct SelvaHierarchyResumeArgs {
+    /**
+     * Field name for REF, EDGE_FIELD and BFS_EDGE_FIELD.
+     */
+    const char *field_str;
+    size_t field_len;
+    /**
+     * Field selector for EXPRESSION and BFS_EXPRESSION.
+     */
+    struct rpn_ctx *rpn_ctx;
+    const struct rpn_expression *rpn_expr;
+    struct rpn_ctx *edge_filter_ctx;
+    const struct rpn_expression *edge_filter;
+};
+
+/**
+ * Create a new resumable traversal starting from head_id.
+ * @returns a pointer to the traversal state; NULL if dir can't be resumed.
+ */
+struct SelvaHierarchyResumable *SelvaHierarchy_NewResumable(enum SelvaTraversal dir, const Selva_NodeId head_id);
+void SelvaHierarchy_DestroyResumable(struct SelvaHierarchyResumable *state);
+/**
+ * Traverse until node_cb returns non-zero or the traversal is done.
+ * The traversal visits the same nodes in the same order as
+ * SelvaHierarchy_Traverse() and friends but only node_cb is called.
+ * The node that stopped the traversal is not visited again when the
+ * traversal is resumed.
+ * @returns 1 if the traversal is done; 0 if it was stopped by node_cb; Otherwise a selva error.
+ */
+int SelvaHierarchy_TraverseResume(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyResumable *state,
+        const struct SelvaHierarchyResumeArgs *args,
+        const struct SelvaHierarchyCallback *cb);
+/**
+ * Save a traversal state to the hierarchy.
+ * The hierarchy takes the ownership of state.
+ * @returns an id that can be passed to SelvaHierarchy_TakeResumable().
+ */
+uint64_t SelvaHierarchy_SaveResumable(struct SelvaHierarchy *hierarchy, struct SelvaHierarchyResumable *state);
+/**
+ * Take a copy of a saved traversal state from the hierarchy.
+ * The caller takes the ownership of the copy. The saved state is kept until
+ * a traversal resumed from the copy is taken, i.e. until the client has
+ * received the page, so the same page can be fetched again.
+ * @returns a pointer to the traversal state; NULL if the state was dropped or a node or an edge has been removed since it was saved.
+ */
+struct SelvaHierarchyResumable *SelvaHierarchy_TakeResumable(struct SelvaHierarchy *hierarchy, uint64_t id);
+/**
+ * Find the shortest path from src_id to dst_id following edge fields.
+ * The search is a bidirectional BFS, the backward search follows the edge
+ * origin references.
+ * @param fields_str is a list of edge field names separated by newlines.
+ * @param edge_filter is an optional expression deciding whether an edge can be
+ *                    used. The edge metadata is the object of the expression.
+ * @param path is an initialized SVector the nodes of the path, including
+ *             src and dst, are appended to. Left empty if there is no path.
+ * @returns 0 if succeed; Otherwise a selva error.
+ */
+int SelvaHierarchy_EdgeShortestPath(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        const Selva_NodeId src_id,
+        const Selva_NodeId dst_id,
+        const char *fields_str,
+        size_t fields_len,
+        struct rpn_ctx *edge_filter_ctx,
+        const struct rpn_expression *edge_filter,
+        SVector *path);
+/**
+ * BFS over edge fields up to max_depth hops from the node id.
+ * The traversal can be terminated early by returning non-zero from node_cb.
+ * @param fields_str is a list of edge field names separated by newlines.
+ * @param edge_filter is an optional expression deciding whether an edge can be
+ *                    followed.
+ */
+int SelvaHierarchy_TraverseEdgeFieldsBfs(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        const Selva_NodeId id,
+        const char *fields_str,
+        size_t fields_len,
+        long long max_depth,
+        struct rpn_ctx *edge_filter_ctx,
+        const struct rpn_expression *edge_filter,
+        const struct SelvaHierarchyCallback *cb);
 /**
  * Foreach value in an array field.
  */
@@ -559,6 +786,13 @@ int SelvaHierarchy_ForeachInField(
 
 int SelvaHierarchy_IsNonEmptyField(const struct SelvaHierarchyNode *node, const char *field_str, size_t field_len);
 
+/**
+ * Get the number of nodes adjacent to node in the direction of a traversal.
+ * This is the exact number of nodes visited by a children or parents traversal
+ * and a lower bound for the recursive traversals.
+ */
+size_t SelvaHierarchy_GetFanOut(const struct SelvaHierarchyNode *node, enum SelvaTraversal dir);
+
 /*
  * hierarchy_reply.c
  */
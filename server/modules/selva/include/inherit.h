@@ -51,4 +51,15 @@ size_t Inherit_SendFields(
         RedisModuleString **types_field_names,
         size_t nr_field_names);
 
+/**
+ * Invalidate the inherit resolution cache.
+ * This should be called when a field of any node changes.
+ */
+void Inherit_InvalidateCache(struct SelvaHierarchy *hierarchy);
+
+/**
+ * Free all the memory used by the inherit resolution cache.
+ */
+void Inherit_DestroyCache(struct SelvaHierarchy *hierarchy);
+
 #endif /* _SELVA_INHERIT_H_ */
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#ifndef SELVA_MODIFY_STREAM_H
+#define SELVA_MODIFY_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "selva.h"
+
+/**
+ * Modify op stream.
+ * A binary format for sending modify ops for one or more nodes in a single
+ * buffer. The stream can be parsed in place without copying or allocating
+ * memory for the individual ops.
+ *
+ * All integers are little endian and unaligned.
+ *
+ * ```
+ * STREAM := HEADER FIELD_TABLE RECORD*
+ * HEADER := VERSION:u8 RESERVED:u8 NR_FIELDS:u16
+ * FIELD_TABLE := (NAME_LEN:u16 NAME)*NR_FIELDS
+ * RECORD := NODE_ID:u8[SELVA_NODE_ID_SIZE] FLAGS:u8 NR_OPS:u32 OP*NR_OPS
+ * OP := TYPE:u8 FIELD:u16 [NAME] VALUE_LEN:u32 VALUE
+ * ```
+ *
+ * FIELD is either the length of the field name that follows it or, if
+ * SELVA_MODIFY_STREAM_FIELD_ID is set, an index to the field table.
+ * The field table is typically built from the schema by the client and
+ * it allows the frequently used field names to be sent only once.
+ *
+ * TYPE is one of enum SelvaModify_ArgType and the value is encoded the same
+ * way as in the selva.modify command.
+ */
+
+#define SELVA_MODIFY_STREAM_VERSION     1
+
+/**
+ * Field is an index to the field table.
+ */
+#define SELVA_MODIFY_STREAM_FIELD_ID    0x8000
+#define SELVA_MODIFY_STREAM_FIELD_MASK  0x7fff
+
+/**
+ * Record flags.
+ * @addtogroup modify_stream_flags
+ * @{
+ */
+#define SELVA_MODIFY_STREAM_FLAG_NO_ROOT    0x01 /*!< Don't set root as a parent. */
+#define SELVA_MODIFY_STREAM_FLAG_NO_MERGE   0x02 /*!< Clear any existing fields. */
+#define SELVA_MODIFY_STREAM_FLAG_CREATE     0x04 /*!< Only create a new node or fail. */
+#define SELVA_MODIFY_STREAM_FLAG_UPDATE     0x08 /*!< Only update an existing node. */
+/**
+ * @}
+ */
+
+#define SELVA_MODIFY_STREAM_HEADER_SIZE (2 * sizeof(uint8_t) + sizeof(uint16_t))
+#define SELVA_MODIFY_STREAM_RECORD_HEADER_SIZE (SELVA_NODE_ID_SIZE + sizeof(uint8_t) + sizeof(uint32_t))
+
+struct SelvaModifyStream {
+    const char *buf;
+    size_t len;
+    size_t off; /*!< Offset of the next record. */
+    unsigned version;
+    size_t nr_fields;
+    size_t fields_off; /*!< Offset of the field table. */
+};
+
+struct SelvaModifyStream_Field {
+    const char *name_str;
+    size_t name_len;
+};
+
+struct SelvaModifyStream_Record {
+    Selva_NodeId node_id;
+    unsigned flags; /*!< SELVA_MODIFY_STREAM_FLAG_xxx */
+    size_t nr_ops;
+    const char *ops; /*!< Pointer to the first op in the stream. */
+    size_t ops_len; /*!< Size of all the ops in bytes. */
+};
+
+struct SelvaModifyStream_Op {
+    char type_code;
+    int field_id; /*!< Index to the field table or -1 if field_str is set. */
+    const char *field_str;
+    size_t field_len;
+    const char *value_str;
+    size_t value_len;
+    const char *raw; /*!< Start of the op in the stream. */
+    size_t raw_len; /*!< Size of the op in the stream. */
+};
+
+/**
+ * Initialize a stream iterator for buf.
+ * The header and the field table are validated.
+ * @returns 0 if succeed; SELVA_ENOTSUP if the version is not supported; SELVA_EINVAL if buf is malformed.
+ */
+int SelvaModifyStream_Init(struct SelvaModifyStream *s, const char *buf, size_t len);
+
+/**
+ * Get the field table of the stream.
+ * @param fields must have room for s->nr_fields fields.
+ */
+void SelvaModifyStream_GetFields(const struct SelvaModifyStream *s, struct SelvaModifyStream_Field *fields);
+
+/**
+ * Get the next record from the stream.
+ * All the ops of the record are validated.
+ * @returns 0 if a record was returned; SELVA_ENOENT if there are no more records; SELVA_EINVAL if the stream is malformed.
+ */
+int SelvaModifyStream_NextRecord(struct SelvaModifyStream *s, struct SelvaModifyStream_Record *rec);
+
+/**
+ * Get the next op of a record.
+ * The record must have been returned by SelvaModifyStream_NextRecord().
+ * @param off is the offset from rec->ops and it must be initialized to 0 before the first call.
+ * @returns 0 if an op was returned; SELVA_ENOENT if there are no more ops.
+ */
+int SelvaModifyStream_NextOp(const struct SelvaModifyStream_Record *rec, size_t *off, struct SelvaModifyStream_Op *op);
+
+#endif /* SELVA_MODIFY_STREAM_H */
@@ -6,6 +6,8 @@
 #ifndef _RPN_H_
 #define _RPN_H_
 
+#include "selva.h"
+
 #define RPN_CODE_SIZE                   sizeof(char)
 
 /**
@@ -133,6 +135,16 @@ struct rpn_expression *rpn_compile(const char *input);
  */
 void rpn_destroy_expression(struct rpn_expression *expr);
 
+/**
+ * Get the descendant constraint of a filter expression.
+ * A filter expression has a descendant constraint if it can be only true for
+ * the descendants of a certain node, i.e. the expression is of the form
+ * `X p` or `... X p M`, where X is a string literal or a register.
+ * @param node_id is set to the node id of the constraint.
+ * @returns 1 if the expression has a descendant constraint; Otherwise 0.
+ */
+int rpn_get_descendant_constraint(struct rpn_ctx *ctx, const struct rpn_expression *expr, Selva_NodeId node_id);
+
 enum rpn_error rpn_bool(struct RedisModuleCtx *redis_ctx, struct rpn_ctx *ctx, const struct rpn_expression *expr, int *out);
 enum rpn_error rpn_double(struct RedisModuleCtx *redis_ctx, struct rpn_ctx *ctx, const struct rpn_expression *expr, double *out);
 enum rpn_error rpn_integer(struct RedisModuleCtx *redis_ctx, struct rpn_ctx *ctx, const struct rpn_expression *expr, long long *out);
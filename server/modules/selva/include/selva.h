@@ -34,8 +34,6 @@
  */
 #define EMPTY_NODE_ID           "\0\0\0\0\0\0\0\0\0\0"
 
-#define SELVA_ALIASES_KEY       "___selva_aliases"
-
 /**
  * Default Redis key name for Selva hierarchy.
  */
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#ifndef SELVA_MEMORY_H
+#define SELVA_MEMORY_H
+
+#include <stddef.h>
+
+/**
+ * Memory arenas.
+ * Each subsystem has its own jemalloc arena so that the memory usage of the
+ * subsystems can be told apart and the fragmentation caused by short-lived
+ * query allocations doesn't spread to the long-lived data.
+ */
+enum selva_arena {
+    SELVA_ARENA_DEFAULT = 0, /*!< Everything not allocated from a subsystem arena. */
+    SELVA_ARENA_HIERARCHY, /*!< Hierarchy and edge field structures. */
+    SELVA_ARENA_OBJECT, /*!< SelvaObjects and SelvaSets. */
+    SELVA_ARENA_SUBSCRIPTIONS, /*!< Subscriptions and markers. */
+    SELVA_ARENA_FIND_INDEX, /*!< Find index control blocks and results. */
+    SELVA_ARENA_QUERY, /*!< Temporaries of a single query. */
+    SELVA_ARENA_NR,
+};
+
+/**
+ * Allocate memory from an arena.
+ * The memory can be freed with selva_free() but selva_arena_free() with the
+ * same arena is faster.
+ * Before the module is loaded all arenas are the default arena.
+ * Like the other allocation functions, returns NULL if the allocation fails.
+ */
+void *selva_arena_malloc(enum selva_arena arena, size_t size)
+    __attribute__((malloc, alloc_size(2)));
+
+/**
+ * Allocate zeroed memory from an arena.
+ */
+void *selva_arena_calloc(enum selva_arena arena, size_t n, size_t size)
+    __attribute__((malloc, alloc_size(2, 3)));
+
+/**
+ * Resize an allocation.
+ * If the allocation is moved it will be moved to the given arena.
+ * @param p is a pointer to the old allocation or NULL.
+ */
+void *selva_arena_realloc(enum selva_arena arena, void *p, size_t size)
+    __attribute__((alloc_size(3)));
+
+/**
+ * Free memory allocated from an arena.
+ * @param p is a pointer to the memory or NULL.
+ */
+void selva_arena_free(enum selva_arena arena, void *p);
+
+#endif /* SELVA_MEMORY_H */
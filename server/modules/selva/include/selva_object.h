@@ -152,6 +152,29 @@ void _cleanup_SelvaObject_Destroy(struct SelvaObject **obj);
 
 size_t SelvaObject_MemUsage(const void *value);
 
+/**
+ * Memory usage of a SelvaObject broken down by the value type.
+ * All sizes are in bytes.
+ */
+struct SelvaObjectMemUsage {
+    size_t objects; /*!< Objects and their keys. */
+    size_t strings; /*!< String values, including strings in arrays and sets. */
+    size_t sets; /*!< SelvaSet elements. */
+    size_t arrays; /*!< Array storage. */
+};
+
+/**
+ * Add the memory usage of obj and its nested objects to usage.
+ */
+void SelvaObject_MemUsageDetail(const struct SelvaObject *obj, struct SelvaObjectMemUsage *usage);
+
+/**
+ * Total memory usage of a SelvaObjectMemUsage.
+ */
+static inline size_t SelvaObject_MemUsageTotal(const struct SelvaObjectMemUsage *usage) {
+    return usage->objects + usage->strings + usage->sets + usage->arrays;
+}
+
 /**
  * Delete a key an its value from a SelvaObject.
  */
@@ -8,13 +8,18 @@
 
 #ifdef SELVA_TRACE
 #include <ittnotify.h>
+#else
+#include <stdint.h>
+#include <time.h>
 #endif
 
 struct SelvaTrace {
 #ifdef SELVA_TRACE
     __itt_string_handle* handle;
-    const char *name;
+#else
+    size_t index; /*!< Index of the trace in the histogram buffers. */
 #endif
+    const char *name;
 };
 
 #ifdef SELVA_TRACE
@@ -63,8 +68,83 @@ void SelvaTrace_AutoEnd(void *);
 extern __itt_domain* selva_trace_domain;
 
 #else
-#define SELVA_TRACE_HANDLE(name)
-#define SELVA_TRACE_BEGIN(name)
-#define SELVA_TRACE_END(name)
-#define SELVA_TRACE_BEGIN_AUTO(_name)
+
+/*
+ * Without ittnotify the traces are recorded to latency histograms.
+ * The histograms are kept per thread and they are only updated while enabled
+ * with `selva.trace.enable`. See selva_trace.c.
+ */
+
+/**
+ * Create a new tracing handle.
+ */
+#define SELVA_TRACE_HANDLE(_name) \
+   struct SelvaTrace CONCATENATE(selva_trace_handle_, _name) = { \
+       .name = #_name, \
+   }; \
+   DATA_SET(selva_trace, CONCATENATE(selva_trace_handle_, _name))
+
+/**
+ * Begin a new trace.
+ * A trace must be ended in the same scope where it was started.
+ */
+#define SELVA_TRACE_BEGIN(_name) \
+    const int64_t CONCATENATE(_selva_trace_start_, _name) = SelvaTrace_Begin()
+
+/**
+ * Begin a new automatic trace.
+ * The trace is automatically terminated when the block scope ends.
+ * SELVA_TRACE_END() must not be called for an automatic trace.
+ */
+#define SELVA_TRACE_BEGIN_AUTO(_name) \
+    __attribute__((cleanup(SelvaTrace_AutoEnd))) struct SelvaTraceAuto CONCATENATE(_autoend_selva_trace_, _name) = { \
+        .trace = &CONCATENATE(selva_trace_handle_, _name), \
+        .start = SelvaTrace_Begin(), \
+    }
+
+/**
+ * End a trace.
+ */
+#define SELVA_TRACE_END(_name) \
+    SelvaTrace_End(&CONCATENATE(selva_trace_handle_, _name), CONCATENATE(_selva_trace_start_, _name))
+
+struct SelvaTraceAuto {
+    struct SelvaTrace *trace;
+    int64_t start;
+};
+
+/**
+ * Set if the histograms are enabled.
+ */
+extern int selva_trace_enabled;
+
+static inline int64_t SelvaTrace_Now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Get the start time of a trace.
+ * @returns 0 if the histograms are disabled.
+ */
+static inline int64_t SelvaTrace_Begin(void) {
+    return selva_trace_enabled ? SelvaTrace_Now() : 0;
+}
+
+/**
+ * Record a latency in ns to the histogram of trace.
+ */
+void SelvaTrace_Record(struct SelvaTrace *trace, int64_t t);
+
+static inline void SelvaTrace_End(struct SelvaTrace *trace, int64_t start) {
+    if (start) {
+        SelvaTrace_Record(trace, SelvaTrace_Now() - start);
+    }
+}
+
+void SelvaTrace_AutoEnd(struct SelvaTraceAuto *p);
+
 #endif
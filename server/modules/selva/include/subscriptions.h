@@ -69,6 +69,14 @@ enum SelvaSubscriptionsMarkerFlags {
      */
     SELVA_SUBSCRIPTION_FLAG_REFRESH = 0x0020,
 
+    /**
+     * Marker cleared because the node is deleted.
+     * This flag is only given to the action function together with
+     * SELVA_SUBSCRIPTION_FLAG_CL_HIERARCHY and it tells that the node will be
+     * deleted, as opposed to the hierarchy just changing around it.
+     */
+    SELVA_SUBSCRIPTION_FLAG_CL_DELETE = 0x0040,
+
     /**
      * Reference subscription.
      * Ignores changes to the root node of the marker and only
@@ -337,6 +345,16 @@ void SelvaSubscriptions_ClearAllMarkers(
         struct SelvaHierarchy *hierarchy,
         struct SelvaHierarchyNode *node);
 
+/**
+ * Clear all markers from a node that is going to be deleted.
+ * This works like SelvaSubscriptions_ClearAllMarkers() but the action
+ * functions will also see SELVA_SUBSCRIPTION_FLAG_CL_DELETE.
+ */
+void SelvaSubscriptions_ClearAllMarkersOnDelete(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyNode *node);
+
 /**
  * Test if the RPN filter defined in the marker matches.
  * This function is particularly useful for the callback function of a callback
@@ -11,4 +11,10 @@
  */
 long long ts_now(void);
 
+/**
+ * Get a monotonic timestamp in ns.
+ * Only useful for measuring time intervals.
+ */
+long long ts_monotonic_ns(void);
+
 #endif /* SELVA_TIMESTAMP_H */
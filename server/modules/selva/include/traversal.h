@@ -10,6 +10,7 @@
 #include "arg_parser.h"
 
 struct FindCommand_Args;
+struct FindCursor;
 struct RedisModuleCtx;
 struct RedisModuleString;
 struct SelvaHierarchy;
@@ -213,6 +214,8 @@ struct FindCommand_Args {
     ssize_t skip; /*!< Start processing from nth node. */
     ssize_t offset; /*!< Start sending results from nth node. */
     ssize_t *limit; /*!< Limit the number of result. */
+    struct FindCursor *cursor; /*!< Pagination cursor; Otherwise NULL. */
+    size_t order_max; /*!< Keep only the first order_max items of an ordered result; 0 = keep all. */
 
     struct rpn_ctx *rpn_ctx;
     const struct rpn_expression *filter;
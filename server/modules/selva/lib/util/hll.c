@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "jemalloc.h"
+#include "cdefs.h"
+#include "hll.h"
+
+#define HLL_SPARSE_INITIAL_SIZE 8
+
+#define SPARSE_INDEX(e) ((e) >> 8)
+#define SPARSE_RANK(e) ((uint8_t)((e) & 0xff))
+#define SPARSE_ENTRY(index, rank) (((uint32_t)(index) << 8) | (rank))
+
+static inline uint32_t nr_registers(const struct hll *hll) {
+    return (uint32_t)1 << hll->precision;
+}
+
+void hll_init(struct hll *hll, int precision) {
+    precision = max(precision, HLL_PRECISION_MIN);
+    precision = min(precision, HLL_PRECISION_MAX);
+
+    hll->precision = (uint8_t)precision;
+    hll->dense = 0;
+    hll->nr_sparse = 0;
+    hll->sparse_size = 0;
+    hll->sparse = NULL;
+}
+
+void hll_destroy(struct hll *hll) {
+    if (hll->dense) {
+        selva_free(hll->registers);
+    } else {
+        selva_free(hll->sparse);
+    }
+    hll->registers = NULL;
+    hll->nr_sparse = 0;
+    hll->sparse_size = 0;
+}
+
+/*
+ * MurmurHash64A.
+ */
+uint64_t hll_hash(const void *buf, size_t len) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    const uint8_t *p = (const uint8_t *)buf;
+    const uint8_t *end = p + (len & ~(size_t)7);
+    const size_t tail_len = len & 7;
+    uint64_t h = 0x8445d61a4e774912ULL ^ (len * m);
+
+    while (p != end) {
+        uint64_t k;
+
+        memcpy(&k, p, sizeof(k));
+        p += sizeof(k);
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h ^= k;
+        h *= m;
+    }
+
+    if (tail_len > 0) {
+        uint64_t k = 0;
+
+        for (size_t i = 0; i < tail_len; i++) {
+            k |= (uint64_t)p[i] << (8 * i);
+        }
+
+        h ^= k;
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+
+    return h;
+}
+
+static void to_dense(struct hll *hll) {
+    uint8_t *registers = selva_calloc(nr_registers(hll), sizeof(uint8_t));
+
+    for (uint32_t i = 0; i < hll->nr_sparse; i++) {
+        const uint32_t e = hll->sparse[i];
+
+        registers[SPARSE_INDEX(e)] = SPARSE_RANK(e);
+    }
+
+    selva_free(hll->sparse);
+    hll->registers = registers;
+    hll->dense = 1;
+    hll->nr_sparse = 0;
+    hll->sparse_size = 0;
+}
+
+static void set_register(struct hll *hll, uint32_t index, uint8_t rank) {
+    uint32_t lo = 0;
+    uint32_t hi;
+
+    if (hll->dense) {
+        if (hll->registers[index] < rank) {
+            hll->registers[index] = rank;
+        }
+        return;
+    }
+
+    hi = hll->nr_sparse;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+
+        if (SPARSE_INDEX(hll->sparse[mid]) < index) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo < hll->nr_sparse && SPARSE_INDEX(hll->sparse[lo]) == index) {
+        if (SPARSE_RANK(hll->sparse[lo]) < rank) {
+            hll->sparse[lo] = SPARSE_ENTRY(index, rank);
+        }
+        return;
+    }
+
+    /*
+     * Switch to the dense representation once it becomes smaller.
+     */
+    if ((hll->nr_sparse + 1) * sizeof(uint32_t) > nr_registers(hll)) {
+        to_dense(hll);
+        hll->registers[index] = rank;
+        return;
+    }
+
+    if (hll->nr_sparse == hll->sparse_size) {
+        hll->sparse_size = hll->sparse_size ? 2 * hll->sparse_size : HLL_SPARSE_INITIAL_SIZE;
+        hll->sparse = selva_realloc(hll->sparse, hll->sparse_size * sizeof(uint32_t));
+    }
+
+    memmove(hll->sparse + lo + 1, hll->sparse + lo, (hll->nr_sparse - lo) * sizeof(uint32_t));
+    hll->sparse[lo] = SPARSE_ENTRY(index, rank);
+    hll->nr_sparse++;
+}
+
+void hll_add_hash(struct hll *hll, uint64_t hash) {
+    const int p = hll->precision;
+    const uint32_t index = (uint32_t)(hash >> (64 - p));
+    /* The guard bit limits the rank to 64 - p + 1. */
+    const uint64_t w = (hash << p) | ((uint64_t)1 << (p - 1));
+    const uint8_t rank = (uint8_t)(__builtin_clzll(w) + 1);
+
+    set_register(hll, index, rank);
+}
+
+int hll_merge(struct hll *dst, const struct hll *src) {
+    if (dst->precision != src->precision) {
+        return -1;
+    }
+
+    if (src->dense) {
+        const uint32_t m = nr_registers(src);
+
+        if (!dst->dense) {
+            to_dense(dst);
+        }
+
+        for (uint32_t i = 0; i < m; i++) {
+            dst->registers[i] = max(dst->registers[i], src->registers[i]);
+        }
+    } else {
+        for (uint32_t i = 0; i < src->nr_sparse; i++) {
+            const uint32_t e = src->sparse[i];
+
+            set_register(dst, SPARSE_INDEX(e), SPARSE_RANK(e));
+        }
+    }
+
+    return 0;
+}
+
+static double get_alpha(uint32_t m) {
+    switch (m) {
+    case 16:
+        return 0.673;
+    case 32:
+        return 0.697;
+    case 64:
+        return 0.709;
+    default:
+        return 0.7213 / (1.0 + 1.079 / (double)m);
+    }
+}
+
+uint64_t hll_count(const struct hll *hll) {
+    const uint32_t m = nr_registers(hll);
+    uint32_t zeros = 0;
+    double sum = 0.0;
+    double e;
+
+    if (hll->dense) {
+        for (uint32_t i = 0; i < m; i++) {
+            const uint8_t rank = hll->registers[i];
+
+            zeros += rank == 0;
+            sum += 1.0 / (double)((uint64_t)1 << rank);
+        }
+    } else {
+        zeros = m - hll->nr_sparse;
+        sum = (double)zeros;
+        for (uint32_t i = 0; i < hll->nr_sparse; i++) {
+            sum += 1.0 / (double)((uint64_t)1 << SPARSE_RANK(hll->sparse[i]));
+        }
+    }
+
+    e = get_alpha(m) * (double)m * (double)m / sum;
+
+    /*
+     * Small range correction.
+     */
+    if (e <= 2.5 * (double)m && zeros > 0) {
+        e = (double)m * log((double)m / (double)zeros);
+    }
+
+    return (uint64_t)(e + 0.5);
+}
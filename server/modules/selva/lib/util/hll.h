@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#ifndef _UTIL_HLL_H_
+#define _UTIL_HLL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HLL_PRECISION_MIN 4
+#define HLL_PRECISION_MAX 16
+
+/**
+ * HyperLogLog cardinality estimator.
+ * A HyperLogLog approximates the number of distinct elements added to it
+ * with a standard error of about `1.04 / sqrt(2^precision)`.
+ *
+ * A new HyperLogLog starts in the sparse representation that stores only
+ * the registers that are set, as a sorted array. Once the sparse array would
+ * take more space than the dense registers, the HyperLogLog is converted to
+ * the dense representation, which has one byte per register.
+ */
+struct hll {
+    uint8_t precision;
+    uint8_t dense; /*!< Set if the dense representation is used. */
+    uint32_t nr_sparse; /*!< Number of registers in the sparse array. */
+    uint32_t sparse_size; /*!< Allocated size of the sparse array. */
+    union {
+        uint32_t *sparse; /*!< Sorted array of `index << 8 | rank`. */
+        uint8_t *registers;
+    };
+};
+
+/**
+ * Initialize a HyperLogLog.
+ * @param precision is the number of index bits. It's clamped to
+ *                  [HLL_PRECISION_MIN, HLL_PRECISION_MAX].
+ */
+void hll_init(struct hll *hll, int precision);
+
+/**
+ * Free the resources held by a HyperLogLog.
+ */
+void hll_destroy(struct hll *hll);
+
+/**
+ * Compute the 64-bit hash used by the HyperLogLog.
+ */
+uint64_t hll_hash(const void *buf, size_t len);
+
+/**
+ * Add an element by its hash value.
+ */
+void hll_add_hash(struct hll *hll, uint64_t hash);
+
+/**
+ * Add an element.
+ */
+static inline void hll_add(struct hll *hll, const void *buf, size_t len) {
+    hll_add_hash(hll, hll_hash(buf, len));
+}
+
+/**
+ * Merge src to dst.
+ * The result estimates the cardinality of the union of the two.
+ * @returns 0 if succeed; Otherwise a non-zero value if the precision of the
+ *          HyperLogLogs doesn't match.
+ */
+int hll_merge(struct hll *dst, const struct hll *src);
+
+/**
+ * Estimate the number of distinct elements added.
+ */
+uint64_t hll_count(const struct hll *hll);
+
+#endif /* _UTIL_HLL_H_ */
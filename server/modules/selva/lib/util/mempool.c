@@ -8,11 +8,18 @@
 #include <stdint.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <unistd.h>
 #include "mempool.h"
 
 #define MOD_AL(x, y) ((x) & ((y) - 1)) /* x % bytes */
 #define PAD(size, al) MOD_AL(((al) - MOD_AL((size), (al))), (al))
 #define ALIGNED_SIZE(size, al) ((size) + PAD((size), (al)))
+#define IS_POW2(x) ((x) != 0 && ((x) & ((x) - 1)) == 0)
+
+/**
+ * The huge page size assumed for MEMPOOL_HUGEPAGE_EXPLICIT.
+ */
+#define MEMPOOL_HUGEPAGE_SIZE ((size_t)2 * 1024 * 1024)
 
 /**
  * Slab descriptor for a mempool.
@@ -21,74 +28,81 @@
  */
 struct slab_info {
     size_t total_bytes;
+    size_t first_chunk;
     size_t chunk_size;
     size_t obj_size;
     size_t nr_objects;
 };
 
-/**
- * Get a pointer to the first chunk in a slab.
- * The rest of the chunks are `info->chunk_size` apart from each other.
- */
-static struct mempool_chunk *get_first_chunk(struct mempool_slab * restrict slab) {
-    char *p = ((char *)slab) + sizeof(struct mempool_slab);
-
-    return (struct mempool_chunk *)p;
-}
-
-static char *get_obj(const struct mempool *mempool, struct mempool_chunk *chunk) {
-    return ((char *)chunk) + sizeof(struct mempool_chunk) + PAD(sizeof(struct mempool_chunk), mempool->obj_align);
-}
-
-static struct mempool_chunk *get_chunk(const struct mempool *mempool, void *obj) {
-    char *p = ((char *)obj) - PAD(sizeof(struct mempool_chunk), mempool->obj_align) - sizeof(struct mempool_chunk);
-
-    return (struct mempool_chunk *)p;
+static size_t get_slab_size(const struct mempool *mempool) {
+    return (size_t)mempool->slab_size_kb * 1024;
 }
 
 /**
  * Calculate slab_info for mempool.
+ * Objects are stored in chunks following the slab header. A chunk is big
+ * enough to hold either the object or a struct mempool_chunk while the object
+ * is free.
  */
 __purefn static struct slab_info slab_info(const struct mempool * restrict mempool);
 static struct slab_info slab_info(const struct mempool * restrict mempool) {
-    const size_t slab_size = mempool->slab_size_kb * 1024;
-    const size_t chunk_size = ALIGNED_SIZE(
-            sizeof(struct mempool_chunk) +
-            PAD(sizeof(struct mempool_chunk), mempool->obj_align) +
-            mempool->obj_size,
-            alignof(struct mempool_chunk));
-    const size_t nr_total = (slab_size - sizeof(struct mempool_slab)) / chunk_size;
+    const size_t slab_size = get_slab_size(mempool);
+    const size_t chunk_align = max((size_t)mempool->obj_align, alignof(struct mempool_chunk));
+    const size_t first_chunk = ALIGNED_SIZE(sizeof(struct mempool_slab), chunk_align);
+    const size_t chunk_size = ALIGNED_SIZE(max((size_t)mempool->obj_size, sizeof(struct mempool_chunk)), chunk_align);
+    const size_t nr_total = (slab_size - first_chunk) / chunk_size;
 
     assert(nr_total > 0);
 
     return (struct slab_info){
         .total_bytes = slab_size,
+        .first_chunk = first_chunk,
         .chunk_size = chunk_size,
         .obj_size = mempool->obj_size,
         .nr_objects = nr_total,
     };
 }
 
-void mempool_init(struct mempool *mempool, size_t slab_size, size_t obj_size, size_t obj_align) {
+/**
+ * Get a pointer to the first chunk in a slab.
+ * The rest of the chunks are `info->chunk_size` apart from each other.
+ */
+static struct mempool_chunk *get_first_chunk(const struct slab_info *info, struct mempool_slab * restrict slab) {
+    return (struct mempool_chunk *)((char *)slab + info->first_chunk);
+}
+
+/**
+ * Get the slab containing the object p.
+ */
+static struct mempool_slab *get_slab(const struct mempool *mempool, void *p) {
+    return (struct mempool_slab *)((uintptr_t)p & ~(uintptr_t)(get_slab_size(mempool) - 1));
+}
+
+void mempool_init2(struct mempool *mempool, size_t slab_size, size_t obj_size, size_t obj_align, enum mempool_hugepage hugepage) {
     assert(slab_size - sizeof(struct mempool_slab) > obj_size &&
            slab_size / 1024 > 0 &&
            slab_size / 1024 < UINT16_MAX &&
-           ALIGNED_SIZE(slab_size, 512) == slab_size);
+           IS_POW2(slab_size));
     assert(obj_size < UINT16_MAX);
-    assert(obj_align < UINT16_MAX && obj_align <= obj_size);
+    assert(obj_align < UINT16_MAX && obj_align <= obj_size && IS_POW2(obj_align));
 
     mempool->slab_size_kb = (typeof(mempool->slab_size_kb))(slab_size / 1024);
     mempool->obj_size = (typeof(mempool->obj_size))(obj_size);
     mempool->obj_align = (typeof(mempool->obj_align))(obj_align);
+    mempool->hugepage = (slab_size % MEMPOOL_HUGEPAGE_SIZE == 0) ? hugepage : MEMPOOL_HUGEPAGE_NONE;
     SLIST_INIT(&mempool->slabs);
     LIST_INIT(&mempool->free_chunks);
 }
 
+void mempool_init(struct mempool *mempool, size_t slab_size, size_t obj_size, size_t obj_align) {
+    mempool_init2(mempool, slab_size, obj_size, obj_align, MEMPOOL_HUGEPAGE_NONE);
+}
+
 /**
  * Free slab that was allocated in mempool
  */
 static void mempool_free_slab(const struct mempool *mempool, struct mempool_slab *slab) {
-    (void)munmap(slab, mempool->slab_size_kb * 1024);
+    (void)munmap(slab, get_slab_size(mempool));
 }
 
 void mempool_destroy(struct mempool *mempool) {
@@ -125,7 +139,7 @@ void mempool_gc(struct mempool *mempool) {
             /*
              * Remove all the objects of this slab from the free list.
              */
-            char *p = (char *)get_first_chunk(slab);
+            char *p = (char *)get_first_chunk(&info, slab);
 
             for (size_t i = 0; i < info.nr_objects; i++) {
                 struct mempool_chunk *chunk;
@@ -141,13 +155,65 @@ void mempool_gc(struct mempool *mempool) {
 }
 
 /**
- * Allocate a new slab using mmap().
+ * Map size bytes aligned to align.
+ * The mapping is over-allocated and the excess pages are unmapped.
+ * @param granule is the page size of the mapping.
  */
+static void *map_aligned(size_t size, size_t align, size_t granule, int flags) {
+    const size_t map_size = (align > granule) ? size + align - granule : size;
+    char *p;
+    char *aligned;
+    size_t head, tail;
+
+    p = mmap(0, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+
+    aligned = (char *)ALIGNED_SIZE((uintptr_t)p, (uintptr_t)align);
+    head = (size_t)(aligned - p);
+    tail = map_size - head - size;
+    if (head) {
+        (void)munmap(p, head);
+    }
+    if (tail) {
+        (void)munmap(aligned + size, tail);
+    }
+
+    return aligned;
+}
+
+/**
+ * Allocate a new slab aligned to the slab size using mmap().
+ */
+static struct mempool_slab *mempool_map_slab(const struct mempool *mempool) {
+    const size_t slab_size = get_slab_size(mempool);
+    void *slab;
+
+#ifdef MAP_HUGETLB
+    if (mempool->hugepage == MEMPOOL_HUGEPAGE_EXPLICIT) {
+        slab = map_aligned(slab_size, slab_size, MEMPOOL_HUGEPAGE_SIZE, MAP_HUGETLB);
+        if (slab) {
+            return slab;
+        }
+    }
+#endif
+
+    slab = map_aligned(slab_size, slab_size, (size_t)sysconf(_SC_PAGESIZE), 0);
+#ifdef MADV_HUGEPAGE
+    if (slab && mempool->hugepage != MEMPOOL_HUGEPAGE_NONE) {
+        (void)madvise(slab, slab_size, MADV_HUGEPAGE);
+    }
+#endif
+
+    return slab;
+}
+
 static int mempool_new_slab(struct mempool *mempool) {
     struct mempool_slab *slab;
 
-    slab = mmap(0, mempool->slab_size_kb * 1024, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (slab == MAP_FAILED) {
+    slab = mempool_map_slab(mempool);
+    if (!slab) {
         return 1;
     }
 
@@ -157,16 +223,17 @@ static int mempool_new_slab(struct mempool *mempool) {
 
     /*
      * Add all new objects to the list of free objects in the pool.
+     * The objects are inserted in reverse order so that the objects are
+     * handed out in the address order.
      */
-    char *p = (char *)get_first_chunk(slab);
+    char *p = (char *)get_first_chunk(&info, slab) + (info.nr_objects - 1) * info.chunk_size;
     for (size_t i = 0; i < info.nr_objects; i++) {
         struct mempool_chunk *chunk;
 
         chunk = (struct mempool_chunk *)p;
-        chunk->slab = slab;
         LIST_INSERT_HEAD(&mempool->free_chunks, chunk, next_free);
 
-        p += info.chunk_size;
+        p -= info.chunk_size;
     }
 
     SLIST_INSERT_HEAD(&mempool->slabs, slab, next_slab);
@@ -188,16 +255,16 @@ void *mempool_get(struct mempool *mempool) {
 
     next = LIST_FIRST(&mempool->free_chunks);
     LIST_REMOVE(next, next_free);
-    next->slab->nr_free--;
+    get_slab(mempool, next)->nr_free--;
 
-    return get_obj(mempool, next);
+    return next;
 }
 
 void mempool_return(struct mempool *mempool, void *p) {
-    struct mempool_chunk *chunk = get_chunk(mempool, p);
+    struct mempool_chunk *chunk = (struct mempool_chunk *)p;
 
     LIST_INSERT_HEAD(&mempool->free_chunks, chunk, next_free);
-    chunk->slab->nr_free++;
+    get_slab(mempool, chunk)->nr_free++;
 
     /*
      * Note that we never free slabs here. Slabs are only removed when the user
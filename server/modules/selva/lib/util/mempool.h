@@ -9,8 +9,31 @@
 #include "cdefs.h"
 #include "queue.h"
 
+/**
+ * Huge page backing of mempool slabs.
+ */
+enum mempool_hugepage {
+    /**
+     * Use normal pages.
+     */
+    MEMPOOL_HUGEPAGE_NONE = 0,
+    /**
+     * Advise the kernel to back the slabs with transparent huge pages.
+     */
+    MEMPOOL_HUGEPAGE_TRANSPARENT = 1,
+    /**
+     * Map the slabs from the explicit huge page pool (MAP_HUGETLB).
+     * Falls back to MEMPOOL_HUGEPAGE_TRANSPARENT if no huge pages are
+     * available.
+     */
+    MEMPOOL_HUGEPAGE_EXPLICIT = 2,
+};
+
 /**
  * A structure describing a slab in the pool allocator.
+ * Slabs are aligned to the slab size and the slab header is placed in the
+ * beginning of the slab, therefore the slab of an object can be found by
+ * masking the address of the object.
  */
 struct mempool_slab {
     size_t nr_free;
@@ -18,16 +41,16 @@ struct mempool_slab {
 } __attribute__((aligned((16)))); /* max_align_t would be better. */
 
 /**
- * A structure describing a chunk allocation.
+ * A structure describing a free chunk.
+ * The structure is stored in the memory of the object itself while the object
+ * is in the free list, therefore allocated objects have no overhead.
  */
 struct mempool_chunk {
-    struct mempool_slab *slab; /*!< A pointer back the slab. */
     /**
-     * A list entry pointing to the next free chunk if this object is in the
-     * free list.
+     * A list entry pointing to the next free chunk.
      */
     LIST_ENTRY(mempool_chunk) next_free;
-} __attribute__((aligned(sizeof(size_t))));
+};
 
 /**
  * A structure describing a memory pool.
@@ -35,18 +58,27 @@ struct mempool_chunk {
 struct mempool {
     uint16_t slab_size_kb;
     uint16_t obj_align;
-    uint32_t obj_size;
+    uint16_t obj_size;
+    uint16_t hugepage; /*!< enum mempool_hugepage */
     SLIST_HEAD(mempool_slab_list, mempool_slab) slabs;
     LIST_HEAD(mempool_free_chunk_list, mempool_chunk) free_chunks;
 };
 
 /**
  * Initialize a new mempool slab allocator.
- * @param slab_size is the size of a single slab.
+ * @param slab_size is the size of a single slab. Must be a power of two.
  * @param obj_size is the size of a single object stored in a slab.
  */
 void mempool_init(struct mempool *mempool, size_t slab_size, size_t obj_size, size_t obj_align);
 
+/**
+ * Initialize a new mempool slab allocator with huge page backed slabs.
+ * Huge pages are only used if slab_size is a multiple of the huge page size.
+ * @param slab_size is the size of a single slab. Must be a power of two.
+ * @param obj_size is the size of a single object stored in a slab.
+ */
+void mempool_init2(struct mempool *mempool, size_t slab_size, size_t obj_size, size_t obj_align, enum mempool_hugepage hugepage);
+
 /**
  * Destroy a mempool and free all memory.
  * Note that this function doesn't check whether all objects have been
@@ -56,6 +88,7 @@ void mempool_destroy(struct mempool *mempool);
 
 /**
  * Free all unused slabs.
+ * The memory of the freed slabs is returned to the OS.
  */
 void mempool_gc(struct mempool *mempool);
 
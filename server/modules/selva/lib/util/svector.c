@@ -310,6 +310,21 @@ void *SVector_InsertFast(SVector *vec, void *el) {
     }
 }
 
+size_t SVector_MemUsage(const SVector * restrict vec) {
+    if (vec->vec_mode == SVECTOR_MODE_ARRAY) {
+        return vec->vec_arr ? VEC_SIZE(vec->vec_arr_len) : 0;
+    } else if (vec->vec_mode == SVECTOR_MODE_RBTREE) {
+        /*
+         * The slabs of the node pool are allocated lazily by the kernel,
+         * therefore the used memory is closer to the size of the nodes than
+         * to the size of the slabs.
+         */
+        return SVector_Size(vec) * sizeof(struct SVector_rbnode);
+    }
+
+    return 0;
+}
+
 ssize_t SVector_SearchIndex(const SVector * restrict vec, void *key) {
     const enum SVectorMode vec_mode = vec->vec_mode;
 
@@ -562,7 +577,7 @@ void *SVector_Pop(SVector * restrict vec) {
         }
 
         last = n->p;
-        RB_REMOVE(SVector_rbtree, &vec->vec_rbhead, last);
+        RB_REMOVE(SVector_rbtree, &vec->vec_rbhead, n);
         mempool_return(&vec->vec_rbmempool, n);
         vec->vec_last--;
     }
@@ -683,6 +698,44 @@ static __hot void *SVector_RbTreeForeach(struct SVectorIterator *it) {
     return cur->p;
 }
 
+void SVector_ForeachBeginAfter(struct SVectorIterator * restrict it, const SVector * restrict vec, size_t index, void *key) {
+    SVector_ForeachBegin(it, vec);
+
+    if (it->mode == SVECTOR_MODE_ARRAY && it->fn == SVector_ArrayForeach) {
+        void **cur = it->arr.cur;
+        void **end = it->arr.end;
+
+        if (vec->vec_compar) {
+            /* Find the first element greater than key. */
+            while (cur < end) {
+                void **mid = cur + (end - cur) / 2;
+
+                if (vec->vec_compar((const void **)&key, (const void **)mid) >= 0) {
+                    cur = mid + 1;
+                } else {
+                    end = mid;
+                }
+            }
+        } else {
+            cur = (index < (size_t)(end - cur)) ? cur + index : end;
+        }
+
+        it->arr.cur = cur;
+    } else if (it->mode == SVECTOR_MODE_RBTREE && it->fn == SVector_RbTreeForeach) {
+        struct SVector_rbnode find = {
+            .compar = vec->vec_compar,
+            .p = key,
+        };
+        struct SVector_rbnode *next;
+
+        next = RB_NFIND(SVector_rbtree, it->rbtree.head, &find);
+        if (next && vec->vec_compar((const void **)&key, (const void **)&next->p) == 0) {
+            next = RB_NEXT(SVector_rbtree, it->rbtree.head, next);
+        }
+        it->rbtree.next = next;
+    }
+}
+
 int SVector_Done(const struct SVectorIterator *it) {
     if (it->mode == SVECTOR_MODE_ARRAY) {
         return it->arr.cur == it->arr.end;
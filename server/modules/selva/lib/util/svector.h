@@ -130,11 +130,25 @@ static inline enum SVectorMode SVector_Mode(const SVector * restrict vec) {
     return vec->vec_mode;
 }
 
+/**
+ * Returns the number of bytes used for storing the elements of the vector.
+ * The control struct itself is not included.
+ */
+size_t SVector_MemUsage(const SVector * restrict vec);
+
 void SVector_ForeachBegin(struct SVectorIterator * restrict it, const SVector * restrict vec);
 static inline void *SVector_Foreach(struct SVectorIterator *it) {
     return it->fn(it);
 }
 
+/**
+ * Begin iterating vec from the element following key.
+ * An ordered vector is searched with vec_compar() and key doesn't need to be
+ * in the vector anymore. An unordered vector skips the first index elements
+ * instead.
+ */
+void SVector_ForeachBeginAfter(struct SVectorIterator * restrict it, const SVector * restrict vec, size_t index, void *key);
+
 /**
  * Returns true if SVector_Foreach() has reached the end of the vector.
  */
@@ -3,6 +3,7 @@
  * SPDX-License-Identifier: MIT
  */
 #include <assert.h>
+#include <pthread.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -10,22 +11,28 @@
 #include <string.h>
 #include <float.h>
 #include "funmap.h"
+#include "hll.h"
 #include "selva.h"
 #include "config.h"
 #include "redismodule.h"
+#include "jemalloc.h"
 #include "auto_free.h"
 #include "arg_parser.h"
 #include "ptag.h"
 #include "hierarchy.h"
+#include "modinfo.h"
 #include "modify.h"
 #include "rpn.h"
+#include "selva_memory.h"
 #include "selva_object.h"
 #include "selva_onload.h"
 #include "selva_set.h"
 #include "subscriptions.h"
 #include "svector.h"
+#include "tree.h"
 #include "traversal.h"
 #include "find_index.h"
+#include "find_profile.h"
 
 enum SelvaHierarchy_AggregateType {
     SELVA_AGGREGATE_TYPE_COUNT_NODE = '0',
@@ -34,11 +41,55 @@ enum SelvaHierarchy_AggregateType {
     SELVA_AGGREGATE_TYPE_AVG_FIELD = '3',
     SELVA_AGGREGATE_TYPE_MIN_FIELD = '4',
     SELVA_AGGREGATE_TYPE_MAX_FIELD = '5',
+    SELVA_AGGREGATE_TYPE_COUNT_UNIQUE_APPROX_FIELD = '6',
 };
 
 struct AggregateCommand_Args;
 typedef int (*agg_func)(struct SelvaObject *, struct AggregateCommand_Args *);
 
+struct aggregate_uniq {
+    struct SelvaSet set_rmstring;
+    struct SelvaSet set_double;
+    struct SelvaSet set_longlong;
+};
+
+/**
+ * Partial aggregate of a group.
+ */
+struct AggregateGroup {
+    RB_ENTRY(AggregateGroup) _entry;
+    uint32_t hash;
+    size_t item_count;
+    double sum;
+    double min;
+    double max;
+    struct aggregate_uniq *uniq; /*!< Only used by SELVA_AGGREGATE_TYPE_COUNT_UNIQUE_FIELD. */
+    struct hll *hll; /*!< Only used by SELVA_AGGREGATE_TYPE_COUNT_UNIQUE_APPROX_FIELD. */
+    size_t key_len;
+    const char *key; /*!< Points right after the struct unless it's a search key. */
+};
+
+RB_HEAD(AggregateGroups, AggregateGroup);
+
+/**
+ * Values of an ungrouped sum, avg, min or max waiting to be reduced.
+ * The values are reduced a block at a time so the memory used doesn't
+ * depend on the number of nodes.
+ */
+struct aggregate_stream {
+    double vals[AGGREGATE_BATCH_SIZE];
+    size_t len;
+};
+
+/**
+ * Objects collected for a batched aggregation.
+ */
+struct aggregate_batch {
+    struct SelvaObject **objs;
+    size_t len;
+    size_t size;
+};
+
 struct AggregateCommand_Args {
     struct RedisModuleCtx *ctx;
     struct FindCommand_Args find_args;
@@ -47,24 +98,50 @@ struct AggregateCommand_Args {
     enum SelvaHierarchy_AggregateType aggregate_type;
     int uniq_initialized;
 
+    /**
+     * Group by field.
+     * If set the aggregate is computed separately for each distinct value
+     * of the field and the objects are collected to the batch. Otherwise
+     * sum, avg, min and max are streamed.
+     */
+    const char *group_by_str;
+    size_t group_by_len;
+
     /*
      * Aggregation state.
      */
     long long int aggregation_result_int;
     double aggregation_result_double;
     size_t item_count;
-    struct {
-        struct SelvaSet set_rmstring;
-        struct SelvaSet set_double;
-        struct SelvaSet set_longlong;
-    } uniq;
+    struct aggregate_uniq uniq;
+    struct aggregate_stream stream;
+    struct aggregate_batch batch;
 };
 
+static unsigned long long aggregate_nr_batched;
+static unsigned long long aggregate_nr_parallel;
+
+static void uniq_init(struct aggregate_uniq *uniq) {
+    SelvaSet_Init(&uniq->set_rmstring, SELVA_SET_TYPE_RMSTRING);
+    SelvaSet_Init(&uniq->set_double, SELVA_SET_TYPE_DOUBLE);
+    SelvaSet_Init(&uniq->set_longlong, SELVA_SET_TYPE_LONGLONG);
+}
+
+static void uniq_destroy(struct aggregate_uniq *uniq) {
+    SelvaSet_Destroy(&uniq->set_rmstring);
+    SelvaSet_Destroy(&uniq->set_double);
+    SelvaSet_Destroy(&uniq->set_longlong);
+}
+
+static size_t uniq_size(struct aggregate_uniq *uniq) {
+    return SelvaSet_Size(&uniq->set_rmstring) +
+           SelvaSet_Size(&uniq->set_double) +
+           SelvaSet_Size(&uniq->set_longlong);
+}
+
 static void init_uniq(struct AggregateCommand_Args *args) {
     if (args->aggregate_type == SELVA_AGGREGATE_TYPE_COUNT_UNIQUE_FIELD) {
-        SelvaSet_Init(&args->uniq.set_rmstring, SELVA_SET_TYPE_RMSTRING);
-        SelvaSet_Init(&args->uniq.set_double, SELVA_SET_TYPE_DOUBLE);
-        SelvaSet_Init(&args->uniq.set_longlong, SELVA_SET_TYPE_LONGLONG);
+        uniq_init(&args->uniq);
         args->uniq_initialized = 1;
     } else {
         args->uniq_initialized = 0;
@@ -73,18 +150,14 @@ static void init_uniq(struct AggregateCommand_Args *args) {
 
 static void destroy_uniq(struct AggregateCommand_Args *args) {
     if (args->uniq_initialized) {
-        SelvaSet_Destroy(&args->uniq.set_rmstring);
-        SelvaSet_Destroy(&args->uniq.set_double);
-        SelvaSet_Destroy(&args->uniq.set_longlong);
+        uniq_destroy(&args->uniq);
         args->uniq_initialized = 0;
     }
 }
 
 static void count_uniq(struct AggregateCommand_Args *args) {
     if (args->uniq_initialized && args->aggregate_type == SELVA_AGGREGATE_TYPE_COUNT_UNIQUE_FIELD) {
-        args->aggregation_result_int = SelvaSet_Size(&args->uniq.set_rmstring) +
-                                       SelvaSet_Size(&args->uniq.set_double) +
-                                       SelvaSet_Size(&args->uniq.set_longlong);
+        args->aggregation_result_int = uniq_size(&args->uniq);
     }
 }
 
@@ -93,20 +166,26 @@ static int agg_fn_count_obj(struct SelvaObject *obj __unused, struct AggregateCo
     return 0;
 }
 
-static int get_first_field_value_double(struct SelvaObject *obj, struct SelvaObject *fields_obj, double *out) {
+static SVector *get_fields(struct SelvaObject *fields_obj) {
     SVector *fields;
-    struct SVectorIterator it;
-    const RedisModuleString *field;
     int err;
 
     err = SelvaObject_GetArrayStr(fields_obj, "0", 1, NULL, &fields);
-    if (err || !fields) {
-        return SELVA_ENOENT;
+    if (err) {
+        return NULL;
     }
 
+    return fields;
+}
+
+static int get_first_value_double(struct SelvaObject *obj, SVector *fields, double *out) {
+    struct SVectorIterator it;
+    const RedisModuleString *field;
+
     SVector_ForeachBegin(&it, fields);
     while ((field = SVector_Foreach(&it))) {
         struct SelvaObjectAny value;
+        int err;
 
         err = SelvaObject_GetAny(obj, field, &value);
         if (!err) {
@@ -123,83 +202,155 @@ static int get_first_field_value_double(struct SelvaObject *obj, struct SelvaObj
     return SELVA_ENOENT;
 }
 
-static int agg_fn_count_uniq_obj(struct SelvaObject *obj, struct AggregateCommand_Args* args) {
-    struct SelvaObject *fields_obj = args->find_args.send_param.fields;
-    SVector *fields;
+static void uniq_add(struct aggregate_uniq *uniq, struct SelvaObject *obj, SVector *fields) {
     struct SVectorIterator it;
     const RedisModuleString *field;
-    int err;
-
-    err = SelvaObject_GetArrayStr(fields_obj, "0", 1, NULL, &fields);
-    if (err || !fields) {
-        return SELVA_ENOENT;
-    }
 
     SVector_ForeachBegin(&it, fields);
     while ((field = SVector_Foreach(&it))) {
         struct SelvaObjectAny value;
+        int err;
 
         err = SelvaObject_GetAny(obj, field, &value);
         if (!err) {
             if (value.type == SELVA_OBJECT_DOUBLE) {
-                SelvaSet_Add(&args->uniq.set_double, value.d);
+                SelvaSet_Add(&uniq->set_double, value.d);
                 break;
             } else if (value.type == SELVA_OBJECT_LONGLONG) {
-                SelvaSet_Add(&args->uniq.set_longlong, value.ll);
+                SelvaSet_Add(&uniq->set_longlong, value.ll);
                 break;
             } else if (value.type == SELVA_OBJECT_STRING) {
                 RedisModuleString *tmp = RedisModule_HoldString(NULL, value.str);
 
-                if (SelvaSet_Add(&args->uniq.set_rmstring, tmp)) {
+                if (SelvaSet_Add(&uniq->set_rmstring, tmp)) {
                     RedisModule_FreeString(NULL, tmp);
                 }
                 break;
             }
         }
     }
+}
 
-    return 0;
+/**
+ * Add the value of the first existing field to a HyperLogLog.
+ * @returns 0 if a value was added; Otherwise SELVA_ENOENT.
+ */
+static int hll_add_obj(struct hll *hll, struct SelvaObject *obj, SVector *fields) {
+    struct SVectorIterator it;
+    const RedisModuleString *field;
+
+    SVector_ForeachBegin(&it, fields);
+    while ((field = SVector_Foreach(&it))) {
+        struct SelvaObjectAny value;
+        int err;
+
+        err = SelvaObject_GetAny(obj, field, &value);
+        if (err) {
+            continue;
+        }
+
+        if (value.type == SELVA_OBJECT_DOUBLE) {
+            const double d = value.d == 0.0 ? 0.0 : value.d; /* -0.0 == 0.0 */
+
+            hll_add(hll, &d, sizeof(d));
+            return 0;
+        } else if (value.type == SELVA_OBJECT_LONGLONG) {
+            hll_add(hll, &value.ll, sizeof(value.ll));
+            return 0;
+        } else if (value.type == SELVA_OBJECT_STRING) {
+            size_t len;
+            const char *str = RedisModule_StringPtrLen(value.str, &len);
+
+            hll_add(hll, str, len);
+            return 0;
+        } else if (value.type == SELVA_OBJECT_SET) {
+            struct SelvaSet *set = value.set;
+            struct SelvaSetElement *el;
+
+            switch (set->type) {
+            case SELVA_SET_TYPE_RMSTRING:
+                SELVA_SET_RMS_FOREACH(el, set) {
+                    size_t len;
+                    const char *str = RedisModule_StringPtrLen(el->value_rms, &len);
+
+                    hll_add(hll, str, len);
+                }
+                break;
+            case SELVA_SET_TYPE_DOUBLE:
+                SELVA_SET_DOUBLE_FOREACH(el, set) {
+                    hll_add(hll, &el->value_d, sizeof(el->value_d));
+                }
+                break;
+            case SELVA_SET_TYPE_LONGLONG:
+                SELVA_SET_LONGLONG_FOREACH(el, set) {
+                    hll_add(hll, &el->value_ll, sizeof(el->value_ll));
+                }
+                break;
+            case SELVA_SET_TYPE_NODEID:
+                SELVA_SET_NODEID_FOREACH(el, set) {
+                    hll_add(hll, el->value_nodeId, SELVA_NODE_ID_SIZE);
+                }
+                break;
+            case SELVA_SET_NR_TYPES:
+                /* Invalid type. */
+                break;
+            }
+            return 0;
+        }
+    }
+
+    return SELVA_ENOENT;
 }
 
-static int agg_fn_sum_obj(struct SelvaObject *obj, struct AggregateCommand_Args* args) {
-    struct SelvaObject *fields_obj = args->find_args.send_param.fields;
-    double d;
+static int agg_fn_count_uniq_obj(struct SelvaObject *obj, struct AggregateCommand_Args* args) {
+    SVector *fields;
 
-    if (!get_first_field_value_double(obj, fields_obj, &d)) {
-        args->aggregation_result_double += d;
-        args->item_count++;
+    fields = get_fields(args->find_args.send_param.fields);
+    if (!fields) {
+        return SELVA_ENOENT;
     }
 
+    uniq_add(&args->uniq, obj, fields);
+
     return 0;
 }
 
-static int agg_fn_avg_obj(struct SelvaObject *obj, struct AggregateCommand_Args* args) {
-    return agg_fn_sum_obj(obj, args);
-}
+static void flush_stream(struct AggregateCommand_Args *args);
 
-static int agg_fn_min_obj(struct SelvaObject *obj, struct AggregateCommand_Args* args) {
-    struct SelvaObject *fields_obj = args->find_args.send_param.fields;
-    double d;
+/**
+ * Add the value of an ungrouped sum, avg, min or max to the stream.
+ */
+static int agg_fn_stream(struct SelvaObject *obj, struct AggregateCommand_Args *args) {
+    struct aggregate_stream *stream = &args->stream;
+    SVector *fields;
 
-    if (!get_first_field_value_double(obj, fields_obj, &d)) {
-        if (d < args->aggregation_result_double) {
-            args->aggregation_result_double = d;
-        }
+    fields = get_fields(args->find_args.send_param.fields);
+    if (!fields) {
+        return SELVA_ENOENT;
+    }
+
+    if (!get_first_value_double(obj, fields, &stream->vals[stream->len]) &&
+        ++stream->len == AGGREGATE_BATCH_SIZE) {
+        flush_stream(args);
     }
 
     return 0;
 }
 
-static int agg_fn_max_obj(struct SelvaObject *obj, struct AggregateCommand_Args* args) {
-    struct SelvaObject *fields_obj = args->find_args.send_param.fields;
-    double d;
+/**
+ * Collect the object to the batch.
+ * The batch is aggregated by aggregate_batch() once the traversal is done.
+ */
+static int agg_fn_collect(struct SelvaObject *obj, struct AggregateCommand_Args *args) {
+    struct aggregate_batch *batch = &args->batch;
 
-    if (!get_first_field_value_double(obj, fields_obj, &d)) {
-        if (d > args->aggregation_result_double) {
-            args->aggregation_result_double = d;
-        }
+    if (batch->len == batch->size) {
+        batch->size = batch->size ? 2 * batch->size : AGGREGATE_BATCH_SIZE;
+        batch->objs = selva_arena_realloc(SELVA_ARENA_QUERY, batch->objs, batch->size * sizeof(*batch->objs));
     }
 
+    batch->objs[batch->len++] = obj;
+
     return 0;
 }
 
@@ -210,14 +361,465 @@ static int agg_fn_none(struct SelvaObject *obj __unused, struct AggregateCommand
 static agg_func agg_funcs[] = {
     agg_fn_count_obj,
     agg_fn_count_uniq_obj,
-    agg_fn_sum_obj,
-    agg_fn_avg_obj,
-    agg_fn_min_obj,
-    agg_fn_max_obj,
+    agg_fn_stream, /* sum */
+    agg_fn_stream, /* avg */
+    agg_fn_stream, /* min */
+    agg_fn_stream, /* max */
+    agg_fn_collect, /* count_unique_approx */
     agg_fn_none,
 };
 
-GENERATE_STATIC_FUNMAP(get_agg_func, agg_funcs, int, num_elem(agg_funcs) - 2);
+GENERATE_STATIC_FUNMAP(get_agg_func, agg_funcs, int, SELVA_AGGREGATE_TYPE_MAX_FIELD - '0');
+
+static int AggregateGroup_Compare(const struct AggregateGroup *a, const struct AggregateGroup *b) {
+    if (a->hash != b->hash) {
+        return a->hash < b->hash ? -1 : 1;
+    }
+    if (a->key_len != b->key_len) {
+        return a->key_len < b->key_len ? -1 : 1;
+    }
+
+    return memcmp(a->key, b->key, a->key_len);
+}
+
+RB_PROTOTYPE_STATIC(AggregateGroups, AggregateGroup, _entry, AggregateGroup_Compare)
+RB_GENERATE_STATIC(AggregateGroups, AggregateGroup, _entry, AggregateGroup_Compare)
+
+/**
+ * A chunk of the batch aggregated by a single thread.
+ */
+struct aggregate_chunk {
+    enum SelvaHierarchy_AggregateType aggregate_type;
+    RedisModuleString *lang;
+    SVector *fields;
+    const char *group_by_str;
+    size_t group_by_len;
+    struct SelvaObject **objs;
+    size_t len;
+    struct AggregateGroups groups; /*!< Partial aggregates of this chunk. */
+};
+
+/**
+ * FNV-1a.
+ */
+static uint32_t hash_group_key(const char *key, size_t key_len) {
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < key_len; i++) {
+        hash ^= (uint8_t)key[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static struct AggregateGroup *new_group(enum SelvaHierarchy_AggregateType aggregate_type, const char *key, size_t key_len, uint32_t hash) {
+    struct AggregateGroup *grp;
+    char *grp_key;
+
+    grp = selva_arena_malloc(SELVA_ARENA_QUERY, sizeof(*grp) + key_len);
+    grp_key = (char *)(grp + 1);
+    memcpy(grp_key, key, key_len);
+
+    grp->hash = hash;
+    grp->item_count = 0;
+    grp->sum = 0.0;
+    grp->min = DBL_MAX;
+    grp->max = -DBL_MAX;
+    grp->uniq = NULL;
+    grp->hll = NULL;
+    grp->key_len = key_len;
+    grp->key = grp_key;
+
+    if (aggregate_type == SELVA_AGGREGATE_TYPE_COUNT_UNIQUE_FIELD) {
+        grp->uniq = selva_arena_malloc(SELVA_ARENA_QUERY, sizeof(*grp->uniq));
+        uniq_init(grp->uniq);
+    } else if (aggregate_type == SELVA_AGGREGATE_TYPE_COUNT_UNIQUE_APPROX_FIELD) {
+        grp->hll = selva_arena_malloc(SELVA_ARENA_QUERY, sizeof(*grp->hll));
+        hll_init(grp->hll, selva_glob_config.aggregate_hll_precision);
+    }
+
+    return grp;
+}
+
+static void destroy_group(struct AggregateGroup *grp) {
+    if (grp->uniq) {
+        uniq_destroy(grp->uniq);
+        selva_arena_free(SELVA_ARENA_QUERY, grp->uniq);
+    }
+    if (grp->hll) {
+        hll_destroy(grp->hll);
+        selva_arena_free(SELVA_ARENA_QUERY, grp->hll);
+    }
+    selva_arena_free(SELVA_ARENA_QUERY, grp);
+}
+
+static void destroy_groups(struct AggregateGroups *groups) {
+    struct AggregateGroup *grp;
+    struct AggregateGroup *next;
+
+    for (grp = RB_MIN(AggregateGroups, groups); grp != NULL; grp = next) {
+        next = RB_NEXT(AggregateGroups, groups, grp);
+        RB_REMOVE(AggregateGroups, groups, grp);
+        destroy_group(grp);
+    }
+}
+
+static struct AggregateGroup *get_group(struct aggregate_chunk *chunk, const char *key, size_t key_len) {
+    struct AggregateGroup find = {
+        .hash = hash_group_key(key, key_len),
+        .key_len = key_len,
+        .key = key,
+    };
+    struct AggregateGroup *grp;
+
+    grp = RB_FIND(AggregateGroups, &chunk->groups, &find);
+    if (!grp) {
+        grp = new_group(chunk->aggregate_type, key, key_len, find.hash);
+        RB_INSERT(AggregateGroups, &chunk->groups, grp);
+    }
+
+    return grp;
+}
+
+/**
+ * Get the group of obj.
+ * Numbers are grouped by their string representation.
+ * @returns A pointer to the group; NULL if obj doesn't have the group_by field.
+ */
+static struct AggregateGroup *get_obj_group(struct aggregate_chunk *chunk, struct SelvaObject *obj) {
+    struct SelvaObjectAny value;
+    char buf[32];
+    const char *key;
+    size_t key_len;
+    int err;
+
+    err = SelvaObject_GetAnyLangStr(obj, chunk->lang, chunk->group_by_str, chunk->group_by_len, &value);
+    if (err) {
+        return NULL;
+    }
+
+    switch (value.type) {
+    case SELVA_OBJECT_STRING:
+        key = RedisModule_StringPtrLen(value.str, &key_len);
+        break;
+    case SELVA_OBJECT_LONGLONG:
+        key = buf;
+        key_len = snprintf(buf, sizeof(buf), "%lld", value.ll);
+        break;
+    case SELVA_OBJECT_DOUBLE:
+        key = buf;
+        key_len = snprintf(buf, sizeof(buf), "%.15g", value.d);
+        break;
+    default:
+        return NULL;
+    }
+
+    return get_group(chunk, key, key_len);
+}
+
+/**
+ * Reduce a batch of values of a single group.
+ * The values are reduced in independent lanes so the compiler can vectorize
+ * the loop without reordering the additions.
+ */
+static void reduce_values(struct AggregateGroup *grp, const double * restrict vals, size_t n) {
+    double sum[AGGREGATE_REDUCE_LANES];
+    double vmin[AGGREGATE_REDUCE_LANES];
+    double vmax[AGGREGATE_REDUCE_LANES];
+    size_t i;
+
+    for (size_t k = 0; k < AGGREGATE_REDUCE_LANES; k++) {
+        sum[k] = 0.0;
+        vmin[k] = grp->min;
+        vmax[k] = grp->max;
+    }
+
+    for (i = 0; i + AGGREGATE_REDUCE_LANES <= n; i += AGGREGATE_REDUCE_LANES) {
+        for (size_t k = 0; k < AGGREGATE_REDUCE_LANES; k++) {
+            const double d = vals[i + k];
+
+            sum[k] += d;
+            vmin[k] = d < vmin[k] ? d : vmin[k];
+            vmax[k] = d > vmax[k] ? d : vmax[k];
+        }
+    }
+    for (; i < n; i++) {
+        const double d = vals[i];
+
+        sum[0] += d;
+        vmin[0] = d < vmin[0] ? d : vmin[0];
+        vmax[0] = d > vmax[0] ? d : vmax[0];
+    }
+
+    for (size_t k = 0; k < AGGREGATE_REDUCE_LANES; k++) {
+        grp->sum += sum[k];
+        grp->min = vmin[k] < grp->min ? vmin[k] : grp->min;
+        grp->max = vmax[k] > grp->max ? vmax[k] : grp->max;
+    }
+    grp->item_count += n;
+}
+
+static void aggregate_chunk(struct aggregate_chunk *chunk) {
+    const enum SelvaHierarchy_AggregateType aggregate_type = chunk->aggregate_type;
+    struct AggregateGroup *all = NULL;
+    struct AggregateGroup *grps[AGGREGATE_BATCH_SIZE];
+    double vals[AGGREGATE_BATCH_SIZE];
+
+    if (aggregate_type != SELVA_AGGREGATE_TYPE_COUNT_NODE && !chunk->fields) {
+        /* Nothing to aggregate. */
+        return;
+    }
+
+    if (!chunk->group_by_str) {
+        all = get_group(chunk, "", 0);
+    }
+
+    for (size_t i = 0; i < chunk->len; i += AGGREGATE_BATCH_SIZE) {
+        const size_t end = min(i + AGGREGATE_BATCH_SIZE, chunk->len);
+        size_t n = 0;
+
+        /*
+         * Extract the values of the batch first.
+         */
+        for (size_t j = i; j < end; j++) {
+            struct SelvaObject *obj = chunk->objs[j];
+            struct AggregateGroup *grp = all;
+
+            if (!grp) {
+                grp = get_obj_group(chunk, obj);
+                if (!grp) {
+                    continue;
+                }
+            }
+
+            if (aggregate_type == SELVA_AGGREGATE_TYPE_COUNT_NODE) {
+                grp->item_count++;
+            } else if (aggregate_type == SELVA_AGGREGATE_TYPE_COUNT_UNIQUE_FIELD) {
+                uniq_add(grp->uniq, obj, chunk->fields);
+            } else if (aggregate_type == SELVA_AGGREGATE_TYPE_COUNT_UNIQUE_APPROX_FIELD) {
+                grp->item_count += !hll_add_obj(grp->hll, obj, chunk->fields);
+            } else if (!get_first_value_double(obj, chunk->fields, &vals[n])) {
+                grps[n++] = grp;
+            }
+        }
+
+        if (all) {
+            reduce_values(all, vals, n);
+        } else {
+            for (size_t j = 0; j < n; j++) {
+                struct AggregateGroup *grp = grps[j];
+                const double d = vals[j];
+
+                grp->sum += d;
+                grp->min = min(grp->min, d);
+                grp->max = max(grp->max, d);
+                grp->item_count++;
+            }
+        }
+    }
+}
+
+static void *aggregate_worker(void *arg) {
+    aggregate_chunk((struct aggregate_chunk *)arg);
+
+    return NULL;
+}
+
+/**
+ * Move the groups of src to dst.
+ */
+static void merge_groups(struct AggregateGroups *dst, struct AggregateGroups *src) {
+    struct AggregateGroup *grp;
+    struct AggregateGroup *next;
+
+    for (grp = RB_MIN(AggregateGroups, src); grp != NULL; grp = next) {
+        struct AggregateGroup *dst_grp;
+
+        next = RB_NEXT(AggregateGroups, src, grp);
+        RB_REMOVE(AggregateGroups, src, grp);
+
+        dst_grp = RB_INSERT(AggregateGroups, dst, grp);
+        if (dst_grp) {
+            /* count_unique is never split into chunks. */
+            assert(!grp->uniq);
+
+            dst_grp->item_count += grp->item_count;
+            dst_grp->sum += grp->sum;
+            dst_grp->min = min(dst_grp->min, grp->min);
+            dst_grp->max = max(dst_grp->max, grp->max);
+            if (grp->hll) {
+                (void)hll_merge(dst_grp->hll, grp->hll);
+            }
+            destroy_group(grp);
+        }
+    }
+}
+
+/**
+ * Aggregate the objects collected to the batch.
+ * The batch is split into disjoint chunks that are aggregated in parallel
+ * if it's big enough. The partial aggregates of the chunks are merged
+ * into groups.
+ */
+static void aggregate_batch(struct AggregateCommand_Args *args, struct AggregateGroups *groups) {
+    const size_t len = args->batch.len;
+    size_t nr_chunks = 1;
+
+    /*
+     * Holding the strings for count_unique is not thread-safe.
+     */
+    if (args->aggregate_type != SELVA_AGGREGATE_TYPE_COUNT_UNIQUE_FIELD &&
+        selva_glob_config.aggregate_workers > 1) {
+        nr_chunks = min((size_t)selva_glob_config.aggregate_workers, len / AGGREGATE_WORKER_MIN_NODES);
+        nr_chunks = max(nr_chunks, (size_t)1);
+    }
+
+    const size_t chunk_len = (len + nr_chunks - 1) / nr_chunks;
+    struct aggregate_chunk chunks[nr_chunks];
+    pthread_t tids[nr_chunks];
+    int started[nr_chunks];
+    SVector *fields = args->find_args.send_param.fields ? get_fields(args->find_args.send_param.fields) : NULL;
+
+    for (size_t i = 0; i < nr_chunks; i++) {
+        const size_t off = i * chunk_len;
+
+        chunks[i] = (struct aggregate_chunk){
+            .aggregate_type = args->aggregate_type,
+            .lang = args->find_args.lang,
+            .fields = fields,
+            .group_by_str = args->group_by_str,
+            .group_by_len = args->group_by_len,
+            .objs = args->batch.objs + off,
+            .len = min(chunk_len, len - off),
+        };
+        RB_INIT(&chunks[i].groups);
+    }
+
+    /*
+     * The first chunk is always aggregated by the calling thread.
+     */
+    for (size_t i = 1; i < nr_chunks; i++) {
+        started[i] = !pthread_create(&tids[i], NULL, aggregate_worker, &chunks[i]);
+        if (!started[i]) {
+            aggregate_chunk(&chunks[i]);
+        }
+    }
+    aggregate_chunk(&chunks[0]);
+
+    for (size_t i = 1; i < nr_chunks; i++) {
+        if (started[i]) {
+            pthread_join(tids[i], NULL);
+        }
+        merge_groups(&chunks[0].groups, &chunks[i].groups);
+    }
+
+    *groups = chunks[0].groups;
+    aggregate_nr_batched += len;
+    aggregate_nr_parallel += nr_chunks > 1;
+}
+
+/**
+ * Test if the group has a result to be sent.
+ * A sum, avg, min or max of a group that has no values for the field is
+ * skipped.
+ */
+static int has_group_result(enum SelvaHierarchy_AggregateType aggregate_type, const struct AggregateGroup *grp) {
+    switch (aggregate_type) {
+    case SELVA_AGGREGATE_TYPE_SUM_FIELD:
+    case SELVA_AGGREGATE_TYPE_AVG_FIELD:
+    case SELVA_AGGREGATE_TYPE_MIN_FIELD:
+    case SELVA_AGGREGATE_TYPE_MAX_FIELD:
+        return grp->item_count > 0;
+    default:
+        return 1;
+    }
+}
+
+static void AggregateCommand_PrintGroups(RedisModuleCtx *ctx, const struct AggregateCommand_Args *args, struct AggregateGroups *groups) {
+    struct AggregateGroup *grp;
+    size_t nr_groups = 0;
+
+    RB_FOREACH(grp, AggregateGroups, groups) {
+        nr_groups += has_group_result(args->aggregate_type, grp);
+    }
+
+    RedisModule_ReplyWithArray(ctx, 2 * nr_groups);
+    RB_FOREACH(grp, AggregateGroups, groups) {
+        if (!has_group_result(args->aggregate_type, grp)) {
+            continue;
+        }
+
+        RedisModule_ReplyWithStringBuffer(ctx, grp->key, grp->key_len);
+
+        switch (args->aggregate_type) {
+        case SELVA_AGGREGATE_TYPE_COUNT_NODE:
+            RedisModule_ReplyWithLongLong(ctx, grp->item_count);
+            break;
+        case SELVA_AGGREGATE_TYPE_COUNT_UNIQUE_FIELD:
+            RedisModule_ReplyWithLongLong(ctx, uniq_size(grp->uniq));
+            break;
+        case SELVA_AGGREGATE_TYPE_COUNT_UNIQUE_APPROX_FIELD:
+            RedisModule_ReplyWithLongLong(ctx, hll_count(grp->hll));
+            break;
+        case SELVA_AGGREGATE_TYPE_AVG_FIELD:
+            RedisModule_ReplyWithDouble(ctx, grp->sum / (double)grp->item_count);
+            break;
+        case SELVA_AGGREGATE_TYPE_MIN_FIELD:
+            RedisModule_ReplyWithDouble(ctx, grp->min);
+            break;
+        case SELVA_AGGREGATE_TYPE_MAX_FIELD:
+            RedisModule_ReplyWithDouble(ctx, grp->max);
+            break;
+        default:
+            RedisModule_ReplyWithDouble(ctx, grp->sum);
+            break;
+        }
+    }
+}
+
+/**
+ * Merge the partial aggregate of all nodes to the aggregation result.
+ */
+static void merge_group_result(struct AggregateCommand_Args *args, const struct AggregateGroup *all) {
+    if (!all || all->item_count == 0) {
+        return;
+    }
+
+    switch (args->aggregate_type) {
+    case SELVA_AGGREGATE_TYPE_COUNT_UNIQUE_APPROX_FIELD:
+        args->aggregation_result_int = hll_count(all->hll);
+        break;
+    case SELVA_AGGREGATE_TYPE_MIN_FIELD:
+        if (all->min < args->aggregation_result_double) {
+            args->aggregation_result_double = all->min;
+        }
+        break;
+    case SELVA_AGGREGATE_TYPE_MAX_FIELD:
+        if (all->max > args->aggregation_result_double) {
+            args->aggregation_result_double = all->max;
+        }
+        break;
+    default:
+        args->aggregation_result_double += all->sum;
+        break;
+    }
+    args->item_count += all->item_count;
+}
+
+/**
+ * Reduce the values waiting in the stream.
+ */
+static void flush_stream(struct AggregateCommand_Args *args) {
+    struct AggregateGroup acc = {
+        .min = DBL_MAX,
+        .max = -DBL_MAX,
+    };
+
+    reduce_values(&acc, args->stream.vals, args->stream.len);
+    args->stream.len = 0;
+    merge_group_result(args, &acc);
+}
 
 static int AggregateCommand_NodeCb(
         RedisModuleCtx *ctx,
@@ -243,7 +845,9 @@ static int AggregateCommand_NodeCb(
         /*
          * Resolve the expression and get the result.
          */
+        SELVA_FIND_PROFILE_BEGIN(filter);
         err = rpn_bool(ctx, rpn_ctx, args->find_args.filter, &take);
+        SELVA_FIND_PROFILE_END(filter, filter_ns);
         if (err) {
             SELVA_LOG(SELVA_LOGL_ERR, "Expression failed (node: \"%.*s\"): \"%s\"\n",
                       (int)SELVA_NODE_ID_SIZE, nodeId,
@@ -277,6 +881,7 @@ static int AggregateCommand_NodeCb(
                 return 1;
             }
         } else {
+            SELVA_FIND_PROFILE_BEGIN(sort);
             struct TraversalOrderItem *item;
 
             item = SelvaTraversalOrder_CreateNodeOrderItem(ctx, args->find_args.lang, node, args->find_args.send_param.order_field);
@@ -291,6 +896,7 @@ static int AggregateCommand_NodeCb(
                  */
                 SELVA_LOG(SELVA_LOGL_ERR, "Out of memory while creating an order result item\n");
             }
+            SELVA_FIND_PROFILE_END(sort, sort_ns);
         }
     }
 
@@ -480,10 +1086,24 @@ static size_t AggregateCommand_PrintAggregateResult(RedisModuleCtx *ctx, const s
         RedisModule_ReplyWithLongLong(ctx, args->item_count);
         break;
     case SELVA_AGGREGATE_TYPE_COUNT_UNIQUE_FIELD:
+    case SELVA_AGGREGATE_TYPE_COUNT_UNIQUE_APPROX_FIELD:
         RedisModule_ReplyWithLongLong(ctx, args->aggregation_result_int);
         break;
     case SELVA_AGGREGATE_TYPE_AVG_FIELD:
-        RedisModule_ReplyWithDouble(ctx, args->aggregation_result_double / (double)args->item_count);
+        if (args->item_count == 0) {
+            RedisModule_ReplyWithNull(ctx);
+        } else {
+            RedisModule_ReplyWithDouble(ctx, args->aggregation_result_double / (double)args->item_count);
+        }
+        break;
+    case SELVA_AGGREGATE_TYPE_MIN_FIELD:
+    case SELVA_AGGREGATE_TYPE_MAX_FIELD:
+        /* There is no min or max of nothing. */
+        if (args->item_count == 0) {
+            RedisModule_ReplyWithNull(ctx);
+        } else {
+            RedisModule_ReplyWithDouble(ctx, args->aggregation_result_double);
+        }
         break;
     default:
         RedisModule_ReplyWithDouble(ctx, args->aggregation_result_double);
@@ -493,6 +1113,35 @@ static size_t AggregateCommand_PrintAggregateResult(RedisModuleCtx *ctx, const s
     return 0;
 }
 
+/**
+ * Finish the aggregation and send the result.
+ */
+static void AggregateCommand_Reply(RedisModuleCtx *ctx, struct AggregateCommand_Args *args) {
+    if (args->agg == agg_fn_collect) {
+        struct AggregateGroups groups;
+
+        aggregate_batch(args, &groups);
+        if (args->group_by_str) {
+            AggregateCommand_PrintGroups(ctx, args, &groups);
+        } else {
+            merge_group_result(args, RB_MIN(AggregateGroups, &groups));
+            AggregateCommand_PrintAggregateResult(ctx, args);
+        }
+        destroy_groups(&groups);
+    } else {
+        if (args->agg == agg_fn_stream) {
+            flush_stream(args);
+        }
+        count_uniq(args);
+        AggregateCommand_PrintAggregateResult(ctx, args);
+    }
+
+    selva_arena_free(SELVA_ARENA_QUERY, args->batch.objs);
+    args->batch.objs = NULL;
+    args->batch.len = 0;
+    args->batch.size = 0;
+}
+
 int SelvaHierarchy_AggregateCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_AutoMemory(ctx);
     int err;
@@ -513,6 +1162,9 @@ int SelvaHierarchy_AggregateCommand(RedisModuleCtx *ctx, RedisModuleString **arg
     int ARGV_LIMIT_NUM       = 6;
     int ARGV_FIELDS_TXT      = 5;
     int ARGV_FIELDS_VAL      = 6;
+    int ARGV_GROUP_TXT       = 5;
+    int ARGV_GROUP_VAL       = 6;
+    int ARGV_PROFILE_TXT     = 5;
     int ARGV_NODE_IDS        = 5;
     int ARGV_FILTER_EXPR     = 6;
     int ARGV_FILTER_ARGS     = 7;
@@ -528,6 +1180,9 @@ int SelvaHierarchy_AggregateCommand(RedisModuleCtx *ctx, RedisModuleString **arg
     ARGV_LIMIT_NUM += i; \
     ARGV_FIELDS_TXT += i; \
     ARGV_FIELDS_VAL += i; \
+    ARGV_GROUP_TXT += i; \
+    ARGV_GROUP_VAL += i; \
+    ARGV_PROFILE_TXT += i; \
     ARGV_NODE_IDS += i; \
     ARGV_FILTER_EXPR += i; \
     ARGV_FILTER_ARGS += i
@@ -598,7 +1253,7 @@ int SelvaHierarchy_AggregateCommand(RedisModuleCtx *ctx, RedisModuleString **arg
     const enum SelvaHierarchy_AggregateType agg_fn_type = RedisModule_StringPtrLen(argv[ARGV_AGG_FN], NULL)[0];
     double initial_double_val = 0;
     if (agg_fn_type == SELVA_AGGREGATE_TYPE_MAX_FIELD) {
-        initial_double_val = DBL_MIN;
+        initial_double_val = -DBL_MAX;
     } else if (agg_fn_type == SELVA_AGGREGATE_TYPE_MIN_FIELD) {
         initial_double_val = DBL_MAX;
     }
@@ -681,6 +1336,30 @@ int SelvaHierarchy_AggregateCommand(RedisModuleCtx *ctx, RedisModuleString **arg
         }
     }
 
+    /*
+     * Parse group_by.
+     */
+    const char *group_by_str = NULL;
+    if (argc > ARGV_GROUP_VAL) {
+        err = SelvaArgParser_StrOpt(&group_by_str, "group_by", argv[ARGV_GROUP_TXT], argv[ARGV_GROUP_VAL]);
+        if (err == 0) {
+            SHIFT_ARGS(2);
+        } else if (err != SELVA_ENOENT) {
+            replyWithSelvaErrorf(ctx, err, "group_by");
+            goto out;
+        }
+    }
+
+    /*
+     * Parse profile.
+     * The reply will be `[result, profile]`; See SelvaFindProfile_Reply().
+     */
+    if (argc > ARGV_PROFILE_TXT + 1 &&
+        !strcmp(RedisModule_StringPtrLen(argv[ARGV_PROFILE_TXT], NULL), "profile")) {
+        SelvaFindProfile_Reply(ctx, "selva.hierarchy.aggregate", argv, argc, ARGV_PROFILE_TXT);
+        goto out;
+    }
+
     /*
      * Prepare the filter expression if given.
      */
@@ -730,7 +1409,9 @@ int SelvaHierarchy_AggregateCommand(RedisModuleCtx *ctx, RedisModuleString **arg
     struct AggregateCommand_Args args = {
         .ctx = ctx,
         .aggregate_type = agg_fn_type,
-        .agg = get_agg_func(agg_fn_type - '0'),
+        .agg = group_by_str ? agg_fn_collect : get_agg_func(agg_fn_type - '0'),
+        .group_by_str = group_by_str,
+        .group_by_len = group_by_str ? strlen(group_by_str) : 0,
         .aggregation_result_int = 0,
         .aggregation_result_double = initial_double_val,
         .item_count = 0,
@@ -740,6 +1421,7 @@ int SelvaHierarchy_AggregateCommand(RedisModuleCtx *ctx, RedisModuleString **arg
 
     ssize_t nr_nodes = 0;
     size_t merge_nr_fields = 0;
+    const size_t nr_restored = hierarchy->detached.nr_restored;
     for (size_t i = 0; i < ids_len; i += SELVA_NODE_ID_SIZE) {
         Selva_NodeId nodeId;
 
@@ -884,6 +1566,16 @@ int SelvaHierarchy_AggregateCommand(RedisModuleCtx *ctx, RedisModuleString **arg
          * Do index accounting.
          */
         SelvaFindIndex_AccMulti(ind_icb, nr_index_hints, ind_select, args.find_args.acc_take, args.find_args.acc_tot);
+
+        if (selva_find_profile) {
+            selva_find_profile->visited += args.find_args.acc_tot;
+            selva_find_profile->taken += args.find_args.acc_take;
+            selva_find_profile->indexed += ind_select >= 0;
+        }
+    }
+
+    if (selva_find_profile) {
+        selva_find_profile->restored += hierarchy->detached.nr_restored - nr_restored;
     }
 
     /*
@@ -894,25 +1586,32 @@ int SelvaHierarchy_AggregateCommand(RedisModuleCtx *ctx, RedisModuleString **arg
         struct AggregateCommand_Args ord_args = {
             .ctx = ctx,
             .aggregate_type = agg_fn_type,
-            .agg = get_agg_func(agg_fn_type - '0'),
+            .agg = args.agg,
+            .group_by_str = args.group_by_str,
+            .group_by_len = args.group_by_len,
             .aggregation_result_int = 0,
             .aggregation_result_double = initial_double_val,
             .item_count = 0,
             .find_args = {
+                .lang = lang,
                 .send_param.fields = fields,
             }
         };
 
         init_uniq(&ord_args);
+        SELVA_FIND_PROFILE_BEGIN(sort);
         nr_nodes = (dir == SELVA_HIERARCHY_TRAVERSAL_ARRAY)
             ? AggregateCommand_AggregateOrderArrayResult(ctx, lang, &ord_args, hierarchy, offset, limit, fields, &order_result)
             : AggregateCommand_AggregateOrderResult(ctx, lang, &ord_args, offset, limit, fields, &order_result);
-        count_uniq(&args);
-        AggregateCommand_PrintAggregateResult(ctx, &ord_args);
-        destroy_uniq(&args);
+        SELVA_FIND_PROFILE_END(sort, sort_ns);
+        SELVA_FIND_PROFILE_BEGIN(reply);
+        AggregateCommand_Reply(ctx, &ord_args);
+        SELVA_FIND_PROFILE_END(reply, reply_ns);
+        destroy_uniq(&ord_args);
     } else {
-        count_uniq(&args);
-        AggregateCommand_PrintAggregateResult(ctx, &args);
+        SELVA_FIND_PROFILE_BEGIN(reply);
+        AggregateCommand_Reply(ctx, &args);
+        SELVA_FIND_PROFILE_END(reply, reply_ns);
     }
 
     destroy_uniq(&args);
@@ -951,6 +1650,8 @@ int SelvaHierarchy_AggregateInCommand(RedisModuleCtx *ctx, RedisModuleString **a
     int ARGV_LIMIT_NUM       = 5;
     int ARGV_FIELDS_TXT      = 4;
     int ARGV_FIELDS_VAL      = 5;
+    int ARGV_GROUP_TXT       = 4;
+    int ARGV_GROUP_VAL       = 5;
     int ARGV_NODE_IDS        = 4;
     int ARGV_FILTER_EXPR     = 5;
     int ARGV_FILTER_ARGS     = 6;
@@ -961,6 +1662,8 @@ int SelvaHierarchy_AggregateInCommand(RedisModuleCtx *ctx, RedisModuleString **a
     ARGV_LIMIT_NUM += i; \
     ARGV_FIELDS_TXT += i; \
     ARGV_FIELDS_VAL += i; \
+    ARGV_GROUP_TXT += i; \
+    ARGV_GROUP_VAL += i; \
     ARGV_NODE_IDS += i; \
     ARGV_FILTER_EXPR += i; \
     ARGV_FILTER_ARGS += i
@@ -982,7 +1685,7 @@ int SelvaHierarchy_AggregateInCommand(RedisModuleCtx *ctx, RedisModuleString **a
     const enum SelvaHierarchy_AggregateType agg_fn_type = RedisModule_StringPtrLen(argv[ARGV_AGG_FN], NULL)[0];
     double initial_double_val = 0;
     if (agg_fn_type == SELVA_AGGREGATE_TYPE_MAX_FIELD) {
-        initial_double_val = DBL_MIN;
+        initial_double_val = -DBL_MAX;
     } else if (agg_fn_type == SELVA_AGGREGATE_TYPE_MIN_FIELD) {
         initial_double_val = DBL_MAX;
     }
@@ -1051,6 +1754,19 @@ int SelvaHierarchy_AggregateInCommand(RedisModuleCtx *ctx, RedisModuleString **a
         }
     }
 
+    /*
+     * Parse group_by.
+     */
+    const char *group_by_str = NULL;
+    if (argc > ARGV_GROUP_VAL) {
+        err = SelvaArgParser_StrOpt(&group_by_str, "group_by", argv[ARGV_GROUP_TXT], argv[ARGV_GROUP_VAL]);
+        if (err == 0) {
+            SHIFT_ARGS(2);
+        } else if (err != SELVA_ENOENT) {
+            return replyWithSelvaErrorf(ctx, err, "group_by");
+        }
+    }
+
     struct rpn_ctx *rpn_ctx = NULL;
     struct rpn_expression *filter_expression = NULL;
 
@@ -1107,7 +1823,9 @@ int SelvaHierarchy_AggregateInCommand(RedisModuleCtx *ctx, RedisModuleString **a
     struct AggregateCommand_Args args = {
         .ctx = ctx,
         .aggregate_type = agg_fn_type,
-        .agg = get_agg_func(agg_fn_type - '0'),
+        .agg = group_by_str ? agg_fn_collect : get_agg_func(agg_fn_type - '0'),
+        .group_by_str = group_by_str,
+        .group_by_len = group_by_str ? strlen(group_by_str) : 0,
         .aggregation_result_int = 0,
         .aggregation_result_double = initial_double_val,
         .item_count = 0,
@@ -1154,12 +1872,15 @@ int SelvaHierarchy_AggregateInCommand(RedisModuleCtx *ctx, RedisModuleString **a
         struct AggregateCommand_Args ord_args = {
             .ctx = ctx,
             .aggregate_type = agg_fn_type,
-            .agg = get_agg_func(agg_fn_type - '0'),
+            .agg = args.agg,
+            .group_by_str = args.group_by_str,
+            .group_by_len = args.group_by_len,
             .aggregation_result_int = 0,
             .aggregation_result_double = initial_double_val,
             .item_count = 0,
             .find_args = {
                 /* we always need context */
+                .lang = lang,
                 .send_param.fields = fields,
                 .send_param.excluded_fields = NULL,
             }
@@ -1167,12 +1888,10 @@ int SelvaHierarchy_AggregateInCommand(RedisModuleCtx *ctx, RedisModuleString **a
 
         init_uniq(&ord_args);
         AggregateCommand_AggregateOrderResult(ctx, lang, &ord_args, offset, limit, fields, &order_result);
-        count_uniq(&ord_args);
-        AggregateCommand_PrintAggregateResult(ctx, &ord_args);
+        AggregateCommand_Reply(ctx, &ord_args);
         destroy_uniq(&ord_args);
     } else {
-        count_uniq(&args);
-        AggregateCommand_PrintAggregateResult(ctx, &args);
+        AggregateCommand_Reply(ctx, &args);
     }
 
     destroy_uniq(&args);
@@ -1202,3 +1921,9 @@ static int Aggregate_OnLoad(RedisModuleCtx *ctx) {
     return REDISMODULE_OK;
 }
 SELVA_ONLOAD(Aggregate_OnLoad);
+
+static void mod_info(RedisModuleInfoCtx *ctx) {
+    (void)RedisModule_InfoAddFieldULongLong(ctx, "nr_batched", aggregate_nr_batched);
+    (void)RedisModule_InfoAddFieldULongLong(ctx, "nr_parallel", aggregate_nr_parallel);
+}
+SELVA_MODINFO("aggregate", mod_info);
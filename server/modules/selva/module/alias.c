@@ -2,24 +2,102 @@
  * Copyright (c) 2022 SAULX
  * SPDX-License-Identifier: MIT
  */
+#include <stddef.h>
+#include <string.h>
 #include "redismodule.h"
+#include "jemalloc.h"
+#include "auto_free.h"
 #include "selva.h"
+#include "selva_onload.h"
 #include "selva_object.h"
 #include "selva_set.h"
+#include "subscriptions.h"
 #include "hierarchy.h"
 #include "alias.h"
 
-RedisModuleKey *open_aliases_key(RedisModuleCtx *ctx) {
-    RedisModuleKey * key;
-    RedisModuleString *alias_key_name;
+static int SelvaAlias_Compare(const struct SelvaAlias *a, const struct SelvaAlias *b) {
+    if (a->name_len != b->name_len) {
+        return a->name_len < b->name_len ? -1 : 1;
+    }
+
+    return memcmp(a->name, b->name, a->name_len);
+}
+
+RB_PROTOTYPE_STATIC(hierarchy_alias_tree, SelvaAlias, _entry, SelvaAlias_Compare)
+RB_GENERATE_STATIC(hierarchy_alias_tree, SelvaAlias, _entry, SelvaAlias_Compare)
+
+void SelvaAliases_Init(struct SelvaAliases *aliases) {
+    RB_INIT(&aliases->head);
+    aliases->nr_aliases = 0;
+}
+
+void SelvaAliases_Destroy(struct SelvaAliases *aliases) {
+    struct hierarchy_alias_tree *head = &aliases->head;
+    struct SelvaAlias *alias;
+    struct SelvaAlias *next;
+
+    for (alias = RB_MIN(hierarchy_alias_tree, head); alias != NULL; alias = next) {
+        next = RB_NEXT(hierarchy_alias_tree, head, alias);
+        RB_REMOVE(hierarchy_alias_tree, head, alias);
+        selva_free(alias);
+    }
+
+    aliases->nr_aliases = 0;
+}
 
-    alias_key_name = RedisModule_CreateString(ctx, SELVA_ALIASES_KEY, sizeof(SELVA_ALIASES_KEY) - 1);
-    key = RedisModule_OpenKey(ctx, alias_key_name, REDISMODULE_READ | REDISMODULE_WRITE);
+static struct SelvaAlias *find_alias(struct SelvaAliases *aliases, const char *name_str, size_t name_len) {
+    struct SelvaAlias find = {
+        .name_len = name_len,
+        .name = name_str,
+    };
+
+    return RB_FIND(hierarchy_alias_tree, &aliases->head, &find);
+}
+
+/**
+ * Insert or update an alias.
+ * @returns 1 if a new alias was inserted; 0 if an existing alias was updated.
+ */
+static int upsert_alias(struct SelvaAliases *aliases, const char *name_str, size_t name_len, const Selva_NodeId dest) {
+    struct SelvaAlias *alias;
+
+    alias = find_alias(aliases, name_str, name_len);
+    if (alias) {
+        memcpy(alias->dest, dest, SELVA_NODE_ID_SIZE);
+        return 0;
+    }
+
+    alias = selva_malloc(sizeof(*alias) + name_len);
+    memcpy(alias->dest, dest, SELVA_NODE_ID_SIZE);
+    alias->name_len = name_len;
+    alias->name = alias->name_buf;
+    memcpy(alias->name_buf, name_str, name_len);
+
+    RB_INSERT(hierarchy_alias_tree, &aliases->head, alias);
+    aliases->nr_aliases++;
+
+    return 1;
+}
 
-    return key;
+static void remove_alias(struct SelvaAliases *aliases, struct SelvaAlias *alias) {
+    RB_REMOVE(hierarchy_alias_tree, &aliases->head, alias);
+    aliases->nr_aliases--;
+    selva_free(alias);
 }
 
-int delete_aliases(RedisModuleKey *aliases_key, struct SelvaSet *set) {
+int get_alias(struct SelvaHierarchy *hierarchy, const char *name_str, size_t name_len, Selva_NodeId node_id) {
+    const struct SelvaAlias *alias;
+
+    alias = find_alias(&hierarchy->aliases, name_str, name_len);
+    if (!alias) {
+        return SELVA_ENOENT;
+    }
+
+    memcpy(node_id, alias->dest, SELVA_NODE_ID_SIZE);
+    return 0;
+}
+
+int delete_aliases(struct SelvaHierarchy *hierarchy, const Selva_NodeId node_id, struct SelvaSet *set) {
     struct SelvaSetElement *el;
 
     if (!set || set->type != SELVA_SET_TYPE_RMSTRING) {
@@ -28,35 +106,150 @@ int delete_aliases(RedisModuleKey *aliases_key, struct SelvaSet *set) {
     }
 
     SELVA_SET_RMS_FOREACH(el, set) {
-        RedisModuleString *alias = el->value_rms;
+        RedisModuleString *name = el->value_rms;
+        TO_STR(name);
+        struct SelvaAlias *alias;
+
+        alias = find_alias(&hierarchy->aliases, name_str, name_len);
+        if (alias && !memcmp(alias->dest, node_id, SELVA_NODE_ID_SIZE)) {
+            remove_alias(&hierarchy->aliases, alias);
+        }
+    }
 
-        RedisModule_HashSet(aliases_key, REDISMODULE_HASH_NONE, alias, REDISMODULE_HASH_DELETE, NULL);
+    return 0;
+}
+
+int delete_alias(struct SelvaHierarchy *hierarchy, struct RedisModuleString *ref) {
+    TO_STR(ref);
+    struct SelvaAlias *alias;
+
+    alias = find_alias(&hierarchy->aliases, ref_str, ref_len);
+    if (!alias) {
+        return SELVA_ENOENT;
     }
 
+    remove_alias(&hierarchy->aliases, alias);
     return 0;
 }
 
-void update_alias(struct RedisModuleCtx *ctx, SelvaHierarchy *hierarchy, RedisModuleKey *alias_key, const Selva_NodeId node_id, RedisModuleString *ref) {
-    RedisModuleString *old = NULL;
+void update_alias(SelvaHierarchy *hierarchy, const Selva_NodeId node_id, RedisModuleString *ref) {
+    TO_STR(ref);
+    Selva_NodeId old_node_id;
 
     /*
      * Remove the alias from the previous node.
      */
-    if (!RedisModule_HashGet(alias_key, REDISMODULE_HASH_NONE, ref, &old, NULL)) {
-        if (old) {
-            TO_STR(old);
-            Selva_NodeId old_node_id;
-            const struct SelvaHierarchyNode *old_node;
-
-            Selva_NodeIdCpy(old_node_id, old_str);
-            old_node = SelvaHierarchy_FindNode(hierarchy, old_node_id);
-            if (old_node) {
-                struct SelvaObject *obj = SelvaHierarchy_GetNodeObject(old_node);
-
-                SelvaObject_RemStringSetStr(obj, SELVA_ALIASES_FIELD, sizeof(SELVA_ALIASES_FIELD) - 1, ref);
-            }
+    if (!get_alias(hierarchy, ref_str, ref_len, old_node_id) &&
+        memcmp(old_node_id, node_id, SELVA_NODE_ID_SIZE)) {
+        const struct SelvaHierarchyNode *old_node;
+
+        old_node = SelvaHierarchy_FindNode(hierarchy, old_node_id);
+        if (old_node) {
+            struct SelvaObject *obj = SelvaHierarchy_GetNodeObject(old_node);
+
+            SelvaObject_RemStringSetStr(obj, SELVA_ALIASES_FIELD, sizeof(SELVA_ALIASES_FIELD) - 1, ref);
         }
     }
 
-    RedisModule_HashSet(alias_key, REDISMODULE_HASH_NONE, ref, RedisModule_CreateString(ctx, node_id, Selva_NodeIdLen(node_id)), NULL);
+    if (upsert_alias(&hierarchy->aliases, ref_str, ref_len, node_id)) {
+        /* Someone might be waiting for this alias to appear. */
+        SelvaSubscriptions_DeferMissingAccessorEvents(hierarchy, ref_str, ref_len);
+    }
+}
+
+void add_node_aliases(struct SelvaHierarchy *hierarchy, const Selva_NodeId node_id, struct SelvaObject *obj) {
+    struct SelvaSet *set;
+    struct SelvaSetElement *el;
+
+    set = SelvaObject_GetSetStr(obj, SELVA_ALIASES_FIELD, sizeof(SELVA_ALIASES_FIELD) - 1);
+    if (!set || set->type != SELVA_SET_TYPE_RMSTRING) {
+        return;
+    }
+
+    SELVA_SET_RMS_FOREACH(el, set) {
+        RedisModuleString *name = el->value_rms;
+        TO_STR(name);
+
+        (void)upsert_alias(&hierarchy->aliases, name_str, name_len, node_id);
+    }
+}
+
+void SelvaAliases_RdbSave(struct RedisModuleIO *io, struct SelvaAliases *aliases) {
+    struct SelvaAlias *alias;
+
+    /*
+     * Serialization format:
+     * NR_ALIASES | NAME1 | NODE_ID1 | NAME2 | NODE_ID2 ...
+     */
+    RedisModule_SaveUnsigned(io, aliases->nr_aliases);
+    RB_FOREACH(alias, hierarchy_alias_tree, &aliases->head) {
+        RedisModule_SaveStringBuffer(io, alias->name, alias->name_len);
+        RedisModule_SaveStringBuffer(io, alias->dest, SELVA_NODE_ID_SIZE);
+    }
+}
+
+int SelvaAliases_RdbLoad(struct RedisModuleIO *io, int encver, struct SelvaHierarchy *hierarchy) {
+    size_t nr_aliases;
+
+    if (encver < 6) { /* hierarchy encver */
+        /*
+         * Older versions didn't persist the aliases with the hierarchy but
+         * the index is populated from the node objects as the nodes are
+         * loaded.
+         */
+        return 0;
+    }
+
+    nr_aliases = RedisModule_LoadUnsigned(io);
+    for (size_t i = 0; i < nr_aliases; i++) {
+        __rm_autofree char *name_str = NULL;
+        __rm_autofree char *node_id = NULL;
+        size_t name_len;
+        size_t node_id_len;
+
+        name_str = RedisModule_LoadStringBuffer(io, &name_len);
+        node_id = RedisModule_LoadStringBuffer(io, &node_id_len);
+        if (!name_str || !node_id || node_id_len != SELVA_NODE_ID_SIZE) {
+            return SELVA_EINVAL;
+        }
+
+        (void)upsert_alias(&hierarchy->aliases, name_str, name_len, node_id);
+    }
+
+    return 0;
+}
+
+/*
+ * KEY
+ * Reply with a flat array of alias and nodeId pairs.
+ */
+static int SelvaHierarchy_AliasesCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    SelvaHierarchy *hierarchy;
+    struct SelvaAlias *alias;
+
+    if (argc != 2) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    hierarchy = SelvaModify_OpenHierarchy(ctx, argv[1], REDISMODULE_READ);
+    if (!hierarchy) {
+        return REDISMODULE_OK;
+    }
+
+    RedisModule_ReplyWithArray(ctx, 2 * hierarchy->aliases.nr_aliases);
+    RB_FOREACH(alias, hierarchy_alias_tree, &hierarchy->aliases.head) {
+        RedisModule_ReplyWithStringBuffer(ctx, alias->name, alias->name_len);
+        RedisModule_ReplyWithStringBuffer(ctx, alias->dest, Selva_NodeIdLen(alias->dest));
+    }
+
+    return REDISMODULE_OK;
+}
+
+static int Alias_OnLoad(RedisModuleCtx *ctx) {
+    if (RedisModule_CreateCommand(ctx, "selva.hierarchy.aliases", SelvaHierarchy_AliasesCommand, "readonly", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    return REDISMODULE_OK;
 }
+SELVA_ONLOAD(Alias_OnLoad);
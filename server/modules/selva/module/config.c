@@ -16,11 +16,17 @@ struct selva_glob_config selva_glob_config = {
     .hierarchy_compression_level = HIERARCHY_COMPRESSION_LEVEL,
     .hierarchy_auto_compress_period_ms = HIERARCHY_AUTO_COMPRESS_PERIOD_MS,
     .hierarchy_auto_compress_old_age_lim = HIERARCHY_AUTO_COMPRESS_OLD_AGE_LIM,
+    .hierarchy_lazy_free_period_ms = HIERARCHY_LAZY_FREE_PERIOD_MS,
+    .hierarchy_lazy_free_slice = HIERARCHY_LAZY_FREE_SLICE,
+    .inherit_cache_max = INHERIT_CACHE_MAX,
+    .aggregate_workers = AGGREGATE_WORKERS,
+    .aggregate_hll_precision = AGGREGATE_HLL_PRECISION,
     .find_indices_max = FIND_INDICES_MAX,
     .find_indexing_threshold = FIND_INDEXING_THRESHOLD,
     .find_indexing_icb_update_interval = FIND_INDEXING_ICB_UPDATE_INTERVAL,
     .find_indexing_interval = FIND_INDEXING_INTERVAL,
     .find_indexing_popularity_ave_period = FIND_INDEXING_POPULARITY_AVE_PERIOD,
+    .find_cache_max_bytes = FIND_CACHE_MAX_BYTES,
 };
 
 static int parse_size_t(void *dst, const RedisModuleString *src) {
@@ -60,11 +66,17 @@ struct cfg {
     { "HIERARCHY_COMPRESSION_LEVEL", parse_int, &selva_glob_config.hierarchy_compression_level },
     { "HIERARCHY_AUTO_COMPRESS_PERIOD_MS", parse_int, &selva_glob_config.hierarchy_auto_compress_period_ms },
     { "HIERARCHY_AUTO_COMPRESS_OLD_AGE_LIM", parse_int, &selva_glob_config.hierarchy_auto_compress_old_age_lim },
+    { "HIERARCHY_LAZY_FREE_PERIOD_MS", parse_int, &selva_glob_config.hierarchy_lazy_free_period_ms },
+    { "HIERARCHY_LAZY_FREE_SLICE", parse_size_t, &selva_glob_config.hierarchy_lazy_free_slice },
+    { "INHERIT_CACHE_MAX", parse_size_t, &selva_glob_config.inherit_cache_max },
+    { "AGGREGATE_WORKERS", parse_int, &selva_glob_config.aggregate_workers },
+    { "AGGREGATE_HLL_PRECISION", parse_int, &selva_glob_config.aggregate_hll_precision },
     { "FIND_INDICES_MAX", parse_int, &selva_glob_config.find_indices_max },
     { "FIND_INDEXING_THRESHOLD", parse_int, &selva_glob_config.find_indexing_threshold },
     { "FIND_INDEXING_ICB_UPDATE_INTERVAL", parse_int, &selva_glob_config.find_indexing_icb_update_interval },
     { "FIND_INDEXING_INTERVAL", parse_int, &selva_glob_config.find_indexing_interval },
     { "FIND_INDEXING_POPULARITY_AVE_PERIOD", parse_int, &selva_glob_config.find_indexing_popularity_ave_period },
+    { "FIND_CACHE_MAX_BYTES", parse_size_t, &selva_glob_config.find_cache_max_bytes },
 };
 
 int parse_config_args(RedisModuleString **argv, int argc) {
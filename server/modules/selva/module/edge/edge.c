@@ -11,6 +11,7 @@
 #include "svector.h"
 #include "selva.h"
 #include "hierarchy.h"
+#include "selva_memory.h"
 #include "selva_object.h"
 #include "subscriptions.h"
 #include "comparator.h"
@@ -110,7 +111,7 @@ __attribute__((nonnull (1, 2))) static struct EdgeField *alloc_EdgeField(
 
     assert(constraint);
 
-    edgeField = selva_calloc(1, sizeof(struct EdgeField));
+    edgeField = selva_arena_calloc(SELVA_ARENA_HIERARCHY, 1, sizeof(struct EdgeField));
     edgeField->constraint = constraint;
     memcpy(edgeField->src_node_id, src_node_id, SELVA_NODE_ID_SIZE);
     SVector_Init(&edgeField->arcs, initial_size, SelvaSVectorComparator_Node);
@@ -390,6 +391,7 @@ int Edge_Add(
     }
 
     insert_edge(src_edge_field, dst_node);
+    hierarchy->generation++;
 
     err = 0; /* Just to be sure. */
 
@@ -599,6 +601,10 @@ int Edge_Delete(
      * Delete the edge.
      */
     remove_arc(edge_field, dst_node_id);
+    if (hierarchy) {
+        hierarchy->generation++;
+        hierarchy->resumable.generation++;
+    }
 
     /*
      * For bidirectional edge fields we need to also remove the edge directed
@@ -804,6 +810,73 @@ size_t Edge_Refcount(struct SelvaHierarchyNode *node) {
     return refcount;
 }
 
+static size_t edge_field_mem_usage(const struct EdgeField *edge_field) {
+    size_t size = sizeof(*edge_field) + SVector_MemUsage(&edge_field->arcs);
+
+    if (edge_field->metadata) {
+        struct SelvaObjectMemUsage usage = { 0 };
+
+        SelvaObject_MemUsageDetail(edge_field->metadata, &usage);
+        size += SelvaObject_MemUsageTotal(&usage);
+    }
+
+    return size;
+}
+
+/**
+ * Sum the size of the edge fields found in obj.
+ * The objects themselves are accounted by SelvaObject_MemUsageDetail().
+ */
+static size_t _fields_mem_usage(struct SelvaObject *obj) {
+    SelvaObject_Iterator *it;
+    const char *name;
+    enum SelvaObjectType type;
+    void *p;
+    size_t size = 0;
+
+    it = SelvaObject_ForeachBegin(obj);
+    while ((p = SelvaObject_ForeachValueType(obj, &it, &name, &type))) {
+        if (type == SELVA_OBJECT_POINTER) {
+            size += edge_field_mem_usage(p);
+        } else if (type == SELVA_OBJECT_OBJECT) {
+            size += _fields_mem_usage(p);
+        } else if (type == SELVA_OBJECT_ARRAY) {
+            struct SVector *array = p;
+            enum SelvaObjectType subtype;
+            struct SVectorIterator sub_it;
+            void *el;
+
+            if (SelvaObject_GetArrayStr(obj, name, strlen(name), &subtype, NULL) ||
+                (subtype != SELVA_OBJECT_POINTER && subtype != SELVA_OBJECT_OBJECT)) {
+                continue;
+            }
+
+            SVector_ForeachBegin(&sub_it, array);
+            while ((el = SVector_Foreach(&sub_it))) {
+                size += (subtype == SELVA_OBJECT_POINTER) ? edge_field_mem_usage(el) : _fields_mem_usage(el);
+            }
+        }
+    }
+
+    return size;
+}
+
+size_t Edge_MemUsage(const struct SelvaHierarchyNode *node) {
+    const struct EdgeFieldContainer *efc = &SelvaHierarchy_GetNodeMetadataByPtr(node)->edge_fields;
+    struct SelvaObjectMemUsage usage = { 0 };
+    size_t size = 0;
+
+    if (efc->edges) {
+        SelvaObject_MemUsageDetail(efc->edges, &usage);
+        size += _fields_mem_usage(efc->edges);
+    }
+    if (efc->origins) {
+        SelvaObject_MemUsageDetail(efc->origins, &usage);
+    }
+
+    return size + SelvaObject_MemUsageTotal(&usage);
+}
+
 static void EdgeField_Reply(struct RedisModuleCtx *ctx, void *p) {
     const struct EdgeField *edge_field = (struct EdgeField *)p;
     const SVector *arcs = &edge_field->arcs;
@@ -840,7 +913,7 @@ static void EdgeField_Free(void *p) {
 #endif
     SVector_Destroy(&edge_field->arcs);
     SelvaObject_Destroy(edge_field->metadata);
-    selva_free(p);
+    selva_arena_free(SELVA_ARENA_HIERARCHY, p);
 }
 
 /**
@@ -31,10 +31,19 @@
 #include "cstrings.h"
 #include "traversal.h"
 #include "inherit.h"
+#include "find_cache.h"
 #include "find_index.h"
+#include "find_cursor.h"
+#include "find_profile.h"
 
 #define WILDCARD_CHAR '*'
 
+/**
+ * Size of the stack buffer used for building prefixed field names.
+ * Longer names are built on the heap.
+ */
+#define FIELD_NAME_BUF_SIZE 128
+
 struct FindCommand_ArrayObjectCb {
     RedisModuleCtx *ctx;
     struct FindCommand_Args *find_args;
@@ -45,8 +54,10 @@ struct FindCommand_ArrayObjectCb {
  */
 SELVA_TRACE_HANDLE(cmd_find_array);
 SELVA_TRACE_HANDLE(cmd_find_bfs_expression);
+SELVA_TRACE_HANDLE(cmd_find_heads);
 SELVA_TRACE_HANDLE(cmd_find_index);
 SELVA_TRACE_HANDLE(cmd_find_refs);
+SELVA_TRACE_HANDLE(cmd_find_resume);
 SELVA_TRACE_HANDLE(cmd_find_rest);
 SELVA_TRACE_HANDLE(cmd_find_sort_result);
 SELVA_TRACE_HANDLE(cmd_find_traversal_expression);
@@ -342,6 +353,12 @@ static int send_node_field(
         size_t field_len,
         RedisModuleString *excluded_fields) {
     Selva_NodeId nodeId;
+    /*
+     * The prefixed field name is built once and the same buffer is used for
+     * the reply, so no RedisModuleStrings are created per field.
+     */
+    char full_field_name_buf[FIELD_NAME_BUF_SIZE];
+    char *full_field_name_heap __selva_autofree = NULL;
     const char *full_field_name_str;
     size_t full_field_name_len;
     int err;
@@ -349,10 +366,15 @@ static int send_node_field(
     SelvaHierarchy_GetNodeId(nodeId, node);
 
     if (field_prefix_str) {
-        RedisModuleString *full_field_name;
+        char *buf = full_field_name_buf;
 
-        full_field_name = RedisModule_CreateStringPrintf(ctx, "%.*s%.*s", (int)field_prefix_len, field_prefix_str, (int)field_len, field_str);
-        full_field_name_str = RedisModule_StringPtrLen(full_field_name, &full_field_name_len);
+        full_field_name_len = field_prefix_len + field_len;
+        if (full_field_name_len > sizeof(full_field_name_buf)) {
+            buf = full_field_name_heap = selva_malloc(full_field_name_len);
+        }
+        memcpy(buf, field_prefix_str, field_prefix_len);
+        memcpy(buf + field_prefix_len, field_str, field_len);
+        full_field_name_str = buf;
     } else {
         full_field_name_str = field_str;
         full_field_name_len = field_len;
@@ -437,7 +459,7 @@ static int send_node_field(
         /*
          * Send the reply.
          */
-        RedisModule_ReplyWithString(ctx, RedisModule_CreateStringPrintf(ctx, "%.*s%.*s", (int)field_prefix_len, field_prefix_str, (int)field_len, field_str));
+        RedisModule_ReplyWithStringBuffer(ctx, full_field_name_str, field_prefix_len + field_len);
         err = SelvaObject_ReplyWithObjectStr(ctx, lang, obj, field_str, field_len, SELVA_OBJECT_REPLY_BINUMF_FLAG);
         if (err) {
             SELVA_LOG(SELVA_LOGL_ERR, "Failed to send the field (%.*s) for node_id: \"%.*s\" err: \"%s\"",
@@ -1180,7 +1202,9 @@ static int process_node_send(
     ssize_t *nr_nodes = args->nr_nodes;
     ssize_t * restrict limit = args->limit;
 
+    SELVA_FIND_PROFILE_BEGIN(reply);
     print_node(ctx, hierarchy, args->lang, node, &args->send_param, args->merge_nr_fields);
+    SELVA_FIND_PROFILE_END(reply, reply_ns);
 
     *nr_nodes = *nr_nodes + 1;
     *limit = *limit - 1;
@@ -1193,11 +1217,32 @@ static int process_node_sort(
         SelvaHierarchy *hierarchy __unused,
         struct FindCommand_Args *args,
         struct SelvaHierarchyNode *node) {
+    SELVA_FIND_PROFILE_BEGIN(sort);
+    struct FindCursor *cursor = args->cursor;
     struct TraversalOrderItem *item;
 
     item = SelvaTraversalOrder_CreateNodeOrderItem(ctx, args->lang, node, args->send_param.order_field);
     if (item) {
+        /*
+         * Skip everything up to and including the last item of the previous
+         * page.
+         */
+        if (cursor && cursor->item &&
+            args->result->vec_compar((const void **)&cursor->item, (const void **)&item) >= 0) {
+            SelvaTraversalOrder_DestroyOrderItem(ctx, item);
+            SELVA_FIND_PROFILE_END(sort, sort_ns);
+            return 0;
+        }
+
         SVector_InsertFast(args->result, item);
+
+        /*
+         * A page only needs the first limit + 1 items, the extra item tells
+         * that there is a next page.
+         */
+        if (args->order_max > 0 && SVector_Size(args->result) > args->order_max) {
+            SelvaTraversalOrder_DestroyOrderItem(ctx, SVector_Pop(args->result));
+        }
     } else {
         Selva_NodeId nodeId;
 
@@ -1212,6 +1257,7 @@ static int process_node_sort(
                   (int)SELVA_NODE_ID_SIZE, nodeId);
     }
 
+    SELVA_FIND_PROFILE_END(sort, sort_ns);
     return 0;
 }
 
@@ -1235,6 +1281,7 @@ static __hot int FindCommand_NodeCb(
     int take = SelvaTraversal_ProcessSkip(args);
 
     args->acc_tot++;
+
     if (take && rpn_ctx) {
         Selva_NodeId nodeId;
         int err;
@@ -1249,7 +1296,9 @@ static __hot int FindCommand_NodeCb(
         /*
          * Resolve the expression and get the result.
          */
+        SELVA_FIND_PROFILE_BEGIN(filter);
         err = rpn_bool(ctx, rpn_ctx, args->filter, &take);
+        SELVA_FIND_PROFILE_END(filter, filter_ns);
         if (err) {
             SELVA_LOG(SELVA_LOGL_ERR, "Expression failed (node: \"%.*s\"): \"%s\"\n",
                       (int)SELVA_NODE_ID_SIZE, nodeId,
@@ -1508,7 +1557,10 @@ static void postprocess_inherit(
 
             SelvaHierarchy_GetNodeId(node_id, node);
             err = Inherit_FieldValue(ctx, hierarchy, lang, node_id, NULL, 0, order_by_field_str, order_by_field_len, &fv);
-            if (err) {
+            if (err == SELVA_ENOENT) {
+                /* Sort the nodes without the field as empty. */
+                memset(&fv, 0, sizeof(fv));
+            } else if (err) {
                 /* TODO Error handling */
                 continue;
             }
@@ -1557,6 +1609,110 @@ static void postprocess_inherit(
     }
 }
 
+/**
+ * Send the cursor for fetching the next page.
+ * A null reply is sent if there are no more results.
+ * @param limit is the remaining limit for an unordered find and the original limit for an ordered find.
+ * @param nr_heads is the number of head nodes of the find.
+ */
+static void reply_next_cursor(
+        RedisModuleCtx *ctx,
+        SelvaHierarchy *hierarchy,
+        struct FindCursor *cursor,
+        ssize_t limit,
+        size_t nr_heads,
+        SVector *result) {
+    __selva_autofree char *s = NULL;
+    size_t len;
+
+    if (cursor->type == FIND_CURSOR_TYPE_POS) {
+        /*
+         * The traversal was stopped because the limit was reached and
+         * there might be more nodes.
+         */
+        if (limit == 0 && cursor->head < nr_heads) {
+            s = FindCursor_EncodePos(hierarchy->resumable.generation, cursor->state_id, cursor->head, &len);
+        }
+    } else if (SVector_Size(result) > (size_t)limit) {
+        const struct TraversalOrderItem *last = SVector_GetIndex(result, limit - 1);
+
+        s = FindCursor_EncodeKey(hierarchy->resumable.generation, last, &len);
+    }
+
+    if (s) {
+        RedisModule_ReplyWithStringBuffer(ctx, s, len);
+    } else {
+        RedisModule_ReplyWithNull(ctx);
+    }
+}
+
+/**
+ * Narrow a descendants traversal using the descendant constraint of the filter.
+ * If the constraint node is a descendant of the head then every node matching
+ * the filter is also a descendant of the constraint node and the traversal can
+ * be started from there.
+ * @returns a pointer to the node the traversal should be started from.
+ */
+static struct SelvaHierarchyNode *narrow_descendants_traversal(
+        SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyNode *head,
+        const Selva_NodeId constraint_id) {
+    struct SelvaHierarchyNode *sub;
+
+    sub = SelvaHierarchy_FindNode(hierarchy, constraint_id);
+    if (head && sub && SelvaHierarchy_IsDescendantOf(hierarchy, sub, head)) {
+        return sub;
+    }
+
+    return head;
+}
+
+/**
+ * Test if the fields argument of find requests data from other nodes than the
+ * node being sent.
+ * Edge and reference fields are dereferenced with a dot, ancestors and
+ * descendants are expanded, and a wildcard may expand edge fields. A dot
+ * can't be told apart from a nested object field without the schema, so
+ * every dotted field counts.
+ * @param fields_str is a list of fields separated by newlines, the
+ *                   alternatives of a field are separated by a pipe.
+ */
+static int fields_dereference(const char *fields_str) {
+    const char *cur = fields_str;
+
+    while (*cur != '\0') {
+        const size_t len = strcspn(cur, "\n|");
+
+        if (cur[0] != '!' &&
+            (memchr(cur, '.', len) ||
+             memchr(cur, WILDCARD_CHAR, len) ||
+             (len == sizeof(SELVA_ANCESTORS_FIELD) - 1 && !memcmp(cur, SELVA_ANCESTORS_FIELD, len)) ||
+             (len == sizeof(SELVA_DESCENDANTS_FIELD) - 1 && !memcmp(cur, SELVA_DESCENDANTS_FIELD, len)))) {
+            return 1;
+        }
+
+        cur += len;
+        if (*cur != '\0') {
+            cur++;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Count the non-empty nodeIds.
+ */
+static size_t count_node_ids(const Selva_NodeId *node_ids, size_t nr_ids) {
+    size_t n = 0;
+
+    for (size_t i = 0; i < nr_ids; i++) {
+        n += node_ids[i][0] != '\0';
+    }
+
+    return n;
+}
+
 /**
  * Find node(s) matching the query.
  *
@@ -1569,14 +1725,39 @@ static void postprocess_inherit(
  * ["order" field asc|desc]                         Sort order of the results
  * ["offset" 1234]                                  Skip the first 1234 - 1 results
  * ["limit" 1234]                                   Limit the number of results (Optional)
+ * ["cursor" CURSOR]                                Paginate using a cursor, an empty string starts from the beginning
  * ["merge" path]                                   Merge fields. fields option must be set
  * ["fields(_rpn)|inherit_rpn" field_names|expr]    Return field values instead of node names
+ * ["profile"]                                      Return a profile of the query with the results
+ * ["explain"]                                      Return the query plan instead of the results
  * NODE_IDS                                         One or more node IDs concatenated (10 chars per ID)
  * [expression]                                     RPN filter expression
  * [args...]                                        Register arguments for the RPN filter
  *
  * The traversed field is typically either ancestors or descendants but it can
  * be any hierarchy or edge field.
+ *
+ * If cursor is given the reply is `[results, next_cursor]`, where next_cursor
+ * is null when there are no more results. The cursor requires a limit and it
+ * can't be used together with offset. A cursor of an unordered find holds the
+ * traversal position and it expires if a node or an edge is removed from the
+ * hierarchy, the same cursor can be used again until the next page is fetched;
+ * A cursor of an ordered find holds the sort key of the last node sent and
+ * stays valid across modifications.
+ *
+ * If FIND_CACHE_MAX_BYTES is set the replies are cached until a change in the
+ * traversed nodes invalidates them. See find_cache.c.
+ *
+ * The query planner chooses between traversing and using the valid indices of
+ * the index hints based on their estimated costs; See SelvaFindIndex_Plan().
+ * If explain is given the query is not executed but the reply is the plan for
+ * each head node:
+ * [[nodeId, type, [index names...], cost, rows, traverse_cost], ...]
+ *
+ * If profile is given the reply is `[result, profile]`, where profile is a
+ * list of names and values: nodes visited, nodes taken, detached subtrees
+ * restored, heads served from an index, the time spent in the filter, sorting
+ * and reply serialization, and the size of the reply in bytes.
  */
 static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_AutoMemory(ctx);
@@ -1597,10 +1778,14 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
     int ARGV_OFFSET_NUM      = 5;
     int ARGV_LIMIT_TXT       = 4;
     int ARGV_LIMIT_NUM       = 5;
+    int ARGV_CURSOR_TXT      = 4;
+    int ARGV_CURSOR_VAL      = 5;
     int ARGV_MERGE_TXT       = 4;
     int ARGV_MERGE_VAL       = 5;
     int ARGV_FIELDS_TXT      = 4;
     int ARGV_FIELDS_VAL      = 5;
+    int ARGV_PROFILE_TXT     = 4;
+    int ARGV_EXPLAIN_TXT     = 4;
     int ARGV_NODE_IDS        = 4;
     int ARGV_FILTER_EXPR     = 5;
     int ARGV_FILTER_ARGS     = 6;
@@ -1616,10 +1801,14 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
     ARGV_OFFSET_NUM += i; \
     ARGV_LIMIT_TXT += i; \
     ARGV_LIMIT_NUM += i; \
+    ARGV_CURSOR_TXT += i; \
+    ARGV_CURSOR_VAL += i; \
     ARGV_MERGE_TXT += i; \
     ARGV_MERGE_VAL += i; \
     ARGV_FIELDS_TXT += i; \
     ARGV_FIELDS_VAL += i; \
+    ARGV_PROFILE_TXT += i; \
+    ARGV_EXPLAIN_TXT += i; \
     ARGV_NODE_IDS += i; \
     ARGV_FILTER_EXPR += i; \
     ARGV_FILTER_ARGS += i
@@ -1650,6 +1839,7 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
      */
     enum SelvaTraversal dir;
     const RedisModuleString *ref_field = NULL;
+    const char *dir_expression_str = NULL;
     err = SelvaTraversal_ParseDir2(&dir, argv[ARGV_DIRECTION]);
     if (err) {
         replyWithSelvaErrorf(ctx, err, "Traversal argument");
@@ -1676,6 +1866,7 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
         const RedisModuleString *input = argv[ARGV_REF_FIELD];
         TO_STR(input);
 
+        dir_expression_str = input_str;
         traversal_rpn_ctx = rpn_init(1);
         traversal_expression = rpn_compile(input_str);
         if (!traversal_expression) {
@@ -1684,11 +1875,13 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
         SHIFT_ARGS(1);
     }
 
+    const char *edge_filter_str = NULL;
     if (argc > ARGV_EDGE_FILTER_VAL) {
         const char *expr_str;
 
         err = SelvaArgParser_StrOpt(&expr_str, "edge_filter", argv[ARGV_EDGE_FILTER_TXT], argv[ARGV_EDGE_FILTER_VAL]);
         if (err == 0) {
+            edge_filter_str = expr_str;
             SHIFT_ARGS(2);
 
             if (!(dir & (SELVA_HIERARCHY_TRAVERSAL_EXPRESSION |
@@ -1762,6 +1955,46 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
         }
     }
 
+    /*
+     * Parse the cursor arg.
+     * An empty cursor starts a new pagination.
+     */
+    int paginate = 0;
+    FIND_CURSOR_AUTOFREE(cursor);
+    if (argc > ARGV_CURSOR_VAL) {
+        err = SelvaArgParser_StrOpt(NULL, "cursor", argv[ARGV_CURSOR_TXT], argv[ARGV_CURSOR_VAL]);
+        if (err == 0) {
+            const RedisModuleString *cursor_arg = argv[ARGV_CURSOR_VAL];
+            TO_STR(cursor_arg);
+
+            if (limit <= 0 || offset != 0) {
+                return replyWithSelvaErrorf(ctx, SELVA_EINVAL, "cursor requires a limit and no offset");
+            }
+
+            if (cursor_arg_len > 0) {
+                err = FindCursor_Decode(&cursor, cursor_arg_str, cursor_arg_len);
+                if (err) {
+                    return replyWithSelvaErrorf(ctx, err, "cursor");
+                }
+
+                if ((cursor.type == FIND_CURSOR_TYPE_KEY) != (order != SELVA_RESULT_ORDER_NONE)) {
+                    return replyWithSelvaErrorf(ctx, SELVA_EINVAL, "cursor doesn't match the order");
+                }
+
+                if (cursor.type == FIND_CURSOR_TYPE_POS && cursor.generation != hierarchy->resumable.generation) {
+                    return replyWithSelvaErrorf(ctx, SELVA_EINVAL, "cursor expired");
+                }
+            } else {
+                cursor.type = (order == SELVA_RESULT_ORDER_NONE) ? FIND_CURSOR_TYPE_POS : FIND_CURSOR_TYPE_KEY;
+            }
+
+            paginate = 1;
+            SHIFT_ARGS(2);
+        } else if (err != SELVA_ENOENT) {
+            return replyWithSelvaErrorf(ctx, err, "cursor");
+        }
+    }
+
     /*
      * Parse the merge flag.
      */
@@ -1792,6 +2025,7 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
     __auto_free_rpn_ctx struct rpn_ctx *fields_rpn_ctx = NULL;
     __auto_free_rpn_expression struct rpn_expression *fields_expression = NULL;
     __auto_free_rpn_expression struct rpn_expression *inherit_expression = NULL;
+    int fields_deref = 0;
     if (argc > ARGV_FIELDS_VAL) {
         const char *argv_fields_txt = RedisModule_StringPtrLen(argv[ARGV_FIELDS_TXT], NULL);
 
@@ -1807,6 +2041,7 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
             if (err) {
                 return replyWithSelvaErrorf(ctx, err, "Parsing fields argument failed");
             }
+            fields_deref = fields_dereference(RedisModule_StringPtrLen(argv[ARGV_FIELDS_VAL], NULL));
 
             SHIFT_ARGS(2);
         } else if (!strcmp("fields_rpn", argv_fields_txt)) {
@@ -1854,6 +2089,34 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
             SHIFT_ARGS(2);
         }
     }
+    if (paginate && (inherit_expression ||
+                     (dir & (SELVA_HIERARCHY_TRAVERSAL_ARRAY |
+                             SELVA_HIERARCHY_TRAVERSAL_SET |
+                             SELVA_HIERARCHY_TRAVERSAL_DFS_FULL)))) {
+        return replyWithSelvaErrorf(ctx, SELVA_ENOTSUP, "cursor is not supported with inherit_rpn, array, set or dfs_full traversals");
+    }
+
+    /*
+     * Parse profile.
+     */
+    if (argc > ARGV_PROFILE_TXT + 1 &&
+        !strcmp(RedisModule_StringPtrLen(argv[ARGV_PROFILE_TXT], NULL), "profile")) {
+        return SelvaFindProfile_Reply(ctx, "selva.hierarchy.find", argv, argc, ARGV_PROFILE_TXT);
+    }
+
+    /*
+     * Parse explain.
+     */
+    int explain = 0;
+    if (argc > ARGV_EXPLAIN_TXT + 1 &&
+        !strcmp(RedisModule_StringPtrLen(argv[ARGV_EXPLAIN_TXT], NULL), "explain")) {
+        if (paginate || merge_strategy != MERGE_STRATEGY_NONE) {
+            return replyWithSelvaErrorf(ctx, SELVA_ENOTSUP, "explain is not supported with cursor or merge");
+        }
+
+        explain = 1;
+        SHIFT_ARGS(1);
+    }
     if (merge_strategy != MERGE_STRATEGY_NONE && (!fields || SelvaTraversal_FieldsContains(fields, "*", 1))) {
         if (fields) {
             SelvaObject_Destroy(fields);
@@ -1896,6 +2159,20 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
         return replyWithSelvaError(ctx, SELVA_HIERARCHY_EINVAL);
     }
 
+    /*
+     * Check if the filter can only match the descendants of a certain node.
+     * Narrowing the traversal changes the traversal order and thus it's only
+     * done if the order of the result doesn't depend on it.
+     */
+    Selva_NodeId descendant_constraint;
+    int has_descendant_constraint = 0;
+    if (filter_expression &&
+        (dir & (SELVA_HIERARCHY_TRAVERSAL_BFS_DESCENDANTS | SELVA_HIERARCHY_TRAVERSAL_DFS_DESCENDANTS)) &&
+        (order != SELVA_RESULT_ORDER_NONE || (limit == -1 && offset == 0)) &&
+        !paginate) {
+        has_descendant_constraint = rpn_get_descendant_constraint(rpn_ctx, filter_expression, descendant_constraint);
+    }
+
     const RedisModuleString *ids = argv[ARGV_NODE_IDS];
     TO_STR(ids);
 
@@ -1905,15 +2182,87 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
         SelvaTraversalOrder_InitOrderResult(&traverse_result, order, limit);
     }
 
+    const size_t nr_ids = (ids_len + SELVA_NODE_ID_SIZE - 1) / SELVA_NODE_ID_SIZE;
+    Selva_NodeId *node_ids = RedisModule_PoolAlloc(ctx, max(nr_ids, (size_t)1) * SELVA_NODE_ID_SIZE);
+    struct SelvaHierarchyNode **heads = RedisModule_PoolAlloc(ctx, max(nr_ids, (size_t)1) * sizeof(struct SelvaHierarchyNode *));
+
+    /*
+     * Look up all the head nodes at once as it's much faster than looking
+     * them up one by one if there are many.
+     */
+    for (size_t i = 0; i < nr_ids; i++) {
+        Selva_NodeIdCpy(node_ids[i], ids_str + i * SELVA_NODE_ID_SIZE);
+    }
+    SELVA_TRACE_BEGIN(cmd_find_heads);
+    const size_t nr_heads = SelvaHierarchy_FindNodes(hierarchy, node_ids, nr_ids, heads);
+    SELVA_TRACE_END(cmd_find_heads);
+
+    /*
+     * Serve the result from the find result cache if possible.
+     * The cache only tracks changes in the traversed nodes, so anything
+     * pulling data from other nodes or paging through the result can't be
+     * cached. Missing heads would need to be tracked separately.
+     */
+    if (selva_glob_config.find_cache_max_bytes > 0 &&
+        !selva_find_profile &&
+        !explain &&
+        !paginate &&
+        dir != SELVA_HIERARCHY_TRAVERSAL_ARRAY &&
+        merge_strategy == MERGE_STRATEGY_NONE &&
+        !fields_deref &&
+        !fields_expression &&
+        !inherit_expression &&
+        nr_heads == count_node_ids(node_ids, nr_ids)) {
+        const struct SelvaFindCacheQuery query = {
+            .dir = dir,
+            .dir_field = ref_field ? RedisModule_StringPtrLen(ref_field, NULL) : NULL,
+            .dir_expression = dir_expression_str,
+            .edge_filter = edge_filter_str,
+            .filter = argv_filter_expr ? RedisModule_StringPtrLen(argv_filter_expr, NULL) : NULL,
+            .filter_has_args = argc > ARGV_FILTER_ARGS,
+            .node_ids = (const Selva_NodeId *)node_ids,
+            .nr_node_ids = nr_ids,
+        };
+
+        if (SelvaFindCache_Reply(ctx, hierarchy, argv, argc, &query)) {
+            return REDISMODULE_OK;
+        }
+    }
+
+    /*
+     * An unordered page continues the traversal saved by the previous page.
+     */
+    struct SelvaHierarchyResumable *resume_state = NULL;
+    if (paginate && cursor.type == FIND_CURSOR_TYPE_POS) {
+        if (cursor.head >= nr_ids) {
+            return replyWithSelvaErrorf(ctx, SELVA_EINVAL, "cursor");
+        }
+
+        if (cursor.state_id) {
+            resume_state = SelvaHierarchy_TakeResumable(hierarchy, cursor.state_id);
+            if (!resume_state) {
+                return replyWithSelvaErrorf(ctx, SELVA_EINVAL, "cursor expired");
+            }
+            cursor.state_id = 0;
+        }
+    }
+
+    if (paginate) {
+        /* [results, next_cursor] */
+        RedisModule_ReplyWithArray(ctx, 2);
+    }
     RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
 
     if (nr_index_hints > 0) {
         /*
          * Limit and indexing can be only used together when an order is requested
          * to guarantee a deterministic response order.
+         * The index results are not stable between pages and thus indexing
+         * can't be used with a cursor.
          */
         if (limit != -1 && order == SELVA_RESULT_ORDER_NONE ||
-            offset == -1) {
+            offset == -1 ||
+            paginate) {
             nr_index_hints = 0;
         }
     }
@@ -1924,10 +2273,11 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
     ssize_t nr_nodes = 0;
     size_t merge_nr_fields = 0;
     SelvaFind_Postprocess postprocess = NULL;
-    for (size_t i = 0; i < ids_len; i += SELVA_NODE_ID_SIZE) {
-        Selva_NodeId nodeId;
+    const size_t nr_restored = hierarchy->detached.nr_restored;
+
+    for (size_t i = paginate ? cursor.head : 0; i < nr_ids; i++) {
+        char *nodeId = node_ids[i];
 
-        Selva_NodeIdCpy(nodeId, ids_str + i);
         if (nodeId[0] == '\0') {
             /* Just skip empty IDs. */
             continue;
@@ -1938,7 +2288,11 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
          * FIND_INDICES_MAX_HINTS_FIND
          */
         struct SelvaFindIndexControlBlock *ind_icb[max(nr_index_hints, 1)];
-        int ind_select = -1; /* Selected index. The smallest of all found. */
+        struct SelvaFindIndexPlan plan = {
+            .type = SELVA_FIND_PLAN_TRAVERSE,
+            .ind_select = -1,
+        };
+        int ind_select = -1; /* Selected index. */
 
         memset(ind_icb, 0, max(nr_index_hints, 1) * sizeof(struct SelvaFindIndexControlBlock *));
 
@@ -1958,9 +2312,41 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
             }
 
             /*
-             * Select the best index res set.
+             * Get the indices of the hints.
+             * Explain shouldn't affect the indexing decisions, so it only
+             * looks up the existing indices.
              */
-            ind_select = SelvaFindIndex_AutoMulti(ctx, hierarchy, dir, dir_expr, nodeId, order, order_by_field, index_hints, nr_index_hints, ind_icb);
+            if (explain) {
+                (void)SelvaFindIndex_LookupMulti(hierarchy, dir, dir_expr, nodeId, order, order_by_field, index_hints, nr_index_hints, ind_icb);
+            } else {
+                (void)SelvaFindIndex_AutoMulti(ctx, hierarchy, dir, dir_expr, nodeId, order, order_by_field, index_hints, nr_index_hints, ind_icb);
+            }
+        }
+
+        /*
+         * Choose the cheapest way to execute the query.
+         */
+        if (nr_index_hints > 0 || explain) {
+            const struct SelvaFindIndexPlanQuery plan_query = {
+                .head = heads[i],
+                .dir = dir,
+                .order = order,
+                .order_field = order_by_field,
+                .filter = argv_filter_expr,
+                .limit = limit >= 0 ? offset + limit : -1,
+                .ordered_ok = ids_len == SELVA_NODE_ID_SIZE,
+            };
+
+            SelvaFindIndex_Plan(&plan_query, ind_icb, nr_index_hints, &plan);
+            ind_select = plan.ind_select;
+        }
+
+        if (explain) {
+            RedisModule_ReplyWithArray(ctx, 6);
+            RedisModule_ReplyWithStringBuffer(ctx, nodeId, Selva_NodeIdLen(nodeId));
+            SelvaFindIndex_ReplyWithPlan(ctx, ind_icb, &plan);
+            nr_nodes++;
+            continue;
         }
 
         /*
@@ -1983,9 +2369,11 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
         struct FindCommand_Args args = {
             .lang = lang,
             .nr_nodes = &nr_nodes,
-            .skip = ind_select >= 0 || offset == -1 ? 0 : SelvaTraversal_GetSkip(dir),
+            .skip = ind_select >= 0 || offset == -1 || resume_state ? 0 : SelvaTraversal_GetSkip(dir),
             .offset = (order == SELVA_RESULT_ORDER_NONE) && offset > 0 ? offset : 0,
             .limit = (order == SELVA_RESULT_ORDER_NONE) ? &limit : &tmp_limit,
+            .cursor = paginate ? &cursor : NULL,
+            .order_max = paginate && order != SELVA_RESULT_ORDER_NONE ? (size_t)limit + 1 : 0,
             .rpn_ctx = rpn_ctx,
             .filter = filter_expression,
             .send_param.merge_strategy = merge_strategy,
@@ -2004,6 +2392,7 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
         };
 
         if (limit == 0) {
+            cursor.head = i;
             break;
         }
 
@@ -2029,6 +2418,13 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
             }
         }
 
+        if (has_descendant_constraint && ind_select < 0) {
+            heads[i] = narrow_descendants_traversal(hierarchy, heads[i], descendant_constraint);
+            if (heads[i]) {
+                SelvaHierarchy_GetNodeId(nodeId, heads[i]);
+            }
+        }
+
         if (ind_select >= 0) {
             /*
              * There is no need to run the filter again if the indexing was
@@ -2040,8 +2436,43 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
             }
 
             SELVA_TRACE_BEGIN(cmd_find_index);
-            err = SelvaFindIndex_Traverse(ctx, hierarchy, ind_icb[ind_select], FindCommand_NodeCb, &args);
+            err = SelvaFindIndex_TraversePlan(ctx, hierarchy, ind_icb, &plan, FindCommand_NodeCb, &args);
             SELVA_TRACE_END(cmd_find_index);
+        } else if (paginate && cursor.type == FIND_CURSOR_TYPE_POS) {
+            const struct SelvaHierarchyCallback cb = {
+                .node_cb = FindCommand_NodeCb,
+                .node_arg = &args,
+            };
+            size_t ref_field_len = 0;
+            const char *ref_field_str = ref_field ? RedisModule_StringPtrLen(ref_field, &ref_field_len) : NULL;
+            const struct SelvaHierarchyResumeArgs resume_args = {
+                .field_str = ref_field_str,
+                .field_len = ref_field_len,
+                .rpn_ctx = traversal_rpn_ctx,
+                .rpn_expr = traversal_expression,
+                .edge_filter_ctx = edge_filter_ctx,
+                .edge_filter = edge_filter,
+            };
+
+            if (!resume_state) {
+                resume_state = SelvaHierarchy_NewResumable(dir, nodeId);
+            }
+
+            SELVA_TRACE_BEGIN(cmd_find_resume);
+            err = SelvaHierarchy_TraverseResume(ctx, hierarchy, resume_state, &resume_args, &cb);
+            SELVA_TRACE_END(cmd_find_resume);
+            if (err == 0 && limit == 0) {
+                /*
+                 * Save the traversal for the next page.
+                 */
+                cursor.state_id = SelvaHierarchy_SaveResumable(hierarchy, resume_state);
+                cursor.head = i;
+            } else {
+                SelvaHierarchy_DestroyResumable(resume_state);
+                cursor.head = i + 1;
+            }
+            resume_state = NULL;
+            err = err < 0 ? err : 0;
         } else if (dir == SELVA_HIERARCHY_TRAVERSAL_ARRAY && ref_field) {
             struct FindCommand_ArrayObjectCb array_args = {
                 .ctx = ctx,
@@ -2094,7 +2525,7 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
             };
 
             SELVA_TRACE_BEGIN(cmd_find_rest);
-            err = SelvaHierarchy_Traverse(ctx, hierarchy, nodeId, dir, &cb);
+            err = SelvaHierarchy_TraverseByPtr(ctx, hierarchy, heads[i], dir, &cb);
             SELVA_TRACE_END(cmd_find_rest);
         }
         if (err != 0) {
@@ -2112,6 +2543,16 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
          * Do index accounting.
          */
         SelvaFindIndex_AccMulti(ind_icb, nr_index_hints, ind_select, args.acc_take, args.acc_tot);
+
+        if (selva_find_profile) {
+            selva_find_profile->visited += args.acc_tot;
+            selva_find_profile->taken += args.acc_take;
+            selva_find_profile->indexed += ind_select >= 0;
+        }
+    }
+
+    if (selva_find_profile) {
+        selva_find_profile->restored += hierarchy->detached.nr_restored - nr_restored;
     }
 
     if (postprocess) {
@@ -2128,12 +2569,20 @@ static int SelvaHierarchy_FindCommand(RedisModuleCtx *ctx, RedisModuleString **a
         };
 
         SELVA_TRACE_BEGIN(cmd_find_sort_result);
+        SELVA_FIND_PROFILE_BEGIN(postprocess);
         postprocess(ctx, hierarchy, lang, offset, limit, &send_args, &traverse_result);
+        SELVA_FIND_PROFILE_END(postprocess, reply_ns);
         SELVA_TRACE_END(cmd_find_sort_result);
     } else {
         RedisModule_ReplySetArrayLength(ctx, get_nr_out(merge_strategy, nr_nodes, merge_nr_fields));
     }
 
+    SelvaHierarchy_DestroyResumable(resume_state);
+
+    if (paginate) {
+        reply_next_cursor(ctx, hierarchy, &cursor, limit, nr_ids, &traverse_result);
+    }
+
     return REDISMODULE_OK;
 #undef SHIFT_ARGS
 }
@@ -0,0 +1,452 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "redismodule.h"
+#include "jemalloc.h"
+#include "selva.h"
+#include "svector.h"
+#include "tree.h"
+#include "queue.h"
+#include "hll.h"
+#include "config.h"
+#include "hierarchy.h"
+#include "modinfo.h"
+#include "selva_onload.h"
+#include "subscriptions.h"
+#include "find_cache.h"
+
+/*
+ * Find result cache.
+ *
+ * The cache maps the argv of a find command to the serialized RESP reply of
+ * the command. On a miss the command is executed through RedisModule_Call()
+ * to capture the reply, and on a hit the captured reply is sent with
+ * RedisModule_ReplyWithCallReply() without traversing the hierarchy.
+ *
+ * Each entry registers a callback marker for each head node of the find,
+ * using the same traversal and filter as the find. Any change in the nodes
+ * covered by the markers invalidates the entry. The markers can't be deleted
+ * while the subscriptions subsystem is executing the marker actions, so
+ * invalidated entries are moved to a stale list and their markers are
+ * deleted on the next cache access.
+ *
+ * Changes to nodes that are only dereferenced by the fields of the find, e.g.
+ * through edge fields or ancestors, wouldn't be tracked, so such finds are
+ * never cached.
+ *
+ * The cache is bounded by FIND_CACHE_MAX_BYTES per hierarchy and the least
+ * recently used entries are evicted first.
+ */
+
+struct SelvaFindCacheEntry {
+    RB_ENTRY(SelvaFindCacheEntry) _entry;
+    TAILQ_ENTRY(SelvaFindCacheEntry) _lru;
+    uint64_t hash;
+    RedisModuleCallReply *reply;
+    size_t size; /*!< Accounted size of the entry. */
+    unsigned linked : 1; /*!< The entry is in the cache. */
+    unsigned stale : 1; /*!< The entry has been invalidated. */
+    Selva_SubscriptionMarkerId first_marker_id;
+    size_t nr_markers;
+    size_t key_len;
+    char key[]; /*!< Length prefixed argv. */
+};
+
+/**
+ * Subscription id used for the cache markers.
+ * Distinct from the subscription id used by the find indexing.
+ */
+static Selva_SubscriptionId find_cache_sub_id = { 0x01 };
+
+/**
+ * A context for executing find commands on cache misses.
+ * The replies can't be created with the command context as it frees the
+ * replies automatically.
+ */
+static RedisModuleCtx *find_cache_ctx;
+
+/**
+ * Set while the cache is executing a find command.
+ */
+static int find_cache_bypass;
+
+static unsigned long long find_cache_hits;
+static unsigned long long find_cache_misses;
+static unsigned long long find_cache_evictions;
+static unsigned long long find_cache_invalidations;
+static size_t find_cache_nr_entries;
+static size_t find_cache_bytes;
+
+static int SelvaFindCacheEntry_Compare(const struct SelvaFindCacheEntry *a, const struct SelvaFindCacheEntry *b) {
+    if (a->hash != b->hash) {
+        return a->hash < b->hash ? -1 : 1;
+    }
+    if (a->key_len != b->key_len) {
+        return a->key_len < b->key_len ? -1 : 1;
+    }
+
+    return memcmp(a->key, b->key, a->key_len);
+}
+
+RB_PROTOTYPE_STATIC(hierarchy_find_cache_tree, SelvaFindCacheEntry, _entry, SelvaFindCacheEntry_Compare)
+RB_GENERATE_STATIC(hierarchy_find_cache_tree, SelvaFindCacheEntry, _entry, SelvaFindCacheEntry_Compare)
+
+/**
+ * Check if an RPN expression reads the clock.
+ * The result of such an expression changes without any change in the
+ * hierarchy and thus it can't be cached.
+ */
+static int is_time_dependent(const char *expr) {
+    const char *s = expr;
+
+    if (!s) {
+        return 0;
+    }
+
+    while (*s) {
+        const char *e;
+
+        while (isspace(*s)) {
+            s++;
+        }
+        e = s;
+        while (*e && !isspace(*e)) {
+            e++;
+        }
+
+        if (e - s == 1 && *s == 'n') {
+            return 1;
+        }
+        s = e;
+    }
+
+    return 0;
+}
+
+/**
+ * Create a new entry keyed by the find argv.
+ * argv[0] is the command name and it's not part of the key.
+ */
+static struct SelvaFindCacheEntry *new_entry(RedisModuleString **argv, int argc) {
+    struct SelvaFindCacheEntry *entry;
+    size_t key_len = 0;
+    char *p;
+
+    for (int i = 1; i < argc; i++) {
+        size_t len;
+
+        (void)RedisModule_StringPtrLen(argv[i], &len);
+        key_len += sizeof(len) + len;
+    }
+
+    entry = selva_calloc(1, sizeof(*entry) + key_len);
+    entry->key_len = key_len;
+
+    /*
+     * Each argument is prefixed with its length to make the key unambiguous.
+     */
+    p = entry->key;
+    for (int i = 1; i < argc; i++) {
+        size_t len;
+        const char *str = RedisModule_StringPtrLen(argv[i], &len);
+
+        memcpy(p, &len, sizeof(len));
+        p += sizeof(len);
+        memcpy(p, str, len);
+        p += len;
+    }
+
+    entry->hash = hll_hash(entry->key, key_len);
+
+    return entry;
+}
+
+static void link_entry(struct SelvaHierarchy *hierarchy, struct SelvaFindCacheEntry *entry) {
+    RB_INSERT(hierarchy_find_cache_tree, &hierarchy->find_cache.head, entry);
+    TAILQ_INSERT_HEAD(&hierarchy->find_cache.lru, entry, _lru);
+    entry->linked = 1;
+
+    hierarchy->find_cache.nr_entries++;
+    hierarchy->find_cache.bytes += entry->size;
+    find_cache_nr_entries++;
+    find_cache_bytes += entry->size;
+}
+
+/**
+ * Remove an entry from the cache and free the cached reply.
+ * The markers of the entry are not deleted.
+ */
+static void unlink_entry(struct SelvaHierarchy *hierarchy, struct SelvaFindCacheEntry *entry) {
+    RB_REMOVE(hierarchy_find_cache_tree, &hierarchy->find_cache.head, entry);
+    TAILQ_REMOVE(&hierarchy->find_cache.lru, entry, _lru);
+    entry->linked = 0;
+
+    hierarchy->find_cache.nr_entries--;
+    hierarchy->find_cache.bytes -= entry->size;
+    find_cache_nr_entries--;
+    find_cache_bytes -= entry->size;
+
+    RedisModule_FreeCallReply(entry->reply);
+    entry->reply = NULL;
+}
+
+static void delete_markers(RedisModuleCtx *ctx, struct SelvaHierarchy *hierarchy, struct SelvaFindCacheEntry *entry) {
+    for (size_t i = 0; i < entry->nr_markers; i++) {
+        (void)SelvaSubscriptions_DeleteMarker(ctx, hierarchy, find_cache_sub_id, entry->first_marker_id + i);
+    }
+    entry->nr_markers = 0;
+}
+
+static void evict_entry(RedisModuleCtx *ctx, struct SelvaHierarchy *hierarchy, struct SelvaFindCacheEntry *entry) {
+    unlink_entry(hierarchy, entry);
+    delete_markers(ctx, hierarchy, entry);
+    selva_free(entry);
+}
+
+/**
+ * Delete the markers of invalidated entries and free the entries.
+ */
+static void drain_stale(RedisModuleCtx *ctx, struct SelvaHierarchy *hierarchy) {
+    struct SelvaFindCacheEntry *entry;
+
+    while ((entry = SVector_Pop(&hierarchy->find_cache.stale))) {
+        delete_markers(ctx, hierarchy, entry);
+        selva_free(entry);
+    }
+}
+
+/**
+ * Marker action invalidating a cache entry.
+ */
+static void invalidate_entry(
+        struct RedisModuleCtx *ctx __unused,
+        struct SelvaHierarchy *hierarchy,
+        struct Selva_SubscriptionMarker *marker,
+        unsigned short event_flags __unused,
+        const char *field_str __unused,
+        size_t field_len __unused,
+        struct SelvaHierarchyNode *node __unused) {
+    struct SelvaFindCacheEntry *entry = (struct SelvaFindCacheEntry *)marker->marker_action_owner_ctx;
+
+    if (entry->stale) {
+        return;
+    }
+
+    entry->stale = 1;
+    find_cache_invalidations++;
+
+    /*
+     * An entry that is not linked yet is still owned by insert_entry().
+     */
+    if (entry->linked) {
+        unlink_entry(hierarchy, entry);
+        SVector_Insert(&hierarchy->find_cache.stale, entry);
+    }
+}
+
+static int add_markers(
+        RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaFindCacheEntry *entry,
+        const struct SelvaFindCacheQuery *query) {
+    const unsigned short marker_flags =
+        SELVA_SUBSCRIPTION_FLAG_CH_HIERARCHY |
+        SELVA_SUBSCRIPTION_FLAG_CH_FIELD;
+    /*
+     * The markers don't have the register arguments of the filter and
+     * therefore a filter using them must be replaced with a wildcard.
+     */
+    const char *filter = query->filter_has_args ? NULL : query->filter;
+
+    entry->first_marker_id = hierarchy->find_cache.next_marker_id;
+    entry->nr_markers = 0;
+
+    for (size_t i = 0; i < query->nr_node_ids; i++) {
+        const char *node_id = query->node_ids[i];
+        Selva_SubscriptionMarkerId marker_id;
+        int err;
+
+        if (node_id[0] == '\0') {
+            continue;
+        }
+
+        marker_id = hierarchy->find_cache.next_marker_id++;
+        err = SelvaSubscriptions_AddCallbackMarker(
+                hierarchy, find_cache_sub_id, marker_id, marker_flags,
+                node_id, query->dir, query->dir_field, query->dir_expression, filter,
+                invalidate_entry,
+                entry);
+        if (!err) {
+            entry->nr_markers++;
+            err = SelvaSubscriptions_RefreshByMarkerId(ctx, hierarchy, find_cache_sub_id, marker_id);
+        }
+        if (err) {
+            delete_markers(ctx, hierarchy, entry);
+            return err;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Insert a new entry to the cache.
+ * @returns 0 if the entry was inserted and the cache took the ownership of
+ *          the entry and the reply; Otherwise a selva error.
+ */
+static int insert_entry(
+        RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaFindCacheEntry *entry,
+        RedisModuleCallReply *reply,
+        const struct SelvaFindCacheQuery *query) {
+    const size_t max_bytes = selva_glob_config.find_cache_max_bytes;
+    size_t proto_len;
+    int err;
+
+    (void)RedisModule_CallReplyProto(reply, &proto_len);
+    entry->size = sizeof(*entry) + entry->key_len + proto_len;
+    if (entry->size > max_bytes) {
+        return SELVA_ENOBUFS;
+    }
+
+    while (hierarchy->find_cache.bytes + entry->size > max_bytes) {
+        evict_entry(ctx, hierarchy, TAILQ_LAST(&hierarchy->find_cache.lru, hierarchy_find_cache_lru));
+        find_cache_evictions++;
+    }
+
+    err = add_markers(ctx, hierarchy, entry, query);
+    if (err) {
+        return err;
+    }
+
+    if (entry->stale) {
+        /* Invalidated while the markers were refreshed. */
+        delete_markers(ctx, hierarchy, entry);
+        return SELVA_ENOENT;
+    }
+
+    entry->reply = reply;
+    link_entry(hierarchy, entry);
+
+    return 0;
+}
+
+void SelvaFindCache_Init(struct SelvaHierarchy *hierarchy) {
+    RB_INIT(&hierarchy->find_cache.head);
+    TAILQ_INIT(&hierarchy->find_cache.lru);
+    SVector_Init(&hierarchy->find_cache.stale, 0, NULL);
+    hierarchy->find_cache.nr_entries = 0;
+    hierarchy->find_cache.bytes = 0;
+    hierarchy->find_cache.next_marker_id = 0;
+}
+
+void SelvaFindCache_Destroy(struct SelvaHierarchy *hierarchy) {
+    struct SelvaFindCacheEntry *entry;
+
+    /*
+     * The markers were already destroyed with the subscriptions.
+     */
+    while ((entry = RB_MIN(hierarchy_find_cache_tree, &hierarchy->find_cache.head))) {
+        unlink_entry(hierarchy, entry);
+        selva_free(entry);
+    }
+
+    while ((entry = SVector_Pop(&hierarchy->find_cache.stale))) {
+        selva_free(entry);
+    }
+    SVector_Destroy(&hierarchy->find_cache.stale);
+}
+
+void SelvaFindCache_InvalidateAll(RedisModuleCtx *ctx, struct SelvaHierarchy *hierarchy) {
+    struct SelvaFindCacheEntry *entry;
+
+    drain_stale(ctx, hierarchy);
+
+    while ((entry = RB_MIN(hierarchy_find_cache_tree, &hierarchy->find_cache.head))) {
+        evict_entry(ctx, hierarchy, entry);
+        find_cache_invalidations++;
+    }
+}
+
+int SelvaFindCache_Reply(
+        RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        RedisModuleString **argv,
+        int argc,
+        const struct SelvaFindCacheQuery *query) {
+    struct SelvaFindCacheEntry *find;
+    struct SelvaFindCacheEntry *entry;
+    RedisModuleCallReply *reply;
+
+    if (find_cache_bypass ||
+        selva_glob_config.find_cache_max_bytes == 0 ||
+        is_time_dependent(query->filter) ||
+        is_time_dependent(query->dir_expression) ||
+        is_time_dependent(query->edge_filter)) {
+        return 0;
+    }
+
+    drain_stale(ctx, hierarchy);
+
+    find = new_entry(argv, argc);
+    entry = RB_FIND(hierarchy_find_cache_tree, &hierarchy->find_cache.head, find);
+    if (entry) {
+        selva_free(find);
+        find_cache_hits++;
+
+        TAILQ_REMOVE(&hierarchy->find_cache.lru, entry, _lru);
+        TAILQ_INSERT_HEAD(&hierarchy->find_cache.lru, entry, _lru);
+
+        RedisModule_ReplyWithCallReply(ctx, entry->reply);
+        return 1;
+    }
+    find_cache_misses++;
+
+    RedisModule_SelectDb(find_cache_ctx, RedisModule_GetSelectedDb(ctx));
+    find_cache_bypass = 1;
+    reply = RedisModule_Call(find_cache_ctx, "selva.hierarchy.find", "v", argv + 1, (size_t)(argc - 1));
+    find_cache_bypass = 0;
+    if (!reply) {
+        selva_free(find);
+        return 0;
+    }
+
+    RedisModule_ReplyWithCallReply(ctx, reply);
+
+    if (RedisModule_CallReplyType(reply) == REDISMODULE_REPLY_ERROR ||
+        insert_entry(ctx, hierarchy, find, reply, query)) {
+        RedisModule_FreeCallReply(reply);
+        selva_free(find);
+    }
+
+    return 1;
+}
+
+static int FindCache_OnLoad(RedisModuleCtx *ctx) {
+    find_cache_ctx = RedisModule_GetDetachedThreadSafeContext(ctx);
+    if (!find_cache_ctx) {
+        return REDISMODULE_ERR;
+    }
+
+    return REDISMODULE_OK;
+}
+SELVA_ONLOAD(FindCache_OnLoad);
+
+static void mod_info(RedisModuleInfoCtx *ctx) {
+    const unsigned long long lookups = find_cache_hits + find_cache_misses;
+
+    (void)RedisModule_InfoAddFieldULongLong(ctx, "hits", find_cache_hits);
+    (void)RedisModule_InfoAddFieldULongLong(ctx, "misses", find_cache_misses);
+    (void)RedisModule_InfoAddFieldDouble(ctx, "hit_ratio", lookups > 0 ? (double)find_cache_hits / (double)lookups : 0.0);
+    (void)RedisModule_InfoAddFieldULongLong(ctx, "evictions", find_cache_evictions);
+    (void)RedisModule_InfoAddFieldULongLong(ctx, "invalidations", find_cache_invalidations);
+    (void)RedisModule_InfoAddFieldULongLong(ctx, "entries", find_cache_nr_entries);
+    (void)RedisModule_InfoAddFieldULongLong(ctx, "bytes", find_cache_bytes);
+}
+SELVA_MODINFO("find_cache", mod_info);
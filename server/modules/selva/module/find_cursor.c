@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "jemalloc.h"
+#include "base64.h"
+#include "selva.h"
+#include "traversal.h"
+#include "find_cursor.h"
+
+/* TODO Support __ORDER_BIG_ENDIAN__ */
+_Static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Only little endian host is supported");
+
+#define FIND_CURSOR_HEADER_SIZE (2 * sizeof(uint8_t) + sizeof(uint64_t))
+#define FIND_CURSOR_KEY_SIZE (sizeof(uint8_t) + sizeof(double) + SELVA_NODE_ID_SIZE)
+
+static size_t put_header(char *buf, enum FindCursorType type, uint64_t generation) {
+    buf[0] = FIND_CURSOR_VERSION;
+    buf[1] = (char)type;
+    memcpy(buf + 2, &generation, sizeof(generation));
+
+    return FIND_CURSOR_HEADER_SIZE;
+}
+
+static char *encode(const char *buf, size_t len, size_t *out_len) {
+    char *s = selva_malloc(base64_out_len(len, 0) + 1);
+    size_t n;
+
+    n = base64_encode_s(s, buf, len, 0);
+    if (out_len) {
+        *out_len = n;
+    }
+
+    return s;
+}
+
+char *FindCursor_EncodePos(uint64_t generation, uint64_t state_id, size_t head, size_t *out_len) {
+    char buf[FIND_CURSOR_HEADER_SIZE + 2 * sizeof(uint64_t)];
+    const uint64_t head64 = (uint64_t)head;
+    size_t off;
+
+    off = put_header(buf, FIND_CURSOR_TYPE_POS, generation);
+    memcpy(buf + off, &state_id, sizeof(state_id));
+    off += sizeof(state_id);
+    memcpy(buf + off, &head64, sizeof(head64));
+
+    return encode(buf, sizeof(buf), out_len);
+}
+
+char *FindCursor_EncodeKey(uint64_t generation, const struct TraversalOrderItem *item, size_t *out_len) {
+    const size_t data_len = (item->type == ORDER_ITEM_TYPE_TEXT) ? strlen(item->data) : 0;
+    const size_t len = FIND_CURSOR_HEADER_SIZE + FIND_CURSOR_KEY_SIZE + data_len + 1;
+    char *buf = selva_malloc(len);
+    char *s;
+    size_t off;
+
+    off = put_header(buf, FIND_CURSOR_TYPE_KEY, generation);
+    buf[off++] = (char)item->type;
+    memcpy(buf + off, &item->d, sizeof(item->d));
+    off += sizeof(item->d);
+    memcpy(buf + off, item->node_id, SELVA_NODE_ID_SIZE);
+    off += SELVA_NODE_ID_SIZE;
+    memcpy(buf + off, data_len > 0 ? item->data : "", data_len + 1);
+
+    s = encode(buf, len, out_len);
+    selva_free(buf);
+
+    return s;
+}
+
+static int decode_pos(struct FindCursor *cursor, const char *buf, size_t len) {
+    uint64_t state_id;
+    uint64_t head;
+
+    if (len != sizeof(state_id) + sizeof(head)) {
+        return SELVA_EINVAL;
+    }
+
+    memcpy(&state_id, buf, sizeof(state_id));
+    memcpy(&head, buf + sizeof(state_id), sizeof(head));
+    cursor->state_id = state_id;
+    cursor->head = (size_t)head;
+
+    return 0;
+}
+
+static int decode_key(struct FindCursor *cursor, const char *buf, size_t len) {
+    enum TraversalOrderItemType type;
+    struct TraversalOrderItem *item;
+    size_t data_size;
+
+    if (len <= FIND_CURSOR_KEY_SIZE || buf[len - 1] != '\0') {
+        return SELVA_EINVAL;
+    }
+
+    type = (enum TraversalOrderItemType)buf[0];
+    if (type != ORDER_ITEM_TYPE_EMPTY &&
+        type != ORDER_ITEM_TYPE_TEXT &&
+        type != ORDER_ITEM_TYPE_DOUBLE) {
+        return SELVA_EINVAL;
+    }
+
+    data_size = len - FIND_CURSOR_KEY_SIZE;
+    item = selva_calloc(1, sizeof(struct TraversalOrderItem) + data_size);
+    item->type = type;
+    memcpy(&item->d, buf + 1, sizeof(item->d));
+    memcpy(item->node_id, buf + 1 + sizeof(item->d), SELVA_NODE_ID_SIZE);
+    memcpy(item->data, buf + FIND_CURSOR_KEY_SIZE, data_size);
+
+    cursor->item = item;
+
+    return 0;
+}
+
+int FindCursor_Decode(struct FindCursor *cursor, const char *str, size_t len) {
+    char *buf;
+    size_t buf_len;
+    uint64_t generation;
+    int err;
+
+    memset(cursor, 0, sizeof(*cursor));
+
+    buf = base64_decode(str, len, &buf_len);
+    if (!buf) {
+        return SELVA_EINVAL;
+    }
+
+    if (buf_len < FIND_CURSOR_HEADER_SIZE) {
+        err = SELVA_EINVAL;
+        goto out;
+    }
+
+    if ((uint8_t)buf[0] != FIND_CURSOR_VERSION) {
+        err = SELVA_ENOTSUP;
+        goto out;
+    }
+
+    memcpy(&generation, buf + 2, sizeof(generation));
+    cursor->type = (enum FindCursorType)buf[1];
+    cursor->generation = generation;
+
+    switch (cursor->type) {
+    case FIND_CURSOR_TYPE_POS:
+        err = decode_pos(cursor, buf + FIND_CURSOR_HEADER_SIZE, buf_len - FIND_CURSOR_HEADER_SIZE);
+        break;
+    case FIND_CURSOR_TYPE_KEY:
+        err = decode_key(cursor, buf + FIND_CURSOR_HEADER_SIZE, buf_len - FIND_CURSOR_HEADER_SIZE);
+        break;
+    default:
+        err = SELVA_EINVAL;
+    }
+
+out:
+    selva_free(buf);
+    return err;
+}
+
+void FindCursor_Destroy(struct FindCursor *cursor) {
+    selva_free(cursor->item);
+    cursor->item = NULL;
+}
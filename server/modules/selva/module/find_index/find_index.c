@@ -13,14 +13,16 @@
 #include "bitmap.h"
 #include "lpf.h"
 #include "poptop.h"
+#include "ptag.h"
 #include "hierarchy.h"
 #include "ida.h"
 #include "selva.h"
 #include "modinfo.h"
+#include "selva_memory.h"
 #include "selva_object.h"
 #include "selva_onload.h"
-#include "selva_set.h"
 #include "selva_trace.h"
+#include "timestamp.h"
 #include "icb.h"
 #include "pick_icb.h"
 #include "find_index.h"
@@ -80,13 +82,9 @@ static int skip_node(const struct SelvaFindIndexControlBlock *icb, const struct
 }
 
 static void icb_res_init(struct SelvaFindIndexControlBlock *icb) {
-    if (icb->flags.ordered) {
-        const size_t initial_len = (size_t)icb->find_acc.take_max_ave;
-
-        SelvaTraversalOrder_InitOrderResult(&icb->res.ord, icb->traversal.sort.order, initial_len);
-    } else {
-        SelvaSet_Init(&icb->res.set, SELVA_SET_TYPE_NODEID);
-    }
+    SelvaFindIndexICB_ResInit(icb);
+    icb->flags.valid = 1;
+    icb->valid_acc.valid_since = ts_now();
 }
 
 static void icb_clear_acc(struct SelvaFindIndexControlBlock *icb) {
@@ -96,49 +94,65 @@ static void icb_clear_acc(struct SelvaFindIndexControlBlock *icb) {
 static void icb_res_destroy(struct SelvaFindIndexControlBlock *icb) {
     if (icb->flags.valid) {
         icb->flags.valid = 0;
+        icb->valid_acc.valid_ms += ts_now() - icb->valid_acc.valid_since;
+        SelvaFindIndexICB_ResDestroy(icb);
+    }
+}
 
-        if (icb->flags.ordered) {
-            /* ctx is not needed here as it was not used when the items were created. */
-            SelvaTraversalOrder_DestroyOrderResult(NULL, &icb->res.ord);
-        } else {
-            SelvaSet_Destroy(&icb->res.set);
-        }
+/**
+ * Check whether the deletion of node may remove other nodes from the traversal.
+ * This is a conservative check; If the node has no adjacent nodes in the
+ * direction of the traversal then only the node itself can leave the index.
+ */
+static int is_traversal_leaf(const struct SelvaFindIndexControlBlock *icb, const struct SelvaHierarchyNode *node) {
+    Selva_NodeId node_id;
+
+    SelvaHierarchy_GetNodeId(node_id, node);
+    if (!memcmp(node_id, icb->node_id, SELVA_NODE_ID_SIZE)) {
+        /* The starting node itself. */
+        return 0;
+    }
+
+    switch (icb->traversal.dir) {
+    case SELVA_HIERARCHY_TRAVERSAL_BFS_DESCENDANTS:
+        return !SelvaHierarchy_IsNonEmptyField(node, SELVA_CHILDREN_FIELD, sizeof(SELVA_CHILDREN_FIELD) - 1);
+    case SELVA_HIERARCHY_TRAVERSAL_BFS_ANCESTORS:
+        return !SelvaHierarchy_IsNonEmptyField(node, SELVA_PARENTS_FIELD, sizeof(SELVA_PARENTS_FIELD) - 1);
+    default:
+        /* The expression may follow any field. */
+        return 0;
     }
 }
 
-static int icb_res_add(struct SelvaFindIndexControlBlock *icb, struct SelvaHierarchyNode *node) {
-    if (icb->flags.ordered) {
-        struct TraversalOrderItem *item;
-        /*
-         * Supporting lang here wouldn't add anything because we'd need to index
-         * each lang separately anyway.
-         */
-        RedisModuleString *lang = NULL;
+/**
+ * Get the percentage of time the index has been valid since it was started.
+ */
+static double icb_valid_pct(const struct SelvaFindIndexControlBlock *icb) {
+    long long now, tot, valid;
 
-        item = SelvaTraversalOrder_CreateNodeOrderItem(NULL, lang, node, icb->traversal.sort.order_field);
-        if (SVector_InsertFast(&icb->res.ord, item)) {
-            SelvaTraversalOrder_DestroyOrderItem(NULL, item);
-        }
-    } else {
-        Selva_NodeId node_id;
-        int err;
+    if (!icb->flags.active) {
+        return 0.0;
+    }
 
-        SelvaHierarchy_GetNodeId(node_id, node);
+    now = ts_now();
+    tot = now - icb->valid_acc.active_since;
+    valid = icb->valid_acc.valid_ms;
+    if (icb->flags.valid) {
+        valid += now - icb->valid_acc.valid_since;
+    }
 
-        err = SelvaSet_Add(&icb->res.set, node_id);
-        if (err && err != SELVA_EEXIST) {
-            return err;
-        }
+    if (tot <= 0) {
+        return icb->flags.valid ? 100.0 : 0.0;
     }
 
-    return 0;
+    return 100.0 * (double)valid / (double)tot;
 }
 
 size_t SelvaFindIndex_IcbCard(const struct SelvaFindIndexControlBlock *icb) {
     if (icb->flags.ordered) {
         return SVector_Size(&icb->res.ord);
     } else {
-        return SelvaSet_Size(&icb->res.set);
+        return SVector_Size(&icb->res.set);
     }
 }
 
@@ -150,8 +164,8 @@ static void update_index(
         struct SelvaHierarchy *hierarchy __unused,
         struct Selva_SubscriptionMarker *marker,
         unsigned short event_flags,
-        const char *field_str,
-        size_t field_len,
+        const char *field_str __unused,
+        size_t field_len __unused,
         struct SelvaHierarchyNode *node) {
     struct SelvaFindIndexControlBlock *icb;
 
@@ -162,12 +176,23 @@ static void update_index(
     icb = (struct SelvaFindIndexControlBlock *)marker->marker_action_owner_ctx;
 
     if (event_flags & SELVA_SUBSCRIPTION_FLAG_CL_HIERARCHY) {
-        /*
-         * A node within the index was deleted.
-         *
-         * Delete the res to trigger a full rebuild.
-         */
-        if (icb->flags.valid) {
+        if (!icb->flags.valid) {
+            return;
+        }
+
+        if ((event_flags & SELVA_SUBSCRIPTION_FLAG_CL_DELETE) && is_traversal_leaf(icb, node)) {
+            /*
+             * A node within the index is deleted but the rest of the
+             * traversal is unaffected.
+             */
+            SelvaFindIndexICB_ResDel(icb, node);
+        } else {
+            /*
+             * The hierarchy changed around a node within the index and the
+             * traversal might have changed.
+             *
+             * Delete the res to trigger a full rebuild.
+             */
 #if 0
             Selva_NodeId node_id;
 
@@ -194,10 +219,8 @@ static void update_index(
              * we have received an event for every node in the traversal,
              * therefore there is no risk setting this result valid before all
              * the ids have been actually added.
+             * Initialize `res` before indexing.
              */
-            icb->flags.valid = 1;
-
-            /* Initialize `res` before indexing. */
             icb_res_init(icb);
         }
 
@@ -211,34 +234,25 @@ static void update_index(
                         __FILE__, __LINE__,
                         (int)SELVA_NODE_ID_SIZE, node_id);
 #endif
-                icb_res_add(icb, node);
+                SelvaFindIndexICB_ResAdd(icb, node);
             }
         }
     } else if (event_flags & (SELVA_SUBSCRIPTION_FLAG_CH_HIERARCHY | SELVA_SUBSCRIPTION_FLAG_CH_FIELD)) {
         /*
-         * An additive change in the hierarchy.
+         * A node in the traversal changed.
+         *
+         * If the node matches the filter it's added to the index or, in case
+         * of an ordered index, moved to its new position if the value of
+         * `order_field` changed. Otherwise the node is removed from the index
+         * if it was there.
          *
          * Note that SELVA_SUBSCRIPTION_FLAG_CH_HIERARCHY applies to both
          * deleting and adding a node. However, we know that currently deleting
          * a node will cause also a SELVA_SUBSCRIPTION_FLAG_CL_HIERARCHY event.
          */
         if (icb->flags.valid && !skip_node(icb, node)) {
-            size_t order_field_len;
-            const char *order_field_str = RedisModule_StringPtrLen(icb->traversal.sort.order_field, &order_field_len);
-
-            if (icb->flags.ordered &&
-                (event_flags & SELVA_SUBSCRIPTION_FLAG_CH_FIELD) &&
-                field_len == order_field_len && !memcmp(field_str, order_field_str, order_field_len)) {
-                /*
-                 * Ordered indexing can't execute an additive change when the
-                 * field changed is the same as the field used for ordering
-                 * (`order_field`). If the value of `order_field` would change
-                 * it would cause the same node to occur twice or more in `res`.
-                 * Therefore we need to start over.
-                 */
-                icb_res_destroy(icb);
-            } else if (Selva_SubscriptionFilterMatch(ctx, hierarchy, node, marker)) {
-                icb_res_add(icb, node);
+            if (Selva_SubscriptionFilterMatch(ctx, hierarchy, node, marker)) {
+                SelvaFindIndexICB_ResAdd(icb, node);
 #if 0
                 Selva_NodeId node_id;
 
@@ -247,6 +261,8 @@ static void update_index(
                         __FILE__, __LINE__,
                         (int)SELVA_NODE_ID_SIZE, node_id);
 #endif
+            } else {
+                SelvaFindIndexICB_ResDel(icb, node);
             }
         }
     } else {
@@ -291,6 +307,8 @@ static int start_index(
     }
 
     icb->flags.active = 1;
+    icb->valid_acc.active_since = ts_now();
+    icb->valid_acc.valid_ms = 0;
 
     /* Clear indexed find accounting. */
     icb->find_acc.ind_take_max = 0.0f;
@@ -420,7 +438,7 @@ __attribute__((nonnull (2, 3))) static int destroy_icb(
     }
 
     memset(icb, 0, sizeof(*icb));
-    selva_free(icb);
+    selva_arena_free(SELVA_ARENA_FIND_INDEX, icb);
 
     return 0;
 }
@@ -678,7 +696,7 @@ static struct SelvaFindIndexControlBlock *upsert_icb(
          * yet but we are going to start counting wether it makes sense to start
          * indexing a query described by the arguments of this function.
          */
-        icb = selva_calloc(1, sizeof(*icb) + name_len);
+        icb = selva_arena_calloc(SELVA_ARENA_FIND_INDEX, 1, sizeof(*icb) + name_len);
         icb->name_len = name_len;
         memcpy(icb->name_str, name_str, name_len);
 
@@ -832,7 +850,27 @@ void SelvaFindIndex_Deinit(struct SelvaHierarchy *hierarchy) {
     memset(&hierarchy->dyn_index, 0, sizeof(hierarchy->dyn_index));
 }
 
-int SelvaFindIndex_Auto(
+/**
+ * Get an existing indexing control block.
+ */
+static struct SelvaFindIndexControlBlock *get_icb(
+        struct SelvaHierarchy *hierarchy,
+        const Selva_NodeId node_id,
+        struct icb_descriptor *desc) {
+    struct SelvaFindIndexControlBlock *icb;
+    const size_t name_len = SelvaFindIndexICB_CalcNameLen(node_id, desc);
+    char name_str[name_len];
+
+    SelvaFindIndexICB_BuildName(name_str, node_id, desc);
+
+    return SelvaFindIndexICB_Get(hierarchy, name_str, name_len, &icb) ? NULL : icb;
+}
+
+/**
+ * Get the ICB for a find query.
+ * @param upsert if set the ICB is created if it doesn't exist yet.
+ */
+static int auto_index(
         RedisModuleCtx *ctx,
         struct SelvaHierarchy *hierarchy,
         enum SelvaTraversal dir, RedisModuleString *dir_expression,
@@ -840,6 +878,7 @@ int SelvaFindIndex_Auto(
         enum SelvaResultOrder order,
         RedisModuleString *order_field,
         RedisModuleString *filter,
+        int upsert,
         struct SelvaFindIndexControlBlock **icb_out) {
     SELVA_TRACE_BEGIN_AUTO(FindIndex_AutoIndex);
     struct SelvaFindIndexControlBlock *icb;
@@ -867,7 +906,8 @@ int SelvaFindIndex_Auto(
         },
     };
 
-    icb = SelvaFindIndexICB_Pick(hierarchy, node_id, &icb_desc, upsert_icb(ctx, hierarchy, node_id, &icb_desc));
+    icb = SelvaFindIndexICB_Pick(hierarchy, node_id, &icb_desc,
+                                 upsert ? upsert_icb(ctx, hierarchy, node_id, &icb_desc) : get_icb(hierarchy, node_id, &icb_desc));
     *icb_out = icb;
 
     if (!icb || !icb->flags.valid) {
@@ -877,7 +917,19 @@ int SelvaFindIndex_Auto(
     return 0;
 }
 
-int SelvaFindIndex_AutoMulti(
+int SelvaFindIndex_Auto(
+        RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        enum SelvaTraversal dir, RedisModuleString *dir_expression,
+        const Selva_NodeId node_id,
+        enum SelvaResultOrder order,
+        RedisModuleString *order_field,
+        RedisModuleString *filter,
+        struct SelvaFindIndexControlBlock **icb_out) {
+    return auto_index(ctx, hierarchy, dir, dir_expression, node_id, order, order_field, filter, 1, icb_out);
+}
+
+static int auto_index_multi(
         RedisModuleCtx *ctx,
         struct SelvaHierarchy *hierarchy,
         enum SelvaTraversal dir, RedisModuleString *dir_expression,
@@ -886,6 +938,7 @@ int SelvaFindIndex_AutoMulti(
         RedisModuleString *order_field,
         RedisModuleString *index_hints[],
         size_t nr_index_hints,
+        int upsert,
         struct SelvaFindIndexControlBlock *ind_icb_out[]) {
     int ind_select = -1;
 
@@ -897,7 +950,7 @@ int SelvaFindIndex_AutoMulti(
          * Hint: It's possible to disable ordered indices completely
          * by changing order here to SELVA_RESULT_ORDER_NONE.
          */
-        err = SelvaFindIndex_Auto(ctx, hierarchy, dir, dir_expression, node_id, order, order_field, index_hints[i], &icb);
+        err = auto_index(ctx, hierarchy, dir, dir_expression, node_id, order, order_field, index_hints[i], upsert, &icb);
         ind_icb_out[i] = icb;
         if (!err) {
             if (icb &&
@@ -914,6 +967,31 @@ int SelvaFindIndex_AutoMulti(
     return ind_select;
 }
 
+int SelvaFindIndex_AutoMulti(
+        RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        enum SelvaTraversal dir, RedisModuleString *dir_expression,
+        const Selva_NodeId node_id,
+        enum SelvaResultOrder order,
+        RedisModuleString *order_field,
+        RedisModuleString *index_hints[],
+        size_t nr_index_hints,
+        struct SelvaFindIndexControlBlock *ind_icb_out[]) {
+    return auto_index_multi(ctx, hierarchy, dir, dir_expression, node_id, order, order_field, index_hints, nr_index_hints, 1, ind_icb_out);
+}
+
+int SelvaFindIndex_LookupMulti(
+        struct SelvaHierarchy *hierarchy,
+        enum SelvaTraversal dir, RedisModuleString *dir_expression,
+        const Selva_NodeId node_id,
+        enum SelvaResultOrder order,
+        RedisModuleString *order_field,
+        RedisModuleString *index_hints[],
+        size_t nr_index_hints,
+        struct SelvaFindIndexControlBlock *ind_icb_out[]) {
+    return auto_index_multi(NULL, hierarchy, dir, dir_expression, node_id, order, order_field, index_hints, nr_index_hints, 0, ind_icb_out);
+}
+
 int SelvaFindIndex_IsOrdered(
         struct SelvaFindIndexControlBlock *icb,
         enum SelvaResultOrder order,
@@ -924,51 +1002,303 @@ int SelvaFindIndex_IsOrdered(
            !RedisModule_StringCompare(icb->traversal.sort.order_field, order_field);
 }
 
+/**
+ * Estimate the cost of sorting n nodes.
+ */
+static double sort_cost(double n) {
+    return (n > 1.0) ? FIND_PLAN_COST_SORT * n * log2(n) : 0.0;
+}
+
+static int is_valid_icb(const struct SelvaFindIndexControlBlock *icb) {
+    return icb && icb->flags.valid;
+}
+
+/**
+ * Estimate the number of nodes visited by traversing the hierarchy.
+ * The find accounting of the indices is the best estimate we have as all the
+ * hints of a find share the same traversal. As nothing might have been
+ * accounted yet, the fan-out of the head and the size of the indices give a
+ * lower bound.
+ */
+static double est_traverse_visit(
+        const struct SelvaFindIndexPlanQuery *query,
+        struct SelvaFindIndexControlBlock *ind_icb[],
+        size_t nr_index_hints) {
+    double est = query->head ? (double)SelvaHierarchy_GetFanOut(query->head, query->dir) : 0.0;
+
+    for (size_t i = 0; i < nr_index_hints; i++) {
+        const struct SelvaFindIndexControlBlock *icb = ind_icb[i];
+
+        if (!icb) {
+            continue;
+        }
+
+        est = max(est, (double)icb->find_acc.tot_max_ave);
+        est = max(est, (double)icb->find_acc.tot_max);
+        if (icb->flags.valid) {
+            est = max(est, (double)SelvaFindIndex_IcbCard(icb));
+        }
+    }
+
+    return est;
+}
+
+/**
+ * Estimate the number of nodes in the result when traversing the hierarchy.
+ */
+static double est_traverse_rows(
+        struct SelvaFindIndexControlBlock *ind_icb[],
+        size_t nr_index_hints,
+        double est_visit) {
+    double est = est_visit;
+
+    for (size_t i = 0; i < nr_index_hints; i++) {
+        const struct SelvaFindIndexControlBlock *icb = ind_icb[i];
+
+        if (!icb || icb->find_acc.tot_max == 0.0f) {
+            continue;
+        }
+
+        est = min(est, (double)max(icb->find_acc.take_max_ave, icb->find_acc.take_max));
+    }
+
+    return est;
+}
+
+/**
+ * Estimate the number of nodes in the result when iterating an index.
+ */
+static double est_index_rows(const struct SelvaFindIndexControlBlock *icb) {
+    const double card = (double)SelvaFindIndex_IcbCard(icb);
+    const double take = (double)max(icb->find_acc.ind_take_max_ave, icb->find_acc.ind_take_max);
+
+    return (take > 0.0) ? min(take, card) : card;
+}
+
+static int filter_equals_icb(const struct SelvaFindIndexPlanQuery *query, const struct SelvaFindIndexControlBlock *icb) {
+    return query->filter && !RedisModule_StringCompare(query->filter, icb->traversal.filter);
+}
+
+void SelvaFindIndex_Plan(
+        const struct SelvaFindIndexPlanQuery *query,
+        struct SelvaFindIndexControlBlock *ind_icb[],
+        size_t nr_index_hints,
+        struct SelvaFindIndexPlan *plan) {
+    const double tot = est_traverse_visit(query, ind_icb, nr_index_hints);
+    const double filter_cost = query->filter ? FIND_PLAN_COST_FILTER : 0.0;
+    const int sorted = query->order != SELVA_RESULT_ORDER_NONE;
+    int by_card[FIND_INDICES_MAX_HINTS_FIND];
+    int nr_valid = 0;
+
+    plan->type = SELVA_FIND_PLAN_TRAVERSE;
+    plan->ind_select = -1;
+    plan->nr_probes = 0;
+    plan->est_visit = tot;
+    plan->est_rows = est_traverse_rows(ind_icb, nr_index_hints, tot);
+    plan->traverse_cost = tot * (FIND_PLAN_COST_TRAVERSE + filter_cost) +
+                          (sorted ? sort_cost(plan->est_rows) : 0.0);
+    plan->cost = plan->traverse_cost;
+
+    /*
+     * Sort the valid indices by cardinality, i.e. the most selective first.
+     */
+    for (int i = 0; i < (int)min(nr_index_hints, (size_t)FIND_INDICES_MAX_HINTS_FIND); i++) {
+        int j;
+
+        if (!is_valid_icb(ind_icb[i])) {
+            continue;
+        }
+
+        for (j = nr_valid; j > 0 && SelvaFindIndex_IcbCard(ind_icb[by_card[j - 1]]) > SelvaFindIndex_IcbCard(ind_icb[i]); j--) {
+            by_card[j] = by_card[j - 1];
+        }
+        by_card[j] = i;
+        nr_valid++;
+    }
+
+    for (int k = 0; k < nr_valid; k++) {
+        const int i = by_card[k];
+        struct SelvaFindIndexControlBlock *icb = ind_icb[i];
+        const double card = (double)SelvaFindIndex_IcbCard(icb);
+        const int ordered = sorted && query->ordered_ok &&
+                            SelvaFindIndex_IsOrdered(icb, query->order, query->order_field);
+        const double icb_filter_cost = filter_equals_icb(query, icb) ? 0.0 : filter_cost;
+        double rows = est_index_rows(icb);
+        double visit = card;
+        double probe_cost = 0.0;
+        double survivors;
+        double cost;
+        int probes[FIND_INDICES_MAX_HINTS_FIND];
+        int nr_probes = 0;
+
+        /*
+         * A find using an ordered index stops once it has enough results.
+         */
+        if (ordered && query->limit >= 0 && rows > 0.0) {
+            visit = min(card, ceil((double)query->limit * card / rows));
+            rows = min(rows, (double)query->limit);
+        }
+
+        survivors = visit;
+        cost = visit * (FIND_PLAN_COST_INDEX + icb_filter_cost);
+
+        /*
+         * Probe the other indices, the most selective first, as long as it
+         * drops enough nodes to pay for the probing. The selectivity of an
+         * index is estimated as the fraction of the traversal it contains,
+         * assuming that the indices are independent.
+         */
+        for (int l = 0; l < nr_valid && tot > 0.0; l++) {
+            const int j = by_card[l];
+            const double sel = min((double)SelvaFindIndex_IcbCard(ind_icb[j]) / tot, 1.0);
+            double new_cost;
+
+            if (j == i) {
+                continue;
+            }
+
+            new_cost = visit * FIND_PLAN_COST_INDEX +
+                       probe_cost + survivors * FIND_PLAN_COST_PROBE +
+                       survivors * sel * icb_filter_cost;
+            if (new_cost >= cost) {
+                break;
+            }
+
+            probe_cost += survivors * FIND_PLAN_COST_PROBE;
+            survivors *= sel;
+            cost = new_cost;
+            probes[nr_probes++] = j;
+        }
+
+        if (!ordered && sorted) {
+            cost += sort_cost(min(rows, survivors));
+        }
+
+        if (cost < plan->cost) {
+            plan->type = nr_probes > 0 ? SELVA_FIND_PLAN_INTERSECT : SELVA_FIND_PLAN_INDEX;
+            plan->ind_select = i;
+            plan->nr_probes = nr_probes;
+            memcpy(plan->probes, probes, nr_probes * sizeof(int));
+            plan->est_visit = visit;
+            plan->est_rows = min(rows, survivors);
+            plan->cost = cost;
+        }
+    }
+}
+
+void SelvaFindIndex_ReplyWithPlan(
+        struct RedisModuleCtx *ctx,
+        struct SelvaFindIndexControlBlock *ind_icb[],
+        const struct SelvaFindIndexPlan *plan) {
+    static const char *type_str[] = {
+        [SELVA_FIND_PLAN_TRAVERSE] = "traverse",
+        [SELVA_FIND_PLAN_INDEX] = "index",
+        [SELVA_FIND_PLAN_INTERSECT] = "intersect",
+    };
+
+    RedisModule_ReplyWithArray(ctx, 5);
+    RedisModule_ReplyWithSimpleString(ctx, type_str[plan->type]);
+
+    if (plan->ind_select >= 0) {
+        const struct SelvaFindIndexControlBlock *icb = ind_icb[plan->ind_select];
+
+        RedisModule_ReplyWithArray(ctx, 1 + plan->nr_probes);
+        RedisModule_ReplyWithStringBuffer(ctx, icb->name_str, icb->name_len);
+        for (int i = 0; i < plan->nr_probes; i++) {
+            icb = ind_icb[plan->probes[i]];
+            RedisModule_ReplyWithStringBuffer(ctx, icb->name_str, icb->name_len);
+        }
+    } else {
+        RedisModule_ReplyWithArray(ctx, 0);
+    }
+
+    RedisModule_ReplyWithDouble(ctx, plan->cost);
+    RedisModule_ReplyWithDouble(ctx, plan->est_rows);
+    RedisModule_ReplyWithDouble(ctx, plan->traverse_cost);
+}
+
 int SelvaFindIndex_Traverse(
         struct RedisModuleCtx *ctx,
         struct SelvaHierarchy *hierarchy,
         struct SelvaFindIndexControlBlock *icb,
         SelvaHierarchyNodeCallback node_cb,
         void * node_arg) {
-    if (icb->flags.ordered) {
-        struct SVectorIterator it;
-        const struct TraversalOrderItem *item;
+    struct SelvaHierarchyNode **nodes;
+    size_t len;
 
-        SVector_ForeachBegin(&it, &icb->res.ord);
-        while ((item = SVector_Foreach(&it))) {
-            struct SelvaHierarchyNode *node;
+    SelvaFindIndexICB_DenseUpdate(icb);
+    nodes = icb->dense.nodes;
+    len = icb->dense.len;
 
-            node = SelvaHierarchy_FindNode(hierarchy, item->node_id);
-            if (node) {
-                /*
-                 * We should be breaking here if requested. This should only
-                 * happen in case the index order is the same as requested
-                 * order. Otherwise find shouldn't return 1 but use OrderItem
-                 * subr.
-                 */
-                if (node_cb(ctx, hierarchy, node, node_arg)) {
-                    break;
-                }
+    if (icb->flags.ordered) {
+        for (size_t i = 0; i < len; i++) {
+            /*
+             * We should be breaking here if requested. This should only
+             * happen in case the index order is the same as requested
+             * order. Otherwise find shouldn't return 1 but use OrderItem
+             * subr.
+             */
+            if (node_cb(ctx, hierarchy, nodes[i], node_arg)) {
+                break;
             }
         }
     } else {
-        struct SelvaSetElement *el;
+        for (size_t i = 0; i < len; i++) {
+            /*
+             * Note that we don't break here on limit because limit and
+             * unordered indexing are incompatible. The reason is that we
+             * can't guarantee that the returned nodes would be the exactly
+             * same with and without indexing. However, find might still
+             * sort this response using the OrderItem subrs.
+             */
+            (void)node_cb(ctx, hierarchy, nodes[i], node_arg);
+        }
+    }
 
-        SELVA_SET_NODEID_FOREACH(el, &icb->res.set) {
-            struct SelvaHierarchyNode *node;
+    return 0;
+}
 
-            node = SelvaHierarchy_FindNode(hierarchy, el->value_nodeId);
-            if (node) {
-                /*
-                 * Note that we don't break here on limit because limit and
-                 * unordered indexing are incompatible. The reason is that we
-                 * can't guarantee that the returned nodes would be the exactly
-                 * same with and without indexing. However, find might still
-                 * sort this response using the OrderItem subrs.
-                 */
-                (void)node_cb(ctx, hierarchy, node, node_arg);
+int SelvaFindIndex_TraversePlan(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaFindIndexControlBlock *ind_icb[],
+        const struct SelvaFindIndexPlan *plan,
+        SelvaHierarchyNodeCallback node_cb,
+        void *node_arg) {
+    struct SelvaFindIndexControlBlock *icb;
+    struct SelvaHierarchyNode **nodes;
+    size_t len;
+
+    if (plan->ind_select < 0) {
+        return SELVA_EINVAL;
+    }
+
+    icb = ind_icb[plan->ind_select];
+    if (plan->nr_probes == 0) {
+        return SelvaFindIndex_Traverse(ctx, hierarchy, icb, node_cb, node_arg);
+    }
+
+    SelvaFindIndexICB_DenseUpdate(icb);
+    nodes = icb->dense.nodes;
+    len = icb->dense.len;
+
+    for (size_t i = 0; i < len; i++) {
+        struct SelvaHierarchyNode *node = nodes[i];
+        int n;
+
+        for (n = 0; n < plan->nr_probes; n++) {
+            if (!SelvaFindIndexICB_ResHas(ind_icb[plan->probes[n]], node)) {
+                break;
             }
         }
+        if (n < plan->nr_probes) {
+            continue;
+        }
+
+        /* See SelvaFindIndex_Traverse() for breaking. */
+        if (node_cb(ctx, hierarchy, node, node_arg) && icb->flags.ordered) {
+            break;
+        }
     }
 
     return 0;
@@ -1037,11 +1367,11 @@ static int list_index(RedisModuleCtx *ctx, struct SelvaObject *obj) {
             const struct SelvaFindIndexControlBlock *icb = (const struct SelvaFindIndexControlBlock *)p;
 
             /*
-             * index_name, [ take, total, ind_take, ind_size ]
+             * index_name, [ take, total, ind_take, ind_size, valid_pct ]
              */
             n++;
             RedisModule_ReplyWithStringBuffer(ctx, icb->name_str, icb->name_len);
-            RedisModule_ReplyWithArray(ctx, 4);
+            RedisModule_ReplyWithArray(ctx, 5);
             RedisModule_ReplyWithDouble(ctx, (double)icb->find_acc.take_max_ave);
             RedisModule_ReplyWithDouble(ctx, (double)icb->find_acc.tot_max_ave);
             RedisModule_ReplyWithDouble(ctx, (double)icb->find_acc.ind_take_max_ave);
@@ -1052,6 +1382,7 @@ static int list_index(RedisModuleCtx *ctx, struct SelvaObject *obj) {
             } else {
                 RedisModule_ReplyWithDouble(ctx, (double)SelvaFindIndex_IcbCard(icb));
             }
+            RedisModule_ReplyWithDouble(ctx, icb_valid_pct(icb));
         } else if (type == SELVA_OBJECT_OBJECT) {
             n += list_index(ctx, (struct SelvaObject *)p);
         } else {
@@ -8,9 +8,11 @@
 
 /*
  * Manage ICB map: name -> ICB.
+ * Manage ICB result sets.
  */
 
 struct SelvaHierarchy;
+struct SelvaHierarchyNode;
 
 /**
  * Sorting descriptor for ordered index.
@@ -59,9 +61,9 @@ struct SelvaFindIndexControlBlock {
         unsigned active : 1;
         /**
          * The indexing result `res` is considered valid.
-         * This can go 0 even when we are indexing if the `res.set` SelvaSet
-         * needs to be refreshed after a `SELVA_SUBSCRIPTION_FLAG_CL_HIERARCHY`
-         * event was received.
+         * This can go 0 even when we are indexing if the `res` needs to be
+         * refreshed after a `SELVA_SUBSCRIPTION_FLAG_CL_HIERARCHY` event was
+         * received for a change that may have changed the traversal.
          */
         unsigned valid : 1;
         /**
@@ -102,13 +104,24 @@ struct SelvaFindIndexControlBlock {
         float take_max_ave; /*!< Average of `take_max` over time. */
 
         /**
-         * The number of nodes taken from the `res` SelvaSet when the index is valid.
+         * The number of nodes taken from `res` when the index is valid.
          * This is updated when the index is valid during a find.
          */
         float ind_take_max;
         float ind_take_max_ave; /*!< Average of `ind_take` over time. */
     } find_acc;
 
+    /**
+     * Index validity time accounting.
+     * Used to report how large portion of the time an active index has been
+     * valid.
+     */
+    struct {
+        long long active_since; /*!< The time the index was started. */
+        long long valid_since; /*!< The time the index last became valid. */
+        long long valid_ms; /*!< Time the index has been valid since the start, excluding the current valid period. */
+    } valid_acc;
+
     /**
      * Hint popularity counter.
      */
@@ -131,19 +144,45 @@ struct SelvaFindIndexControlBlock {
     /**
      * Result set of the indexing clause.
      * Only valid if `flags.valid` is set.
-     * The elements in this set are Selva_NodeIds.
+     * The results are kept as node pointers. This is safe because every node
+     * in the result is marked with the subscription marker of the index, and
+     * a node can't be deleted without clearing its markers first, which
+     * either removes the node from `res` or invalidates the whole index.
      */
     union {
         /**
          * Unordered indexing result.
+         * Node pointers ordered by node_id.
          */
-        struct SelvaSet set;
-        /**
-         * Ordered indexing result.
-         */
-        struct SVector ord;
+        struct SVector set;
+        struct {
+            /**
+             * Ordered indexing result.
+             */
+            struct SVector ord;
+            /**
+             * The same items as in `ord` ordered by node_id.
+             * This is used to find the current position of a node in `ord`
+             * so that it can be removed or repositioned without rebuilding
+             * the index.
+             */
+            struct SVector ord_map;
+        };
     } res;
 
+    /**
+     * A dense array of the node pointers in `res`.
+     * The array is in the same order as `res`. It's rebuilt lazily by
+     * the next indexed find after `res` has been changed, so the finds
+     * served from a stable index can just iterate over a plain array.
+     */
+    struct {
+        struct SelvaHierarchyNode **nodes;
+        size_t len; /*!< Number of nodes in `nodes`. */
+        size_t size; /*!< Allocated size of `nodes` in elements. */
+        int dirty; /*!< Set if `res` has changed since `nodes` was built. */
+    } dense;
+
     /**
      * Length of name_str.
      */
@@ -182,4 +221,35 @@ int SelvaFindIndexICB_Set(struct SelvaHierarchy *hierarchy, const char *name_str
  */
 int SelvaFindIndexICB_Del(struct SelvaHierarchy *hierarchy, const struct SelvaFindIndexControlBlock *icb);
 
+/**
+ * Initialize the result set `res` of an ICB.
+ * The set is created as ordered if `flags.ordered` is set.
+ */
+void SelvaFindIndexICB_ResInit(struct SelvaFindIndexControlBlock *icb);
+
+/**
+ * Destroy the result set `res` and the dense array of an ICB.
+ */
+void SelvaFindIndexICB_ResDestroy(struct SelvaFindIndexControlBlock *icb);
+
+/**
+ * Add a node to the result set or update its position in an ordered set.
+ */
+int SelvaFindIndexICB_ResAdd(struct SelvaFindIndexControlBlock *icb, struct SelvaHierarchyNode *node);
+
+/**
+ * Remove a node from the result set if it's there.
+ */
+void SelvaFindIndexICB_ResDel(struct SelvaFindIndexControlBlock *icb, struct SelvaHierarchyNode *node);
+
+/**
+ * Check whether a node is in the result set.
+ */
+int SelvaFindIndexICB_ResHas(struct SelvaFindIndexControlBlock *icb, struct SelvaHierarchyNode *node);
+
+/**
+ * Rebuild the dense array of node pointers if `res` has changed.
+ */
+void SelvaFindIndexICB_DenseUpdate(struct SelvaFindIndexControlBlock *icb);
+
 #endif /* _FIND_INDEX_ICB_ */
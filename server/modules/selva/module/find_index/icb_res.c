@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#include <stddef.h>
+#include <string.h>
+#include "redismodule.h"
+#include "ptag.h"
+#include "svector.h"
+#include "selva.h"
+#include "selva_memory.h"
+#include "traversal.h"
+#include "hierarchy.h"
+#include "icb.h"
+
+/**
+ * Compare the node_ids of two TraversalOrderItems.
+ * Used for the `res.ord_map` of an ordered index.
+ */
+static int ord_map_compar(const void ** restrict a_raw, const void ** restrict b_raw) {
+    const struct TraversalOrderItem *a = *(const struct TraversalOrderItem **)a_raw;
+    const struct TraversalOrderItem *b = *(const struct TraversalOrderItem **)b_raw;
+
+    return memcmp(a->node_id, b->node_id, SELVA_NODE_ID_SIZE);
+}
+
+/**
+ * Compare the node_ids of two nodes.
+ * Used for the `res.set` of an unordered index.
+ */
+static int node_id_compar(const void ** restrict a_raw, const void ** restrict b_raw) {
+    const struct SelvaHierarchyNode *a = *(const struct SelvaHierarchyNode **)a_raw;
+    const struct SelvaHierarchyNode *b = *(const struct SelvaHierarchyNode **)b_raw;
+    Selva_NodeId a_id;
+    Selva_NodeId b_id;
+
+    SelvaHierarchy_GetNodeId(a_id, a);
+    SelvaHierarchy_GetNodeId(b_id, b);
+
+    return memcmp(a_id, b_id, SELVA_NODE_ID_SIZE);
+}
+
+void SelvaFindIndexICB_ResInit(struct SelvaFindIndexControlBlock *icb) {
+    if (icb->flags.ordered) {
+        const size_t initial_len = (size_t)icb->find_acc.take_max_ave;
+
+        SelvaTraversalOrder_InitOrderResult(&icb->res.ord, icb->traversal.sort.order, initial_len);
+        SVector_Init(&icb->res.ord_map, (initial_len > 0) ? initial_len : HIERARCHY_EXPECTED_RESP_LEN, ord_map_compar);
+    } else {
+        SVector_Init(&icb->res.set, (size_t)icb->find_acc.take_max_ave, node_id_compar);
+    }
+
+    icb->dense.dirty = 1;
+}
+
+void SelvaFindIndexICB_ResDestroy(struct SelvaFindIndexControlBlock *icb) {
+    if (icb->flags.ordered) {
+        SVector_Destroy(&icb->res.ord_map);
+        /* ctx is not needed here as it was not used when the items were created. */
+        SelvaTraversalOrder_DestroyOrderResult(NULL, &icb->res.ord);
+    } else {
+        SVector_Destroy(&icb->res.set);
+    }
+
+    selva_arena_free(SELVA_ARENA_FIND_INDEX, icb->dense.nodes);
+    memset(&icb->dense, 0, sizeof(icb->dense));
+}
+
+int SelvaFindIndexICB_ResAdd(struct SelvaFindIndexControlBlock *icb, struct SelvaHierarchyNode *node) {
+    if (icb->flags.ordered) {
+        struct TraversalOrderItem *item;
+        struct TraversalOrderItem *old_item;
+        /*
+         * Supporting lang here wouldn't add anything because we'd need to index
+         * each lang separately anyway.
+         */
+        RedisModuleString *lang = NULL;
+
+        item = SelvaTraversalOrder_CreateNodeOrderItem(NULL, lang, node, icb->traversal.sort.order_field);
+        if (!item) {
+            return SELVA_ENOMEM;
+        }
+
+        old_item = SVector_Search(&icb->res.ord_map, item);
+        if (old_item) {
+            if (!icb->res.ord.vec_compar((const void **)&old_item, (const void **)&item)) {
+                /* The position of the node didn't change. */
+                SelvaTraversalOrder_DestroyOrderItem(NULL, item);
+                return 0;
+            }
+
+            /* The sorting key changed; Remove and reinsert. */
+            SVector_Remove(&icb->res.ord, old_item);
+            SVector_Remove(&icb->res.ord_map, old_item);
+            SelvaTraversalOrder_DestroyOrderItem(NULL, old_item);
+        }
+
+        SVector_Insert(&icb->res.ord, item);
+        SVector_Insert(&icb->res.ord_map, item);
+    } else {
+        if (SVector_InsertFast(&icb->res.set, node)) {
+            /* Already in the index. */
+            return 0;
+        }
+    }
+
+    icb->dense.dirty = 1;
+
+    return 0;
+}
+
+void SelvaFindIndexICB_ResDel(struct SelvaFindIndexControlBlock *icb, struct SelvaHierarchyNode *node) {
+    if (icb->flags.ordered) {
+        struct TraversalOrderItem key;
+        struct TraversalOrderItem *item;
+
+        SelvaHierarchy_GetNodeId(key.node_id, node);
+        item = SVector_Remove(&icb->res.ord_map, &key);
+        if (item) {
+            SVector_Remove(&icb->res.ord, item);
+            SelvaTraversalOrder_DestroyOrderItem(NULL, item);
+            icb->dense.dirty = 1;
+        }
+    } else {
+        if (SVector_Remove(&icb->res.set, node)) {
+            icb->dense.dirty = 1;
+        }
+    }
+}
+
+int SelvaFindIndexICB_ResHas(struct SelvaFindIndexControlBlock *icb, struct SelvaHierarchyNode *node) {
+    if (icb->flags.ordered) {
+        struct TraversalOrderItem key;
+
+        SelvaHierarchy_GetNodeId(key.node_id, node);
+        return !!SVector_Search(&icb->res.ord_map, &key);
+    } else {
+        return !!SVector_Search(&icb->res.set, node);
+    }
+}
+
+void SelvaFindIndexICB_DenseUpdate(struct SelvaFindIndexControlBlock *icb) {
+    const SVector *vec = icb->flags.ordered ? &icb->res.ord : &icb->res.set;
+    struct SVectorIterator it;
+    void *p;
+    size_t i = 0;
+
+    if (!icb->dense.dirty) {
+        return;
+    }
+
+    if (SVector_Size(vec) > icb->dense.size) {
+        icb->dense.size = SVector_Size(vec);
+        icb->dense.nodes = selva_arena_realloc(SELVA_ARENA_FIND_INDEX, icb->dense.nodes, icb->dense.size * sizeof(struct SelvaHierarchyNode *));
+    }
+
+    SVector_ForeachBegin(&it, vec);
+    while ((p = SVector_Foreach(&it))) {
+        icb->dense.nodes[i++] = icb->flags.ordered
+            ? PTAG_GETP(((struct TraversalOrderItem *)p)->tagp)
+            : p;
+    }
+
+    icb->dense.len = i;
+    icb->dense.dirty = 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#include <stddef.h>
+#include "redismodule.h"
+#include "selva.h"
+#include "selva_onload.h"
+#include "find_profile.h"
+
+struct SelvaFindProfile *selva_find_profile;
+
+/**
+ * A context for executing the profiled commands.
+ * The reply of the command must be captured to measure its size.
+ */
+static RedisModuleCtx *find_profile_ctx;
+
+static void reply_with_profile(RedisModuleCtx *ctx, const struct SelvaFindProfile *profile, size_t bytes) {
+    RedisModule_ReplyWithArray(ctx, 16);
+
+    RedisModule_ReplyWithSimpleString(ctx, "visited");
+    RedisModule_ReplyWithLongLong(ctx, (long long)profile->visited);
+    RedisModule_ReplyWithSimpleString(ctx, "taken");
+    RedisModule_ReplyWithLongLong(ctx, (long long)profile->taken);
+    RedisModule_ReplyWithSimpleString(ctx, "restored");
+    RedisModule_ReplyWithLongLong(ctx, (long long)profile->restored);
+    RedisModule_ReplyWithSimpleString(ctx, "indexed");
+    RedisModule_ReplyWithLongLong(ctx, (long long)profile->indexed);
+    RedisModule_ReplyWithSimpleString(ctx, "filter_us");
+    RedisModule_ReplyWithDouble(ctx, (double)profile->filter_ns / 1e3);
+    RedisModule_ReplyWithSimpleString(ctx, "sort_us");
+    RedisModule_ReplyWithDouble(ctx, (double)profile->sort_ns / 1e3);
+    RedisModule_ReplyWithSimpleString(ctx, "reply_us");
+    RedisModule_ReplyWithDouble(ctx, (double)profile->reply_ns / 1e3);
+    RedisModule_ReplyWithSimpleString(ctx, "bytes");
+    RedisModule_ReplyWithLongLong(ctx, (long long)bytes);
+}
+
+int SelvaFindProfile_Reply(
+        RedisModuleCtx *ctx,
+        const char *cmd,
+        RedisModuleString **argv,
+        int argc,
+        int profile_arg) {
+    RedisModuleString **cmd_argv;
+    struct SelvaFindProfile profile = { 0 };
+    RedisModuleCallReply *reply;
+    size_t bytes;
+    int n = 0;
+
+    if (selva_find_profile) {
+        return replyWithSelvaErrorf(ctx, SELVA_EINVAL, "nested profile");
+    }
+
+    cmd_argv = RedisModule_PoolAlloc(ctx, argc * sizeof(RedisModuleString *));
+    for (int i = 1; i < argc; i++) {
+        if (i != profile_arg) {
+            cmd_argv[n++] = argv[i];
+        }
+    }
+
+    RedisModule_SelectDb(find_profile_ctx, RedisModule_GetSelectedDb(ctx));
+    selva_find_profile = &profile;
+    reply = RedisModule_Call(find_profile_ctx, cmd, "v", cmd_argv, (size_t)n);
+    selva_find_profile = NULL;
+    if (!reply) {
+        return replyWithSelvaErrorf(ctx, SELVA_EGENERAL, "Failed to execute the command");
+    }
+
+    if (RedisModule_CallReplyType(reply) == REDISMODULE_REPLY_ERROR) {
+        RedisModule_ReplyWithCallReply(ctx, reply);
+    } else {
+        (void)RedisModule_CallReplyProto(reply, &bytes);
+
+        RedisModule_ReplyWithArray(ctx, 2);
+        RedisModule_ReplyWithCallReply(ctx, reply);
+        reply_with_profile(ctx, &profile, bytes);
+    }
+
+    RedisModule_FreeCallReply(reply);
+
+    return REDISMODULE_OK;
+}
+
+static int FindProfile_OnLoad(RedisModuleCtx *ctx) {
+    find_profile_ctx = RedisModule_GetDetachedThreadSafeContext(ctx);
+    if (!find_profile_ctx) {
+        return REDISMODULE_ERR;
+    }
+
+    return REDISMODULE_OK;
+}
+SELVA_ONLOAD(FindProfile_OnLoad);
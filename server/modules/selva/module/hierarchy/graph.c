@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#include <stddef.h>
+#include <string.h>
+#include "redismodule.h"
+#include "selva.h"
+#include "arg_parser.h"
+#include "hierarchy.h"
+#include "rpn.h"
+#include "selva_onload.h"
+#include "svector.h"
+
+struct khop_args {
+    RedisModuleCtx *ctx;
+    struct SelvaHierarchyNode *head;
+    struct rpn_ctx *rpn_ctx;
+    const struct rpn_expression *filter;
+    ssize_t limit; /*!< Stop after this many matching nodes; -1 = no limit. */
+    SVector *nodes; /*!< Collect the matching nodes here if not NULL. */
+    long long nr_nodes; /*!< Number of matching nodes found. */
+    enum rpn_error rpn_err; /*!< Set if the filter failed and the traversal was stopped. */
+};
+
+static int khop_node_cb(
+        struct RedisModuleCtx *ctx __unused,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyNode *node,
+        void *arg) {
+    struct khop_args *args = (struct khop_args *)arg;
+    Selva_NodeId node_id;
+
+    if (node == args->head) {
+        return 0;
+    }
+
+    SelvaHierarchy_GetNodeId(node_id, node);
+
+    if (args->filter) {
+        int take = 0;
+        enum rpn_error rpn_err;
+
+        rpn_set_reg(args->rpn_ctx, 0, node_id, SELVA_NODE_ID_SIZE, RPN_SET_REG_FLAG_IS_NAN);
+        rpn_set_hierarchy_node(args->rpn_ctx, hierarchy, node);
+        rpn_set_obj(args->rpn_ctx, SelvaHierarchy_GetNodeObject(node));
+        rpn_err = rpn_bool(args->ctx, args->rpn_ctx, args->filter, &take);
+        if (rpn_err) {
+            SELVA_LOG(SELVA_LOGL_ERR, "Expression failed (node: \"%.*s\"): \"%s\"\n",
+                      (int)SELVA_NODE_ID_SIZE, node_id,
+                      rpn_str_error[rpn_err]);
+            args->rpn_err = rpn_err;
+            return 1;
+        }
+        if (!take) {
+            return 0;
+        }
+    }
+
+    if (args->nodes) {
+        SVector_Insert(args->nodes, node);
+    }
+    args->nr_nodes++;
+
+    return args->limit != -1 && args->nr_nodes >= args->limit;
+}
+
+/**
+ * Parse the optional edge_filter argument.
+ * @returns 0 if the option was found; SELVA_ENOENT if the option wasn't given;
+ *          Otherwise a selva error.
+ */
+static int parse_edge_filter(
+        RedisModuleString *txt,
+        RedisModuleString *val,
+        struct rpn_ctx **edge_filter_ctx,
+        struct rpn_expression **edge_filter) {
+    const char *expr_str;
+    int err;
+
+    err = SelvaArgParser_StrOpt(&expr_str, "edge_filter", txt, val);
+    if (err) {
+        return err;
+    }
+
+    *edge_filter_ctx = rpn_init(1);
+    *edge_filter = rpn_compile(expr_str);
+    if (!*edge_filter) {
+        return SELVA_RPN_ECOMP;
+    }
+
+    return 0;
+}
+
+/*
+ * Find the shortest path between two nodes following edge fields.
+ *
+ * SELVA.HIERARCHY.path
+ * REDIS_KEY
+ * ["edge_filter" expr]     Expression to decide whether an edge can be used
+ * SRC_NODE_ID
+ * DST_NODE_ID
+ * FIELD_NAMES              Edge field names separated by newlines
+ *
+ * Reply with the nodeIds of the path from SRC_NODE_ID to DST_NODE_ID; An
+ * empty array if there is no path.
+ */
+static int SelvaHierarchy_PathCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    RedisModule_AutoMemory(ctx);
+    int err;
+
+    const int ARGV_REDIS_KEY = 1;
+    int ARGV_EDGE_FILTER_TXT = 2;
+    int ARGV_EDGE_FILTER_VAL = 3;
+    int ARGV_SRC = 2;
+    int ARGV_DST = 3;
+    int ARGV_FIELDS = 4;
+#define SHIFT_ARGS(i) \
+    ARGV_EDGE_FILTER_TXT += i; \
+    ARGV_EDGE_FILTER_VAL += i; \
+    ARGV_SRC += i; \
+    ARGV_DST += i; \
+    ARGV_FIELDS += i
+
+    __auto_free_rpn_ctx struct rpn_ctx *edge_filter_ctx = NULL;
+    __auto_free_rpn_expression struct rpn_expression *edge_filter = NULL;
+    if (argc > ARGV_EDGE_FILTER_VAL) {
+        err = parse_edge_filter(argv[ARGV_EDGE_FILTER_TXT], argv[ARGV_EDGE_FILTER_VAL], &edge_filter_ctx, &edge_filter);
+        if (err == 0) {
+            SHIFT_ARGS(2);
+        } else if (err != SELVA_ENOENT) {
+            return replyWithSelvaErrorf(ctx, err, "edge_filter");
+        }
+    }
+
+    if (argc != ARGV_FIELDS + 1) {
+        return RedisModule_WrongArity(ctx);
+    }
+#undef SHIFT_ARGS
+
+    SelvaHierarchy *hierarchy = SelvaModify_OpenHierarchy(ctx, argv[ARGV_REDIS_KEY], REDISMODULE_READ);
+    if (!hierarchy) {
+        return REDISMODULE_OK;
+    }
+
+    Selva_NodeId src_id;
+    Selva_NodeId dst_id;
+    const RedisModuleString *fields = argv[ARGV_FIELDS];
+    TO_STR(fields);
+    SVECTOR_AUTOFREE(path);
+
+    err = Selva_RMString2NodeId(src_id, argv[ARGV_SRC]);
+    if (err) {
+        return replyWithSelvaErrorf(ctx, err, "src_node_id");
+    }
+    err = Selva_RMString2NodeId(dst_id, argv[ARGV_DST]);
+    if (err) {
+        return replyWithSelvaErrorf(ctx, err, "dst_node_id");
+    }
+    SVector_Init(&path, 0, NULL);
+
+    err = SelvaHierarchy_EdgeShortestPath(ctx, hierarchy, src_id, dst_id, fields_str, fields_len, edge_filter_ctx, edge_filter, &path);
+    if (err) {
+        return replyWithSelvaErrorf(ctx, err, "Path search failed");
+    }
+
+    struct SVectorIterator it;
+    const struct SelvaHierarchyNode *node;
+
+    RedisModule_ReplyWithArray(ctx, SVector_Size(&path));
+    SVector_ForeachBegin(&it, &path);
+    while ((node = SVector_Foreach(&it))) {
+        Selva_NodeId node_id;
+
+        SelvaHierarchy_GetNodeId(node_id, node);
+        RedisModule_ReplyWithStringBuffer(ctx, node_id, Selva_NodeIdLen(node_id));
+    }
+
+    return REDISMODULE_OK;
+}
+
+/*
+ * Find nodes within k hops following edge fields.
+ *
+ * SELVA.HIERARCHY.khop
+ * REDIS_KEY
+ * ["edge_filter" expr]     Expression to decide whether an edge can be followed
+ * ["limit" 1234]           Stop after finding this many matching nodes
+ * ["count"]                Reply with the number of nodes instead of the nodeIds
+ * NODE_ID                  The node to start from
+ * DEPTH                    Maximum number of hops
+ * FIELD_NAMES              Edge field names separated by newlines
+ * [expression]             RPN filter expression
+ * [args...]                Register arguments for the RPN filter
+ *
+ * Reply with the nodeIds of the matching nodes in BFS order, excluding
+ * NODE_ID itself. The nodes are collected before replying so that a failing
+ * filter or traversal can be replied as an error instead of a truncated result.
+ */
+static int SelvaHierarchy_KHopCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    RedisModule_AutoMemory(ctx);
+    int err;
+
+    const int ARGV_REDIS_KEY = 1;
+    int ARGV_EDGE_FILTER_TXT = 2;
+    int ARGV_EDGE_FILTER_VAL = 3;
+    int ARGV_LIMIT_TXT = 2;
+    int ARGV_LIMIT_NUM = 3;
+    int ARGV_COUNT_TXT = 2;
+    int ARGV_NODE_ID = 2;
+    int ARGV_DEPTH = 3;
+    int ARGV_FIELDS = 4;
+    int ARGV_FILTER_EXPR = 5;
+    int ARGV_FILTER_ARGS = 6;
+#define SHIFT_ARGS(i) \
+    ARGV_EDGE_FILTER_TXT += i; \
+    ARGV_EDGE_FILTER_VAL += i; \
+    ARGV_LIMIT_TXT += i; \
+    ARGV_LIMIT_NUM += i; \
+    ARGV_COUNT_TXT += i; \
+    ARGV_NODE_ID += i; \
+    ARGV_DEPTH += i; \
+    ARGV_FIELDS += i; \
+    ARGV_FILTER_EXPR += i; \
+    ARGV_FILTER_ARGS += i
+
+    __auto_free_rpn_ctx struct rpn_ctx *edge_filter_ctx = NULL;
+    __auto_free_rpn_expression struct rpn_expression *edge_filter = NULL;
+    if (argc > ARGV_EDGE_FILTER_VAL) {
+        err = parse_edge_filter(argv[ARGV_EDGE_FILTER_TXT], argv[ARGV_EDGE_FILTER_VAL], &edge_filter_ctx, &edge_filter);
+        if (err == 0) {
+            SHIFT_ARGS(2);
+        } else if (err != SELVA_ENOENT) {
+            return replyWithSelvaErrorf(ctx, err, "edge_filter");
+        }
+    }
+
+    ssize_t limit = -1;
+    if (argc > ARGV_LIMIT_NUM) {
+        err = SelvaArgParser_IntOpt(&limit, "limit", argv[ARGV_LIMIT_TXT], argv[ARGV_LIMIT_NUM]);
+        if (err == 0) {
+            SHIFT_ARGS(2);
+        } else if (err != SELVA_ENOENT) {
+            return replyWithSelvaErrorf(ctx, err, "limit");
+        }
+    }
+
+    int reply_ids = 1;
+    if (argc > ARGV_COUNT_TXT) {
+        const RedisModuleString *count_txt = argv[ARGV_COUNT_TXT];
+        TO_STR(count_txt);
+
+        if (count_txt_len == sizeof("count") - 1 && !memcmp(count_txt_str, "count", count_txt_len)) {
+            reply_ids = 0;
+            SHIFT_ARGS(1);
+        }
+    }
+
+    if (argc <= ARGV_FIELDS) {
+        return RedisModule_WrongArity(ctx);
+    }
+#undef SHIFT_ARGS
+
+    long long depth;
+    if (RedisModule_StringToLongLong(argv[ARGV_DEPTH], &depth) != REDISMODULE_OK || depth < 0) {
+        return replyWithSelvaErrorf(ctx, SELVA_EINVAL, "depth");
+    }
+
+    /*
+     * Prepare the filter expression if given.
+     */
+    __auto_free_rpn_ctx struct rpn_ctx *rpn_ctx = NULL;
+    __auto_free_rpn_expression struct rpn_expression *filter_expression = NULL;
+    if (argc > ARGV_FILTER_EXPR) {
+        const int nr_reg = argc - ARGV_FILTER_ARGS + 2;
+
+        rpn_ctx = rpn_init(nr_reg);
+        filter_expression = rpn_compile(RedisModule_StringPtrLen(argv[ARGV_FILTER_EXPR], NULL));
+        if (!filter_expression) {
+            return replyWithSelvaErrorf(ctx, SELVA_RPN_ECOMP, "Failed to compile the filter expression");
+        }
+
+        for (int i = ARGV_FILTER_ARGS; i < argc; i++) {
+            /* reg[0] is reserved for the current nodeId */
+            const size_t reg_i = i - ARGV_FILTER_ARGS + 1;
+            size_t str_len;
+            const char *str = RedisModule_StringPtrLen(argv[i], &str_len);
+
+            rpn_set_reg(rpn_ctx, reg_i, str, str_len + 1, 0);
+        }
+    }
+
+    SelvaHierarchy *hierarchy = SelvaModify_OpenHierarchy(ctx, argv[ARGV_REDIS_KEY], REDISMODULE_READ);
+    if (!hierarchy) {
+        return REDISMODULE_OK;
+    }
+
+    Selva_NodeId node_id;
+    const RedisModuleString *fields = argv[ARGV_FIELDS];
+    TO_STR(fields);
+    SVECTOR_AUTOFREE(nodes);
+
+    err = Selva_RMString2NodeId(node_id, argv[ARGV_NODE_ID]);
+    if (err) {
+        return replyWithSelvaErrorf(ctx, err, "node_id");
+    }
+    if (reply_ids) {
+        SVector_Init(&nodes, 0, NULL);
+    }
+
+    struct khop_args args = {
+        .ctx = ctx,
+        .head = SelvaHierarchy_FindNode(hierarchy, node_id),
+        .rpn_ctx = rpn_ctx,
+        .filter = filter_expression,
+        .limit = limit,
+        .nodes = reply_ids ? &nodes : NULL,
+        .nr_nodes = 0,
+        .rpn_err = RPN_ERR_OK,
+    };
+    const struct SelvaHierarchyCallback cb = {
+        .node_cb = khop_node_cb,
+        .node_arg = &args,
+    };
+
+    if (!args.head) {
+        return replyWithSelvaError(ctx, SELVA_HIERARCHY_ENOENT);
+    }
+    if (limit == 0) {
+        return reply_ids ? RedisModule_ReplyWithArray(ctx, 0) : RedisModule_ReplyWithLongLong(ctx, 0);
+    }
+
+    err = SelvaHierarchy_TraverseEdgeFieldsBfs(ctx, hierarchy, node_id, fields_str, fields_len, depth, edge_filter_ctx, edge_filter, &cb);
+    if (err) {
+        return replyWithSelvaErrorf(ctx, err, "khop traversal failed");
+    }
+    if (args.rpn_err) {
+        return replyWithSelvaErrorf(ctx, SELVA_EINVAL, "Expression failed: %s", rpn_str_error[args.rpn_err]);
+    }
+
+    if (reply_ids) {
+        struct SVectorIterator it;
+        const struct SelvaHierarchyNode *node;
+
+        RedisModule_ReplyWithArray(ctx, SVector_Size(&nodes));
+        SVector_ForeachBegin(&it, &nodes);
+        while ((node = SVector_Foreach(&it))) {
+            Selva_NodeId nid;
+
+            SelvaHierarchy_GetNodeId(nid, node);
+            RedisModule_ReplyWithStringBuffer(ctx, nid, Selva_NodeIdLen(nid));
+        }
+    } else {
+        RedisModule_ReplyWithLongLong(ctx, args.nr_nodes);
+    }
+
+    return REDISMODULE_OK;
+}
+
+static int Graph_OnLoad(RedisModuleCtx *ctx) {
+    if (RedisModule_CreateCommand(ctx, "selva.hierarchy.path", SelvaHierarchy_PathCommand, "readonly", 1, 1, 1) == REDISMODULE_ERR ||
+        RedisModule_CreateCommand(ctx, "selva.hierarchy.khop", SelvaHierarchy_KHopCommand, "readonly", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    return REDISMODULE_OK;
+}
+SELVA_ONLOAD(Graph_OnLoad);
@@ -4,12 +4,14 @@
  */
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 #include "redismodule.h"
 #include "jemalloc.h"
 #include "auto_free.h"
@@ -21,10 +23,14 @@
 #include "modify.h"
 #include "rpn.h"
 #include "config.h"
+#include "modinfo.h"
+#include "selva_memory.h"
 #include "selva_object.h"
 #include "selva_onload.h"
 #include "selva_trace.h"
+#include "find_cache.h"
 #include "find_index.h"
+#include "inherit.h"
 #include "timestamp.h"
 #include "selva_set.h"
 #include "subscriptions.h"
@@ -77,6 +83,18 @@ typedef struct SelvaHierarchyNode {
     struct SelvaHierarchyMetadata metadata;
     SVector parents;
     SVector children;
+    /**
+     * Ancestor reachability label.
+     * The node is a descendant of every node whose [lo, hi) interval contains
+     * lo of this node.
+     */
+    struct {
+        uint64_t lo;
+        uint64_t hi;
+        uint64_t next; /*!< The free label space for new children is [next, hi). */
+        struct SelvaHierarchyNode *parent; /*!< The parent the label was allocated from. */
+        int exception; /*!< The node has parents not covered by the label. */
+    } reach;
     RB_ENTRY(SelvaHierarchyNode) _index_entry;
 } SelvaHierarchyNode;
 
@@ -129,6 +147,7 @@ static void SelvaModify_DestroyNode(
         RedisModuleCtx *ctx,
         SelvaHierarchy *hierarchy,
         SelvaHierarchyNode *node);
+static void free_node(SelvaHierarchy *hierarchy, SelvaHierarchyNode *node);
 static int removeRelationships(
         RedisModuleCtx *ctx,
         SelvaHierarchy *hierarchy,
@@ -138,6 +157,8 @@ RB_PROTOTYPE_STATIC(hierarchy_index_tree, SelvaHierarchyNode, _index_entry, Selv
 static int detach_subtree(RedisModuleCtx *ctx, SelvaHierarchy *hierarchy, struct SelvaHierarchyNode *node, enum SelvaHierarchyDetachedType type);
 static int restore_subtree(SelvaHierarchy *hierarchy, const Selva_NodeId id);
 static void auto_compress_proc(RedisModuleCtx *ctx, void *data);
+static void lazy_free_proc(RedisModuleCtx *ctx, void *data);
+static void drop_resumables(struct SelvaHierarchy *hierarchy);
 
 /* Node metadata constructors. */
 SET_DECLARE(selva_HMCtor, SelvaHierarchyMetadataConstructorHook);
@@ -150,8 +171,11 @@ static RedisModuleType *HierarchySubtreeType;
 
 SELVA_TRACE_HANDLE(find_inmem);
 SELVA_TRACE_HANDLE(find_detached);
+SELVA_TRACE_HANDLE(find_inmem_batch);
 SELVA_TRACE_HANDLE(restore_subtree);
 SELVA_TRACE_HANDLE(auto_compress_proc);
+SELVA_TRACE_HANDLE(lazy_free_proc);
+SELVA_TRACE_HANDLE(reach_relabel);
 
 /**
  * A pointer to the hierarchy subtree being loaded.
@@ -159,6 +183,10 @@ SELVA_TRACE_HANDLE(auto_compress_proc);
  * global variable is needed for Hierarchy_SubtreeRDBLoad().
  */
 static SelvaHierarchy *subtree_hierarchy;
+/**
+ * The nodeId of the head of the subtree last loaded by Hierarchy_SubtreeRDBLoad().
+ */
+static Selva_NodeId subtree_head_id;
 static int isDecompressingSubtree;
 
 /**
@@ -167,6 +195,22 @@ static int isDecompressingSubtree;
  */
 static int isRdbSaving;
 
+/**
+ * Lazy free stats.
+ * These are global counters over all hierarchies.
+ */
+static size_t lazy_free_pending; /*!< Nodes waiting to be freed. */
+static unsigned long long lazy_free_freed; /*!< Total number of nodes freed lazily. */
+
+/**
+ * Hierarchy export state.
+ * There can be only one export child running at any given time.
+ */
+static struct {
+    int child_pid; /*!< pid of the export child or 0 if no export is running. */
+    int last_status; /*!< Exit status of the last export. */
+} hierarchy_export;
+
 static int isRdbLoading(RedisModuleCtx *ctx) {
      return !!(REDISMODULE_CTX_FLAGS_LOADING & RedisModule_GetContextFlags(ctx) || isDecompressingSubtree);
 }
@@ -216,11 +260,17 @@ static int SelvaHierarchyNode_Compare(const SelvaHierarchyNode *a, const SelvaHi
 RB_GENERATE_STATIC(hierarchy_index_tree, SelvaHierarchyNode, _index_entry, SelvaHierarchyNode_Compare)
 
 SelvaHierarchy *SelvaModify_NewHierarchy(RedisModuleCtx *ctx) {
-    SelvaHierarchy *hierarchy = selva_calloc(1, sizeof(*hierarchy));
+    SelvaHierarchy *hierarchy = selva_arena_calloc(SELVA_ARENA_HIERARCHY, 1, sizeof(*hierarchy));
 
-    mempool_init(&hierarchy->node_pool, HIERARCHY_SLAB_SIZE, sizeof(SelvaHierarchyNode), _Alignof(SelvaHierarchyNode));
+    mempool_init2(&hierarchy->node_pool, HIERARCHY_SLAB_SIZE, sizeof(SelvaHierarchyNode), _Alignof(SelvaHierarchyNode), HIERARCHY_SLAB_HUGEPAGE);
     RB_INIT(&hierarchy->index_head);
+    RB_INIT(&hierarchy->inherit_cache.head);
+    TAILQ_INIT(&hierarchy->resumable.head);
+    SelvaFindCache_Init(hierarchy);
+    SelvaAliases_Init(&hierarchy->aliases);
     SVector_Init(&hierarchy->heads, 1, SVector_HierarchyNode_id_compare);
+    SVector_Init(&hierarchy->lazy_free.nodes, 0, NULL);
+    hierarchy->reach.next = 1; /* 0 is reserved for unlabeled nodes. */
     SelvaObject_Init(hierarchy->types._obj_data);
     Edge_InitEdgeFieldConstraints(&hierarchy->edge_field_constraints);
     SelvaSubscriptions_InitHierarchy(hierarchy);
@@ -256,6 +306,20 @@ void SelvaModify_DestroyHierarchy(SelvaHierarchy *hierarchy) {
         SelvaModify_DestroyNode(NULL, hierarchy, node);
     }
 
+    /*
+     * The lazily deleted nodes are no longer in the index and they are
+     * already unlinked, so only the memory needs to be freed.
+     */
+    if (hierarchy->lazy_free.timer_active) {
+        (void)RedisModule_StopTimerUnsafe(hierarchy->lazy_free.timer_id, NULL);
+        hierarchy->lazy_free.timer_active = 0;
+    }
+    while ((node = SVector_Pop(&hierarchy->lazy_free.nodes))) {
+        free_node(hierarchy, node);
+        lazy_free_pending--;
+    }
+    SVector_Destroy(&hierarchy->lazy_free.nodes);
+
     /*
      * Note that ctx can be NULL because we are freeing the whole hierarchy
      * which will destroy all hierarchy nodes and thus all the marker pointers
@@ -268,6 +332,10 @@ void SelvaModify_DestroyHierarchy(SelvaHierarchy *hierarchy) {
      * hopefully the deinit doesn't need a RedisModuleCtx.
      */
     SelvaFindIndex_Deinit(hierarchy);
+    Inherit_DestroyCache(hierarchy);
+    SelvaFindCache_Destroy(hierarchy);
+    drop_resumables(hierarchy);
+    SelvaAliases_Destroy(&hierarchy->aliases);
 
     Edge_DeinitEdgeFieldConstraints(&hierarchy->edge_field_constraints);
 
@@ -282,7 +350,7 @@ void SelvaModify_DestroyHierarchy(SelvaHierarchy *hierarchy) {
 #if MEM_DEBUG
     memset(hierarchy, 0, sizeof(*hierarchy));
 #endif
-    selva_free(hierarchy);
+    selva_arena_free(SELVA_ARENA_HIERARCHY, hierarchy);
 }
 
 SelvaHierarchy *SelvaModify_OpenHierarchy(RedisModuleCtx *ctx, RedisModuleString *key_name, int mode) {
@@ -436,7 +504,13 @@ static void new_node_events(RedisModuleCtx *ctx, SelvaHierarchy *hierarchy, Selv
         SelvaSubscriptions_DeferMissingAccessorEvents(hierarchy, node->id, SELVA_NODE_ID_SIZE);
 }
 
-static void SelvaModify_DestroyNode(RedisModuleCtx *ctx, SelvaHierarchy *hierarchy, SelvaHierarchyNode *node) {
+/**
+ * Destroy the metadata of a node.
+ * The metadata destructors also unlink the node from other nodes, e.g. by
+ * removing the edges pointing to it, therefore this must be called before the
+ * node can be considered fully unlinked.
+ */
+static void destroy_node_metadata(RedisModuleCtx *ctx, SelvaHierarchy *hierarchy, SelvaHierarchyNode *node) {
     SelvaHierarchyMetadataDestructorHook **dtor_p;
 
     /* Don't pass ctx when loading. */
@@ -446,7 +520,12 @@ static void SelvaModify_DestroyNode(RedisModuleCtx *ctx, SelvaHierarchy *hierarc
         SelvaHierarchyMetadataDestructorHook *dtor = *dtor_p;
         dtor(ctx, hierarchy, node, &node->metadata);
     }
+}
 
+/**
+ * Free the memory of a node that has been already unlinked.
+ */
+static void free_node(SelvaHierarchy *hierarchy, SelvaHierarchyNode *node) {
     SVector_Destroy(&node->parents);
     SVector_Destroy(&node->children);
     SelvaObject_Destroy(GET_NODE_OBJ(node));
@@ -456,6 +535,56 @@ static void SelvaModify_DestroyNode(RedisModuleCtx *ctx, SelvaHierarchy *hierarc
     mempool_return(&hierarchy->node_pool, node);
 }
 
+static void SelvaModify_DestroyNode(RedisModuleCtx *ctx, SelvaHierarchy *hierarchy, SelvaHierarchyNode *node) {
+    destroy_node_metadata(ctx, hierarchy, node);
+    free_node(hierarchy, node);
+}
+
+/**
+ * Destroy a node lazily.
+ * The node is unlinked immediately but freeing the memory is deferred to
+ * lazy_free_proc().
+ */
+static void lazy_destroy_node(RedisModuleCtx *ctx, SelvaHierarchy *hierarchy, SelvaHierarchyNode *node) {
+    destroy_node_metadata(ctx, hierarchy, node);
+
+    SVector_Insert(&hierarchy->lazy_free.nodes, node);
+    lazy_free_pending++;
+
+    if (!hierarchy->lazy_free.timer_active) {
+        hierarchy->lazy_free.timer_id = RedisModule_CreateTimer(ctx, selva_glob_config.hierarchy_lazy_free_period_ms, lazy_free_proc, hierarchy);
+        hierarchy->lazy_free.timer_active = 1;
+    }
+}
+
+/**
+ * Free a slice of lazily deleted nodes.
+ */
+static void lazy_free_proc(RedisModuleCtx *ctx, void *data) {
+    SELVA_TRACE_BEGIN_AUTO(lazy_free_proc);
+    SelvaHierarchy *hierarchy = (struct SelvaHierarchy *)data;
+    const size_t slice = selva_glob_config.hierarchy_lazy_free_slice > 0 ? selva_glob_config.hierarchy_lazy_free_slice : 1;
+    SelvaHierarchyNode *node;
+
+    for (size_t i = 0; i < slice && (node = SVector_Pop(&hierarchy->lazy_free.nodes)); i++) {
+        free_node(hierarchy, node);
+        lazy_free_pending--;
+        lazy_free_freed++;
+    }
+
+    if (SVector_Size(&hierarchy->lazy_free.nodes) > 0) {
+        hierarchy->lazy_free.timer_id = RedisModule_CreateTimer(ctx, selva_glob_config.hierarchy_lazy_free_period_ms, lazy_free_proc, hierarchy);
+    } else {
+        hierarchy->lazy_free.timer_active = 0;
+
+        /*
+         * Typically a large subtree was deleted and there might be some
+         * slabs to release now.
+         */
+        mempool_gc(&hierarchy->node_pool);
+    }
+}
+
 /**
  * Create a new detached node with given parents.
  */
@@ -570,6 +699,94 @@ SelvaHierarchyNode *SelvaHierarchy_FindNode(SelvaHierarchy *hierarchy, const Sel
     return NULL;
 }
 
+/**
+ * Interleaved lookup of a batch of nodeIds from the normal node index.
+ * All the lookups descend the tree one level at a time and the next tree node
+ * of each lookup is prefetched before proceeding with the other lookups, so
+ * the cache misses of the lookups overlap.
+ */
+static void find_node_index_batch(SelvaHierarchy *hierarchy, const Selva_NodeId *ids, size_t nr_ids, SelvaHierarchyNode **nodes) {
+    SelvaHierarchyNode *cur[HIERARCHY_FIND_BATCH];
+    SelvaHierarchyNode *root = RB_ROOT(&hierarchy->index_head);
+    size_t nr_pending = nr_ids;
+
+    assert(nr_ids <= HIERARCHY_FIND_BATCH);
+
+    for (size_t i = 0; i < nr_ids; i++) {
+        cur[i] = root;
+        nodes[i] = NULL;
+    }
+
+    while (nr_pending > 0) {
+        for (size_t i = 0; i < nr_ids; i++) {
+            SelvaHierarchyNode *node = cur[i];
+            int cmp;
+
+            if (!node) {
+                continue;
+            }
+
+            cmp = memcmp(ids[i], node->id, SELVA_NODE_ID_SIZE);
+            if (cmp == 0) {
+                nodes[i] = node;
+                node = NULL;
+            } else {
+                node = cmp < 0 ? RB_LEFT(node, _index_entry) : RB_RIGHT(node, _index_entry);
+                __builtin_prefetch(node, 0, 0);
+            }
+
+            cur[i] = node;
+            nr_pending -= !node;
+        }
+    }
+}
+
+size_t SelvaHierarchy_FindNodes(SelvaHierarchy *hierarchy, const Selva_NodeId *ids, size_t nr_ids, struct SelvaHierarchyNode **nodes) {
+    size_t nr_found = 0;
+
+    SELVA_TRACE_BEGIN(find_inmem_batch);
+    for (size_t i = 0; i < nr_ids; i += HIERARCHY_FIND_BATCH) {
+        find_node_index_batch(hierarchy, ids + i, min(nr_ids - i, (size_t)HIERARCHY_FIND_BATCH), nodes + i);
+    }
+    SELVA_TRACE_END(find_inmem_batch);
+
+    for (size_t i = 0; i < nr_ids; i++) {
+        SelvaHierarchyNode *node = nodes[i];
+
+        if ((!node && SelvaHierarchyDetached_IndexExists(hierarchy)) ||
+            (node && (node->flags & SELVA_NODE_FLAGS_DETACHED))) {
+            /* Take the slow path that knows how to restore detached subtrees. */
+            node = SelvaHierarchy_FindNode(hierarchy, ids[i]);
+            nodes[i] = node;
+        }
+
+        nr_found += !!node;
+    }
+
+    return nr_found;
+}
+
+size_t SelvaHierarchy_NodesExist(SelvaHierarchy *hierarchy, const Selva_NodeId *ids, size_t nr_ids, char *exists) {
+    size_t nr_found = 0;
+
+    for (size_t i = 0; i < nr_ids; i += HIERARCHY_FIND_BATCH) {
+        const size_t batch_len = min(nr_ids - i, (size_t)HIERARCHY_FIND_BATCH);
+        SelvaHierarchyNode *nodes[HIERARCHY_FIND_BATCH];
+
+        find_node_index_batch(hierarchy, ids + i, batch_len, nodes);
+        for (size_t j = 0; j < batch_len; j++) {
+            /*
+             * The head of a detached subtree is kept in the index but the rest
+             * of the subtree can only be found from the detached index.
+             */
+            exists[i + j] = nodes[j] || SelvaHierarchyDetached_NodeExists(hierarchy, ids[i + j]);
+            nr_found += exists[i + j];
+        }
+    }
+
+    return nr_found;
+}
+
 struct SelvaObject *SelvaHierarchy_GetNodeObject(const struct SelvaHierarchyNode *node) {
     return GET_NODE_OBJ(node);
 }
@@ -625,28 +842,306 @@ static inline void rmHead(SelvaHierarchy *hierarchy, SelvaHierarchyNode *node) {
     }
 }
 
+/*
+ * Ancestor reachability labels.
+ *
+ * Every node is given an interval [lo, hi) allocated from the free label space
+ * of its label parent, which is normally the first parent the node was linked
+ * to. The size of the interval doesn't depend on the free space left but on
+ * the number of children the parent has: each doubling of the children halves
+ * the interval given to a new child, so the label space of a node is only
+ * exhausted by an exponential number of children. A node is a descendant of
+ * every node whose interval contains the lo of the node. The labels only cover
+ * the edges to the label parents and the nodes having other parents are marked
+ * as exceptions, whose remaining parents are expanded separately when testing
+ * reachability.
+ *
+ * The labels are updated incrementally as relationships are added and removed.
+ * If a change can't be done incrementally, e.g. because the free label space
+ * of a parent was exhausted or a node having children lost its label parent,
+ * the labels are marked dirty and rebuilt on the next query. A rebuild leaves
+ * every node free label space proportional to the size of its subtree.
+ */
+#define REACH_LABEL_END (UINT64_C(1) << 63)
+#define REACH_LABEL_SPLIT 32 /*!< The children of a node take 1/REACH_LABEL_SPLIT of its label space per each doubling. */
+#define REACH_LABEL_HEADS_SPAN (REACH_LABEL_END / 2) /*!< Label space for computing the intervals of heads. */
+
+static unsigned long long reach_relabels;
+
+static inline int reach_contains(const SelvaHierarchyNode *a, const SelvaHierarchyNode *b) {
+    return a->reach.lo < b->reach.lo && b->reach.lo < a->reach.hi;
+}
+
+static void reach_set_exception(SelvaHierarchy *hierarchy, SelvaHierarchyNode *node) {
+    if (!node->reach.exception) {
+        node->reach.exception = 1;
+        hierarchy->reach.nr_exceptions++;
+    }
+}
+
+/**
+ * Allocate a new label for node from the free label space [*free_lo, free_hi).
+ * @param span is the size of the label space of the parent.
+ * @param nr_siblings is the number of children the parent has including node.
+ */
+static int reach_alloc(uint64_t *free_lo, uint64_t free_hi, uint64_t span, size_t nr_siblings, SelvaHierarchyNode *node) {
+    const unsigned doublings = nr_siblings > 1 ? 63 - __builtin_clzll(nr_siblings) : 0;
+    const uint64_t size = doublings < 58 ? (span / REACH_LABEL_SPLIT) >> doublings : 0;
+
+    if (size < 2 || size > free_hi - *free_lo) {
+        return SELVA_ENOBUFS;
+    }
+
+    node->reach.lo = *free_lo;
+    node->reach.hi = *free_lo + size;
+    node->reach.next = *free_lo + 1;
+    *free_lo += size;
+
+    return 0;
+}
+
+/**
+ * Update the labels after a new relationship parent -> child was added.
+ */
+static void reach_link(SelvaHierarchy *hierarchy, SelvaHierarchyNode *parent, SelvaHierarchyNode *child) {
+    if (hierarchy->reach.dirty) {
+        return;
+    }
+
+    if (parent->reach.lo == 0) {
+        /* Only a head can be still unlabeled. */
+        if (SVector_Size(&parent->parents) > 0 ||
+            reach_alloc(&hierarchy->reach.next, REACH_LABEL_END, REACH_LABEL_HEADS_SPAN, SVector_Size(&hierarchy->heads), parent)) {
+            goto dirty;
+        }
+    }
+
+    if (SVector_Size(&child->children) == 0 && SVector_Size(&child->parents) == 1) {
+        /* A leaf can be relabeled freely. */
+        if (parent->reach.hi == 0 ||
+            reach_alloc(&parent->reach.next, parent->reach.hi, parent->reach.hi - parent->reach.lo, SVector_Size(&parent->children), child)) {
+            goto dirty;
+        }
+        child->reach.parent = parent;
+    } else if (child->reach.lo != 0) {
+        reach_set_exception(hierarchy, child);
+    } else {
+        goto dirty;
+    }
+
+    return;
+dirty:
+    hierarchy->reach.dirty = 1;
+}
+
+/**
+ * Update the labels after the relationship parent -> child was removed.
+ */
+static void reach_unlink(SelvaHierarchy *hierarchy, SelvaHierarchyNode *parent, SelvaHierarchyNode *child) {
+    if (hierarchy->reach.dirty || child->reach.parent != parent) {
+        /* The relationship wasn't covered by the labels. */
+        return;
+    }
+
+    if (SVector_Size(&child->children) > 0) {
+        /* The whole subtree would need new labels. */
+        hierarchy->reach.dirty = 1;
+        return;
+    }
+
+    child->reach.lo = 0;
+    child->reach.hi = 0;
+    child->reach.next = 0;
+    child->reach.parent = NULL;
+
+    /*
+     * A leaf can be moved under any of the remaining parents. If there are no
+     * parents left the leaf is left unlabeled until it gets children.
+     */
+    if (SVector_Size(&child->parents) > 0) {
+        SelvaHierarchyNode *new_parent = SVector_GetIndex(&child->parents, 0);
+
+        if (new_parent->reach.hi == 0 ||
+            reach_alloc(&new_parent->reach.next, new_parent->reach.hi, new_parent->reach.hi - new_parent->reach.lo, SVector_Size(&new_parent->children), child)) {
+            hierarchy->reach.dirty = 1;
+            return;
+        }
+        child->reach.parent = new_parent;
+    }
+}
+
+struct reach_relabel_frame {
+    SelvaHierarchyNode *node;
+    uint64_t size; /*!< Number of nodes in the label subtree of node. */
+    struct SVectorIterator it;
+};
+
+struct reach_relabel_state {
+    uint64_t label; /*!< Next label. */
+    uint64_t unit; /*!< Free label space reserved per each node in the subtree of a node. */
+    uint64_t total; /*!< Sum of the label subtree sizes of all nodes. */
+    size_t stack_len;
+    size_t stack_size;
+    struct reach_relabel_frame *stack;
+};
+
+static struct reach_relabel_frame *reach_relabel_push(struct reach_relabel_state *state, SelvaHierarchyNode *node) {
+    struct reach_relabel_frame *frame;
+
+    if (state->stack_len == state->stack_size) {
+        state->stack_size = state->stack_size ? 2 * state->stack_size : 64;
+        state->stack = selva_arena_realloc(SELVA_ARENA_QUERY, state->stack, state->stack_size * sizeof(*state->stack));
+    }
+
+    frame = &state->stack[state->stack_len++];
+    frame->node = node;
+    SVector_ForeachBegin(&frame->it, &node->children);
+
+    return frame;
+}
+
+/**
+ * Pick the label tree under head using DFS and count the size of every subtree.
+ * The label parent of a node is the parent it's first reached from and the
+ * subtree size is stored temporarily in reach.hi.
+ */
+static void reach_relabel_count(SelvaHierarchy *hierarchy, struct reach_relabel_state *state, SelvaHierarchyNode *head) {
+    head->reach.hi = 1;
+    (void)reach_relabel_push(state, head);
+
+    while (state->stack_len > 0) {
+        struct reach_relabel_frame *frame = &state->stack[state->stack_len - 1];
+        SelvaHierarchyNode *child;
+
+        child = SVector_Foreach(&frame->it);
+        if (child) {
+            if (child->reach.hi == 0) {
+                child->reach.hi = 1;
+                child->reach.parent = frame->node;
+                (void)reach_relabel_push(state, child);
+            } else {
+                /* Already reached through another parent. */
+                reach_set_exception(hierarchy, child);
+            }
+        } else {
+            SelvaHierarchyNode *node = frame->node;
+
+            state->total += node->reach.hi;
+            if (node->reach.parent) {
+                node->reach.parent->reach.hi += node->reach.hi;
+            }
+            state->stack_len--;
+        }
+    }
+}
+
+/**
+ * Label the label tree under head using DFS.
+ * Every node gets its own label, the labels of its label subtree, and free
+ * label space proportional to the size of its subtree for new children.
+ */
+static void reach_relabel_subtree(struct reach_relabel_state *state, SelvaHierarchyNode *head) {
+    struct reach_relabel_frame *frame;
+
+    frame = reach_relabel_push(state, head);
+    frame->size = head->reach.hi;
+    head->reach.lo = state->label++;
+
+    while (state->stack_len > 0) {
+        SelvaHierarchyNode *child;
+
+        frame = &state->stack[state->stack_len - 1];
+        child = SVector_Foreach(&frame->it);
+        if (child) {
+            if (child->reach.parent == frame->node) {
+                const uint64_t size = child->reach.hi;
+
+                frame = reach_relabel_push(state, child);
+                frame->size = size;
+                child->reach.lo = state->label++;
+            }
+        } else {
+            SelvaHierarchyNode *node = frame->node;
+
+            node->reach.next = state->label;
+            state->label += frame->size * state->unit;
+            node->reach.hi = state->label;
+            state->stack_len--;
+        }
+    }
+}
+
+/**
+ * Rebuild the reachability labels of the whole hierarchy.
+ */
+static void reach_relabel(SelvaHierarchy *hierarchy) {
+    SELVA_TRACE_BEGIN_AUTO(reach_relabel);
+    struct reach_relabel_state state = {
+        .label = 1,
+    };
+    SelvaHierarchyNode *node;
+    size_t nr_nodes = 0;
+
+    RB_FOREACH(node, hierarchy_index_tree, &hierarchy->index_head) {
+        memset(&node->reach, 0, sizeof(node->reach));
+        nr_nodes++;
+    }
+    hierarchy->reach.nr_exceptions = 0;
+
+    RB_FOREACH(node, hierarchy_index_tree, &hierarchy->index_head) {
+        if (SVector_Size(&node->parents) == 0) {
+            reach_relabel_count(hierarchy, &state, node);
+        }
+    }
+
+    /*
+     * Anything still not reached is only reachable through a cycle.
+     */
+    RB_FOREACH(node, hierarchy_index_tree, &hierarchy->index_head) {
+        if (node->reach.hi == 0) {
+            reach_set_exception(hierarchy, node);
+            reach_relabel_count(hierarchy, &state, node);
+        }
+    }
+
+    /*
+     * Half of the label space is given to the existing nodes and the other
+     * half is left for new heads. The free space of a node is proportional
+     * to the size of its subtree, so that reach_alloc() can keep allocating
+     * labels for the new children of large subtrees too.
+     */
+    state.unit = (REACH_LABEL_END / 2 - nr_nodes) / (state.total + 1);
+
+    RB_FOREACH(node, hierarchy_index_tree, &hierarchy->index_head) {
+        if (!node->reach.parent) {
+            reach_relabel_subtree(&state, node);
+        }
+    }
+
+    selva_arena_free(SELVA_ARENA_QUERY, state.stack);
+    hierarchy->reach.next = state.label;
+    hierarchy->reach.dirty = 0;
+    reach_relabels++;
+}
+
 /**
- * Delete all aliases from the aliases key.
+ * Delete all aliases of a node from the alias index.
  * Note that this function doesn't delete the aliases from the node object.
  */
-static void delete_node_aliases(RedisModuleCtx *ctx, struct SelvaObject *obj) {
+static void delete_node_aliases(SelvaHierarchy *hierarchy, const Selva_NodeId id, struct SelvaObject *obj) {
     struct SelvaSet *node_aliases_set;
 
     node_aliases_set = SelvaObject_GetSetStr(obj, SELVA_ALIASES_FIELD, sizeof(SELVA_ALIASES_FIELD) - 1);
     if (node_aliases_set) {
-        RedisModuleKey *aliases_key;
-
-        aliases_key = open_aliases_key(ctx);
-        if (aliases_key) {
-            delete_aliases(aliases_key, node_aliases_set);
-            RedisModule_CloseKey(aliases_key);
-        } else {
-            SELVA_LOG(SELVA_LOGL_WARN, "Unable to open aliases\n");
-        }
+        (void)delete_aliases(hierarchy, id, node_aliases_set);
     }
 }
 
-static void del_node(RedisModuleCtx *ctx, SelvaHierarchy *hierarchy, SelvaHierarchyNode *node) {
+/**
+ * Delete a node.
+ * @param flags only DEL_HIERARCHY_NODE_LAZY and DEL_HIERARCHY_NODE_DETACH are used here.
+ */
+static void del_node(RedisModuleCtx *ctx, SelvaHierarchy *hierarchy, SelvaHierarchyNode *node, enum SelvaModify_DelHierarchyNodeFlag flags) {
     struct SelvaObject *obj = GET_NODE_OBJ(node);
     Selva_NodeId id;
     int is_root;
@@ -667,8 +1162,12 @@ static void del_node(RedisModuleCtx *ctx, SelvaHierarchy *hierarchy, SelvaHierar
     }
     SelvaSubscriptions_DeferHierarchyDeletionEvents(ctx, hierarchy, node);
 
-    if (likely(ctx)) {
-        delete_node_aliases(ctx, obj);
+    /*
+     * The aliases of a detached node are kept in the index and resolving
+     * them will restore the subtree.
+     */
+    if (!(flags & DEL_HIERARCHY_NODE_DETACH)) {
+        delete_node_aliases(hierarchy, id, obj);
     }
 
     /*
@@ -702,7 +1201,16 @@ static void del_node(RedisModuleCtx *ctx, SelvaHierarchy *hierarchy, SelvaHierar
         rmHead(hierarchy, node);
 
         RB_REMOVE(hierarchy_index_tree, &hierarchy->index_head, node);
-        SelvaModify_DestroyNode(ctx, hierarchy, node);
+        hierarchy->generation++;
+        hierarchy->resumable.generation++;
+        if (node->reach.exception) {
+            hierarchy->reach.nr_exceptions--;
+        }
+        if ((flags & DEL_HIERARCHY_NODE_LAZY) && ctx && !isRdbLoading(ctx)) {
+            lazy_destroy_node(ctx, hierarchy, node);
+        } else {
+            SelvaModify_DestroyNode(ctx, hierarchy, node);
+        }
     }
 }
 
@@ -854,12 +1362,15 @@ static int cross_insert_children(
         }
 
         if (SVector_InsertFast(&node->children, child) == NULL) {
+            hierarchy->generation++;
+
             /* The child node is no longer an orphan */
             if (SVector_Size(&child->parents) == 0) {
                 rmHead(hierarchy, child);
             }
 
             (void)SVector_InsertFast(&child->parents, node);
+            reach_link(hierarchy, node, child);
 
 #if 0
             fprintf(stderr, "%s:%d: Inserted %.*s.children <= %.*s\n",
@@ -960,6 +1471,8 @@ static int cross_insert_parents(
         /* Do inserts only if the relationship doesn't exist already */
         if (SVector_InsertFast(&node->parents, parent) == NULL) {
             (void)SVector_InsertFast(&parent->children, node);
+            hierarchy->generation++;
+            reach_link(hierarchy, parent, node);
 
 #if 0
             fprintf(stderr, "%s:%d: Inserted %.*s.parents <= %.*s\n",
@@ -1063,6 +1576,9 @@ static int crossRemove(
 
             SVector_Remove(&parent->children, node);
             SVector_Remove(&node->parents, parent);
+            hierarchy->generation++;
+            hierarchy->resumable.generation++;
+            reach_unlink(hierarchy, parent, node);
 
 #if HIERARCHY_SORT_BY_DEPTH
             updateDepth(hierarchy, adjacent);
@@ -1101,6 +1617,9 @@ static int crossRemove(
 
             SVector_Remove(&child->parents, node);
             SVector_Remove(&node->children, child);
+            hierarchy->generation++;
+            hierarchy->resumable.generation++;
+            reach_unlink(hierarchy, node, child);
 
             if (SVector_Size(&child->parents) == 0) {
                 /* child is an orphan now */
@@ -1188,9 +1707,13 @@ static int removeRelationships(
 
         SVector_Remove(vec_b, node);
 
-        if (rel == RELATIONSHIP_PARENT && SVector_Size(vec_b) == 0) {
-            /* This node is now orphan */
-            mkHead(hierarchy, adj);
+        if (rel == RELATIONSHIP_PARENT) {
+            reach_unlink(hierarchy, node, adj);
+
+            if (SVector_Size(vec_b) == 0) {
+                /* This node is now orphan */
+                mkHead(hierarchy, adj);
+            }
         }
 
 #if HIERARCHY_SORT_BY_DEPTH
@@ -1198,6 +1721,11 @@ static int removeRelationships(
 #endif
     }
     SVector_Clear(vec_a);
+    hierarchy->generation++;
+    hierarchy->resumable.generation++;
+    if (rel == RELATIONSHIP_CHILD && node->reach.parent) {
+        reach_unlink(hierarchy, node->reach.parent, node);
+    }
 
     SelvaSubscriptions_RefreshByMarker(ctx, hierarchy, &sub_markers);
 
@@ -1283,7 +1811,7 @@ int SelvaModify_SetHierarchy(
     err = cross_insert_parents(ctx, hierarchy, node, nr_parents, parents);
     if (err < 0) {
         if (isNewNode) {
-            del_node(ctx, hierarchy, node);
+            del_node(ctx, hierarchy, node, 0);
         }
         return err;
     }
@@ -1293,7 +1821,7 @@ int SelvaModify_SetHierarchy(
     err = cross_insert_children(ctx, hierarchy, node, nr_children, children);
     if (err < 0) {
         if (isNewNode) {
-            del_node(ctx, hierarchy, node);
+            del_node(ctx, hierarchy, node, 0);
         }
         return err;
     }
@@ -1552,7 +2080,7 @@ int SelvaModify_AddHierarchy(
     err = SelvaModify_AddHierarchyP(ctx, hierarchy, node, nr_parents, parents, nr_children, children);
     if (err < 0) {
         if (isNewNode) {
-            del_node(ctx, hierarchy, node);
+            del_node(ctx, hierarchy, node, 0);
         }
 
         return err;
@@ -1660,7 +2188,12 @@ static int SelvaModify_DelHierarchyNodeP(
         return SELVA_HIERARCHY_ENOTSUP;
     }
 
-    SelvaSubscriptions_ClearAllMarkers(ctx, hierarchy, node);
+    if (flags & DEL_HIERARCHY_NODE_DETACH) {
+        /* The node will still exist in the detached storage. */
+        SelvaSubscriptions_ClearAllMarkers(ctx, hierarchy, node);
+    } else {
+        SelvaSubscriptions_ClearAllMarkersOnDelete(ctx, hierarchy, node);
+    }
 
     /*
      * Delete links to parents.
@@ -1728,7 +2261,7 @@ static int SelvaModify_DelHierarchyNodeP(
     if ((flags & DEL_HIERARCHY_NODE_REPLY_IDS) != 0) {
         RedisModule_ReplyWithStringBuffer(ctx, node->id, Selva_NodeIdLen(node->id));
     }
-    del_node(ctx, hierarchy, node);
+    del_node(ctx, hierarchy, node, flags);
 
     return nr_deleted + 1;
 }
@@ -1772,6 +2305,31 @@ static void SelvaHierarchyChildCallback_Dummy(
         void *arg __unused) {
 }
 
+/**
+ * Prefetch the first adjacent nodes in vec.
+ */
+static inline void prefetch_adjacents_begin(const SVector *vec) {
+    if (SVector_Mode(vec) == SVECTOR_MODE_ARRAY && vec->vec_arr) {
+        const size_t end = min((size_t)vec->vec_last, (size_t)vec->vec_arr_shift_index + HIERARCHY_TRAVERSAL_PREFETCH_DIST);
+
+        for (size_t i = vec->vec_arr_shift_index; i < end; i++) {
+            __builtin_prefetch(vec->vec_arr[i], 1, 3);
+        }
+    }
+}
+
+/**
+ * Prefetch the adjacent node HIERARCHY_TRAVERSAL_PREFETCH_DIST steps ahead.
+ * Must be called after each SVector_Foreach() of the iteration.
+ * The rbtree mode is only used for very large vectors and it's not prefetched.
+ */
+static inline void prefetch_adjacents_next(const struct SVectorIterator *it) {
+    if (it->mode == SVECTOR_MODE_ARRAY &&
+        it->arr.end - it->arr.cur >= HIERARCHY_TRAVERSAL_PREFETCH_DIST) {
+        __builtin_prefetch(it->arr.cur[HIERARCHY_TRAVERSAL_PREFETCH_DIST - 1], 1, 3);
+    }
+}
+
 /**
  * DFS from a given head node towards its descendants or ancestors.
  */
@@ -1833,7 +2391,10 @@ static int dfs(
             const SVector *vec = (SVector *)((char *)node + offset);
 
             SVector_ForeachBegin(&it, vec);
+            prefetch_adjacents_begin(vec);
             while ((adj = SVector_Foreach(&it))) {
+                prefetch_adjacents_next(&it);
+
                 if (adj->flags & SELVA_NODE_FLAGS_DETACHED) {
                     err = restore_subtree(hierarchy, adj->id);
                     if (err) {
@@ -1970,7 +2531,10 @@ static int full_dfs(
                 }
 
                 SVector_ForeachBegin(&it2, &node->children);
+                prefetch_adjacents_begin(&node->children);
                 while ((adj = SVector_Foreach(&it2))) {
+                    prefetch_adjacents_next(&it2);
+
                     if ((adj->flags & SELVA_NODE_FLAGS_DETACHED) && enable_restore) {
                         err = restore_subtree(hierarchy, adj->id);
                         if (err) {
@@ -1993,35 +2557,118 @@ out:
     return err;
 }
 
-#define BFS_TRAVERSE(ctx, hierarchy, head, cb) \
-    SelvaHierarchyHeadCallback head_cb = (cb)->head_cb ? (cb)->head_cb : SelvaHierarchyHeadCallback_Dummy; \
-    SelvaHierarchyNodeCallback node_cb = (cb)->node_cb ? (cb)->node_cb : HierarchyNode_Callback_Dummy; \
-    SelvaHierarchyChildCallback child_cb = (cb)->child_cb ? (cb)->child_cb : SelvaHierarchyChildCallback_Dummy; \
-    \
-    SVECTOR_AUTOFREE(_bfs_q); \
-    SVector_Init(&_bfs_q, selva_glob_config.hierarchy_expected_resp_len, NULL); \
-    \
-    struct trx trx_cur; \
-    if (Trx_Begin(&(hierarchy)->trx_state, &trx_cur)) { \
-        return SELVA_HIERARCHY_ETRMAX; \
-    } \
-    \
-    Trx_Visit(&trx_cur, &(head)->trx_label); \
-    SVector_Insert(&_bfs_q, (head)); \
-    if (head_cb((ctx), (hierarchy), (head), (cb)->head_arg)) { Trx_End(&(hierarchy)->trx_state, &trx_cur); return 0; } \
-    while (SVector_Size(&_bfs_q) > 0) { \
-        SelvaHierarchyNode *node = SVector_Shift(&_bfs_q);
+/**
+ * A FIFO queue of nodes for BFS.
+ * The queue is a ring buffer with a power of two capacity that is doubled
+ * when the queue gets full.
+ */
+struct bfs_queue {
+    size_t head; /*!< Index of the first node in buf. */
+    size_t len; /*!< Number of nodes in the queue. */
+    size_t mask; /*!< Capacity - 1. */
+    SelvaHierarchyNode **buf;
+};
 
-#define BFS_VISIT_NODE(ctx, hierarchy) \
-        /* Note that Trx_Visit() has been already called for this node. */ \
-        if (node_cb((ctx), (hierarchy), node, cb->node_arg)) { \
-            Trx_End(&(hierarchy)->trx_state, &trx_cur); \
-            return 0; \
-        }
+#define BFS_QUEUE_AUTOFREE(name) \
+    __attribute__((cleanup(bfs_queue_destroy))) struct bfs_queue name = { .buf = NULL }
 
-#define BFS_VISIT_ADJACENT(ctx, hierarchy, _origin_field_str, _origin_field_len, adj_node) do { \
-        if (Trx_Visit(&trx_cur, &(adj_node)->trx_label)) { \
-            if ((adj_node)->flags & SELVA_NODE_FLAGS_DETACHED) { \
+static void bfs_queue_init(struct bfs_queue *q, size_t initial_len) {
+    size_t cap = HIERARCHY_TRAVERSAL_PREFETCH_DIST;
+
+    while (cap < initial_len) {
+        cap <<= 1;
+    }
+
+    q->head = 0;
+    q->len = 0;
+    q->mask = cap - 1;
+    q->buf = selva_arena_malloc(SELVA_ARENA_QUERY, cap * sizeof(SelvaHierarchyNode *));
+}
+
+static void bfs_queue_destroy(struct bfs_queue *q) {
+    selva_arena_free(SELVA_ARENA_QUERY, q->buf);
+    q->buf = NULL;
+}
+
+static void bfs_queue_grow(struct bfs_queue *q) {
+    const size_t old_cap = q->mask + 1;
+    const size_t tail_len = old_cap - q->head; /* Nodes before the wrap around. */
+    SelvaHierarchyNode **buf = selva_arena_malloc(SELVA_ARENA_QUERY, 2 * old_cap * sizeof(SelvaHierarchyNode *));
+
+    /* The queue is full so it's always wrapped unless head is zero. */
+    memcpy(buf, q->buf + q->head, tail_len * sizeof(SelvaHierarchyNode *));
+    memcpy(buf + tail_len, q->buf, q->head * sizeof(SelvaHierarchyNode *));
+    selva_arena_free(SELVA_ARENA_QUERY, q->buf);
+
+    q->buf = buf;
+    q->head = 0;
+    q->mask = 2 * old_cap - 1;
+}
+
+static inline void bfs_queue_push(struct bfs_queue *q, SelvaHierarchyNode *node) {
+    if (unlikely(q->len > q->mask)) {
+        bfs_queue_grow(q);
+    }
+
+    q->buf[(q->head + q->len++) & q->mask] = node;
+}
+
+/**
+ * Remove the first node from the queue.
+ * The node HIERARCHY_TRAVERSAL_PREFETCH_DIST steps behind it in the queue is
+ * prefetched so that it's hopefully in the cache once it's shifted.
+ * The queue must not be empty.
+ */
+static inline SelvaHierarchyNode *bfs_queue_shift(struct bfs_queue *q) {
+    SelvaHierarchyNode *node = q->buf[q->head];
+
+    q->head = (q->head + 1) & q->mask;
+    q->len--;
+
+    if (q->len >= HIERARCHY_TRAVERSAL_PREFETCH_DIST) {
+        __builtin_prefetch(q->buf[(q->head + HIERARCHY_TRAVERSAL_PREFETCH_DIST - 1) & q->mask], 0, 3);
+    }
+
+    return node;
+}
+
+/**
+ * Get the i:th node in the queue without removing it.
+ * @returns the node; NULL if i is out of bounds.
+ */
+static inline SelvaHierarchyNode *bfs_queue_peek(const struct bfs_queue *q, size_t i) {
+    return i < q->len ? q->buf[(q->head + i) & q->mask] : NULL;
+}
+
+#define BFS_TRAVERSE(ctx, hierarchy, head, cb) \
+    SelvaHierarchyHeadCallback head_cb = (cb)->head_cb ? (cb)->head_cb : SelvaHierarchyHeadCallback_Dummy; \
+    SelvaHierarchyNodeCallback node_cb = (cb)->node_cb ? (cb)->node_cb : HierarchyNode_Callback_Dummy; \
+    SelvaHierarchyChildCallback child_cb = (cb)->child_cb ? (cb)->child_cb : SelvaHierarchyChildCallback_Dummy; \
+    \
+    BFS_QUEUE_AUTOFREE(_bfs_q); \
+    bfs_queue_init(&_bfs_q, selva_glob_config.hierarchy_expected_resp_len); \
+    \
+    struct trx trx_cur; \
+    if (Trx_Begin(&(hierarchy)->trx_state, &trx_cur)) { \
+        return SELVA_HIERARCHY_ETRMAX; \
+    } \
+    \
+    Trx_Visit(&trx_cur, &(head)->trx_label); \
+    bfs_queue_push(&_bfs_q, (head)); \
+    if (head_cb((ctx), (hierarchy), (head), (cb)->head_arg)) { Trx_End(&(hierarchy)->trx_state, &trx_cur); return 0; } \
+    while (_bfs_q.len > 0) { \
+        SelvaHierarchyNode *node = bfs_queue_shift(&_bfs_q);
+
+#define BFS_VISIT_NODE(ctx, hierarchy) \
+        /* Note that Trx_Visit() has been already called for this node. */ \
+        if (node_cb((ctx), (hierarchy), node, cb->node_arg)) { \
+            Trx_End(&(hierarchy)->trx_state, &trx_cur); \
+            return 0; \
+        }
+
+#define BFS_VISIT_ADJACENT(ctx, hierarchy, _origin_field_str, _origin_field_len, adj_node) do { \
+        if (Trx_Visit(&trx_cur, &(adj_node)->trx_label)) { \
+            if ((adj_node)->flags & SELVA_NODE_FLAGS_DETACHED) { \
                 int subtree_err = restore_subtree((hierarchy), (adj_node)->id); \
                 if (subtree_err) { \
                     Trx_End(&(hierarchy)->trx_state, &trx_cur); \
@@ -2034,7 +2681,7 @@ out:
                 .origin_node = node, \
             }; \
             child_cb((ctx), (hierarchy), &_cb_metadata, (adj_node), cb->child_arg); \
-            SVector_Insert(&_bfs_q, (adj_node)); \
+            bfs_queue_push(&_bfs_q, (adj_node)); \
         } \
     } while (0)
 
@@ -2042,8 +2689,10 @@ out:
         struct SVectorIterator _bfs_visit_it; \
         \
         SVector_ForeachBegin(&_bfs_visit_it, (adj_vec)); \
+        prefetch_adjacents_begin(adj_vec); \
         SelvaHierarchyNode *_adj; \
         while ((_adj = SVector_Foreach(&_bfs_visit_it))) { \
+            prefetch_adjacents_next(&_bfs_visit_it); \
             BFS_VISIT_ADJACENT((ctx), (hierarchy), (origin_field_str), (origin_field_len), _adj); \
         } \
     } while (0)
@@ -2155,6 +2804,26 @@ static __hot int bfs(
 
     BFS_TRAVERSE(ctx, hierarchy, head, cb) {
         const SVector *adj_vec = (SVector *)((char *)node + offset);
+        const SelvaHierarchyNode *next;
+
+        /*
+         * The header of the node HIERARCHY_TRAVERSAL_PREFETCH_DIST steps ahead
+         * was prefetched by the shift, now prefetch its adjacency vector.
+         * The vector array of the node halfway there should have its SVector
+         * already in the cache.
+         */
+        next = bfs_queue_peek(&_bfs_q, HIERARCHY_TRAVERSAL_PREFETCH_DIST - 1);
+        if (next) {
+            __builtin_prefetch((char *)next + offset, 0, 3);
+        }
+        next = bfs_queue_peek(&_bfs_q, HIERARCHY_TRAVERSAL_PREFETCH_DIST / 2 - 1);
+        if (next) {
+            const SVector *next_vec = (SVector *)((char *)next + offset);
+
+            if (SVector_Mode(next_vec) == SVECTOR_MODE_ARRAY && next_vec->vec_arr) {
+                __builtin_prefetch(next_vec->vec_arr + next_vec->vec_arr_shift_index, 0, 3);
+            }
+        }
 
         BFS_VISIT_NODE(ctx, hierarchy);
         BFS_VISIT_ADJACENTS(ctx, hierarchy, origin_field_str, origin_field_len, adj_vec);
@@ -2381,6 +3050,72 @@ void SelvaHierarchy_TraverseParents(
     traverse_adjacents(ctx, hierarchy, &node->parents, cb);
 }
 
+struct SelvaHierarchyNode *SelvaHierarchy_GetSingleParent(const struct SelvaHierarchyNode *node) {
+    return (SVector_Size(&node->parents) == 1) ? SVector_GetIndex(&node->parents, 0) : NULL;
+}
+
+static int SVector_HierarchyNode_ptr_compare(const void ** restrict a_raw, const void ** restrict b_raw) {
+    const uintptr_t a = (uintptr_t)*a_raw;
+    const uintptr_t b = (uintptr_t)*b_raw;
+
+    return (a > b) - (a < b);
+}
+
+static int reach_search(SelvaHierarchy *hierarchy, SVector *visited, SelvaHierarchyNode *node, SelvaHierarchyNode *ancestor) {
+    if (reach_contains(ancestor, node)) {
+        return 1;
+    }
+
+    /*
+     * Expand the parents not covered by the labels for every exception on
+     * the label path from node up to its head.
+     */
+    for (SelvaHierarchyNode *cur = node; cur; cur = cur->reach.parent) {
+        struct SVectorIterator it;
+        SelvaHierarchyNode *parent;
+
+        if (!cur->reach.exception || SVector_InsertFast(visited, cur)) {
+            continue;
+        }
+
+        SVector_ForeachBegin(&it, &cur->parents);
+        while ((parent = SVector_Foreach(&it))) {
+            if (parent != cur->reach.parent &&
+                (parent == ancestor || reach_search(hierarchy, visited, parent, ancestor))) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int SelvaHierarchy_IsDescendantOf(
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyNode *node,
+        struct SelvaHierarchyNode *ancestor) {
+    SVECTOR_AUTOFREE(visited);
+
+    if (hierarchy->reach.dirty) {
+        reach_relabel(hierarchy);
+    }
+
+    /* An unlabeled node has no parents nor children. */
+    if (node == ancestor || node->reach.lo == 0 || ancestor->reach.lo == 0) {
+        return 0;
+    }
+
+    if (reach_contains(ancestor, node)) {
+        return 1;
+    } else if (hierarchy->reach.nr_exceptions == 0) {
+        return 0;
+    }
+
+    SVector_Init(&visited, 0, SVector_HierarchyNode_ptr_compare);
+
+    return reach_search(hierarchy, &visited, node, ancestor);
+}
+
 int SelvaHierarchy_TraverseBFSAncestors(
         struct RedisModuleCtx *ctx,
         struct SelvaHierarchy *hierarchy,
@@ -2403,8 +3138,7 @@ int SelvaHierarchy_Traverse(
         const Selva_NodeId id,
         enum SelvaTraversal dir,
         const struct SelvaHierarchyCallback *cb) {
-    SelvaHierarchyNode *head;
-    int err = 0;
+    SelvaHierarchyNode *head = NULL;
 
     if (dir == SELVA_HIERARCHY_TRAVERSAL_NONE) {
         return SELVA_HIERARCHY_EINVAL;
@@ -2415,6 +3149,27 @@ int SelvaHierarchy_Traverse(
         if (!head) {
             return SELVA_HIERARCHY_ENOENT;
         }
+    }
+
+    return SelvaHierarchy_TraverseByPtr(ctx, hierarchy, head, dir, cb);
+}
+
+int SelvaHierarchy_TraverseByPtr(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyNode *head,
+        enum SelvaTraversal dir,
+        const struct SelvaHierarchyCallback *cb) {
+    int err = 0;
+
+    if (dir == SELVA_HIERARCHY_TRAVERSAL_NONE) {
+        return SELVA_HIERARCHY_EINVAL;
+    }
+
+    if (dir != SELVA_HIERARCHY_TRAVERSAL_DFS_FULL) {
+        if (!head) {
+            return SELVA_HIERARCHY_ENOENT;
+        }
 
         Trx_Sync(&hierarchy->trx_state, &head->trx_label);
     }
@@ -2583,128 +3338,1182 @@ int SelvaHierarchy_TraverseExpressionBfs(
     return bfs_expression(ctx, hierarchy, head, rpn_ctx, rpn_expr, edge_filter_ctx, edge_filter, cb);
 }
 
-int SelvaHierarchy_TraverseArray(
-        struct RedisModuleCtx *ctx __unused,
-        struct SelvaHierarchy *hierarchy,
-        const Selva_NodeId id,
-        const char *field_str,
-        size_t field_len,
-        const struct SelvaObjectArrayForeachCallback *cb) {
-    struct SelvaHierarchyNode *head;
+/**
+ * Initial number of slots in the visited set of a resumable traversal.
+ * Must be a power of two.
+ */
+#define RESUMABLE_VISITED_INITIAL_SIZE 64
 
-    head = SelvaHierarchy_FindNode(hierarchy, id);
-    if (!head) {
-        return SELVA_HIERARCHY_ENOENT;
-    }
+/**
+ * A set of visited nodes.
+ * An open addressing hash set of node pointers with linear probing. The
+ * nodes are never removed from the set.
+ */
+struct resumable_visited {
+    SelvaHierarchyNode **slots;
+    size_t mask; /*!< Number of slots - 1. */
+    size_t count;
+};
 
-    Trx_Sync(&hierarchy->trx_state, &head->trx_label);
+/**
+ * State of a resumable traversal.
+ * The nodes are referred by pointer. A saved traversal is dropped when any
+ * node or edge is removed from the hierarchy, see hierarchy->resumable.generation,
+ * and thus it never points to a freed node.
+ */
+struct SelvaHierarchyResumable {
+    enum SelvaTraversal dir;
+    Selva_NodeId head_id;
+    int started; /*!< The head has been processed. */
+    uint64_t id; /*!< Id of a saved traversal. */
+    uint64_t prev_id; /*!< Id of the saved traversal this one was resumed from. */
+    uint64_t generation; /*!< Removal generation at the time the traversal was saved. */
+    TAILQ_ENTRY(SelvaHierarchyResumable) _entry;
 
-    return SelvaObject_ArrayForeach(GET_NODE_OBJ(head), field_str, field_len, cb);
-}
+    /*
+     * Adjacency list traversals.
+     */
+    size_t index; /*!< Number of nodes visited. */
+    struct SelvaHierarchySearchFilter last; /*!< The last node visited. */
 
-int SelvaHierarchy_TraverseSet(
-        struct RedisModuleCtx *ctx __unused,
-        struct SelvaHierarchy *hierarchy,
-        const Selva_NodeId id,
-        const char *field_str,
-        size_t field_len,
-        const struct SelvaObjectSetForeachCallback *cb) {
-    struct SelvaHierarchyNode *head;
+    /*
+     * Recursive traversals.
+     */
+    SelvaHierarchyNode **nodes; /*!< BFS queue or DFS stack. */
+    size_t nodes_first; /*!< The first node in the queue. */
+    size_t nodes_last; /*!< One past the last node. */
+    size_t nodes_size;
+    struct resumable_visited visited;
+};
 
-    head = SelvaHierarchy_FindNode(hierarchy, id);
-    if (!head) {
-        return SELVA_HIERARCHY_ENOENT;
+enum resumable_kind {
+    RESUMABLE_NONE = 0,
+    RESUMABLE_NODE, /*!< Visit the head only. */
+    RESUMABLE_LIST, /*!< Visit an adjacency vector of the head. */
+    RESUMABLE_FLAT, /*!< Visit the adjacent nodes of the head. */
+    RESUMABLE_BFS,
+    RESUMABLE_DFS,
+};
+
+static enum resumable_kind get_resumable_kind(enum SelvaTraversal dir) {
+    switch (dir) {
+    case SELVA_HIERARCHY_TRAVERSAL_NODE:
+        return RESUMABLE_NODE;
+    case SELVA_HIERARCHY_TRAVERSAL_CHILDREN:
+    case SELVA_HIERARCHY_TRAVERSAL_PARENTS:
+    case SELVA_HIERARCHY_TRAVERSAL_EDGE_FIELD:
+        return RESUMABLE_LIST;
+    case SELVA_HIERARCHY_TRAVERSAL_REF:
+    case SELVA_HIERARCHY_TRAVERSAL_EXPRESSION:
+        return RESUMABLE_FLAT;
+    case SELVA_HIERARCHY_TRAVERSAL_BFS_ANCESTORS:
+    case SELVA_HIERARCHY_TRAVERSAL_BFS_DESCENDANTS:
+    case SELVA_HIERARCHY_TRAVERSAL_BFS_EDGE_FIELD:
+    case SELVA_HIERARCHY_TRAVERSAL_BFS_EXPRESSION:
+        return RESUMABLE_BFS;
+    case SELVA_HIERARCHY_TRAVERSAL_DFS_ANCESTORS:
+    case SELVA_HIERARCHY_TRAVERSAL_DFS_DESCENDANTS:
+        return RESUMABLE_DFS;
+    default:
+        return RESUMABLE_NONE;
     }
+}
 
-    Trx_Sync(&hierarchy->trx_state, &head->trx_label);
+static inline size_t visited_hash(const SelvaHierarchyNode *node) {
+    uint64_t x = (uint64_t)(uintptr_t)node;
 
-    return SelvaObject_SetForeach(GET_NODE_OBJ(head), field_str, field_len, cb);
+    /* The low bits are always zero due to the alignment. */
+    x ^= x >> 33;
+    x *= UINT64_C(0xff51afd7ed558ccd);
+    x ^= x >> 33;
+
+    return (size_t)x;
 }
 
-int SelvaHierarchy_IsNonEmptyField(const struct SelvaHierarchyNode *node, const char *field_str, size_t field_len) {
-#define IS_FIELD(name) \
-    (field_len == (sizeof(name) - 1) && !memcmp(name, field_str, sizeof(name) - 1))
+static void visited_insert(struct resumable_visited *visited, SelvaHierarchyNode *node) {
+    size_t i = visited_hash(node) & visited->mask;
 
-    if (IS_FIELD(SELVA_PARENTS_FIELD) ||
-        IS_FIELD(SELVA_ANCESTORS_FIELD)) {
-        return SVector_Size(&node->parents) > 0;
-    } else if (IS_FIELD(SELVA_CHILDREN_FIELD) ||
-               IS_FIELD(SELVA_DESCENDANTS_FIELD)) {
-        return SVector_Size(&node->children) > 0;
-    } else if (field_len > 0) {
-        /*
-         * Check if field is a custom edge field name.
-         */
-        const struct EdgeField *edge_field;
+    while (visited->slots[i]) {
+        i = (i + 1) & visited->mask;
+    }
+    visited->slots[i] = node;
+    visited->count++;
+}
 
-        edge_field = Edge_GetField(node, field_str, field_len);
-        if (!edge_field) {
-            return 0;
+static void visited_grow(struct resumable_visited *visited) {
+    SelvaHierarchyNode **old_slots = visited->slots;
+    const size_t old_size = old_slots ? visited->mask + 1 : 0;
+    const size_t new_size = old_size ? 2 * old_size : RESUMABLE_VISITED_INITIAL_SIZE;
+
+    visited->slots = selva_arena_calloc(SELVA_ARENA_QUERY, new_size, sizeof(SelvaHierarchyNode *));
+    visited->mask = new_size - 1;
+    visited->count = 0;
+
+    for (size_t i = 0; i < old_size; i++) {
+        if (old_slots[i]) {
+            visited_insert(visited, old_slots[i]);
         }
+    }
+    selva_arena_free(SELVA_ARENA_QUERY, old_slots);
+}
 
-        return SVector_Size(&edge_field->arcs);
+static int visited_has(const struct resumable_visited *visited, const SelvaHierarchyNode *node) {
+    if (!visited->slots) {
+        return 0;
+    }
+
+    for (size_t i = visited_hash(node) & visited->mask; visited->slots[i]; i = (i + 1) & visited->mask) {
+        if (visited->slots[i] == node) {
+            return 1;
+        }
     }
 
     return 0;
-#undef IS_FIELD
 }
 
 /**
- * DO NOT CALL DIRECTLY. USE verifyDetachableSubtree().
+ * Add a node to the visited set.
+ * @returns 0 if the node was added; 1 if the node was already visited.
  */
-static int verifyDetachableSubtreeNodeCb(
-        RedisModuleCtx *ctx __unused,
-        struct SelvaHierarchy *hierarchy __unused,
-        struct SelvaHierarchyNode *node,
-        void *arg) {
-    struct verifyDetachableSubtree *data = (struct verifyDetachableSubtree *)arg;
-    struct SVectorIterator it;
-    const SelvaHierarchyNode *parent;
-
-    /*
-     * If edges from other nodes are pointing to this node, we want to
-     * verify it later that all those edges are within the subtree.
-     */
-    if (Edge_Usage(node) & 2) {
-        struct SelvaObject *origins = node->metadata.edge_fields.origins;
-        SelvaObject_Iterator *it;
-        const char *origin;
-
-        it = SelvaObject_ForeachBegin(origins);
-        while ((origin = SelvaObject_ForeachKey(origins, &it))) {
-            Selva_NodeId origin_id;
-
-            Selva_NodeIdCpy(origin_id, origin);
-            SelvaSet_Add(&data->edge_origin_node_ids, origin_id);
-        }
+static int visited_add(struct resumable_visited *visited, SelvaHierarchyNode *node) {
+    if (visited_has(visited, node)) {
+        return 1;
     }
 
-    /*
-     * Check that there are no active subscription markers on the node.
-     * Subs starting from root can be ignored.
-     */
-    if (SelvaSubscriptions_hasActiveMarkers(&node->metadata)) {
-        data->err = "markers";
-        return 1;
+    /* Keep the load factor under 1/2. */
+    if (!visited->slots || 2 * (visited->count + 1) > visited->mask + 1) {
+        visited_grow(visited);
     }
+    visited_insert(visited, node);
 
-    /*
-     * A subtree is allowed be a acyclic but `node` must be its true parent,
-     * i.e. the whole subtree has only a single root node that is `node`.
-     */
-    SVector_ForeachBegin(&it, &node->parents);
-    if (node != data->head) {
-        while ((parent = SVector_Foreach(&it))) {
-            if (!Trx_HasVisited(&data->trx_cur, &parent->trx_label)) {
-                data->err = "not_tree";
-                return 1; /* not a proper subtree. */
-            }
-        }
+    return 0;
+}
+
+struct SelvaHierarchyResumable *SelvaHierarchy_NewResumable(enum SelvaTraversal dir, const Selva_NodeId head_id) {
+    struct SelvaHierarchyResumable *state;
+
+    if (get_resumable_kind(dir) == RESUMABLE_NONE) {
+        return NULL;
     }
 
-    Trx_Visit(&data->trx_cur, &node->trx_label);
+    state = selva_arena_calloc(SELVA_ARENA_QUERY, 1, sizeof(*state));
+    state->dir = dir;
+    memcpy(state->head_id, head_id, SELVA_NODE_ID_SIZE);
 
-    return 0;
+    return state;
+}
+
+void SelvaHierarchy_DestroyResumable(struct SelvaHierarchyResumable *state) {
+    if (!state) {
+        return;
+    }
+
+    selva_arena_free(SELVA_ARENA_QUERY, state->visited.slots);
+    selva_arena_free(SELVA_ARENA_QUERY, state->nodes);
+    selva_arena_free(SELVA_ARENA_QUERY, state);
+}
+
+/**
+ * Copy a traversal state.
+ * The copy is not in the list of saved traversals.
+ */
+static struct SelvaHierarchyResumable *clone_resumable(const struct SelvaHierarchyResumable *state) {
+    struct SelvaHierarchyResumable *clone;
+    const size_t nr_nodes = state->nodes_last - state->nodes_first;
+
+    clone = selva_arena_malloc(SELVA_ARENA_QUERY, sizeof(*clone));
+    memcpy(clone, state, sizeof(*clone));
+
+    /* Only the nodes still in the queue are copied. */
+    clone->nodes = nr_nodes ? selva_arena_malloc(SELVA_ARENA_QUERY, nr_nodes * sizeof(SelvaHierarchyNode *)) : NULL;
+    if (nr_nodes) {
+        memcpy(clone->nodes, state->nodes + state->nodes_first, nr_nodes * sizeof(SelvaHierarchyNode *));
+    }
+    clone->nodes_first = 0;
+    clone->nodes_last = nr_nodes;
+    clone->nodes_size = nr_nodes;
+
+    if (state->visited.slots) {
+        const size_t visited_size = (state->visited.mask + 1) * sizeof(SelvaHierarchyNode *);
+
+        clone->visited.slots = selva_arena_malloc(SELVA_ARENA_QUERY, visited_size);
+        memcpy(clone->visited.slots, state->visited.slots, visited_size);
+    }
+
+    return clone;
+}
+
+static void resumable_push(struct SelvaHierarchyResumable *state, SelvaHierarchyNode *node) {
+    if (state->nodes_last == state->nodes_size) {
+        if (state->nodes_first >= state->nodes_size / 2 && state->nodes_first > 0) {
+            /* Reclaim the space of the nodes already shifted out. */
+            memmove(state->nodes, state->nodes + state->nodes_first, (state->nodes_last - state->nodes_first) * sizeof(SelvaHierarchyNode *));
+            state->nodes_last -= state->nodes_first;
+            state->nodes_first = 0;
+        } else {
+            state->nodes_size = state->nodes_size ? 2 * state->nodes_size : HIERARCHY_INITIAL_VECTOR_LEN;
+            state->nodes = selva_arena_realloc(SELVA_ARENA_QUERY, state->nodes, state->nodes_size * sizeof(SelvaHierarchyNode *));
+        }
+    }
+
+    state->nodes[state->nodes_last++] = node;
+}
+
+/**
+ * Take the next node to be visited.
+ * @returns the node; NULL if the traversal is done.
+ */
+static SelvaHierarchyNode *resumable_next(struct SelvaHierarchyResumable *state, enum resumable_kind kind) {
+    while (state->nodes_first < state->nodes_last) {
+        SelvaHierarchyNode *node;
+
+        if (kind == RESUMABLE_DFS) {
+            node = state->nodes[--state->nodes_last];
+            if (visited_add(&state->visited, node)) {
+                /* Already visited. */
+                continue;
+            }
+        } else {
+            node = state->nodes[state->nodes_first++];
+        }
+
+        return node;
+    }
+
+    return NULL;
+}
+
+/**
+ * Add an adjacent node to be visited later.
+ * Same as BFS_VISIT_ADJACENT() for BFS and the same as dfs() for DFS.
+ */
+static int resumable_add(SelvaHierarchy *hierarchy, struct SelvaHierarchyResumable *state, enum resumable_kind kind, SelvaHierarchyNode *adj) {
+    if (kind != RESUMABLE_DFS && visited_has(&state->visited, adj)) {
+        return 0;
+    }
+
+    if (kind != RESUMABLE_FLAT && (adj->flags & SELVA_NODE_FLAGS_DETACHED)) {
+        int err;
+
+        err = restore_subtree(hierarchy, adj->id);
+        if (err) {
+            return err;
+        }
+    }
+
+    if (kind != RESUMABLE_DFS) {
+        (void)visited_add(&state->visited, adj);
+    }
+    resumable_push(state, adj);
+
+    return 0;
+}
+
+static int resumable_add_vec(SelvaHierarchy *hierarchy, struct SelvaHierarchyResumable *state, enum resumable_kind kind, const SVector *adj_vec) {
+    struct SVectorIterator it;
+    SelvaHierarchyNode *adj;
+
+    SVector_ForeachBegin(&it, adj_vec);
+    while ((adj = SVector_Foreach(&it))) {
+        int err;
+
+        err = resumable_add(hierarchy, state, kind, adj);
+        if (err) {
+            return err;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Evaluate the field names to be traversed from node.
+ */
+static int resumable_eval_fields(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyNode *node,
+        const struct SelvaHierarchyResumeArgs *args,
+        struct SelvaSet *fields) {
+    enum rpn_error rpn_err;
+
+    rpn_set_reg(args->rpn_ctx, 0, node->id, SELVA_NODE_ID_SIZE, RPN_SET_REG_FLAG_IS_NAN);
+    rpn_set_hierarchy_node(args->rpn_ctx, hierarchy, node);
+    rpn_set_obj(args->rpn_ctx, SelvaHierarchy_GetNodeObject(node));
+    rpn_err = rpn_selvaset(ctx, args->rpn_ctx, args->rpn_expr, fields);
+    if (rpn_err) {
+        SELVA_LOG(SELVA_LOGL_ERR, "RPN field selector expression failed for %.*s: %s\n",
+                  (int)SELVA_NODE_ID_SIZE, node->id,
+                  rpn_str_error[rpn_err]);
+        return SELVA_HIERARCHY_EINVAL;
+    }
+
+    return 0;
+}
+
+/**
+ * Add the adjacent nodes of node to be visited later.
+ * @param fields is the result of resumable_eval_fields() for expression traversals.
+ */
+static int resumable_expand(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyResumable *state,
+        enum resumable_kind kind,
+        struct SelvaHierarchyNode *node,
+        const struct SelvaHierarchyResumeArgs *args,
+        struct SelvaSet *fields) {
+    switch (state->dir) {
+    case SELVA_HIERARCHY_TRAVERSAL_BFS_ANCESTORS:
+    case SELVA_HIERARCHY_TRAVERSAL_DFS_ANCESTORS:
+        return resumable_add_vec(hierarchy, state, kind, &node->parents);
+    case SELVA_HIERARCHY_TRAVERSAL_BFS_DESCENDANTS:
+    case SELVA_HIERARCHY_TRAVERSAL_DFS_DESCENDANTS:
+        return resumable_add_vec(hierarchy, state, kind, &node->children);
+    case SELVA_HIERARCHY_TRAVERSAL_BFS_EDGE_FIELD:
+        {
+            const struct EdgeField *edge_field;
+
+            edge_field = Edge_GetField(node, args->field_str, args->field_len);
+            return edge_field ? resumable_add_vec(hierarchy, state, kind, &edge_field->arcs) : 0;
+        }
+    case SELVA_HIERARCHY_TRAVERSAL_REF:
+        {
+            struct SelvaSet *ref_set;
+            struct SelvaSetElement *el;
+
+            ref_set = SelvaObject_GetSetStr(GET_NODE_OBJ(node), args->field_str, args->field_len);
+            if (!ref_set) {
+                return SELVA_HIERARCHY_ENOENT;
+            }
+            if (ref_set->type != SELVA_SET_TYPE_RMSTRING) {
+                return SELVA_EINTYPE;
+            }
+
+            SELVA_SET_RMS_FOREACH(el, ref_set) {
+                Selva_NodeId nodeId;
+                SelvaHierarchyNode *adj;
+
+                Selva_RMString2NodeId(nodeId, el->value_rms);
+                adj = SelvaHierarchy_FindNode(hierarchy, nodeId);
+                if (adj) {
+                    resumable_push(state, adj);
+                }
+            }
+            return 0;
+        }
+    case SELVA_HIERARCHY_TRAVERSAL_EXPRESSION:
+    case SELVA_HIERARCHY_TRAVERSAL_BFS_EXPRESSION:
+        {
+            struct SelvaSetElement *field_el;
+
+            SELVA_SET_RMS_FOREACH(field_el, fields) {
+                size_t field_len;
+                const char *field_str = RedisModule_StringPtrLen(field_el->value_rms, &field_len);
+                enum SelvaTraversal field_type;
+                const SVector *adj_vec;
+                struct SVectorIterator it;
+                SelvaHierarchyNode *adj;
+
+                adj_vec = get_adj_vec(node, field_str, field_len, &field_type);
+                if (!adj_vec) {
+                    continue;
+                }
+
+                SVector_ForeachBegin(&it, adj_vec);
+                while ((adj = SVector_Foreach(&it))) {
+                    int err;
+
+                    if (field_type == SELVA_HIERARCHY_TRAVERSAL_EDGE_FIELD && args->edge_filter &&
+                        !visited_has(&state->visited, adj) &&
+                        !exec_edge_filter(ctx, hierarchy, args->edge_filter_ctx, args->edge_filter, adj_vec, adj)) {
+                        continue;
+                    }
+
+                    err = resumable_add(hierarchy, state, kind, adj);
+                    if (err) {
+                        return err;
+                    }
+                }
+            }
+            return 0;
+        }
+    default:
+        return SELVA_HIERARCHY_ENOTSUP;
+    }
+}
+
+static int resume_list(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyResumable *state,
+        struct SelvaHierarchyNode *head,
+        const struct SelvaHierarchyResumeArgs *args,
+        const struct SelvaHierarchyCallback *cb) {
+    const SVector *adj_vec;
+    struct SVectorIterator it;
+    SelvaHierarchyNode *node;
+
+    if (state->dir == SELVA_HIERARCHY_TRAVERSAL_CHILDREN) {
+        adj_vec = &head->children;
+    } else if (state->dir == SELVA_HIERARCHY_TRAVERSAL_PARENTS) {
+        adj_vec = &head->parents;
+    } else {
+        const struct EdgeField *edge_field;
+
+        edge_field = Edge_GetField(head, args->field_str, args->field_len);
+        if (!edge_field) {
+            return 1;
+        }
+        adj_vec = &edge_field->arcs;
+    }
+
+    if (state->started) {
+        SVector_ForeachBeginAfter(&it, adj_vec, state->index, &state->last);
+    } else {
+        SVector_ForeachBegin(&it, adj_vec);
+        state->started = 1;
+    }
+
+    while ((node = SVector_Foreach(&it))) {
+        state->index++;
+        memcpy(state->last.id, node->id, SELVA_NODE_ID_SIZE);
+        Trx_Sync(&hierarchy->trx_state, &node->trx_label);
+
+        if (cb->node_cb(ctx, hierarchy, node, cb->node_arg)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int SelvaHierarchy_TraverseResume(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyResumable *state,
+        const struct SelvaHierarchyResumeArgs *args,
+        const struct SelvaHierarchyCallback *cb) {
+    const enum resumable_kind kind = get_resumable_kind(state->dir);
+    const int is_expression = state->dir & (SELVA_HIERARCHY_TRAVERSAL_EXPRESSION | SELVA_HIERARCHY_TRAVERSAL_BFS_EXPRESSION);
+    SelvaHierarchyNode *head;
+    SelvaHierarchyNode *node;
+    int err;
+
+    head = SelvaHierarchy_FindNode(hierarchy, state->head_id);
+    if (!head) {
+        return SELVA_HIERARCHY_ENOENT;
+    }
+
+    if (kind == RESUMABLE_NODE) {
+        if (!state->started) {
+            state->started = 1;
+            Trx_Sync(&hierarchy->trx_state, &head->trx_label);
+            cb->node_cb(ctx, hierarchy, head, cb->node_arg);
+        }
+        return 1;
+    } else if (kind == RESUMABLE_LIST) {
+        return resume_list(ctx, hierarchy, state, head, args, cb);
+    }
+
+    if (!state->started) {
+        state->started = 1;
+        Trx_Sync(&hierarchy->trx_state, &head->trx_label);
+
+        if (kind == RESUMABLE_FLAT) {
+            struct SelvaSet fields;
+
+            SelvaSet_Init(&fields, SELVA_SET_TYPE_RMSTRING);
+            err = is_expression ? resumable_eval_fields(ctx, hierarchy, head, args, &fields) : 0;
+            if (!err) {
+                err = resumable_expand(ctx, hierarchy, state, kind, head, args, &fields);
+            }
+            SelvaSet_Destroy(&fields);
+            if (err) {
+                return err;
+            }
+        } else {
+            if (kind == RESUMABLE_BFS) {
+                (void)visited_add(&state->visited, head);
+            }
+            resumable_push(state, head);
+        }
+    }
+
+    while ((node = resumable_next(state, kind))) {
+        struct SelvaSet fields;
+        int stop;
+
+        SelvaSet_Init(&fields, SELVA_SET_TYPE_RMSTRING);
+        if (kind != RESUMABLE_FLAT && is_expression &&
+            resumable_eval_fields(ctx, hierarchy, node, args, &fields)) {
+            /* Same as bfs_expression(), the node is skipped. */
+            SelvaSet_Destroy(&fields);
+            continue;
+        }
+
+        Trx_Sync(&hierarchy->trx_state, &node->trx_label);
+        stop = cb->node_cb(ctx, hierarchy, node, cb->node_arg);
+
+        err = (kind != RESUMABLE_FLAT) ? resumable_expand(ctx, hierarchy, state, kind, node, args, &fields) : 0;
+        SelvaSet_Destroy(&fields);
+        if (err) {
+            return err;
+        }
+        if (stop) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Drop all saved traversals.
+ */
+static void drop_resumables(struct SelvaHierarchy *hierarchy) {
+    struct SelvaHierarchyResumable *state;
+
+    while ((state = TAILQ_FIRST(&hierarchy->resumable.head))) {
+        TAILQ_REMOVE(&hierarchy->resumable.head, state, _entry);
+        SelvaHierarchy_DestroyResumable(state);
+    }
+    hierarchy->resumable.nr_saved = 0;
+}
+
+static struct SelvaHierarchyResumable *find_resumable(struct SelvaHierarchy *hierarchy, uint64_t id) {
+    struct SelvaHierarchyResumable *state;
+
+    TAILQ_FOREACH(state, &hierarchy->resumable.head, _entry) {
+        if (state->id == id) {
+            return state;
+        }
+    }
+
+    return NULL;
+}
+
+static void drop_resumable(struct SelvaHierarchy *hierarchy, struct SelvaHierarchyResumable *state) {
+    TAILQ_REMOVE(&hierarchy->resumable.head, state, _entry);
+    SelvaHierarchy_DestroyResumable(state);
+    hierarchy->resumable.nr_saved--;
+}
+
+uint64_t SelvaHierarchy_SaveResumable(struct SelvaHierarchy *hierarchy, struct SelvaHierarchyResumable *state) {
+    struct SelvaHierarchyResumable *first = TAILQ_FIRST(&hierarchy->resumable.head);
+
+    /*
+     * The saved traversals can't be resumed after a node or an edge was
+     * removed so they can all be dropped.
+     */
+    if (first && first->generation != hierarchy->resumable.generation) {
+        drop_resumables(hierarchy);
+    }
+
+    if (hierarchy->resumable.nr_saved >= HIERARCHY_MAX_RESUMABLE) {
+        drop_resumable(hierarchy, TAILQ_LAST(&hierarchy->resumable.head, hierarchy_resumable_list));
+    }
+
+    state->id = ++hierarchy->resumable.next_id;
+    state->generation = hierarchy->resumable.generation;
+    TAILQ_INSERT_HEAD(&hierarchy->resumable.head, state, _entry);
+    hierarchy->resumable.nr_saved++;
+
+    return state->id;
+}
+
+struct SelvaHierarchyResumable *SelvaHierarchy_TakeResumable(struct SelvaHierarchy *hierarchy, uint64_t id) {
+    struct SelvaHierarchyResumable *state;
+    struct SelvaHierarchyResumable *clone;
+
+    state = find_resumable(hierarchy, id);
+    if (!state) {
+        return NULL;
+    }
+
+    if (state->generation != hierarchy->resumable.generation) {
+        drop_resumable(hierarchy, state);
+        return NULL;
+    }
+
+    /*
+     * The client has received the page that ended at state, so the state
+     * the page was resumed from is no longer needed for a retry.
+     */
+    if (state->prev_id) {
+        struct SelvaHierarchyResumable *prev = find_resumable(hierarchy, state->prev_id);
+
+        if (prev) {
+            drop_resumable(hierarchy, prev);
+        }
+        state->prev_id = 0;
+    }
+
+    clone = clone_resumable(state);
+    clone->prev_id = id;
+
+    return clone;
+}
+
+/**
+ * A field name in a list of field names separated by newlines.
+ */
+struct edge_field_name {
+    const char *str;
+    size_t len;
+};
+
+/**
+ * Get an upper bound for the number of names in a list of field names.
+ */
+static size_t count_field_names(const char *list_str, size_t list_len) {
+    size_t n = 1;
+
+    for (size_t i = 0; i < list_len; i++) {
+        n += list_str[i] == '\n';
+    }
+
+    return n;
+}
+
+/**
+ * Split a list of field names separated by newlines.
+ * The list is given by the client and the number of names is unbounded, thus
+ * the array is allocated from the heap.
+ * @param[out] names_out is set to an array that must be freed with selva_free().
+ * @returns the number of field names.
+ */
+static size_t split_field_names(struct edge_field_name **names_out, const char *list_str, size_t list_len) {
+    struct edge_field_name *names = selva_malloc(count_field_names(list_str, list_len) * sizeof(*names));
+    const char *end = list_str + list_len;
+    size_t n = 0;
+
+    *names_out = names;
+
+    while (list_str < end) {
+        const char *next = memchr(list_str, '\n', end - list_str);
+
+        if (!next) {
+            next = end;
+        }
+        if (next > list_str) {
+            names[n].str = list_str;
+            names[n].len = next - list_str;
+            n++;
+        }
+
+        list_str = next + 1;
+    }
+
+    return n;
+}
+
+/**
+ * One side of a bidirectional BFS.
+ */
+struct path_search {
+    struct trx trx_cur;
+    struct path_visit {
+        SelvaHierarchyNode *node;
+        ssize_t pred; /*!< Index of the previous node on the path; -1 for the start. */
+    } *visits;
+    size_t len; /*!< Number of nodes visited. */
+    size_t size; /*!< Allocated size of visits. */
+    size_t level_begin; /*!< Index of the first node of the frontier. */
+};
+
+static void path_search_push(struct path_search *side, SelvaHierarchyNode *node, ssize_t pred) {
+    if (side->len == side->size) {
+        side->size = side->size ? 2 * side->size : HIERARCHY_INITIAL_VECTOR_LEN;
+        side->visits = selva_arena_realloc(SELVA_ARENA_QUERY, side->visits, side->size * sizeof(struct path_visit));
+    }
+
+    side->visits[side->len++] = (struct path_visit){
+        .node = node,
+        .pred = pred,
+    };
+}
+
+static ssize_t path_search_index(const struct path_search *side, const SelvaHierarchyNode *node) {
+    for (size_t i = 0; i < side->len; i++) {
+        if (side->visits[i].node == node) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Visit node found from side->visits[pred].
+ * @returns 1 if node was already visited by the other side;
+ *          0 if the search should continue;
+ *          Otherwise a selva error.
+ */
+static int path_search_visit(
+        struct SelvaHierarchy *hierarchy,
+        struct path_search *side,
+        const struct path_search *other,
+        SelvaHierarchyNode *node,
+        ssize_t pred) {
+    if (Trx_HasVisited(&other->trx_cur, &node->trx_label)) {
+        return 1;
+    }
+
+    if (Trx_Visit(&side->trx_cur, &node->trx_label)) {
+        if (node->flags & SELVA_NODE_FLAGS_DETACHED) {
+            int err = restore_subtree(hierarchy, node->id);
+            if (err) {
+                return err;
+            }
+        }
+
+        path_search_push(side, node, pred);
+    }
+
+    return 0;
+}
+
+/**
+ * Expand the frontier of the side searching forward from the source node.
+ * @param[out] meet_from is set to the index of the node in side that has an
+ *                       edge to meet_node if the searches meet.
+ * @param[out] meet_node is set to the node visited by the other side.
+ * @returns 1 if the searches met; 0 if the search should continue;
+ *          Otherwise a selva error.
+ */
+static int path_search_expand_fwd(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct path_search *side,
+        const struct path_search *other,
+        const struct edge_field_name *fields,
+        size_t nr_fields,
+        struct rpn_ctx *edge_filter_ctx,
+        const struct rpn_expression *edge_filter,
+        ssize_t *meet_from,
+        SelvaHierarchyNode **meet_node) {
+    const size_t end = side->len;
+
+    for (size_t i = side->level_begin; i < end; i++) {
+        SelvaHierarchyNode *node = side->visits[i].node;
+
+        for (size_t j = 0; j < nr_fields; j++) {
+            const struct EdgeField *edge_field;
+            struct SVectorIterator it;
+            SelvaHierarchyNode *adj;
+
+            edge_field = Edge_GetField(node, fields[j].str, fields[j].len);
+            if (!edge_field) {
+                continue;
+            }
+
+            SVector_ForeachBegin(&it, &edge_field->arcs);
+            prefetch_adjacents_begin(&edge_field->arcs);
+            while ((adj = SVector_Foreach(&it))) {
+                int res;
+
+                prefetch_adjacents_next(&it);
+
+                if (Trx_HasVisited(&side->trx_cur, &adj->trx_label) ||
+                    (edge_filter && !exec_edge_filter(ctx, hierarchy, edge_filter_ctx, edge_filter, &edge_field->arcs, adj))) {
+                    continue;
+                }
+
+                res = path_search_visit(hierarchy, side, other, adj, i);
+                if (res == 1) {
+                    *meet_from = i;
+                    *meet_node = adj;
+                }
+                if (res) {
+                    return res;
+                }
+            }
+        }
+    }
+
+    side->level_begin = end;
+    return 0;
+}
+
+/**
+ * Expand the frontier of the side searching backward from the destination node.
+ * The edges are followed backwards using the edge origin references of each
+ * node. Returns like path_search_expand_fwd().
+ */
+static int path_search_expand_bck(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct path_search *side,
+        const struct path_search *other,
+        const struct edge_field_name *fields,
+        size_t nr_fields,
+        struct rpn_ctx *edge_filter_ctx,
+        const struct rpn_expression *edge_filter,
+        ssize_t *meet_from,
+        SelvaHierarchyNode **meet_node) {
+    const size_t end = side->len;
+
+    for (size_t i = side->level_begin; i < end; i++) {
+        SelvaHierarchyNode *node = side->visits[i].node;
+        struct SelvaObject *origins = node->metadata.edge_fields.origins;
+        void *obj_it;
+        SVector *origin_fields;
+        const char *src_node_id_str;
+
+        if (!origins) {
+            continue;
+        }
+
+        obj_it = SelvaObject_ForeachBegin(origins);
+        while ((origin_fields = SelvaObject_ForeachValue(origins, &obj_it, &src_node_id_str, SELVA_OBJECT_ARRAY))) {
+            Selva_NodeId src_node_id;
+            SelvaHierarchyNode *src;
+            struct SVectorIterator it;
+            struct EdgeField *edge_field;
+            int res;
+
+            Selva_NodeIdCpy(src_node_id, src_node_id_str);
+            src = SelvaHierarchy_FindNode(hierarchy, src_node_id);
+            if (!src || Trx_HasVisited(&side->trx_cur, &src->trx_label)) {
+                continue;
+            }
+
+            /*
+             * Find an edge from src to node in one of the fields.
+             */
+            SVector_ForeachBegin(&it, origin_fields);
+            while ((edge_field = SVector_Foreach(&it))) {
+                size_t j;
+
+                for (j = 0; j < nr_fields; j++) {
+                    if (Edge_GetField(src, fields[j].str, fields[j].len) == edge_field) {
+                        break;
+                    }
+                }
+                if (j < nr_fields &&
+                    (!edge_filter || exec_edge_filter(ctx, hierarchy, edge_filter_ctx, edge_filter, &edge_field->arcs, node))) {
+                    break;
+                }
+            }
+            if (!edge_field) {
+                continue;
+            }
+
+            res = path_search_visit(hierarchy, side, other, src, i);
+            if (res == 1) {
+                *meet_from = i;
+                *meet_node = src;
+            }
+            if (res) {
+                return res;
+            }
+        }
+    }
+
+    side->level_begin = end;
+    return 0;
+}
+
+/**
+ * Build a path from the results of a bidirectional search.
+ * There must be an edge from fwd->visits[fwd_i] to bck->visits[bck_i].
+ */
+static void build_path(SVector *path, const struct path_search *fwd, ssize_t fwd_i, const struct path_search *bck, ssize_t bck_i) {
+    for (ssize_t i = fwd_i; i >= 0; i = fwd->visits[i].pred) {
+        SVector_InsertIndex(path, 0, fwd->visits[i].node);
+    }
+    for (ssize_t i = bck_i; i >= 0; i = bck->visits[i].pred) {
+        SVector_Insert(path, bck->visits[i].node);
+    }
+}
+
+int SelvaHierarchy_EdgeShortestPath(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        const Selva_NodeId src_id,
+        const Selva_NodeId dst_id,
+        const char *fields_str,
+        size_t fields_len,
+        struct rpn_ctx *edge_filter_ctx,
+        const struct rpn_expression *edge_filter,
+        SVector *path) {
+    struct edge_field_name *fields __selva_autofree = NULL;
+    const size_t nr_fields = split_field_names(&fields, fields_str, fields_len);
+    SelvaHierarchyNode *src;
+    SelvaHierarchyNode *dst;
+    struct path_search fwd = { 0 };
+    struct path_search bck = { 0 };
+    int err = 0;
+
+    src = SelvaHierarchy_FindNode(hierarchy, src_id);
+    dst = SelvaHierarchy_FindNode(hierarchy, dst_id);
+    if (!src || !dst) {
+        return SELVA_HIERARCHY_ENOENT;
+    }
+
+    if (src == dst) {
+        SVector_Insert(path, src);
+        return 0;
+    }
+
+    if (Trx_Begin(&hierarchy->trx_state, &fwd.trx_cur)) {
+        return SELVA_HIERARCHY_ETRMAX;
+    }
+    if (Trx_Begin(&hierarchy->trx_state, &bck.trx_cur)) {
+        Trx_End(&hierarchy->trx_state, &fwd.trx_cur);
+        return SELVA_HIERARCHY_ETRMAX;
+    }
+
+    Trx_Visit(&fwd.trx_cur, &src->trx_label);
+    path_search_push(&fwd, src, -1);
+    Trx_Visit(&bck.trx_cur, &dst->trx_label);
+    path_search_push(&bck, dst, -1);
+
+    /*
+     * Expand a whole level of the smaller frontier at a time until the
+     * searches meet. The first meeting point is always on a shortest path
+     * because all the nodes of a frontier are equally far from its start.
+     */
+    while (fwd.level_begin < fwd.len && bck.level_begin < bck.len) {
+        ssize_t meet_from;
+        SelvaHierarchyNode *meet_node;
+
+        if (fwd.len - fwd.level_begin <= bck.len - bck.level_begin) {
+            err = path_search_expand_fwd(ctx, hierarchy, &fwd, &bck, fields, nr_fields, edge_filter_ctx, edge_filter, &meet_from, &meet_node);
+            if (err == 1) {
+                build_path(path, &fwd, meet_from, &bck, path_search_index(&bck, meet_node));
+            }
+        } else {
+            err = path_search_expand_bck(ctx, hierarchy, &bck, &fwd, fields, nr_fields, edge_filter_ctx, edge_filter, &meet_from, &meet_node);
+            if (err == 1) {
+                build_path(path, &fwd, path_search_index(&fwd, meet_node), &bck, meet_from);
+            }
+        }
+        if (err) {
+            if (err == 1) {
+                err = 0;
+            }
+            break;
+        }
+    }
+
+    Trx_End(&hierarchy->trx_state, &bck.trx_cur);
+    Trx_End(&hierarchy->trx_state, &fwd.trx_cur);
+    selva_arena_free(SELVA_ARENA_QUERY, fwd.visits);
+    selva_arena_free(SELVA_ARENA_QUERY, bck.visits);
+
+    return err;
+}
+
+int SelvaHierarchy_TraverseEdgeFieldsBfs(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        const Selva_NodeId id,
+        const char *fields_str,
+        size_t fields_len,
+        long long max_depth,
+        struct rpn_ctx *edge_filter_ctx,
+        const struct rpn_expression *edge_filter,
+        const struct SelvaHierarchyCallback * restrict cb) {
+    struct edge_field_name *fields __selva_autofree = NULL;
+    const size_t nr_fields = split_field_names(&fields, fields_str, fields_len);
+    SelvaHierarchyNode *head;
+    long long depth = -1;
+    size_t level_left = 0; /* Nodes left in the queue from the current level. */
+
+    head = SelvaHierarchy_FindNode(hierarchy, id);
+    if (!head) {
+        return SELVA_HIERARCHY_ENOENT;
+    }
+
+    BFS_TRAVERSE(ctx, hierarchy, head, cb) {
+        /*
+         * The queue contains exactly the next level when the first node of a
+         * level is shifted.
+         */
+        if (level_left == 0) {
+            depth++;
+            level_left = _bfs_q.len;
+        } else {
+            level_left--;
+        }
+
+        BFS_VISIT_NODE(ctx, hierarchy);
+
+        if (depth >= max_depth) {
+            continue;
+        }
+
+        for (size_t i = 0; i < nr_fields; i++) {
+            const struct EdgeField *edge_field;
+            struct SVectorIterator it;
+            SelvaHierarchyNode *adj;
+
+            edge_field = Edge_GetField(node, fields[i].str, fields[i].len);
+            if (!edge_field) {
+                continue;
+            }
+
+            SVector_ForeachBegin(&it, &edge_field->arcs);
+            prefetch_adjacents_begin(&edge_field->arcs);
+            while ((adj = SVector_Foreach(&it))) {
+                prefetch_adjacents_next(&it);
+
+                if (edge_filter &&
+                    !Trx_HasVisited(&trx_cur, &adj->trx_label) && /* skip if already visited. */
+                    !exec_edge_filter(ctx, hierarchy, edge_filter_ctx, edge_filter, &edge_field->arcs, adj)) {
+                    continue;
+                }
+
+                BFS_VISIT_ADJACENT(ctx, hierarchy, fields[i].str, fields[i].len, adj);
+            }
+        }
+    } BFS_TRAVERSE_END(hierarchy);
+
+    return 0;
+}
+
+int SelvaHierarchy_TraverseArray(
+        struct RedisModuleCtx *ctx __unused,
+        struct SelvaHierarchy *hierarchy,
+        const Selva_NodeId id,
+        const char *field_str,
+        size_t field_len,
+        const struct SelvaObjectArrayForeachCallback *cb) {
+    struct SelvaHierarchyNode *head;
+
+    head = SelvaHierarchy_FindNode(hierarchy, id);
+    if (!head) {
+        return SELVA_HIERARCHY_ENOENT;
+    }
+
+    Trx_Sync(&hierarchy->trx_state, &head->trx_label);
+
+    return SelvaObject_ArrayForeach(GET_NODE_OBJ(head), field_str, field_len, cb);
+}
+
+int SelvaHierarchy_TraverseSet(
+        struct RedisModuleCtx *ctx __unused,
+        struct SelvaHierarchy *hierarchy,
+        const Selva_NodeId id,
+        const char *field_str,
+        size_t field_len,
+        const struct SelvaObjectSetForeachCallback *cb) {
+    struct SelvaHierarchyNode *head;
+
+    head = SelvaHierarchy_FindNode(hierarchy, id);
+    if (!head) {
+        return SELVA_HIERARCHY_ENOENT;
+    }
+
+    Trx_Sync(&hierarchy->trx_state, &head->trx_label);
+
+    return SelvaObject_SetForeach(GET_NODE_OBJ(head), field_str, field_len, cb);
+}
+
+int SelvaHierarchy_IsNonEmptyField(const struct SelvaHierarchyNode *node, const char *field_str, size_t field_len) {
+#define IS_FIELD(name) \
+    (field_len == (sizeof(name) - 1) && !memcmp(name, field_str, sizeof(name) - 1))
+
+    if (IS_FIELD(SELVA_PARENTS_FIELD) ||
+        IS_FIELD(SELVA_ANCESTORS_FIELD)) {
+        return SVector_Size(&node->parents) > 0;
+    } else if (IS_FIELD(SELVA_CHILDREN_FIELD) ||
+               IS_FIELD(SELVA_DESCENDANTS_FIELD)) {
+        return SVector_Size(&node->children) > 0;
+    } else if (field_len > 0) {
+        /*
+         * Check if field is a custom edge field name.
+         */
+        const struct EdgeField *edge_field;
+
+        edge_field = Edge_GetField(node, field_str, field_len);
+        if (!edge_field) {
+            return 0;
+        }
+
+        return SVector_Size(&edge_field->arcs);
+    }
+
+    return 0;
+#undef IS_FIELD
+}
+
+size_t SelvaHierarchy_GetFanOut(const struct SelvaHierarchyNode *node, enum SelvaTraversal dir) {
+    switch (dir) {
+    case SELVA_HIERARCHY_TRAVERSAL_NODE:
+        return 1;
+    case SELVA_HIERARCHY_TRAVERSAL_CHILDREN:
+    case SELVA_HIERARCHY_TRAVERSAL_BFS_DESCENDANTS:
+    case SELVA_HIERARCHY_TRAVERSAL_DFS_DESCENDANTS:
+    case SELVA_HIERARCHY_TRAVERSAL_DFS_FULL:
+        return SVector_Size(&node->children);
+    case SELVA_HIERARCHY_TRAVERSAL_PARENTS:
+    case SELVA_HIERARCHY_TRAVERSAL_BFS_ANCESTORS:
+    case SELVA_HIERARCHY_TRAVERSAL_DFS_ANCESTORS:
+        return SVector_Size(&node->parents);
+    default:
+        return 0;
+    }
+}
+
+/**
+ * DO NOT CALL DIRECTLY. USE verifyDetachableSubtree().
+ */
+static int verifyDetachableSubtreeNodeCb(
+        RedisModuleCtx *ctx __unused,
+        struct SelvaHierarchy *hierarchy __unused,
+        struct SelvaHierarchyNode *node,
+        void *arg) {
+    struct verifyDetachableSubtree *data = (struct verifyDetachableSubtree *)arg;
+    struct SVectorIterator it;
+    const SelvaHierarchyNode *parent;
+
+    /*
+     * If edges from other nodes are pointing to this node, we want to
+     * verify it later that all those edges are within the subtree.
+     */
+    if (Edge_Usage(node) & 2) {
+        struct SelvaObject *origins = node->metadata.edge_fields.origins;
+        SelvaObject_Iterator *it;
+        const char *origin;
+
+        it = SelvaObject_ForeachBegin(origins);
+        while ((origin = SelvaObject_ForeachKey(origins, &it))) {
+            Selva_NodeId origin_id;
+
+            Selva_NodeIdCpy(origin_id, origin);
+            SelvaSet_Add(&data->edge_origin_node_ids, origin_id);
+        }
+    }
+
+    /*
+     * Check that there are no active subscription markers on the node.
+     * Subs starting from root can be ignored.
+     */
+    if (SelvaSubscriptions_hasActiveMarkers(&node->metadata)) {
+        data->err = "markers";
+        return 1;
+    }
+
+    /*
+     * A subtree is allowed be a acyclic but `node` must be its true parent,
+     * i.e. the whole subtree has only a single root node that is `node`.
+     */
+    SVector_ForeachBegin(&it, &node->parents);
+    if (node != data->head) {
+        while ((parent = SVector_Foreach(&it))) {
+            if (!Trx_HasVisited(&data->trx_cur, &parent->trx_label)) {
+                data->err = "not_tree";
+                return 1; /* not a proper subtree. */
+            }
+        }
+    }
+
+    Trx_Visit(&data->trx_cur, &node->trx_label);
+
+    return 0;
 }
 
 /**
@@ -2916,6 +4725,7 @@ static int restore_subtree(SelvaHierarchy *hierarchy, const Selva_NodeId id) {
         err = restore_compressed_subtree(hierarchy, compressed);
         if (!err) {
             rms_free_compressed(compressed);
+            hierarchy->detached.nr_restored++;
         }
     }
 
@@ -3020,6 +4830,12 @@ static int load_metadata(RedisModuleIO *io, int encver, SelvaHierarchy *hierarch
         return SELVA_ENOENT;
     }
 
+    /*
+     * The alias index is saved with the hierarchy but it doesn't cover
+     * subtrees loaded from a string nor older encoding versions.
+     */
+    add_node_aliases(hierarchy, node->id, GET_NODE_OBJ(node));
+
     return 0;
 }
 
@@ -3258,6 +5074,13 @@ static void *Hierarchy_RDBLoad(RedisModuleIO *io, int encver) {
         goto error;
     }
 
+    err = SelvaAliases_RdbLoad(io, encver, hierarchy);
+    if (err) {
+        SELVA_LOG(SELVA_LOGL_CRIT, "Failed to load the aliases: %s",
+                  getSelvaErrorStr(err));
+        goto error;
+    }
+
     err = load_tree(io, encver, hierarchy);
     if (err) {
         goto error;
@@ -3394,6 +5217,7 @@ static void Hierarchy_RDBSave(RedisModuleIO *io, void *value) {
      * Serialization format:
      * TYPE_MAP
      * EDGE_CONSTRAINTS
+     * ALIASES
      * NODE_ID1 | FLAGS | METADATA | NR_CHILDREN | CHILD_ID_0,..
      * NODE_ID2 | FLAGS | METADATA | NR_CHILDREN | ...
      * HIERARCHY_RDB_EOF
@@ -3401,6 +5225,7 @@ static void Hierarchy_RDBSave(RedisModuleIO *io, void *value) {
     isRdbSaving = 1;
     SelvaObjectTypeRDBSave(io, SELVA_HIERARCHY_GET_TYPES_OBJ(hierarchy), NULL);
     EdgeConstraint_RdbSave(io, &hierarchy->edge_field_constraints);
+    SelvaAliases_RdbSave(io, &hierarchy->aliases);
     save_hierarchy(io, hierarchy);
     isRdbSaving = 0;
 }
@@ -3448,6 +5273,7 @@ static void *Hierarchy_SubtreeRDBLoad(RedisModuleIO *io, int encver) {
     }
 
     SelvaHierarchyDetached_RemoveNode(RedisModule_GetContextFromIO(io), hierarchy, nodeId);
+    memcpy(subtree_head_id, nodeId, SELVA_NODE_ID_SIZE);
 
     err = load_tree(io, encver, hierarchy);
     if (err) {
@@ -3503,6 +5329,10 @@ void HierarchyTypeFree(void *value) {
 /*
  * SELVA.HIERARCHY.DEL HIERARCHY_KEY FLAGS [NODE_ID1[, NODE_ID2, ...]]
  * If no NODE_IDs are given then nothing will be deleted.
+ * FLAGS:
+ * - F = Force delete descendants
+ * - I = Reply with the deleted nodeIds
+ * - L = Lazy; free the memory of the deleted nodes in the background
  */
 int SelvaHierarchy_DelNodeCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_AutoMemory(ctx);
@@ -3526,6 +5356,7 @@ int SelvaHierarchy_DelNodeCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
     for (size_t i = 0; i < flags_len; i++) {
         flags |= flags_str[i] == 'F' ? DEL_HIERARCHY_NODE_FORCE : 0;
         flags |= flags_str[i] == 'I' ? DEL_HIERARCHY_NODE_REPLY_IDS : 0;
+        flags |= flags_str[i] == 'L' ? DEL_HIERARCHY_NODE_LAZY : 0;
     }
 
     if ((flags & DEL_HIERARCHY_NODE_REPLY_IDS) != 0) {
@@ -3565,40 +5396,255 @@ int SelvaHierarchy_DelNodeCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
 
 int SelvaHierarchy_HeadsCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_AutoMemory(ctx);
-    const SelvaHierarchy *hierarchy;
+    const SelvaHierarchy *hierarchy;
+
+    if (argc != 2) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    /*
+     * Open the Redis key.
+     */
+    hierarchy = SelvaModify_OpenHierarchy(ctx, argv[1], REDISMODULE_READ);
+    if (!hierarchy) {
+        return REDISMODULE_OK;
+    }
+
+    struct SVectorIterator it;
+    const SelvaHierarchyNode *node;
+
+    RedisModule_ReplyWithArray(ctx, SVector_Size(&hierarchy->heads));
+
+    SVector_ForeachBegin(&it, &hierarchy->heads);
+    while ((node = SVector_Foreach(&it))) {
+        RedisModule_ReplyWithStringBuffer(ctx, node->id, Selva_NodeIdLen(node->id));
+    }
+
+    return REDISMODULE_OK;
+}
+
+int SelvaHierarchy_ParentsCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 3) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    /*
+     * Open the Redis key.
+     */
+    SelvaHierarchy *hierarchy = SelvaModify_OpenHierarchy(ctx, argv[1], REDISMODULE_READ);
+    if (!hierarchy) {
+        return REDISMODULE_OK;
+    }
+
+    /*
+     * Find the node.
+     */
+    Selva_NodeId nodeId;
+
+    Selva_RMString2NodeId(nodeId, argv[2]);
+    const SelvaHierarchyNode *node = SelvaHierarchy_FindNode(hierarchy, nodeId);
+    if (!node) {
+        return replyWithSelvaError(ctx, SELVA_HIERARCHY_ENOENT);
+    }
+
+    struct SVectorIterator it;
+    const SelvaHierarchyNode *parent;
+    const SVector *parents;
+
+#if HIERARCHY_SORT_BY_DEPTH
+    SVECTOR_AUTOFREE(parents_d);
+
+    if (unlikely(!SVector_Clone(&parents_d, &node->parents, SVector_HierarchyNode_depth_compare))) {
+        return replyWithSelvaError(ctx, SELVA_HIERARCHY_ENOMEM);
+    }
+
+    parents = &parents_d;
+#else
+    parents = &node->parents;
+#endif
+
+    RedisModule_ReplyWithArray(ctx, SVector_Size(parents));
+
+    SVector_ForeachBegin(&it, parents);
+    while ((parent = SVector_Foreach(&it))) {
+        RedisModule_ReplyWithStringBuffer(ctx, parent->id, Selva_NodeIdLen(parent->id));
+    }
+
+    return REDISMODULE_OK;
+}
+
+int SelvaHierarchy_ChildrenCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 3) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    /*
+     * Open the Redis key.
+     */
+    SelvaHierarchy *hierarchy = SelvaModify_OpenHierarchy(ctx, argv[1], REDISMODULE_READ);
+    if (!hierarchy) {
+        return REDISMODULE_OK;
+    }
+
+    /*
+     * Find the node.
+     */
+    Selva_NodeId nodeId;
+
+    Selva_RMString2NodeId(nodeId, argv[2]);
+    const SelvaHierarchyNode *node = SelvaHierarchy_FindNode(hierarchy, nodeId);
+    if (!node) {
+        return replyWithSelvaError(ctx, SELVA_HIERARCHY_ENOENT);
+    }
+
+    RedisModule_ReplyWithArray(ctx, SVector_Size(&node->children));
+
+    struct SVectorIterator it;
+    const SelvaHierarchyNode *child;
+
+    SVector_ForeachBegin(&it, &node->children);
+    while((child = SVector_Foreach(&it))) {
+        RedisModule_ReplyWithStringBuffer(ctx, child->id, Selva_NodeIdLen(child->id));
+    }
+
+    return REDISMODULE_OK;
+}
+
+int SelvaHierarchy_EdgeListCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 3 && argc != 4) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    /*
+     * Open the Redis key.
+     */
+    SelvaHierarchy *hierarchy = SelvaModify_OpenHierarchy(ctx, argv[1], REDISMODULE_READ);
+    if (!hierarchy) {
+        return REDISMODULE_OK;
+    }
+
+    /*
+     * Find the node.
+     */
+    Selva_NodeId nodeId;
+
+    Selva_RMString2NodeId(nodeId, argv[2]);
+    SelvaHierarchyNode *node = SelvaHierarchy_FindNode(hierarchy, nodeId);
+    if (!node) {
+        return replyWithSelvaError(ctx, SELVA_HIERARCHY_ENOENT);
+    }
+
+    struct SelvaObject *obj = node->metadata.edge_fields.edges;
+
+    if (!obj) {
+        /* No custom edges set. */
+        return RedisModule_ReplyWithArray(ctx, 0);
+    }
+
+    const RedisModuleString *key_name = argc == 4 ? argv[3] : NULL;
+    if (key_name) {
+        int err;
+
+        err = SelvaObject_GetObject(obj, key_name, &obj);
+        if (err) {
+            return replyWithSelvaError(ctx, err);
+        }
+    }
+
+    SelvaObject_ReplyWithObject(ctx, NULL, obj, NULL, 0);
+
+    return REDISMODULE_OK;
+}
+
+/*
+ * Get edges of an edge field.
+ *
+ * Reply format:
+ * [
+ *   constraint_id,
+ *   nodeId1,
+ *   nodeId2,
+ * ]
+ */
+int SelvaHierarchy_EdgeGetCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    RedisModule_AutoMemory(ctx);
 
-    if (argc != 2) {
+    if (argc != 4) {
         return RedisModule_WrongArity(ctx);
     }
 
     /*
      * Open the Redis key.
      */
-    hierarchy = SelvaModify_OpenHierarchy(ctx, argv[1], REDISMODULE_READ);
+    SelvaHierarchy *hierarchy = SelvaModify_OpenHierarchy(ctx, argv[1], REDISMODULE_READ);
     if (!hierarchy) {
         return REDISMODULE_OK;
     }
 
-    struct SVectorIterator it;
+    /*
+     * Find the node.
+     */
+    Selva_NodeId nodeId;
     const SelvaHierarchyNode *node;
 
-    RedisModule_ReplyWithArray(ctx, SVector_Size(&hierarchy->heads));
+    Selva_RMString2NodeId(nodeId, argv[2]);
+    node = SelvaHierarchy_FindNode(hierarchy, nodeId);
+    if (!node) {
+        return replyWithSelvaError(ctx, SELVA_HIERARCHY_ENOENT);
+    }
 
-    SVector_ForeachBegin(&it, &hierarchy->heads);
-    while ((node = SVector_Foreach(&it))) {
-        RedisModule_ReplyWithStringBuffer(ctx, node->id, Selva_NodeIdLen(node->id));
+    const RedisModuleString *field_name = argv[3];
+    TO_STR(field_name);
+    const struct EdgeField *edge_field;
+
+    edge_field = Edge_GetField(node, field_name_str, field_name_len);
+    if (!edge_field) {
+        return RedisModule_ReplyWithNull(ctx);
+    }
+
+    const struct SVector *arcs = &edge_field->arcs;
+    struct SVectorIterator it;
+    const SelvaHierarchyNode *dst;
+
+    RedisModule_ReplyWithArray(ctx, 1 + SVector_Size(arcs));
+    RedisModule_ReplyWithLongLong(ctx, edge_field->constraint ? edge_field->constraint->constraint_id : EDGE_FIELD_CONSTRAINT_ID_DEFAULT);
+
+    SVector_ForeachBegin(&it, arcs);
+    while ((dst = SVector_Foreach(&it))) {
+        RedisModule_ReplyWithStringBuffer(ctx, dst->id, Selva_NodeIdLen(dst->id));
     }
 
     return REDISMODULE_OK;
 }
 
-int SelvaHierarchy_ParentsCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+/*
+ * Get metadata of an edge.
+ *
+ * Reply format:
+ * SelvaObject
+ */
+int SelvaHierarchy_EdgeGetMetadataCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_AutoMemory(ctx);
+    Selva_NodeId src_node_id;
+    const RedisModuleString *field_name;
+    Selva_NodeId dst_node_id;
+    int err;
 
-    if (argc != 3) {
+    if (argc != 5) {
         return RedisModule_WrongArity(ctx);
     }
 
+    Selva_RMString2NodeId(src_node_id, argv[2]);
+    field_name = argv[3];
+    Selva_RMString2NodeId(dst_node_id, argv[4]);
+    TO_STR(field_name);
+
     /*
      * Open the Redis key.
      */
@@ -3610,47 +5656,62 @@ int SelvaHierarchy_ParentsCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
     /*
      * Find the node.
      */
-    Selva_NodeId nodeId;
-
-    Selva_RMString2NodeId(nodeId, argv[2]);
-    const SelvaHierarchyNode *node = SelvaHierarchy_FindNode(hierarchy, nodeId);
-    if (!node) {
+    const SelvaHierarchyNode *src_node = SelvaHierarchy_FindNode(hierarchy, src_node_id);
+    if (!src_node) {
         return replyWithSelvaError(ctx, SELVA_HIERARCHY_ENOENT);
     }
 
-    struct SVectorIterator it;
-    const SelvaHierarchyNode *parent;
-    const SVector *parents;
-
-#if HIERARCHY_SORT_BY_DEPTH
-    SVECTOR_AUTOFREE(parents_d);
-
-    if (unlikely(!SVector_Clone(&parents_d, &node->parents, SVector_HierarchyNode_depth_compare))) {
-        return replyWithSelvaError(ctx, SELVA_HIERARCHY_ENOMEM);
+    struct EdgeField *edge_field;
+    edge_field = Edge_GetField(src_node, field_name_str, field_name_len);
+    if (!edge_field) {
+        return replyWithSelvaErrorf(ctx, SELVA_ENOENT, "Edge field not found");
     }
 
-    parents = &parents_d;
-#else
-    parents = &node->parents;
-#endif
-
-    RedisModule_ReplyWithArray(ctx, SVector_Size(parents));
-
-    SVector_ForeachBegin(&it, parents);
-    while ((parent = SVector_Foreach(&it))) {
-        RedisModule_ReplyWithStringBuffer(ctx, parent->id, Selva_NodeIdLen(parent->id));
+    struct SelvaObject *edge_metadata;
+    err = Edge_GetFieldEdgeMetadata(edge_field, dst_node_id, 0, &edge_metadata);
+    if (err == SELVA_ENOENT) {
+        return RedisModule_ReplyWithNull(ctx);
+    } else if (err) { /* Also if the edge doesn't exist. */
+        return replyWithSelvaError(ctx, err);
     }
 
+    SelvaObject_ReplyWithObject(ctx, NULL, edge_metadata, NULL, SELVA_OBJECT_REPLY_BINUMF_FLAG);
+
     return REDISMODULE_OK;
 }
 
-int SelvaHierarchy_ChildrenCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+int SelvaHierarchy_CompressCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_AutoMemory(ctx);
+    enum SelvaHierarchyDetachedType type = SELVA_HIERARCHY_DETACHED_COMPRESSED_MEM;
+    int err;
 
-    if (argc != 3) {
+    if (argc != 3 && argc != 4) {
         return RedisModule_WrongArity(ctx);
     }
 
+    if (argc == 4) {
+        static const struct SelvaArgParser_EnumType types[] = {
+            {
+                .name = "mem",
+                .id = SELVA_HIERARCHY_DETACHED_COMPRESSED_MEM,
+            },
+            {
+                .name = "disk",
+                .id = SELVA_HIERARCHY_DETACHED_COMPRESSED_DISK,
+            },
+            {
+                .name = NULL,
+                .id = 0,
+            }
+        };
+
+        err = SelvaArgParser_Enum(types, argv[3]);
+        if (err < 0) {
+            return replyWithSelvaErrorf(ctx, err, "Type");
+        }
+        type = err;
+    }
+
     /*
      * Open the Redis key.
      */
@@ -3665,28 +5726,28 @@ int SelvaHierarchy_ChildrenCommand(RedisModuleCtx *ctx, RedisModuleString **argv
     Selva_NodeId nodeId;
 
     Selva_RMString2NodeId(nodeId, argv[2]);
-    const SelvaHierarchyNode *node = SelvaHierarchy_FindNode(hierarchy, nodeId);
+    SelvaHierarchyNode *node = SelvaHierarchy_FindNode(hierarchy, nodeId);
     if (!node) {
         return replyWithSelvaError(ctx, SELVA_HIERARCHY_ENOENT);
     }
 
-    RedisModule_ReplyWithArray(ctx, SVector_Size(&node->children));
-
-    struct SVectorIterator it;
-    const SelvaHierarchyNode *child;
-
-    SVector_ForeachBegin(&it, &node->children);
-    while((child = SVector_Foreach(&it))) {
-        RedisModule_ReplyWithStringBuffer(ctx, child->id, Selva_NodeIdLen(child->id));
+    err = detach_subtree(ctx, hierarchy, node, type);
+    if (err) {
+        return replyWithSelvaError(ctx, err);
     }
 
+    RedisModule_ReplyWithLongLong(ctx, 1);
+    RedisModule_ReplicateVerbatim(ctx);
+
     return REDISMODULE_OK;
 }
 
-int SelvaHierarchy_EdgeListCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+int SelvaHierarchy_ListCompressedCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_AutoMemory(ctx);
+    SelvaObject_Iterator *it;
+    const char *id;
 
-    if (argc != 3 && argc != 4) {
+    if (argc != 2) {
         return RedisModule_WrongArity(ctx);
     }
 
@@ -3698,56 +5759,350 @@ int SelvaHierarchy_EdgeListCommand(RedisModuleCtx *ctx, RedisModuleString **argv
         return REDISMODULE_OK;
     }
 
+    if (!hierarchy->detached.obj) {
+        return RedisModule_ReplyWithArray(ctx, 0);
+    }
+
+    RedisModule_ReplyWithArray(ctx, SelvaObject_Len(hierarchy->detached.obj, NULL));
+    it = SelvaObject_ForeachBegin(hierarchy->detached.obj);
+    while ((id = SelvaObject_ForeachKey(hierarchy->detached.obj, &it))) {
+        RedisModule_ReplyWithSimpleString(ctx, id);
+    }
+
+    return REDISMODULE_OK;
+}
+
+struct hierarchy_memusage_item {
+    Selva_NodeId id;
+    long long depth;
+};
+
+struct hierarchy_memusage_type {
+    Selva_NodeType type;
+    size_t nodes;
+    size_t bytes;
+};
+
+/**
+ * State of a SELVA.HIERARCHY.MEMUSAGE run.
+ */
+struct hierarchy_memusage {
+    RedisModuleBlockedClient *bc;
+    RedisModuleString *key_name;
+    SelvaHierarchy *hierarchy; /*!< Used to detect if the key was replaced between slices. */
+    long long max_depth;
+    SVector queue; /*!< struct hierarchy_memusage_item. */
+    struct SelvaSet visited;
+    int err;
+
+    size_t nr_nodes;
+    size_t nr_detached;
+    size_t node_bytes; /*!< Node structs and the parents/children vectors. */
+    size_t edge_bytes;
+    size_t marker_bytes;
+    struct SelvaObjectMemUsage obj;
+
+    long long age_min;
+    long long age_max;
+    long long age_sum;
+    size_t cold_nodes;
+    size_t cold_bytes;
+
+    size_t nr_types;
+    struct hierarchy_memusage_type *types;
+};
+
+static void memusage_enqueue(struct hierarchy_memusage *mu, const Selva_NodeId id, long long depth) {
+    struct hierarchy_memusage_item *item = selva_malloc(sizeof(*item));
+
+    memcpy(item->id, id, SELVA_NODE_ID_SIZE);
+    item->depth = depth;
+    SelvaSet_Add(&mu->visited, id);
+    SVector_Insert(&mu->queue, item);
+}
+
+static struct hierarchy_memusage *memusage_new(RedisModuleString *key_name, SelvaHierarchy *hierarchy, const Selva_NodeId id, long long max_depth) {
+    struct hierarchy_memusage *mu = selva_calloc(1, sizeof(*mu));
+
+    mu->key_name = key_name;
+    mu->hierarchy = hierarchy;
+    mu->max_depth = max_depth;
+    SVector_Init(&mu->queue, selva_glob_config.hierarchy_expected_resp_len, NULL);
+    SelvaSet_Init(&mu->visited, SELVA_SET_TYPE_NODEID);
+    mu->age_min = LLONG_MAX;
+    memusage_enqueue(mu, id, 0);
+
+    return mu;
+}
+
+static void memusage_free(struct hierarchy_memusage *mu) {
+    struct hierarchy_memusage_item *item;
+
+    while ((item = SVector_Shift(&mu->queue))) {
+        selva_free(item);
+    }
+    SVector_Destroy(&mu->queue);
+    SelvaSet_Destroy(&mu->visited);
+    if (mu->key_name) {
+        RedisModule_FreeString(NULL, mu->key_name);
+    }
+    selva_free(mu->types);
+    selva_free(mu);
+}
+
+static struct hierarchy_memusage_type *memusage_get_type(struct hierarchy_memusage *mu, const Selva_NodeId id) {
+    for (size_t i = 0; i < mu->nr_types; i++) {
+        if (Selva_CmpNodeIdType(id, mu->types[i].type) == 0) {
+            return &mu->types[i];
+        }
+    }
+
+    mu->types = selva_realloc(mu->types, ++mu->nr_types * sizeof(*mu->types));
+    struct hierarchy_memusage_type *t = &mu->types[mu->nr_types - 1];
+    memcpy(t->type, id, SELVA_NODE_TYPE_SIZE);
+    t->nodes = 0;
+    t->bytes = 0;
+
+    return t;
+}
+
+static size_t memusage_markers(const SelvaHierarchyNode *node) {
+    const struct Selva_SubscriptionMarkers *sub_markers = &node->metadata.sub_markers;
+    struct SVectorIterator it;
+    const struct Selva_SubscriptionMarker *marker;
+    size_t size = SVector_MemUsage(&sub_markers->vec);
+
     /*
-     * Find the node.
+     * A marker is referenced from every node it covers but it's only
+     * accounted to the node the marker starts from.
      */
-    Selva_NodeId nodeId;
+    SVector_ForeachBegin(&it, &sub_markers->vec);
+    while ((marker = SVector_Foreach(&it))) {
+        if (!(marker->marker_flags & SELVA_SUBSCRIPTION_FLAG_TRIGGER) &&
+            !memcmp(marker->node_id, node->id, SELVA_NODE_ID_SIZE)) {
+            size += sizeof(*marker);
+        }
+    }
 
-    Selva_RMString2NodeId(nodeId, argv[2]);
-    SelvaHierarchyNode *node = SelvaHierarchy_FindNode(hierarchy, nodeId);
-    if (!node) {
-        return replyWithSelvaError(ctx, SELVA_HIERARCHY_ENOENT);
+    return size;
+}
+
+/**
+ * Account a single node.
+ * Nothing here touches the trx label of the node, as that would reset the
+ * access recency we are reporting.
+ * The head of a detached subtree is only a stub without a node object and
+ * it's accounted as it is, as restoring the subtree would defeat the purpose.
+ */
+static void memusage_node(struct hierarchy_memusage *mu, SelvaHierarchy *hierarchy, const SelvaHierarchyNode *node) {
+    struct SelvaObjectMemUsage obj = { 0 };
+    const long long age = Trx_LabelAge(&hierarchy->trx_state, &node->trx_label);
+    size_t node_bytes, edge_bytes, marker_bytes, total;
+
+    node_bytes = sizeof(*node) + SVector_MemUsage(&node->parents) + SVector_MemUsage(&node->children);
+    if (!(node->flags & SELVA_NODE_FLAGS_DETACHED)) {
+        SelvaObject_MemUsageDetail(GET_NODE_OBJ(node), &obj);
+        obj.objects -= SELVA_OBJECT_BSIZE; /* Embedded in the node. */
     }
+    edge_bytes = Edge_MemUsage(node);
+    marker_bytes = memusage_markers(node);
+    total = node_bytes + SelvaObject_MemUsageTotal(&obj) + edge_bytes + marker_bytes;
 
-    struct SelvaObject *obj = node->metadata.edge_fields.edges;
+    mu->nr_nodes++;
+    if (node->flags & SELVA_NODE_FLAGS_DETACHED) {
+        mu->nr_detached++;
+    }
+    mu->node_bytes += node_bytes;
+    mu->edge_bytes += edge_bytes;
+    mu->marker_bytes += marker_bytes;
+    mu->obj.objects += obj.objects;
+    mu->obj.strings += obj.strings;
+    mu->obj.sets += obj.sets;
+    mu->obj.arrays += obj.arrays;
+
+    mu->age_min = min(mu->age_min, age);
+    mu->age_max = max(mu->age_max, age);
+    mu->age_sum += age;
+    if (age >= selva_glob_config.hierarchy_auto_compress_old_age_lim) {
+        mu->cold_nodes++;
+        mu->cold_bytes += total;
+    }
+
+    struct hierarchy_memusage_type *t = memusage_get_type(mu, node->id);
+    t->nodes++;
+    t->bytes += total;
+}
 
-    if (!obj) {
-        /* No custom edges set. */
-        return RedisModule_ReplyWithArray(ctx, 0);
+/**
+ * Check whether id is a node inside of a detached subtree.
+ * The subtree is not restored.
+ */
+static int memusage_is_detached(SelvaHierarchy *hierarchy, const Selva_NodeId id) {
+    return SelvaHierarchyDetached_IndexExists(hierarchy) &&
+           SelvaObject_ExistsStr(hierarchy->detached.obj, id, SELVA_NODE_ID_SIZE) == 0;
+}
+
+/**
+ * Account at most slice nodes from the queue.
+ * The nodes are looked up without restoring detached subtrees.
+ * @returns 1 if the whole subtree has been accounted; Otherwise 0.
+ */
+static int memusage_slice(struct hierarchy_memusage *mu, SelvaHierarchy *hierarchy, size_t slice) {
+    struct hierarchy_memusage_item *item;
+
+    while (slice-- > 0 && (item = SVector_Shift(&mu->queue))) {
+        SelvaHierarchyNode *node;
+
+        /* The node might have been deleted between slices. */
+        node = find_node_index(hierarchy, item->id);
+        if (!node) {
+            if (memusage_is_detached(hierarchy, item->id)) {
+                mu->nr_nodes++;
+                mu->nr_detached++;
+            }
+        } else {
+            memusage_node(mu, hierarchy, node);
+
+            if (item->depth < mu->max_depth && !(node->flags & SELVA_NODE_FLAGS_DETACHED)) {
+                struct SVectorIterator it;
+                const SelvaHierarchyNode *child;
+
+                SVector_ForeachBegin(&it, &node->children);
+                while ((child = SVector_Foreach(&it))) {
+                    if (!SelvaSet_Has(&mu->visited, child->id)) {
+                        memusage_enqueue(mu, child->id, item->depth + 1);
+                    }
+                }
+            }
+        }
+
+        selva_free(item);
     }
 
-    const RedisModuleString *key_name = argc == 4 ? argv[3] : NULL;
-    if (key_name) {
-        int err;
+    return SVector_Size(&mu->queue) == 0;
+}
+
+static void memusage_reply(RedisModuleCtx *ctx, const struct hierarchy_memusage *mu) {
+    if (mu->err) {
+        replyWithSelvaError(ctx, mu->err);
+        return;
+    }
+
+    RedisModule_ReplyWithArray(ctx, 32);
+
+    RedisModule_ReplyWithSimpleString(ctx, "nodes");
+    RedisModule_ReplyWithLongLong(ctx, mu->nr_nodes);
+    RedisModule_ReplyWithSimpleString(ctx, "detached");
+    RedisModule_ReplyWithLongLong(ctx, mu->nr_detached);
+
+    RedisModule_ReplyWithSimpleString(ctx, "node");
+    RedisModule_ReplyWithLongLong(ctx, mu->node_bytes);
+    RedisModule_ReplyWithSimpleString(ctx, "objects");
+    RedisModule_ReplyWithLongLong(ctx, mu->obj.objects);
+    RedisModule_ReplyWithSimpleString(ctx, "strings");
+    RedisModule_ReplyWithLongLong(ctx, mu->obj.strings);
+    RedisModule_ReplyWithSimpleString(ctx, "sets");
+    RedisModule_ReplyWithLongLong(ctx, mu->obj.sets);
+    RedisModule_ReplyWithSimpleString(ctx, "arrays");
+    RedisModule_ReplyWithLongLong(ctx, mu->obj.arrays);
+    RedisModule_ReplyWithSimpleString(ctx, "edges");
+    RedisModule_ReplyWithLongLong(ctx, mu->edge_bytes);
+    RedisModule_ReplyWithSimpleString(ctx, "markers");
+    RedisModule_ReplyWithLongLong(ctx, mu->marker_bytes);
+    RedisModule_ReplyWithSimpleString(ctx, "total");
+    RedisModule_ReplyWithLongLong(ctx, mu->node_bytes + SelvaObject_MemUsageTotal(&mu->obj) + mu->edge_bytes + mu->marker_bytes);
+
+    RedisModule_ReplyWithSimpleString(ctx, "age_min");
+    RedisModule_ReplyWithLongLong(ctx, mu->nr_nodes ? mu->age_min : 0);
+    RedisModule_ReplyWithSimpleString(ctx, "age_mean");
+    RedisModule_ReplyWithLongLong(ctx, mu->nr_nodes ? mu->age_sum / (long long)mu->nr_nodes : 0);
+    RedisModule_ReplyWithSimpleString(ctx, "age_max");
+    RedisModule_ReplyWithLongLong(ctx, mu->age_max);
+    RedisModule_ReplyWithSimpleString(ctx, "cold_nodes");
+    RedisModule_ReplyWithLongLong(ctx, mu->cold_nodes);
+    RedisModule_ReplyWithSimpleString(ctx, "cold_bytes");
+    RedisModule_ReplyWithLongLong(ctx, mu->cold_bytes);
+
+    RedisModule_ReplyWithSimpleString(ctx, "types");
+    RedisModule_ReplyWithArray(ctx, 2 * mu->nr_types);
+    for (size_t i = 0; i < mu->nr_types; i++) {
+        const struct hierarchy_memusage_type *t = &mu->types[i];
+
+        RedisModule_ReplyWithStringBuffer(ctx, t->type, SELVA_NODE_TYPE_SIZE);
+        RedisModule_ReplyWithArray(ctx, 4);
+        RedisModule_ReplyWithSimpleString(ctx, "nodes");
+        RedisModule_ReplyWithLongLong(ctx, t->nodes);
+        RedisModule_ReplyWithSimpleString(ctx, "bytes");
+        RedisModule_ReplyWithLongLong(ctx, t->bytes);
+    }
+}
+
+static int memusage_reply_cb(RedisModuleCtx *ctx, RedisModuleString **argv __unused, int argc __unused) {
+    memusage_reply(ctx, RedisModule_GetBlockedClientPrivateData(ctx));
+
+    return REDISMODULE_OK;
+}
+
+static void memusage_free_privdata(RedisModuleCtx *ctx __unused, void *privdata) {
+    memusage_free(privdata);
+}
+
+static void memusage_proc(RedisModuleCtx *ctx, void *data) {
+    struct hierarchy_memusage *mu = (struct hierarchy_memusage *)data;
+    RedisModuleKey *key;
+    SelvaHierarchy *hierarchy = NULL;
 
-        err = SelvaObject_GetObject(obj, key_name, &obj);
-        if (err) {
-            return replyWithSelvaError(ctx, err);
-        }
+    /*
+     * The timer runs in the db the command was called in but the key might
+     * have been deleted or replaced since the previous slice.
+     */
+    key = RedisModule_OpenKey(ctx, mu->key_name, REDISMODULE_READ);
+    if (RedisModule_ModuleTypeGetType(key) == HierarchyType) {
+        hierarchy = RedisModule_ModuleTypeGetValue(key);
     }
+    RedisModule_CloseKey(key);
 
-    SelvaObject_ReplyWithObject(ctx, NULL, obj, NULL, 0);
+    if (!hierarchy || hierarchy != mu->hierarchy) {
+        mu->err = SELVA_HIERARCHY_ENOENT;
+    } else if (!memusage_slice(mu, hierarchy, HIERARCHY_MEMUSAGE_SLICE)) {
+        (void)RedisModule_CreateTimer(ctx, selva_glob_config.hierarchy_lazy_free_period_ms, memusage_proc, mu);
+        return;
+    }
 
-    return REDISMODULE_OK;
+    RedisModule_UnblockClient(mu->bc, mu);
 }
 
 /*
- * Get edges of an edge field.
+ * Memory usage of a subtree.
+ * SELVA.HIERARCHY.MEMUSAGE HIERARCHY_KEY NODE_ID [DEPTH]
  *
- * Reply format:
- * [
- *   constraint_id,
- *   nodeId1,
- *   nodeId2,
- * ]
+ * The subtree is traversed over the children of NODE_ID up to DEPTH levels,
+ * NODE_ID itself being at depth 0. If DEPTH is not given the whole subtree is
+ * accounted. Large subtrees are accounted in slices of
+ * HIERARCHY_MEMUSAGE_SLICE nodes run from a timer to avoid blocking the
+ * server, and the client is blocked until the result is ready.
+ *
+ * The reply contains the number of nodes, the memory usage broken down by the
+ * kind of data, the access age of the nodes in hierarchy transactions, the
+ * number and size of nodes that are old enough for auto compression, and the
+ * memory usage per node type.
  */
-int SelvaHierarchy_EdgeGetCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+int SelvaHierarchy_MemUsageCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_AutoMemory(ctx);
+    Selva_NodeId nodeId;
+    long long max_depth = LLONG_MAX;
+    struct hierarchy_memusage *mu;
 
-    if (argc != 4) {
+    if (argc != 3 && argc != 4) {
         return RedisModule_WrongArity(ctx);
     }
 
+    Selva_RMString2NodeId(nodeId, argv[2]);
+    if (argc == 4 &&
+        (RedisModule_StringToLongLong(argv[3], &max_depth) != REDISMODULE_OK || max_depth < 0)) {
+        return replyWithSelvaErrorf(ctx, SELVA_EINVAL, "depth");
+    }
+
     /*
      * Open the Redis key.
      */
@@ -3756,129 +6111,160 @@ int SelvaHierarchy_EdgeGetCommand(RedisModuleCtx *ctx, RedisModuleString **argv,
         return REDISMODULE_OK;
     }
 
-    /*
-     * Find the node.
-     */
-    Selva_NodeId nodeId;
-    const SelvaHierarchyNode *node;
-
-    Selva_RMString2NodeId(nodeId, argv[2]);
-    node = SelvaHierarchy_FindNode(hierarchy, nodeId);
-    if (!node) {
+    if (!find_node_index(hierarchy, nodeId) && !memusage_is_detached(hierarchy, nodeId)) {
         return replyWithSelvaError(ctx, SELVA_HIERARCHY_ENOENT);
     }
 
-    const RedisModuleString *field_name = argv[3];
-    TO_STR(field_name);
-    const struct EdgeField *edge_field;
+    mu = memusage_new(NULL, hierarchy, nodeId, max_depth);
 
-    edge_field = Edge_GetField(node, field_name_str, field_name_len);
-    if (!edge_field) {
-        return RedisModule_ReplyWithNull(ctx);
+    /*
+     * Small subtrees are done in the first slice. Clients that can't be
+     * blocked get the result in one go.
+     */
+    if (!memusage_slice(mu, hierarchy, HIERARCHY_MEMUSAGE_SLICE) &&
+        (RedisModule_GetContextFlags(ctx) & (REDISMODULE_CTX_FLAGS_MULTI | REDISMODULE_CTX_FLAGS_LUA))) {
+        (void)memusage_slice(mu, hierarchy, SIZE_MAX);
     }
 
-    const struct SVector *arcs = &edge_field->arcs;
-    struct SVectorIterator it;
-    const SelvaHierarchyNode *dst;
-
-    RedisModule_ReplyWithArray(ctx, 1 + SVector_Size(arcs));
-    RedisModule_ReplyWithLongLong(ctx, edge_field->constraint ? edge_field->constraint->constraint_id : EDGE_FIELD_CONSTRAINT_ID_DEFAULT);
-
-    SVector_ForeachBegin(&it, arcs);
-    while ((dst = SVector_Foreach(&it))) {
-        RedisModule_ReplyWithStringBuffer(ctx, dst->id, Selva_NodeIdLen(dst->id));
+    if (SVector_Size(&mu->queue) == 0) {
+        memusage_reply(ctx, mu);
+        memusage_free(mu);
+        return REDISMODULE_OK;
     }
 
+    mu->key_name = RedisModule_CreateStringFromString(NULL, argv[1]);
+    mu->bc = RedisModule_BlockClient(ctx, memusage_reply_cb, NULL, memusage_free_privdata, 0);
+    (void)RedisModule_CreateTimer(ctx, selva_glob_config.hierarchy_lazy_free_period_ms, memusage_proc, mu);
+
     return REDISMODULE_OK;
 }
 
-/*
- * Get metadata of an edge.
- *
- * Reply format:
- * SelvaObject
+/**
+ * Check that path is a bare filename.
+ * Export files are only accessed relative to the working directory of the
+ * server, i.e. the Redis `dir`, the same way as subtrees compressed on disk,
+ * so that a client can't read or write arbitrary files.
  */
-int SelvaHierarchy_EdgeGetMetadataCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    RedisModule_AutoMemory(ctx);
-    Selva_NodeId src_node_id;
-    const RedisModuleString *field_name;
-    Selva_NodeId dst_node_id;
+static int export_path_valid(const char *path_str, size_t path_len) {
+    return path_len > 0 &&
+           !memchr(path_str, '/', path_len) &&
+           !memchr(path_str, '\0', path_len) &&
+           !(path_len == 1 && path_str[0] == '.') &&
+           !(path_len == 2 && path_str[0] == '.' && path_str[1] == '.');
+}
+
+/**
+ * Serialize and compress the subtree of node into a file.
+ * The file is written to a temporary file first and then renamed to path
+ * to make sure that a partial export is never seen at path.
+ * This function is executed in the export child process.
+ */
+static int export_subtree(RedisModuleCtx *ctx, SelvaHierarchy *hierarchy, struct SelvaHierarchyNode *node, const char *path) {
+    struct SelvaHierarchySubtree subtree = {
+        .hierarchy = hierarchy,
+        .node = node,
+    };
+    RedisModuleString *raw;
+    RedisModuleString *tmp_path;
+    struct compressed_rms *compressed;
+    FILE *fp;
     int err;
 
-    if (argc != 5) {
-        return RedisModule_WrongArity(ctx);
+    raw = RedisModule_SaveDataTypeToString(ctx, &subtree, HierarchySubtreeType);
+    if (!raw) {
+        return SELVA_HIERARCHY_EGENERAL;
     }
 
-    Selva_RMString2NodeId(src_node_id, argv[2]);
-    field_name = argv[3];
-    Selva_RMString2NodeId(dst_node_id, argv[4]);
-    TO_STR(field_name);
-
-    /*
-     * Open the Redis key.
-     */
-    SelvaHierarchy *hierarchy = SelvaModify_OpenHierarchy(ctx, argv[1], REDISMODULE_READ);
-    if (!hierarchy) {
-        return REDISMODULE_OK;
+    compressed = rms_alloc_compressed();
+    err = rms_compress(compressed, raw, NULL);
+    RedisModule_FreeString(ctx, raw);
+    if (err) {
+        goto out;
     }
 
-    /*
-     * Find the node.
-     */
-    const SelvaHierarchyNode *src_node = SelvaHierarchy_FindNode(hierarchy, src_node_id);
-    if (!src_node) {
-        return replyWithSelvaError(ctx, SELVA_HIERARCHY_ENOENT);
-    }
+    tmp_path = RedisModule_CreateStringPrintf(ctx, "%s.%d.tmp", path, (int)getpid());
+    TO_STR(tmp_path);
 
-    struct EdgeField *edge_field;
-    edge_field = Edge_GetField(src_node, field_name_str, field_name_len);
-    if (!edge_field) {
-        return replyWithSelvaErrorf(ctx, SELVA_ENOENT, "Edge field not found");
+    fp = fopen(tmp_path_str, "wb");
+    if (!fp) {
+        SELVA_LOG(SELVA_LOGL_ERR, "Failed to open \"%s\": %s",
+                  tmp_path_str,
+                  strerror(errno));
+        err = SELVA_EINVAL;
+        goto out;
     }
 
-    struct SelvaObject *edge_metadata;
-    err = Edge_GetFieldEdgeMetadata(edge_field, dst_node_id, 0, &edge_metadata);
-    if (err == SELVA_ENOENT) {
-        return RedisModule_ReplyWithNull(ctx);
-    } else if (err) { /* Also if the edge doesn't exist. */
-        return replyWithSelvaError(ctx, err);
+    err = rms_fwrite_compressed(compressed, fp);
+    if (fclose(fp) && !err) {
+        err = SELVA_EGENERAL;
+    }
+    if (!err && rename(tmp_path_str, path)) {
+        SELVA_LOG(SELVA_LOGL_ERR, "Failed to rename \"%s\" to \"%s\": %s",
+                  tmp_path_str, path,
+                  strerror(errno));
+        err = SELVA_EGENERAL;
+    }
+    if (err) {
+        (void)unlink(tmp_path_str);
     }
 
-    SelvaObject_ReplyWithObject(ctx, NULL, edge_metadata, NULL, SELVA_OBJECT_REPLY_BINUMF_FLAG);
+out:
+    rms_free_compressed(compressed);
+    return err;
+}
 
-    return REDISMODULE_OK;
+static void export_done(int exitcode, int bysignal, void *user_data __unused) {
+    if (exitcode || bysignal) {
+        SELVA_LOG(SELVA_LOGL_ERR, "Hierarchy export failed. exitcode: %d bysignal: %d",
+                  exitcode, bysignal);
+    } else {
+        SELVA_LOG(SELVA_LOGL_INFO, "Hierarchy export done");
+    }
+
+    hierarchy_export.child_pid = 0;
+    hierarchy_export.last_status = bysignal ? SELVA_EGENERAL : -exitcode;
 }
 
-int SelvaHierarchy_CompressCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+/*
+ * Export the subtree of NODE_ID to a file.
+ * SELVA.HIERARCHY.EXPORT HIERARCHY_KEY PATH [NODE_ID]
+ *
+ * PATH must be a bare filename and the file is created in the Redis `dir`.
+ *
+ * The subtree is serialized and written by a forked child process and
+ * the command returns immediately with the pid of the child. The progress
+ * and the result can be followed from INFO. If NODE_ID is not given the whole
+ * hierarchy starting from root is exported.
+ *
+ * The file format is the same as used for subtrees compressed on disk and it
+ * can be read back with SELVA.HIERARCHY.IMPORT. Note that the format is not
+ * portable between different architectures.
+ */
+int SelvaHierarchy_ExportCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_AutoMemory(ctx);
-    enum SelvaHierarchyDetachedType type = SELVA_HIERARCHY_DETACHED_COMPRESSED_MEM;
-    int err;
+    Selva_NodeId nodeId;
+    int pid;
 
     if (argc != 3 && argc != 4) {
         return RedisModule_WrongArity(ctx);
     }
 
+    const RedisModuleString *path = argv[2];
+    TO_STR(path);
+
+    if (!export_path_valid(path_str, path_len)) {
+        return replyWithSelvaErrorf(ctx, SELVA_EINVAL, "path");
+    }
+
     if (argc == 4) {
-        static const struct SelvaArgParser_EnumType types[] = {
-            {
-                .name = "mem",
-                .id = SELVA_HIERARCHY_DETACHED_COMPRESSED_MEM,
-            },
-            {
-                .name = "disk",
-                .id = SELVA_HIERARCHY_DETACHED_COMPRESSED_DISK,
-            },
-            {
-                .name = NULL,
-                .id = 0,
-            }
-        };
+        int err;
 
-        err = SelvaArgParser_Enum(types, argv[3]);
-        if (err < 0) {
-            return replyWithSelvaErrorf(ctx, err, "Type");
+        err = Selva_RMString2NodeId(nodeId, argv[3]);
+        if (err) {
+            return replyWithSelvaErrorf(ctx, err, "node_id");
         }
-        type = err;
+    } else {
+        memcpy(nodeId, ROOT_NODE_ID, SELVA_NODE_ID_SIZE);
     }
 
     /*
@@ -3889,55 +6275,184 @@ int SelvaHierarchy_CompressCommand(RedisModuleCtx *ctx, RedisModuleString **argv
         return REDISMODULE_OK;
     }
 
-    /*
-     * Find the node.
-     */
-    Selva_NodeId nodeId;
-
-    Selva_RMString2NodeId(nodeId, argv[2]);
     SelvaHierarchyNode *node = SelvaHierarchy_FindNode(hierarchy, nodeId);
     if (!node) {
         return replyWithSelvaError(ctx, SELVA_HIERARCHY_ENOENT);
     }
 
-    err = detach_subtree(ctx, hierarchy, node, type);
-    if (err) {
-        return replyWithSelvaError(ctx, err);
+    if (hierarchy_export.child_pid) {
+        return replyWithSelvaErrorf(ctx, SELVA_EEXIST, "An export is already running");
     }
 
-    RedisModule_ReplyWithLongLong(ctx, 1);
-    RedisModule_ReplicateVerbatim(ctx);
+    pid = RedisModule_Fork(export_done, NULL);
+    if (pid < 0) {
+        return replyWithSelvaErrorf(ctx, SELVA_EGENERAL, "Fork failed: %s", strerror(errno));
+    } else if (pid == 0) {
+        /* Child. */
+        int err;
 
-    return REDISMODULE_OK;
+        err = export_subtree(ctx, hierarchy, node, path_str);
+        RedisModule_ExitFromChild(-err);
+    }
+
+    hierarchy_export.child_pid = pid;
+
+    return RedisModule_ReplyWithLongLong(ctx, pid);
 }
 
-int SelvaHierarchy_ListCompressedCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+/**
+ * Read the contents of an export file.
+ */
+static int fread_export(RedisModuleCtx *ctx, const char *path, RedisModuleString **out) {
+    char *buf __selva_autofree = NULL;
+    FILE *fp;
+    long size;
+    int err = 0;
+
+    fp = fopen(path, "rb");
+    if (!fp) {
+        SELVA_LOG(SELVA_LOGL_ERR, "Failed to open \"%s\": %s",
+                  path,
+                  strerror(errno));
+        return SELVA_ENOENT;
+    }
+
+    if (fseek(fp, 0L, SEEK_END) || (size = ftell(fp)) < 0) {
+        err = SELVA_EGENERAL;
+        goto out;
+    }
+    rewind(fp);
+
+    buf = selva_malloc(size);
+    if (fread(buf, sizeof(char), size, fp) != (size_t)size) {
+        err = SELVA_EINVAL;
+        goto out;
+    }
+
+    *out = RedisModule_CreateString(ctx, buf, size);
+out:
+    fclose(fp);
+    return err;
+}
+
+/**
+ * Import a subtree from an export buffer.
+ * The buffer is in the format written by rms_fwrite_compressed().
+ */
+static int import_subtree(SelvaHierarchy *hierarchy, const RedisModuleString *data) {
+    struct compressed_rms *compressed;
+    TO_STR(data);
+    int err;
+
+    if (data_len < sizeof(compressed->uncompressed_size)) {
+        return SELVA_EINVAL;
+    }
+
+    compressed = rms_alloc_compressed();
+    memcpy(&compressed->uncompressed_size, data_str, sizeof(compressed->uncompressed_size));
+    compressed->rms = RedisModule_CreateString(NULL,
+            data_str + sizeof(compressed->uncompressed_size),
+            data_len - sizeof(compressed->uncompressed_size));
+
+    err = restore_compressed_subtree(hierarchy, compressed);
+    rms_free_compressed(compressed);
+
+    return err;
+}
+
+/*
+ * Import a subtree exported with SELVA.HIERARCHY.EXPORT.
+ * SELVA.HIERARCHY.IMPORT HIERARCHY_KEY FILE PATH
+ * SELVA.HIERARCHY.IMPORT HIERARCHY_KEY BUF DATA
+ *
+ * The nodes are built directly into the hierarchy the same way as when
+ * loading a compressed subtree. Existing nodes are updated. Subscription
+ * markers are inherited by the head of the imported subtree and the
+ * subscription events are sent once the whole subtree has been imported.
+ *
+ * PATH must be a bare filename of a file in the Redis `dir`.
+ *
+ * The command is always replicated using the BUF form because replicas are
+ * not expected to have access to PATH.
+ */
+int SelvaHierarchy_ImportCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_AutoMemory(ctx);
-    SelvaObject_Iterator *it;
-    const char *id;
+    static const struct SelvaArgParser_EnumType sources[] = {
+        {
+            .name = "FILE",
+            .id = 0,
+        },
+        {
+            .name = "BUF",
+            .id = 1,
+        },
+        {
+            .name = NULL,
+            .id = 0,
+        }
+    };
+    RedisModuleString *data;
+    int err;
 
-    if (argc != 2) {
+    if (argc != 4) {
         return RedisModule_WrongArity(ctx);
     }
 
     /*
      * Open the Redis key.
      */
-    SelvaHierarchy *hierarchy = SelvaModify_OpenHierarchy(ctx, argv[1], REDISMODULE_READ);
+    SelvaHierarchy *hierarchy = SelvaModify_OpenHierarchy(ctx, argv[1], REDISMODULE_READ | REDISMODULE_WRITE);
     if (!hierarchy) {
         return REDISMODULE_OK;
     }
 
-    if (!hierarchy->detached.obj) {
-        return RedisModule_ReplyWithArray(ctx, 0);
+    err = SelvaArgParser_Enum(sources, argv[2]);
+    if (err < 0) {
+        return replyWithSelvaErrorf(ctx, err, "Source");
+    } else if (err == 0) {
+        const RedisModuleString *path = argv[3];
+        TO_STR(path);
+
+        if (!export_path_valid(path_str, path_len)) {
+            return replyWithSelvaErrorf(ctx, SELVA_EINVAL, "path");
+        }
+
+        err = fread_export(ctx, path_str, &data);
+        if (err) {
+            return replyWithSelvaErrorf(ctx, err, "Failed to read \"%s\"", path_str);
+        }
+    } else {
+        data = argv[3];
     }
 
-    RedisModule_ReplyWithArray(ctx, SelvaObject_Len(hierarchy->detached.obj, NULL));
-    it = SelvaObject_ForeachBegin(hierarchy->detached.obj);
-    while ((id = SelvaObject_ForeachKey(hierarchy->detached.obj, &it))) {
-        RedisModule_ReplyWithSimpleString(ctx, id);
+    err = import_subtree(hierarchy, data);
+    if (err) {
+        return replyWithSelvaErrorf(ctx, err, "Import failed");
+    }
+
+    SelvaHierarchyNode *head = find_node_index(hierarchy, subtree_head_id);
+    if (head) {
+        struct SVectorIterator it;
+        SelvaHierarchyNode *parent;
+
+        SVector_ForeachBegin(&it, &head->parents);
+        while ((parent = SVector_Foreach(&it))) {
+            SelvaSubscriptions_InheritParent(
+                ctx, hierarchy,
+                head->id, &head->metadata,
+                SVector_Size(&head->children),
+                parent);
+            publishChildrenUpdate(ctx, hierarchy, parent);
+            publishDescendantsUpdate(ctx, hierarchy, parent);
+        }
+
+        SelvaSubscriptions_DeferHierarchyEvents(ctx, hierarchy, head);
     }
 
+    RedisModule_ReplyWithLongLong(ctx, 1);
+    RedisModule_Replicate(ctx, RedisModule_StringPtrLen(argv[0], NULL), "scs", argv[1], "BUF", data);
+    SelvaSubscriptions_SendDeferredEvents(hierarchy);
+
     return REDISMODULE_OK;
 }
 
@@ -3993,6 +6508,15 @@ static void SelvaVersion_AuxSave(RedisModuleIO *io, int when __unused) {
     RedisModule_SaveStringBuffer(io, selva_version, len);
 }
 
+static void mod_info(RedisModuleInfoCtx *ctx) {
+    (void)RedisModule_InfoAddFieldULongLong(ctx, "lazy_free_pending", lazy_free_pending);
+    (void)RedisModule_InfoAddFieldULongLong(ctx, "lazy_free_freed", lazy_free_freed);
+    (void)RedisModule_InfoAddFieldULongLong(ctx, "reach_relabels", reach_relabels);
+    (void)RedisModule_InfoAddFieldLongLong(ctx, "export_child_pid", hierarchy_export.child_pid);
+    (void)RedisModule_InfoAddFieldCString(ctx, "export_last_status", (char *)getSelvaErrorStr(hierarchy_export.last_status));
+}
+SELVA_MODINFO("hierarchy", mod_info);
+
 static int Hierarchy_OnLoad(RedisModuleCtx *ctx) {
     RedisModuleTypeMethods mtm = {
         .version = REDISMODULE_TYPE_METHOD_VERSION,
@@ -4032,6 +6556,9 @@ static int Hierarchy_OnLoad(RedisModuleCtx *ctx) {
         RedisModule_CreateCommand(ctx, "selva.hierarchy.edgegetmetadata", SelvaHierarchy_EdgeGetMetadataCommand, "readonly fast", 1, 1, 1) == REDISMODULE_ERR ||
         RedisModule_CreateCommand(ctx, "selva.hierarchy.compress", SelvaHierarchy_CompressCommand, "write deny-oom", 1, 1, 1) == REDISMODULE_ERR ||
         RedisModule_CreateCommand(ctx, "selva.hierarchy.listcompressed", SelvaHierarchy_ListCompressedCommand, "readonly", 1, 1, 1) == REDISMODULE_ERR ||
+        RedisModule_CreateCommand(ctx, "selva.hierarchy.memusage", SelvaHierarchy_MemUsageCommand, "readonly", 1, 1, 1) == REDISMODULE_ERR ||
+        RedisModule_CreateCommand(ctx, "selva.hierarchy.export", SelvaHierarchy_ExportCommand, "readonly", 1, 1, 1) == REDISMODULE_ERR ||
+        RedisModule_CreateCommand(ctx, "selva.hierarchy.import", SelvaHierarchy_ImportCommand, "write deny-oom", 1, 1, 1) == REDISMODULE_ERR ||
         RedisModule_CreateCommand(ctx, "selva.hierarchy.ver", SelvaHierarchy_VerCommand, "readonly allow-stale fast", 0, 0, 0) == REDISMODULE_ERR) {
         return REDISMODULE_ERR;
     }
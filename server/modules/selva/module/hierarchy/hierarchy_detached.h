@@ -7,6 +7,7 @@
 #define _SELVA_HIERARCHY_DETACHED_H_
 
 #include "selva.h"
+#include "selva_object.h"
 
 /**
  * Storage backend type of the detached subtree node.
@@ -34,6 +35,16 @@ static inline int SelvaHierarchyDetached_IndexExists(const struct SelvaHierarchy
     return !!hierarchy->detached.obj;
 }
 
+/**
+ * Check if a node_id is in a detached subtree.
+ * This doesn't restore the subtree.
+ * @returns truthy if node_id is in a detached subtree; Otherwise zero.
+ */
+static inline int SelvaHierarchyDetached_NodeExists(const struct SelvaHierarchy *hierarchy, const Selva_NodeId node_id) {
+    return SelvaHierarchyDetached_IndexExists(hierarchy) &&
+           !SelvaObject_ExistsStr(hierarchy->detached.obj, node_id, SELVA_NODE_ID_SIZE);
+}
+
 /**
  * Prepare compressed subtree to be stored in the detached hierarchy.
  * If the type is SELVA_HIERARCHY_DETACHED_COMPRESSED_MEM this function will only
@@ -136,3 +136,14 @@ int Inherit_GetField(
         struct SelvaObjectAny *out) {
     return get_field_value(hierarchy, lang, node, obj, field_str, field_len, out);
 }
+
+int Inherit_HasFieldValue(
+        SelvaHierarchy *hierarchy,
+        RedisModuleString *lang,
+        const struct SelvaHierarchyNode *node,
+        const char *field_str,
+        size_t field_len) {
+    struct SelvaObjectAny any;
+
+    return !get_field_value(hierarchy, lang, node, SelvaHierarchy_GetNodeObject(node), field_str, field_len, &any);
+}
@@ -2,7 +2,6 @@
  * Copyright (c) 2022 SAULX
  * SPDX-License-Identifier: MIT
  */
-#include <alloca.h>
 #include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -10,7 +9,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include "redismodule.h"
-#include "bitmap.h"
 #include "cstrings.h"
 #include "selva.h"
 #include "svector.h"
@@ -24,25 +22,6 @@
 #include "subscriptions.h"
 #include "inherit_fields.h"
 
-struct InheritFieldValue_Args {
-    size_t first_node; /*!< We ignore the type of the first node. */
-    size_t nr_types;
-    const Selva_NodeType *types;
-    RedisModuleString *lang;
-    const char *field_name_str;
-    size_t field_name_len;
-    struct SelvaObjectAny *res;
-};
-
-struct InheritSendFields_Args {
-    size_t first_node; /*!< We ignore the type of the first node. */
-    size_t nr_fields;
-    RedisModuleString *lang;
-    RedisModuleString **field_names;
-    struct bitmap *found;
-    ssize_t nr_results; /*!< Number of results sent. */
-};
-
 struct InheritCommand_Args {
     size_t first_node; /*!< We ignore the type of the first node. */
     size_t nr_fields;
@@ -73,51 +52,6 @@ static int is_type_match(struct SelvaHierarchyNode *node, const Selva_NodeType *
     return 0;
 }
 
-static int Inherit_FieldValue_NodeCb(
-        RedisModuleCtx *ctx __unused,
-        struct SelvaHierarchy *hierarchy,
-        struct SelvaHierarchyNode *node,
-        void *arg) {
-    struct InheritFieldValue_Args *restrict args = (struct InheritFieldValue_Args *)arg;
-    struct SelvaObject *obj = SelvaHierarchy_GetNodeObject(node);
-    int err;
-
-    /*
-     * Check that the node is of an accepted type.
-     */
-    if (likely(!args->first_node)) {
-        if (!is_type_match(node, args->types, args->nr_types)) {
-            /*
-             * This node type is not accepted and we don't need to check whether
-             * the field set.
-             */
-            return 0;
-        }
-    } else {
-        args->first_node = 0;
-    }
-
-    err = Inherit_GetField(hierarchy, args->lang, node, obj, args->field_name_str, args->field_name_len, args->res);
-    if (err == 0) {
-        return 1; /* found */
-    } else if (err != SELVA_ENOENT) {
-        Selva_NodeId nodeId;
-
-        SelvaHierarchy_GetNodeId(nodeId, node);
-
-        /*
-         * SELVA_ENOENT is expected as not all nodes have all fields set;
-         * Any other error is unexpected.
-         */
-        SELVA_LOG(SELVA_LOGL_ERR, "Failed to get a field value. nodeId: %.*s fieldName: \"%.*s\" error: %s\n",
-                  (int)SELVA_NODE_ID_SIZE, nodeId,
-                  (int)args->field_name_len, args->field_name_str,
-                  getSelvaErrorStr(err));
-    }
-
-    return 0;
-}
-
 int Inherit_FieldValue(
         RedisModuleCtx *ctx,
         struct SelvaHierarchy *hierarchy,
@@ -128,21 +62,21 @@ int Inherit_FieldValue(
         const char *field_name_str,
         size_t field_name_len,
         struct SelvaObjectAny *res) {
-    struct InheritFieldValue_Args args = {
-        .lang = lang,
-        .first_node = 1,
-        .nr_types = nr_types,
-        .types = types,
-        .field_name_str = field_name_str,
-        .field_name_len = field_name_len,
-        .res = res,
-    };
-    const struct SelvaHierarchyCallback cb = {
-        .node_cb = Inherit_FieldValue_NodeCb,
-        .node_arg = &args,
-    };
+    struct SelvaHierarchyNode *node;
+    struct SelvaHierarchyNode *src;
+    int err;
 
-    return SelvaHierarchy_Traverse(ctx, hierarchy, node_id, SELVA_HIERARCHY_TRAVERSAL_BFS_ANCESTORS, &cb);
+    node = SelvaHierarchy_FindNode(hierarchy, node_id);
+    if (!node) {
+        return SELVA_HIERARCHY_ENOENT;
+    }
+
+    err = Inherit_Resolve(ctx, hierarchy, lang, node, types, nr_types, field_name_str, field_name_len, Inherit_HasFieldValue, &src);
+    if (err) {
+        return err;
+    }
+
+    return Inherit_GetField(hierarchy, lang, src, SelvaHierarchy_GetNodeObject(src), field_name_str, field_name_len, res);
 }
 
 static void parse_type_and_field(const char *str, size_t len, const char **types_str, size_t *types_len, const char **name_str, size_t *name_len) {
@@ -164,31 +98,29 @@ static void parse_type_and_field(const char *str, size_t len, const char **types
     *types_len = (size_t)(*name_str - *types_str - 1);
 }
 
-static int Inherit_SendFields_NodeCb(
+size_t Inherit_SendFields(
         RedisModuleCtx *ctx,
         struct SelvaHierarchy *hierarchy,
-        struct SelvaHierarchyNode *node,
-        void *arg) {
-    struct InheritSendFields_Args *restrict args = (struct InheritSendFields_Args *)arg;
-    const int first_node = args->first_node;
-    struct SelvaObject *obj = SelvaHierarchy_GetNodeObject(node);
-    int err;
+        RedisModuleString *lang,
+        const Selva_NodeId node_id,
+        RedisModuleString **types_field_names,
+        size_t nr_field_names) {
+    struct SelvaHierarchyNode *node;
+    size_t nr_results = 0;
 
-    if (unlikely(first_node)) {
-        args->first_node = 0;
+    node = SelvaHierarchy_FindNode(hierarchy, node_id);
+    if (!node) {
+        return 0;
     }
 
-    for (size_t i = 0; i < args->nr_fields; i++) {
-        /* Field already found. */
-        if (bitmap_get(args->found, i)) {
-            continue;
-        }
-
-        const RedisModuleString *types_and_field = args->field_names[i];
+    for (size_t i = 0; i < nr_field_names; i++) {
+        const RedisModuleString *types_and_field = types_field_names[i];
         const char *types_str;
         size_t types_len;
         const char *field_name_str;
         size_t field_name_len;
+        struct SelvaHierarchyNode *src;
+        int err;
         TO_STR(types_and_field);
 
         parse_type_and_field(types_and_field_str, types_and_field_len, &types_str, &types_len, &field_name_str, &field_name_len);
@@ -197,82 +129,36 @@ static int Inherit_SendFields_NodeCb(
             continue;
         }
 
-        if (!first_node && !is_type_match(node, (const char (*)[SELVA_NODE_TYPE_SIZE])types_str, types_len / sizeof(Selva_NodeType))) {
+        err = Inherit_Resolve(ctx, hierarchy, lang, node,
+                              (const Selva_NodeType *)types_str, types_len / sizeof(Selva_NodeType),
+                              field_name_str, field_name_len,
+                              Inherit_HasFieldFind, &src);
+        if (err == 0) {
             /*
-             * This node type is not accepted and we don't need to check whether
-             * the field set.
-             * We accept any type for the first node.
+             * Get and send the field value to the client.
+             * The response should always start like this: [node_id, field_name, ...]
+             * but we don't send the header yet.
              */
-            return 0;
+            err = Inherit_SendFieldFind(ctx, hierarchy, lang,
+                                        src, SelvaHierarchy_GetNodeObject(src),
+                                        field_name_str, field_name_len, /* Initially full_field is the same as field_name. */
+                                        field_name_str, field_name_len);
         }
-
-        /*
-         * Get and send the field value to the client.
-         * The response should always start like this: [node_id, field_name, ...]
-         * but we don't send the header yet.
-         */
-        err = Inherit_SendFieldFind(ctx, hierarchy, args->lang,
-                                    node, obj,
-                                    field_name_str, field_name_len, /* Initially full_field is the same as field_name. */
-                                    field_name_str, field_name_len);
         if (err == 0) { /* found */
-            bitmap_set(args->found, i); /* No need to look for this field anymore. */
-            args->nr_results++;
-
-            /* Stop traversing if all fields were found. */
-            if (args->nr_results == (ssize_t)args->nr_fields) {
-                return 1;
-            }
+            nr_results++;
         } else if (err != SELVA_ENOENT) {
-            Selva_NodeId nodeId;
-
-            SelvaHierarchy_GetNodeId(nodeId, node);
-
             /*
              * SELVA_ENOENT is expected as not all nodes have all fields set;
              * Any other error is unexpected.
              */
-            SELVA_LOG(SELVA_LOGL_ERR, "Failed to get a field value. nodeId: %.*s fieldName: \"%.*s\" error: %s\n",
-                      (int)SELVA_NODE_ID_SIZE, nodeId,
+            SELVA_LOG(SELVA_LOGL_ERR, "Failed to inherit a field value. nodeId: %.*s fieldName: \"%.*s\" error: %s\n",
+                      (int)SELVA_NODE_ID_SIZE, node_id,
                       (int)field_name_len, field_name_str,
                       getSelvaErrorStr(err));
         }
     }
 
-    return 0;
-}
-
-int Inherit_SendFields(
-        RedisModuleCtx *ctx,
-        struct SelvaHierarchy *hierarchy,
-        RedisModuleString *lang,
-        const Selva_NodeId node_id,
-        RedisModuleString **types_field_names,
-        size_t nr_field_names) {
-    struct InheritSendFields_Args args = {
-        .lang = lang,
-        .first_node = 1,
-        .field_names = types_field_names,
-        .nr_fields = nr_field_names,
-        .nr_results = 0,
-    };
-    const struct SelvaHierarchyCallback cb = {
-        .node_cb = Inherit_SendFields_NodeCb,
-        .node_arg = &args,
-    };
-    int err;
-
-    args.found = alloca(BITMAP_ALLOC_SIZE(nr_field_names));
-    args.found->nbits = nr_field_names;
-    bitmap_erase(args.found);
-
-    err = SelvaHierarchy_Traverse(ctx, hierarchy, node_id, SELVA_HIERARCHY_TRAVERSAL_BFS_ANCESTORS, &cb);
-    if (err) {
-        /* TODO Better error handling? */
-        SELVA_LOG(SELVA_LOGL_ERR, "Inherit failed: %s", getSelvaErrorStr(err));
-    }
-
-    return args.nr_results;
+    return nr_results;
 }
 
 static int InheritCommand_NodeCb(
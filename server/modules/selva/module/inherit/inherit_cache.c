@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "redismodule.h"
+#include "jemalloc.h"
+#include "auto_free.h"
+#include "selva.h"
+#include "svector.h"
+#include "tree.h"
+#include "config.h"
+#include "hierarchy.h"
+#include "modinfo.h"
+#include "inherit.h"
+#include "inherit_fields.h"
+
+/*
+ * Inherit resolution cache.
+ *
+ * The cache maps (node, has_field, types, field, lang) to the node the field
+ * is inherited from, or to NULL if none of the ancestors have the field.
+ *
+ * The entries hold pointers to hierarchy nodes and thus the whole cache is
+ * dropped whenever the structure of the hierarchy changes, which is tracked
+ * with hierarchy->generation. Field changes are signaled by the subscriptions
+ * subsystem through Inherit_InvalidateCache().
+ *
+ * Nodes that have a single parent share the resolution of their parent, as
+ * the BFS ancestors order of such a node is the node itself followed by the
+ * BFS ancestors order of its parent. This allows resolving a deep chain of
+ * ancestors only once per find and populating the cache for every node on the
+ * chain at the same time.
+ */
+
+struct InheritCacheEntry {
+    RB_ENTRY(InheritCacheEntry) _entry;
+    const struct SelvaHierarchyNode *node;
+    Inherit_HasField has_field;
+    struct SelvaHierarchyNode *res; /*!< The resolved node or NULL. */
+    size_t key_len;
+    char key[]; /*!< types, field, and lang. */
+};
+
+static unsigned long long inherit_cache_hits;
+static unsigned long long inherit_cache_misses;
+static unsigned long long inherit_cache_flushes;
+
+static int InheritCacheEntry_Compare(const struct InheritCacheEntry *a, const struct InheritCacheEntry *b) {
+    if (a->node != b->node) {
+        return (uintptr_t)a->node < (uintptr_t)b->node ? -1 : 1;
+    }
+    if (a->has_field != b->has_field) {
+        return (uintptr_t)a->has_field < (uintptr_t)b->has_field ? -1 : 1;
+    }
+    if (a->key_len != b->key_len) {
+        return a->key_len < b->key_len ? -1 : 1;
+    }
+
+    return memcmp(a->key, b->key, a->key_len);
+}
+
+RB_PROTOTYPE_STATIC(hierarchy_inherit_cache_tree, InheritCacheEntry, _entry, InheritCacheEntry_Compare)
+RB_GENERATE_STATIC(hierarchy_inherit_cache_tree, InheritCacheEntry, _entry, InheritCacheEntry_Compare)
+
+static void flush_cache(struct SelvaHierarchy *hierarchy) {
+    struct hierarchy_inherit_cache_tree *head = &hierarchy->inherit_cache.head;
+    struct InheritCacheEntry *entry;
+    struct InheritCacheEntry *next;
+
+    if (hierarchy->inherit_cache.nr_entries == 0) {
+        return;
+    }
+
+    for (entry = RB_MIN(hierarchy_inherit_cache_tree, head); entry != NULL; entry = next) {
+        next = RB_NEXT(hierarchy_inherit_cache_tree, head, entry);
+        RB_REMOVE(hierarchy_inherit_cache_tree, head, entry);
+        selva_free(entry);
+    }
+
+    hierarchy->inherit_cache.nr_entries = 0;
+    inherit_cache_flushes++;
+}
+
+void Inherit_InvalidateCache(struct SelvaHierarchy *hierarchy) {
+    flush_cache(hierarchy);
+}
+
+void Inherit_DestroyCache(struct SelvaHierarchy *hierarchy) {
+    flush_cache(hierarchy);
+}
+
+/**
+ * Create a search entry for the given key.
+ * The node can be changed for each search.
+ */
+static struct InheritCacheEntry *new_find_entry(
+        RedisModuleString *lang,
+        const Selva_NodeType *types,
+        size_t nr_types,
+        const char *field_str,
+        size_t field_len,
+        Inherit_HasField has_field) {
+    const size_t types_len = nr_types * sizeof(Selva_NodeType);
+    size_t lang_len = 0;
+    const char *lang_str = lang ? RedisModule_StringPtrLen(lang, &lang_len) : "";
+    struct InheritCacheEntry *find;
+    char *p;
+
+    /* The field is delimited from the other parts to make the key unambiguous. */
+    find = selva_malloc(sizeof(*find) + types_len + field_len + lang_len + 2);
+    find->node = NULL;
+    find->has_field = has_field;
+    find->res = NULL;
+    find->key_len = types_len + field_len + lang_len + 2;
+
+    p = find->key;
+    memcpy(p, types, types_len);
+    p += types_len;
+    *p++ = '\0';
+    memcpy(p, field_str, field_len);
+    p += field_len;
+    *p++ = '\0';
+    memcpy(p, lang_str, lang_len);
+
+    return find;
+}
+
+static void insert_entry(struct SelvaHierarchy *hierarchy, const struct InheritCacheEntry *find, const struct SelvaHierarchyNode *node, struct SelvaHierarchyNode *res) {
+    struct InheritCacheEntry *entry;
+
+    if (hierarchy->inherit_cache.nr_entries >= selva_glob_config.inherit_cache_max) {
+        flush_cache(hierarchy);
+    }
+
+    entry = selva_malloc(sizeof(*entry) + find->key_len);
+    memcpy(entry, find, sizeof(*entry) + find->key_len);
+    entry->node = node;
+    entry->res = res;
+
+    if (RB_INSERT(hierarchy_inherit_cache_tree, &hierarchy->inherit_cache.head, entry)) {
+        /* Already cached. */
+        selva_free(entry);
+    } else {
+        hierarchy->inherit_cache.nr_entries++;
+    }
+}
+
+static int is_type_match(const struct SelvaHierarchyNode *node, const Selva_NodeType *types, size_t nr_types) {
+    Selva_NodeType type;
+
+    if (nr_types == 0) {
+        /* Wildcard */
+        return 1;
+    }
+
+    SelvaHierarchy_GetNodeType(type, node);
+
+    for (size_t i = 0; i < nr_types; i++) {
+        if (!memcmp(types[i], type, SELVA_NODE_TYPE_SIZE)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+struct resolve_bfs_args {
+    int first_node;
+    RedisModuleString *lang;
+    const Selva_NodeType *types;
+    size_t nr_types;
+    const char *field_str;
+    size_t field_len;
+    Inherit_HasField has_field;
+    struct SelvaHierarchyNode *res;
+};
+
+static int resolve_bfs_node_cb(
+        RedisModuleCtx *ctx __unused,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyNode *node,
+        void *arg) {
+    struct resolve_bfs_args *args = (struct resolve_bfs_args *)arg;
+
+    /* The first node was already checked by the caller. */
+    if (args->first_node) {
+        args->first_node = 0;
+        return 0;
+    }
+
+    if (is_type_match(node, args->types, args->nr_types) &&
+        args->has_field(hierarchy, args->lang, node, args->field_str, args->field_len)) {
+        args->res = node;
+        return 1;
+    }
+
+    return 0;
+}
+
+int Inherit_Resolve(
+        RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        RedisModuleString *lang,
+        struct SelvaHierarchyNode *node,
+        const Selva_NodeType *types,
+        size_t nr_types,
+        const char *field_str,
+        size_t field_len,
+        Inherit_HasField has_field,
+        struct SelvaHierarchyNode **res) {
+    const int use_cache = selva_glob_config.inherit_cache_max > 0;
+    __selva_autofree struct InheritCacheEntry *find = NULL;
+    SVECTOR_AUTOFREE(chain); /* Nodes sharing the same resolution. */
+    struct SelvaHierarchyNode *cur = node;
+    struct SelvaHierarchyNode *found = NULL;
+    int first = 1;
+
+    if (hierarchy->inherit_cache.generation != hierarchy->generation) {
+        flush_cache(hierarchy);
+        hierarchy->inherit_cache.generation = hierarchy->generation;
+    }
+
+    if (use_cache) {
+        find = new_find_entry(lang, types, nr_types, field_str, field_len, has_field);
+        SVector_Init(&chain, 0, NULL);
+    }
+
+    /*
+     * Walk up as long as there is only a single parent.
+     * The resolution of a node equals the resolution of its parent if the
+     * node doesn't have the field and the parent's type is accepted.
+     */
+    while (1) {
+        const int accepted = first || is_type_match(cur, types, nr_types);
+
+        if (accepted) {
+            if (use_cache) {
+                struct InheritCacheEntry *entry;
+
+                find->node = cur;
+                entry = RB_FIND(hierarchy_inherit_cache_tree, &hierarchy->inherit_cache.head, find);
+                if (entry) {
+                    inherit_cache_hits++;
+                    found = entry->res;
+                    break;
+                }
+                inherit_cache_misses++;
+                SVector_Insert(&chain, cur);
+            }
+
+            if (has_field(hierarchy, lang, cur, field_str, field_len)) {
+                found = cur;
+                break;
+            }
+        }
+
+        struct SelvaHierarchyNode *parent = SelvaHierarchy_GetSingleParent(cur);
+        if (parent) {
+            cur = parent;
+            first = 0;
+        } else {
+            /*
+             * Fallback to BFS for the rest of the ancestors.
+             */
+            struct resolve_bfs_args args = {
+                .first_node = 1,
+                .lang = lang,
+                .types = types,
+                .nr_types = nr_types,
+                .field_str = field_str,
+                .field_len = field_len,
+                .has_field = has_field,
+                .res = NULL,
+            };
+            const struct SelvaHierarchyCallback cb = {
+                .node_cb = resolve_bfs_node_cb,
+                .node_arg = &args,
+            };
+            int err;
+
+            err = SelvaHierarchy_TraverseBFSAncestors(ctx, hierarchy, cur, &cb);
+            if (err) {
+                /* Don't cache anything. */
+                return err;
+            }
+
+            found = args.res;
+            break;
+        }
+    }
+
+    if (use_cache) {
+        struct SVectorIterator it;
+        const struct SelvaHierarchyNode *chain_node;
+
+        SVector_ForeachBegin(&it, &chain);
+        while ((chain_node = SVector_Foreach(&it))) {
+            insert_entry(hierarchy, find, chain_node, found);
+        }
+    }
+
+    *res = found;
+    return found ? 0 : SELVA_ENOENT;
+}
+
+static void mod_info(RedisModuleInfoCtx *ctx) {
+    (void)RedisModule_InfoAddFieldULongLong(ctx, "cache_hits", inherit_cache_hits);
+    (void)RedisModule_InfoAddFieldULongLong(ctx, "cache_misses", inherit_cache_misses);
+    (void)RedisModule_InfoAddFieldULongLong(ctx, "cache_flushes", inherit_cache_flushes);
+}
+SELVA_MODINFO("inherit", mod_info);
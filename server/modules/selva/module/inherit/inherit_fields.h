@@ -9,8 +9,20 @@
 struct RedisModuleCtx;
 struct RedisModuleString;
 struct SelvaHierarchy;
+struct SelvaHierarchyNode;
 struct SelvaObjectAny;
 
+/**
+ * Check whether a field can be inherited from a node.
+ * @returns 1 if the field exists; Otherwise 0.
+ */
+typedef int (*Inherit_HasField)(
+        struct SelvaHierarchy *hierarchy,
+        struct RedisModuleString *lang,
+        const struct SelvaHierarchyNode *node,
+        const char *field_str,
+        size_t field_len);
+
 /**
  * Get a plain field value.
  */
@@ -23,6 +35,16 @@ int Inherit_GetField(
         size_t field_len,
         struct SelvaObjectAny *out);
 
+/**
+ * Inherit_HasField for Inherit_GetField().
+ */
+int Inherit_HasFieldValue(
+        struct SelvaHierarchy *hierarchy,
+        struct RedisModuleString *lang,
+        const struct SelvaHierarchyNode *node,
+        const char *field_str,
+        size_t field_len);
+
 /**
  * Send a field value to the client.
  * Particularly this function sends the node_id, field name, and field value in
@@ -53,4 +75,36 @@ int Inherit_SendFieldFind(
         const char *field_str,
         size_t field_len);
 
+/**
+ * Inherit_HasField for Inherit_SendFieldFind().
+ */
+int Inherit_HasFieldFind(
+        struct SelvaHierarchy *hierarchy,
+        struct RedisModuleString *lang,
+        const struct SelvaHierarchyNode *node,
+        const char *field_str,
+        size_t field_len);
+
+/**
+ * Resolve the node a field should be inherited from.
+ * The first node is accepted regardless of its type and the rest of the
+ * ancestors are visited in BFS order.
+ * The result is cached in the inherit resolution cache of the hierarchy.
+ * @param has_field is used to check whether a node has the field. The function
+ *                  pointer is also a part of the cache key.
+ * @param[out] res is set to the resolved node.
+ * @returns 0 if a node was found; SELVA_ENOENT if none of the ancestors have the field.
+ */
+int Inherit_Resolve(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct RedisModuleString *lang,
+        struct SelvaHierarchyNode *node,
+        const Selva_NodeType *types,
+        size_t nr_types,
+        const char *field_str,
+        size_t field_len,
+        Inherit_HasField has_field,
+        struct SelvaHierarchyNode **res);
+
 #endif /* _SELVA_INHERIT_FIELDS_H_ */
@@ -172,6 +172,53 @@ static int send_field_value(
     return send_object_field_value(ctx, lang, node, obj, full_field_str, full_field_len, field_str, field_len);
 }
 
+/**
+ * Check whether send_field_value() would find the field.
+ */
+static int has_field_value(
+        SelvaHierarchy *hierarchy,
+        const struct SelvaHierarchyNode *node,
+        struct SelvaObject *obj,
+        const char *field_str,
+        size_t field_len) {
+    struct EdgeField *edge_field;
+
+    edge_field = Edge_GetField(node, field_str, field_len);
+    if (edge_field) {
+        return 1;
+    } else {
+        ssize_t n = field_len;
+
+        while ((n = strrnchr(field_str, n, '.')) > 0) {
+            edge_field = Edge_GetField(node, field_str, n);
+            if (edge_field) {
+                const char *rest_str = field_str + n + 1;
+                const size_t rest_len = field_len - n - 1;
+                struct SelvaObject *ref_obj;
+                Selva_NodeId ref_node_id;
+                const struct SelvaHierarchyNode *ref_node;
+
+                if (deref_single_ref(edge_field, ref_node_id, &ref_obj)) {
+                    return 0;
+                }
+
+                if (rest_len == 1 && rest_str[0] == '*') {
+                    return 1;
+                }
+
+                ref_node = SelvaHierarchy_FindNode(hierarchy, ref_node_id);
+                if (!ref_node) {
+                    return 0;
+                }
+
+                return has_field_value(hierarchy, ref_node, ref_obj, rest_str, rest_len);
+            }
+        }
+    }
+
+    return !SelvaObject_ExistsStr(obj, field_str, field_len);
+}
+
 int Inherit_SendFieldFind(
         RedisModuleCtx *ctx,
         SelvaHierarchy *hierarchy,
@@ -184,3 +231,12 @@ int Inherit_SendFieldFind(
         size_t field_len) {
     return send_field_value(ctx, hierarchy, lang, node, obj, full_field_str, full_field_len, field_str, field_len);
 }
+
+int Inherit_HasFieldFind(
+        SelvaHierarchy *hierarchy,
+        RedisModuleString *lang __unused,
+        const struct SelvaHierarchyNode *node,
+        const char *field_str,
+        size_t field_len) {
+    return has_field_value(hierarchy, node, SelvaHierarchy_GetNodeObject(node), field_str, field_len);
+}
@@ -32,12 +32,18 @@
 #include "timestamp.h"
 #include "typestr.h"
 #include "modify.h"
+#include "modify_stream.h"
 
 #define FLAG_NO_ROOT    0x01 /*!< Don't set root as a parent. */
 #define FLAG_NO_MERGE   0x02 /*!< Clear any existing fields. */
 #define FLAG_CREATE     0x04 /*!< Only create a new node or fail. */
 #define FLAG_UPDATE     0x08 /*!< Only update an existing node. */
 
+_Static_assert(FLAG_NO_ROOT == SELVA_MODIFY_STREAM_FLAG_NO_ROOT, "Modify flags must match");
+_Static_assert(FLAG_NO_MERGE == SELVA_MODIFY_STREAM_FLAG_NO_MERGE, "Modify flags must match");
+_Static_assert(FLAG_CREATE == SELVA_MODIFY_STREAM_FLAG_CREATE, "Modify flags must match");
+_Static_assert(FLAG_UPDATE == SELVA_MODIFY_STREAM_FLAG_UPDATE, "Modify flags must match");
+
 #define FISSET_NO_ROOT(m) (((m) & FLAG_NO_ROOT) == FLAG_NO_ROOT)
 #define FISSET_NO_MERGE(m) (((m) & FLAG_NO_MERGE) == FLAG_NO_MERGE)
 #define FISSET_CREATE(m) (((m) & FLAG_CREATE) == FLAG_CREATE)
@@ -56,7 +62,53 @@ struct replicate_ts {
     long long updated_at;
 };
 
+/**
+ * A single node modify request parsed from a selva.modify.batch stream.
+ */
+struct modify_batch_rec {
+    struct SelvaModifyStream_Record rec;
+    int8_t replicate; /*!< Set if something should be replicated for this node. */
+    struct bitmap *replset;
+    struct replicate_ts rs;
+};
+
+/**
+ * A modify op argument.
+ * The RedisModuleString versions of the field and value are created lazily
+ * only if an op needs them.
+ */
+struct modify_arg {
+    char type_code;
+    const char *field_str;
+    size_t field_len;
+    const char *value_str;
+    size_t value_len;
+    RedisModuleString *field;
+    RedisModuleString *value;
+};
+
 SELVA_TRACE_HANDLE(cmd_modify);
+SELVA_TRACE_HANDLE(cmd_modify_batch);
+
+static RedisModuleString *arg_field(RedisModuleCtx *ctx, struct modify_arg *arg) {
+    if (!arg->field) {
+        arg->field = RedisModule_CreateString(ctx, arg->field_str, arg->field_len);
+    }
+
+    return arg->field;
+}
+
+static RedisModuleString *arg_value(RedisModuleCtx *ctx, struct modify_arg *arg) {
+    if (!arg->value) {
+        arg->value = RedisModule_CreateString(ctx, arg->value_str, arg->value_len);
+    }
+
+    return arg->value;
+}
+
+static int arg_field_eq(const struct modify_arg *arg, const char *str, size_t len) {
+    return arg->field_len == len && !memcmp(arg->field_str, str, len);
+}
 
 static ssize_t string2rms(RedisModuleCtx *ctx, int8_t type, const char *s, RedisModuleString **out) {
     size_t len;
@@ -375,7 +427,7 @@ static void selva_set_defer_alias_change_events(
 static int add_set_values(
     RedisModuleCtx *ctx,
     SelvaHierarchy *hierarchy,
-    RedisModuleKey *alias_key,
+    bool is_aliases,
     struct SelvaObject *obj,
     const Selva_NodeId node_id,
     const RedisModuleString *field,
@@ -428,16 +480,16 @@ static int add_set_values(
             if (err == 0) {
                 RedisModule_RetainString(ctx, ref);
 
-                /* Add to the global aliases hash. */
-                if (alias_key) {
+                /* Add to the alias index. */
+                if (is_aliases) {
                     SelvaSubscriptions_DeferAliasChangeEvents(ctx, hierarchy, ref);
 
-                    update_alias(ctx, hierarchy, alias_key, node_id, ref);
+                    update_alias(hierarchy, node_id, ref);
                 }
 
                 res++;
             } else if (err != SELVA_EEXIST) {
-                if (alias_key) {
+                if (is_aliases) {
                     SELVA_LOG(SELVA_LOGL_ERR, "Alias update failed");
                 } else {
                     SELVA_LOG(SELVA_LOGL_ERR, "String set field update failed");
@@ -474,9 +526,9 @@ static int add_set_values(
                     /* el doesn't exist in new_set, therefore it should be removed. */
                     SelvaSet_DestroyElement(SelvaSet_Remove(objSet, el));
 
-                    if (alias_key) {
+                    if (is_aliases) {
                         SelvaSubscriptions_DeferAliasChangeEvents(ctx, hierarchy, el);
-                        RedisModule_HashSet(alias_key, REDISMODULE_HASH_NONE, el, REDISMODULE_HASH_DELETE, NULL);
+                        (void)delete_alias(hierarchy, el);
                     }
 
                     RedisModule_FreeString(ctx, el);
@@ -606,7 +658,8 @@ string_err:
 
 static int del_set_values(
     RedisModuleCtx *ctx,
-    RedisModuleKey *alias_key,
+    SelvaHierarchy *hierarchy,
+    bool is_aliases,
     struct SelvaObject *obj,
     const RedisModuleString *field,
     const char *value_ptr,
@@ -637,9 +690,9 @@ static int del_set_values(
                 res++;
             }
 
-            /* Remove from the global aliases hash. */
-            if (alias_key) {
-                RedisModule_HashSet(alias_key, REDISMODULE_HASH_NONE, ref, REDISMODULE_HASH_DELETE, NULL);
+            /* Remove from the alias index. */
+            if (is_aliases && !err) {
+                (void)delete_alias(hierarchy, ref);
             }
 
             /* +1 to skip the NUL if cstring */
@@ -709,24 +762,16 @@ static int update_set(
     const struct SelvaModify_OpSet *setOpts
 ) {
     TO_STR(field);
-    RedisModuleKey *alias_key = NULL;
+    const bool is_aliases = !strcmp(field_str, SELVA_ALIASES_FIELD);
     int res = 0;
 
-    if (!strcmp(field_str, SELVA_ALIASES_FIELD)) {
-        alias_key = open_aliases_key(ctx);
-        if (!alias_key) {
-            SELVA_LOG(SELVA_LOGL_ERR, "Unable to open aliases");
-            return SELVA_ENOENT;
-        }
-    }
-
     if (setOpts->$value_len > 0) {
         int err;
 
         /*
          * Set new values.
          */
-        err = add_set_values(ctx, hierarchy, alias_key, obj, node_id, field, setOpts->$value, setOpts->$value_len, setOpts->op_set_type, 1);
+        err = add_set_values(ctx, hierarchy, is_aliases, obj, node_id, field, setOpts->$value, setOpts->$value_len, setOpts->op_set_type, 1);
         if (err < 0) {
             return err;
         } else {
@@ -736,7 +781,7 @@ static int update_set(
         if (setOpts->$add_len > 0) {
             int err;
 
-            err = add_set_values(ctx, hierarchy, alias_key, obj, node_id, field, setOpts->$add, setOpts->$add_len, setOpts->op_set_type, 0);
+            err = add_set_values(ctx, hierarchy, is_aliases, obj, node_id, field, setOpts->$add, setOpts->$add_len, setOpts->op_set_type, 0);
             if (err < 0) {
                 return err;
             } else {
@@ -747,7 +792,7 @@ static int update_set(
         if (setOpts->$delete_len > 0) {
             int err;
 
-            err = del_set_values(ctx, alias_key, obj, field, setOpts->$delete, setOpts->$delete_len, setOpts->op_set_type);
+            err = del_set_values(ctx, hierarchy, is_aliases, obj, field, setOpts->$delete, setOpts->$delete_len, setOpts->op_set_type);
             if (err < 0) {
                 return err;
             }
@@ -807,22 +852,15 @@ int SelvaModify_ModifySet(
 
             /*
              * First we need to delete the aliases of this node from the
-             * ___selva_aliases hash.
+             * alias index.
              */
             if (!strcmp(field_str, SELVA_ALIASES_FIELD)) {
-                RedisModuleKey *alias_key;
                 struct SelvaSet *node_aliases;
 
-                alias_key = open_aliases_key(ctx);
-                if (!alias_key) {
-                    SELVA_LOG(SELVA_LOGL_ERR, "Unable to open aliases");
-                    return SELVA_ENOENT;
-                }
-
                 node_aliases = SelvaObject_GetSet(obj, field);
                 if (node_aliases) {
                     selva_set_defer_alias_change_events(ctx, hierarchy, node_aliases);
-                    (void)delete_aliases(alias_key, node_aliases);
+                    (void)delete_aliases(hierarchy, node_id, node_aliases);
                 }
             }
 
@@ -904,18 +942,17 @@ static int parse_flags(const RedisModuleString *arg) {
  * @param out a vector for the query.
  *            The SVector must be initialized before calling this function.
  */
-static void parse_alias_query(RedisModuleString **argv, int argc, SVector *out) {
-    for (int i = 0; i < argc; i += 3) {
-        const RedisModuleString *type = argv[i];
-        const RedisModuleString *field = argv[i + 1];
-        const RedisModuleString *value = argv[i + 2];
+static void parse_alias_query(RedisModuleCtx *ctx, struct modify_arg *args, size_t nr_args, SVector *out) {
+    for (size_t i = 0; i < nr_args; i++) {
+        struct modify_arg *arg = &args[i];
 
-        TO_STR(type, field, value);
-        char type_code = type_str[0];
-
-        if (type_code == SELVA_MODIFY_ARG_STRING_ARRAY && !strcmp(field_str, "$alias")) {
+        if (arg->type_code == SELVA_MODIFY_ARG_STRING_ARRAY && arg_field_eq(arg, "$alias", sizeof("$alias") - 1)) {
+            /* The aliases must be nul-terminated and the RMS guarantees that. */
+            const RedisModuleString *value = arg_value(ctx, arg);
+            TO_STR(value);
             const char *s;
             size_t j = 0;
+
             while ((s = sztok(value_str, value_len, &j))) {
                 SVector_Insert(out, (void *)s);
             }
@@ -927,14 +964,13 @@ static int in_mem_range(const void *p, const void *start, size_t size) {
     return (ptrdiff_t)p >= (ptrdiff_t)start && (ptrdiff_t)p < (ptrdiff_t)start + (ptrdiff_t)size;
 }
 
-struct SelvaModify_OpSet *SelvaModify_OpSet_align(RedisModuleCtx *ctx, const struct RedisModuleString *data) {
-    TO_STR(data);
+static struct SelvaModify_OpSet *OpSet_align(RedisModuleCtx *ctx, const char *data_str, size_t data_len) {
     struct SelvaModify_OpSet *op;
 
     /* TODO Support __ORDER_BIG_ENDIAN__ */
     _Static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Only little endian host is supported");
 
-    if (!data || data_len == 0 || data_len < sizeof(struct SelvaModify_OpSet)) {
+    if (!data_str || data_len == 0 || data_len < sizeof(struct SelvaModify_OpSet)) {
         return NULL;
     }
 
@@ -955,14 +991,19 @@ struct SelvaModify_OpSet *SelvaModify_OpSet_align(RedisModuleCtx *ctx, const str
     return op;
 }
 
-static struct SelvaModify_OpEdgeMeta *SelvaModify_OpEdgeMeta_align(RedisModuleCtx *ctx, const struct RedisModuleString *data) {
+struct SelvaModify_OpSet *SelvaModify_OpSet_align(RedisModuleCtx *ctx, const struct RedisModuleString *data) {
     TO_STR(data);
+
+    return OpSet_align(ctx, data_str, data_len);
+}
+
+static struct SelvaModify_OpEdgeMeta *OpEdgeMeta_align(RedisModuleCtx *ctx, const char *data_str, size_t data_len) {
     struct SelvaModify_OpEdgeMeta *op;
 
     /* TODO Support __ORDER_BIG_ENDIAN__ */
     _Static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Only little endian host is supported");
 
-    if (!data || data_len == 0 || data_len < sizeof(struct SelvaModify_OpEdgeMeta)) {
+    if (!data_str || data_len == 0 || data_len < sizeof(struct SelvaModify_OpEdgeMeta)) {
         return NULL;
     }
 
@@ -1000,12 +1041,13 @@ void get_replicate_ts(struct replicate_ts *rs, struct SelvaHierarchyNode *node,
     }
 }
 
-enum selva_op_repl_state SelvaModify_ModifyMetadata(
+static enum selva_op_repl_state modify_metadata(
         RedisModuleCtx *ctx,
         struct SelvaObject *obj,
-        const RedisModuleString *field,
-        const RedisModuleString *value) {
-    TO_STR(value);
+        const char *field_str,
+        size_t field_len,
+        const char *value_str,
+        size_t value_len) {
     SelvaObjectMeta_t new_user_meta;
     SelvaObjectMeta_t old_user_meta;
     int err;
@@ -1016,10 +1058,10 @@ enum selva_op_repl_state SelvaModify_ModifyMetadata(
     }
 
     memcpy(&new_user_meta, value_str, sizeof(SelvaObjectMeta_t));
-    err = SelvaObject_SetUserMeta(obj, field, new_user_meta, &old_user_meta);
+    err = SelvaObject_SetUserMetaStr(obj, field_str, field_len, new_user_meta, &old_user_meta);
     if (err) {
-        replyWithSelvaErrorf(ctx, err, "Failed to set key metadata (%s)",
-                RedisModule_StringPtrLen(field, NULL));
+        replyWithSelvaErrorf(ctx, err, "Failed to set key metadata (%.*s)",
+                (int)field_len, field_str);
         return SELVA_OP_REPL_STATE_UNCHANGED;
     }
 
@@ -1030,15 +1072,27 @@ enum selva_op_repl_state SelvaModify_ModifyMetadata(
     return SELVA_OP_REPL_STATE_REPLICATE;
 }
 
+enum selva_op_repl_state SelvaModify_ModifyMetadata(
+        RedisModuleCtx *ctx,
+        struct SelvaObject *obj,
+        const RedisModuleString *field,
+        const RedisModuleString *value) {
+    TO_STR(field, value);
+
+    return modify_metadata(ctx, obj, field_str, field_len, value_str, value_len);
+}
+
 static enum selva_op_repl_state modify_array_op(
         RedisModuleCtx *ctx,
         struct SelvaHierarchyNode *node,
         int *active_insert_idx,
         int has_push,
-        char type_code,
-        RedisModuleString *field,
-        RedisModuleString *value) {
-    TO_STR(field, value);
+        struct modify_arg *arg) {
+    const char type_code = arg->type_code;
+    const char *field_str = arg->field_str;
+    const size_t field_len = arg->field_len;
+    const char *value_str = arg->value_str;
+    const size_t value_len = arg->value_len;
     ssize_t new_len;
     ssize_t idx;
 
@@ -1062,6 +1116,7 @@ static enum selva_op_repl_state modify_array_op(
     }
 
     if (type_code == SELVA_MODIFY_ARG_STRING) {
+        RedisModuleString *value = arg_value(ctx, arg);
         int err;
 
         if (*active_insert_idx == idx) {
@@ -1134,7 +1189,7 @@ static enum selva_op_repl_state modify_array_op(
             return SELVA_OP_REPL_STATE_UNCHANGED;
         }
     } else if (type_code == SELVA_MODIFY_ARG_OP_OBJ_META) {
-        return SelvaModify_ModifyMetadata(ctx, obj, field, value);
+        return modify_metadata(ctx, obj, field_str, field_len, value_str, value_len);
     } else {
         replyWithSelvaErrorf(ctx, SELVA_EINTYPE, "ERR Invalid operation type with array syntax: \"%c\"", type_code);
         return SELVA_OP_REPL_STATE_UNCHANGED;
@@ -1148,26 +1203,40 @@ static enum selva_op_repl_state modify_op(
         SelvaHierarchy *hierarchy,
         const Selva_NodeId nodeId,
         struct SelvaHierarchyNode *node,
-        char type_code,
-        RedisModuleString *field,
-        RedisModuleString *value) {
+        struct modify_arg *arg) {
     struct SelvaObject *obj = SelvaHierarchy_GetNodeObject(node);
-    TO_STR(field, value);
+    const char type_code = arg->type_code;
+    const char *field_str = arg->field_str;
+    const size_t field_len = arg->field_len;
+    const char *value_str = arg->value_str;
+    const size_t value_len = arg->value_len;
 
     if (type_code == SELVA_MODIFY_ARG_OP_INCREMENT) {
-        const struct SelvaModify_OpIncrement *incrementOpts = (const struct SelvaModify_OpIncrement *)value_str;
+        struct SelvaModify_OpIncrement incrementOpts;
         int err;
 
-        err = SelvaObject_IncrementLongLong(obj, field, incrementOpts->$default, incrementOpts->$increment);
+        if (value_len < sizeof(incrementOpts)) {
+            REPLY_WITH_ARG_TYPE_ERROR(incrementOpts);
+            return SELVA_OP_REPL_STATE_UNCHANGED;
+        }
+
+        memcpy(&incrementOpts, value_str, sizeof(incrementOpts));
+        err = SelvaObject_IncrementLongLongStr(obj, field_str, field_len, incrementOpts.$default, incrementOpts.$increment);
         if (err) {
             replyWithSelvaError(ctx, err);
             return SELVA_OP_REPL_STATE_UNCHANGED;
         }
     } else if (type_code == SELVA_MODIFY_ARG_OP_INCREMENT_DOUBLE) {
-        const struct SelvaModify_OpIncrementDouble *incrementOpts = (const struct SelvaModify_OpIncrementDouble*)value_str;
+        struct SelvaModify_OpIncrementDouble incrementOpts;
         int err;
 
-        err = SelvaObject_IncrementDouble(obj, field, incrementOpts->$default, incrementOpts->$increment);
+        if (value_len < sizeof(incrementOpts)) {
+            REPLY_WITH_ARG_TYPE_ERROR(incrementOpts);
+            return SELVA_OP_REPL_STATE_UNCHANGED;
+        }
+
+        memcpy(&incrementOpts, value_str, sizeof(incrementOpts));
+        err = SelvaObject_IncrementDoubleStr(obj, field_str, field_len, incrementOpts.$default, incrementOpts.$increment);
         if (err) {
             replyWithSelvaError(ctx, err);
             return SELVA_OP_REPL_STATE_UNCHANGED;
@@ -1176,13 +1245,13 @@ static enum selva_op_repl_state modify_op(
         struct SelvaModify_OpSet *setOpts;
         int err;
 
-        setOpts = SelvaModify_OpSet_align(ctx, value);
+        setOpts = OpSet_align(ctx, value_str, value_len);
         if (!setOpts) {
             replyWithSelvaErrorf(ctx, SELVA_EINVAL, "Invalid OpSet");
             return SELVA_OP_REPL_STATE_UNCHANGED;
         }
 
-        err = SelvaModify_ModifySet(ctx, hierarchy, nodeId, node, obj, field, setOpts);
+        err = SelvaModify_ModifySet(ctx, hierarchy, nodeId, node, obj, arg_field(ctx, arg), setOpts);
         if (err == 0) {
             RedisModule_ReplyWithSimpleString(ctx, "OK");
             return SELVA_OP_REPL_STATE_UNCHANGED;
@@ -1193,7 +1262,7 @@ static enum selva_op_repl_state modify_op(
     } else if (type_code == SELVA_MODIFY_ARG_OP_DEL) {
         int err;
 
-        err = SelvaModify_ModifyDel(ctx, hierarchy, node, obj, field);
+        err = SelvaModify_ModifyDel(ctx, hierarchy, node, obj, arg_field(ctx, arg));
         if (err == SELVA_ENOENT) {
             /* No need to replicate. */
             RedisModule_ReplyWithSimpleString(ctx, "OK");
@@ -1207,6 +1276,7 @@ static enum selva_op_repl_state modify_op(
                type_code == SELVA_MODIFY_ARG_STRING) {
         const enum SelvaObjectType old_type = SelvaObject_GetTypeStr(obj, field_str, field_len);
         RedisModuleString *old_value;
+        RedisModuleString *value;
         RedisModuleString *shared;
         int err;
 
@@ -1215,11 +1285,11 @@ static enum selva_op_repl_state modify_op(
             return SELVA_OP_REPL_STATE_UNCHANGED;
         }
 
-        if (old_type == SELVA_OBJECT_STRING && !SelvaObject_GetString(obj, field, &old_value)) {
+        if (old_type == SELVA_OBJECT_STRING && !SelvaObject_GetStringStr(obj, field_str, field_len, &old_value)) {
             TO_STR(old_value);
 
             if (old_value_len == value_len && !memcmp(old_value_str, value_str, value_len)) {
-                if (!strcmp(field_str, "type")) {
+                if (arg_field_eq(arg, SELVA_TYPE_FIELD, sizeof(SELVA_TYPE_FIELD) - 1)) {
                     /*
                      * Always send "UPDATED" for the "type" field because the
                      * client will/should only send a it for a new node but
@@ -1233,16 +1303,17 @@ static enum selva_op_repl_state modify_op(
             }
         }
 
+        value = arg_value(ctx, arg);
         shared = Share_RMS(field_str, field_len, value);
         if (shared) {
-            err = SelvaObject_SetString(obj, field, shared);
+            err = SelvaObject_SetStringStr(obj, field_str, field_len, shared);
             if (err) {
                 RedisModule_FreeString(NULL, shared);
                 replyWithSelvaErrorf(ctx, err, "Failed to set a shared string value");
                 return SELVA_OP_REPL_STATE_UNCHANGED;
             }
         } else {
-            err = SelvaObject_SetString(obj, field, value);
+            err = SelvaObject_SetStringStr(obj, field_str, field_len, value);
             if (err) {
                 replyWithSelvaErrorf(ctx, err, "Failed to set a string value");
                 return SELVA_OP_REPL_STATE_UNCHANGED;
@@ -1262,9 +1333,9 @@ static enum selva_op_repl_state modify_op(
         memcpy(&ll, value_str, sizeof(ll));
 
         if (type_code == SELVA_MODIFY_ARG_DEFAULT_LONGLONG) {
-            err = SelvaObject_SetLongLongDefault(obj, field, ll);
+            err = SelvaObject_SetLongLongDefaultStr(obj, field_str, field_len, ll);
         } else {
-            err = SelvaObject_UpdateLongLong(obj, field, ll);
+            err = SelvaObject_UpdateLongLongStr(obj, field_str, field_len, ll);
         }
         if (err == SELVA_EEXIST) { /* Default handling. */
             RedisModule_ReplyWithSimpleString(ctx, "OK");
@@ -1286,9 +1357,9 @@ static enum selva_op_repl_state modify_op(
         memcpy(&d, value_str, sizeof(d));
 
         if (type_code == SELVA_MODIFY_ARG_DEFAULT_DOUBLE) {
-            err = SelvaObject_SetDoubleDefault(obj, field, d);
+            err = SelvaObject_SetDoubleDefaultStr(obj, field_str, field_len, d);
         } else {
-            err = SelvaObject_UpdateDouble(obj, field, d);
+            err = SelvaObject_UpdateDoubleStr(obj, field_str, field_len, d);
         }
         if (err == SELVA_EEXIST) { /* Default handling. */
             RedisModule_ReplyWithSimpleString(ctx, "OK");
@@ -1298,7 +1369,7 @@ static enum selva_op_repl_state modify_op(
             return SELVA_OP_REPL_STATE_UNCHANGED;
         }
     } else if (type_code == SELVA_MODIFY_ARG_OP_OBJ_META) {
-        return SelvaModify_ModifyMetadata(ctx, obj, field, value);
+        return modify_metadata(ctx, obj, field_str, field_len, value_str, value_len);
     } else if (type_code == SELVA_MODIFY_ARG_OP_ARRAY_REMOVE) {
         uint32_t v;
         int err;
@@ -1328,9 +1399,9 @@ static enum selva_op_repl_state modify_op(
 static enum selva_op_repl_state modify_edge_meta_op(
         RedisModuleCtx *ctx,
         struct SelvaHierarchyNode *node,
-        RedisModuleString *field,
-        RedisModuleString *raw_value) {
-    TO_STR(field);
+        const struct modify_arg *arg) {
+    const char *field_str = arg->field_str;
+    const size_t field_len = arg->field_len;
     struct EdgeField *edge_field;
     struct SelvaObject *edge_metadata;
     const struct SelvaModify_OpEdgeMeta *op;
@@ -1343,7 +1414,7 @@ static enum selva_op_repl_state modify_edge_meta_op(
         return SELVA_OP_REPL_STATE_UNCHANGED;
     }
 
-    op = SelvaModify_OpEdgeMeta_align(ctx, raw_value);
+    op = OpEdgeMeta_align(ctx, arg->value_str, arg->value_len);
     if (!op) {
         replyWithSelvaError(ctx, SELVA_EINVAL);
         return SELVA_OP_REPL_STATE_UNCHANGED;
@@ -1452,6 +1523,23 @@ static enum selva_op_repl_state modify_edge_meta_op(
     return SELVA_OP_REPL_STATE_UPDATED;
 }
 
+static void replication_delay(void) {
+    /*
+     * It's kinda not optimal needing to check this global on every replication
+     * but it helps us with testing and it's still very negligible overhead.
+     * TODO Perhaps in the future we could have a CI build flag to enable this
+     * sort of things.
+     */
+    if (selva_glob_config.debug_modify_replication_delay_ns > 0) {
+        const struct timespec tim = {
+            .tv_sec = 0,
+            .tv_nsec = selva_glob_config.debug_modify_replication_delay_ns,
+        };
+
+        nanosleep(&tim, NULL);
+    }
+}
+
 /*
  * Replicate the selva.modify command.
  * This function depends on the argument order of selva.modify.
@@ -1506,52 +1594,37 @@ void replicateModify(RedisModuleCtx *ctx, const struct bitmap *replset, RedisMod
         argv[argc++] = RedisModule_CreateString(ctx, v, size);
     }
 
-    /*
-     * It's kinda not optimal needing to check this global on every replication
-     * but it helps us with testing and it's still very negligible overhead.
-     * TODO Perhaps in the future we could have a CI build flag to enable this
-     * sort of things.
-     */
-    if (selva_glob_config.debug_modify_replication_delay_ns > 0) {
-        const struct timespec tim = {
-            .tv_sec = 0,
-            .tv_nsec = selva_glob_config.debug_modify_replication_delay_ns,
-        };
-
-        nanosleep(&tim, NULL);
-    }
-
+    replication_delay();
     RedisModule_ReplicateVerbatimArgs(ctx, argv, argc);
 }
 
-/*
- * Request:
- * id, FLAGS type, field, value [, ... type, field, value]]
- * N = No root
- * M = Merge
- *
- * The behavior and meaning of `value` depends on `type` (enum SelvaModify_ArgType).
- *
- * Response:
- * [
- * id,
- * [err | 0 | 1]
- * ...
- * ]
- *
- * err = error in parsing or executing the triplet
- * OK = the triplet made no changes
- * UPDATED = changes made and replicated
+/**
+ * Modify a single node.
+ * A reply is always sent for the node, either an error, null, or an array of
+ * op results.
+ * Subscription events are deferred and the caller must send them.
+ * @param id_str is the node id given by the client. It may be replaced by an $alias op.
+ * @param flags is a combination of FLAG_xxx.
+ * @param[out] replset_out is set to the replication bitmap of the ops.
+ * @param[out] rs is updated with the automatic timestamps to be replicated; Can be NULL.
+ * @returns 0 if the node was modified and replset_out is valid;
+ *          Otherwise a non-zero value is returned and nothing should be replicated.
  */
-int SelvaCommand_Modify(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    SELVA_TRACE_BEGIN_AUTO(cmd_modify);
-    RedisModule_AutoMemory(ctx);
-    SelvaHierarchy *hierarchy;
-    RedisModuleString *id = NULL;
+static int modify_node(
+        RedisModuleCtx *ctx,
+        SelvaHierarchy *hierarchy,
+        const char *id_str,
+        size_t id_len,
+        unsigned flags,
+        struct modify_arg *args,
+        size_t nr_args,
+        struct bitmap **replset_out,
+        struct replicate_ts *rs) {
     SVECTOR_AUTOFREE(alias_query);
     bool created = false; /* Will be set if the node was created during this command. */
     bool updated = false;
     bool new_alias = false; /* Set if $alias will be creating new alias(es). */
+    Selva_NodeId alias_id; /* Storage for id_str if it's replaced by an alias. */
     int err = 0;
 
     /*
@@ -1560,105 +1633,75 @@ int SelvaCommand_Modify(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
      */
     SVector_Init(&alias_query, 5, NULL);
 
-    /*
-     * We expect two fixed arguments and a number of [type, field, value] triplets.
-     */
-    if (argc < 6 || (argc - 3) % 3) {
-        return RedisModule_WrongArity(ctx);
-    }
-
-    RedisModuleString *hkey_name = RedisModule_CreateString(ctx, HIERARCHY_DEFAULT_KEY, sizeof(HIERARCHY_DEFAULT_KEY) - 1);
-    hierarchy = SelvaModify_OpenHierarchy(ctx, hkey_name, REDISMODULE_READ | REDISMODULE_WRITE);
-    if (!hierarchy) {
-        return REDISMODULE_OK;
-    }
-
     /*
      * We use the ID generated by the client as the nodeId by default but later
-     * on if an $alias entry is found then the following value will be discarded.
+     * on if an $alias entry is found then the id will be discarded.
      */
-    id = argv[1];
 
     /*
      * Look for $alias that would replace id.
      */
-    parse_alias_query(argv + 3, argc - 3, &alias_query);
+    parse_alias_query(ctx, args, nr_args, &alias_query);
     if (SVector_Size(&alias_query) > 0) {
-        RedisModuleKey *alias_key = open_aliases_key(ctx);
-
-        if (alias_key && RedisModule_KeyType(alias_key) == REDISMODULE_KEYTYPE_HASH) {
-            struct SVectorIterator it;
-            char *str;
-
-            /*
-             * Replace id with the first match from alias_query.
-             */
-            SVector_ForeachBegin(&it, &alias_query);
-            while ((str = SVector_Foreach(&it))) {
-                RedisModuleString *tmp_id;
+        struct SVectorIterator it;
+        char *str;
 
-                if (!RedisModule_HashGet(alias_key, REDISMODULE_HASH_CFIELDS, str, &tmp_id, NULL)) {
-                    Selva_NodeId nodeId;
+        /* An empty index is a sign that there are no aliases in the DB yet. */
+        new_alias = hierarchy->aliases.nr_aliases == 0;
 
-                    err = Selva_RMString2NodeId(nodeId, tmp_id);
-                    if (err) {
-                        /* TODO Should it fail? */
-                        continue;
-                    }
+        /*
+         * Replace id with the first match from alias_query.
+         */
+        SVector_ForeachBegin(&it, &alias_query);
+        while ((str = SVector_Foreach(&it))) {
+            Selva_NodeId alias_node_id;
 
-                    if (SelvaHierarchy_NodeExists(hierarchy, nodeId)) {
-                        id = tmp_id;
+            if (!get_alias(hierarchy, str, strlen(str), alias_node_id) &&
+                SelvaHierarchy_NodeExists(hierarchy, alias_node_id)) {
+                memcpy(alias_id, alias_node_id, SELVA_NODE_ID_SIZE);
+                id_str = alias_id;
+                id_len = Selva_NodeIdLen(alias_id);
 
-                        /*
-                         * If no match was found all the aliases should be assigned.
-                         * If a match was found the query vector can be cleared now
-                         * to prevent any aliases from being created.
-                         */
-                        SVector_Clear(&alias_query);
+                /*
+                 * If no match was found all the aliases should be assigned.
+                 * If a match was found the query vector can be cleared now
+                 * to prevent any aliases from being created.
+                 */
+                SVector_Clear(&alias_query);
 
-                        break;
-                    }
-                }
+                break;
             }
-        } else {
-#if 0
-            /* This is probably ok and it's a sign that there are no aliases in the DB yet. */
-            fprintf(stderr, "%s:%d: Unable to open the aliases key or its type is invalid\n",
-                    __FILE__, __LINE__);
-#endif
-            new_alias = true;
         }
-
-        RedisModule_CloseKey(alias_key);
     }
 
     Selva_NodeId nodeId;
     struct SelvaHierarchyNode *node;
-    const unsigned flags = parse_flags(argv[2]);
 
-    err = Selva_RMString2NodeId(nodeId, id);
-    if (err) {
-        return replyWithSelvaErrorf(ctx, err, "Invalid nodeId");
+    if (id_len < SELVA_NODE_TYPE_SIZE + 1 || id_len > SELVA_NODE_ID_SIZE) {
+        replyWithSelvaErrorf(ctx, SELVA_EINVAL, "Invalid nodeId");
+        return SELVA_EINVAL;
     }
+    Selva_NodeIdCpy(nodeId, id_str);
 
     node = SelvaHierarchy_FindNode(hierarchy, nodeId);
     if (!node) {
         if (FISSET_UPDATE(flags)) {
             /* if the specified id doesn't exist but $operation: 'update' specified */
             RedisModule_ReplyWithNull(ctx);
-            return REDISMODULE_OK;
+            return SELVA_HIERARCHY_ENOENT;
         }
 
         const size_t nr_parents = !FISSET_NO_ROOT(flags);
 
         err = SelvaModify_SetHierarchy(ctx, hierarchy, nodeId, nr_parents, ((Selva_NodeId []){ ROOT_NODE_ID }), 0, NULL, &node);
         if (err < 0) {
-            return replyWithSelvaErrorf(ctx, err, "ERR Failed to initialize the node hierarchy for id: \"%s\"", RedisModule_StringPtrLen(id, NULL));
+            replyWithSelvaErrorf(ctx, err, "ERR Failed to initialize the node hierarchy for id: \"%.*s\"", (int)id_len, id_str);
+            return err;
         }
     } else if (FISSET_CREATE(flags)) {
         /* if the specified id exists but $operation: 'insert' specified. */
         RedisModule_ReplyWithNull(ctx);
-        return REDISMODULE_OK;
+        return SELVA_HIERARCHY_EEXIST;
     }
 
     created = updated = SelvaHierarchy_ClearNodeFlagImplicit(node);
@@ -1672,14 +1715,13 @@ int SelvaCommand_Modify(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
      * Replication bitmap.
      *
      * bit  desc
-     * 0    replicate the first triplet
-     * 1    replicate the second triplet
+     * 0    replicate the first op
+     * 1    replicate the second op
      * ...  ...
      */
-    const int nr_triplets = (argc - 3) / 3;
-    struct bitmap *replset = RedisModule_PoolAlloc(ctx, BITMAP_ALLOC_SIZE(nr_triplets));
+    struct bitmap *replset = RedisModule_PoolAlloc(ctx, BITMAP_ALLOC_SIZE(nr_args));
 
-    replset->nbits = nr_triplets;
+    replset->nbits = nr_args;
     bitmap_erase(replset);
 
     int has_push = 0;
@@ -1690,21 +1732,21 @@ int SelvaCommand_Modify(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
      * Each part of the command will send a separate response back to the client.
      * Each part is also replicated separately.
      */
-    RedisModule_ReplyWithArray(ctx, 1 + nr_triplets);
-    RedisModule_ReplyWithString(ctx, id);
-
-    for (int i = 3; i < argc; i += 3) {
-        RedisModuleString *type = argv[i];
-        RedisModuleString *field = argv[i + 1];
-        RedisModuleString *value = argv[i + 2];
-        TO_STR(type, field);
-        const char type_code = type_str[0]; /* [0] always points to a valid char in RM_String. */
+    RedisModule_ReplyWithArray(ctx, 1 + nr_args);
+    RedisModule_ReplyWithStringBuffer(ctx, id_str, id_len);
+
+    for (size_t i = 0; i < nr_args; i++) {
+        struct modify_arg *arg = &args[i];
+        const char type_code = arg->type_code;
+        const char *field_str = arg->field_str;
+        const size_t field_len = arg->field_len;
+        const char *value_str = arg->value_str;
+        const size_t value_len = arg->value_len;
         enum selva_op_repl_state repl_state = SELVA_OP_REPL_STATE_UNCHANGED;
 
         if (get_array_field_index(field_str, field_len, NULL) >= 0) {
-            repl_state = modify_array_op(ctx, node, &active_insert_idx, has_push, type_code, field, value);
+            repl_state = modify_array_op(ctx, node, &active_insert_idx, has_push, arg);
         } else if (type_code == SELVA_MODIFY_ARG_OP_ARRAY_PUSH) {
-            TO_STR(value);
             uint32_t item_type;
 
             if (value_len != sizeof(uint32_t)) {
@@ -1731,7 +1773,6 @@ int SelvaCommand_Modify(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
 
             repl_state = SELVA_OP_REPL_STATE_UPDATED;
         } else if (type_code == SELVA_MODIFY_ARG_OP_ARRAY_INSERT) {
-            TO_STR(value);
             uint32_t item_type;
             uint32_t insert_idx;
 
@@ -1762,7 +1803,6 @@ int SelvaCommand_Modify(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
 
             repl_state = SELVA_OP_REPL_STATE_UPDATED;
         } else if (type_code == SELVA_MODIFY_ARG_OP_ARRAY_QUEUE_TRIM) {
-            TO_STR(value);
             uint32_t max_array_len;
 
             if (value_len != 1 * sizeof(uint32_t)) {
@@ -1801,29 +1841,30 @@ int SelvaCommand_Modify(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
                 RedisModule_ReplyWithSimpleString(ctx, "OK");
             }
 
-            /* This triplet needs to be replicated. */
-            bitmap_set(replset, i / 3 - 1);
+            /* This op needs to be replicated. */
+            bitmap_set(replset, i);
             continue;
         } else if (type_code == SELVA_MODIFY_ARG_OP_EDGE_META) {
-            repl_state = modify_edge_meta_op(ctx, node, field, value);
+            repl_state = modify_edge_meta_op(ctx, node, arg);
         } else {
-            repl_state = modify_op(ctx, hierarchy, nodeId, node, type_code, field, value);
+            repl_state = modify_op(ctx, hierarchy, nodeId, node, arg);
         }
 
         if (repl_state == SELVA_OP_REPL_STATE_REPLICATE) {
-            /* This triplet needs to be replicated. */
-            bitmap_set(replset, i / 3 - 1);
+            /* This op needs to be replicated. */
+            bitmap_set(replset, i);
 
             RedisModule_ReplyWithSimpleString(ctx, "OK");
         } else if (repl_state == SELVA_OP_REPL_STATE_UPDATED) {
-            /* This triplet needs to be replicated. */
-            bitmap_set(replset, i / 3 - 1);
+            /* This op needs to be replicated. */
+            bitmap_set(replset, i);
 
             /*
              * Publish that the field was changed.
              * Hierarchy handles events for parents and children.
              */
-            if (strcmp(field_str, SELVA_PARENTS_FIELD) && strcmp(field_str, SELVA_CHILDREN_FIELD)) {
+            if (!arg_field_eq(arg, SELVA_PARENTS_FIELD, sizeof(SELVA_PARENTS_FIELD) - 1) &&
+                !arg_field_eq(arg, SELVA_CHILDREN_FIELD, sizeof(SELVA_CHILDREN_FIELD) - 1)) {
                 SelvaSubscriptions_DeferFieldChangeEvents(ctx, hierarchy, node, field_str, field_len);
             }
 
@@ -1857,15 +1898,13 @@ int SelvaCommand_Modify(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
 
             err = SelvaModify_ModifySet(ctx, hierarchy, nodeId, node, obj, aliases_field, &opSet);
             if (err < 0) {
-                TO_STR(id);
-
                 /*
                  * Since we are already at the end of the command, it's next to
                  * impossible to rollback the command, so we'll just log any
                  * errors received here.
                  */
-                SELVA_LOG(SELVA_LOGL_ERR, "An error occurred while setting an alias \"%s\" -> %s: %s\n",
-                          alias, id_str, getSelvaErrorStr(err));
+                SELVA_LOG(SELVA_LOGL_ERR, "An error occurred while setting an alias \"%s\" -> %.*s: %s\n",
+                          alias, (int)id_len, id_str, getSelvaErrorStr(err));
             }
         }
     }
@@ -1894,10 +1933,82 @@ int SelvaCommand_Modify(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
         }
     }
 
-    if (RedisModule_GetContextFlags(ctx) & REDISMODULE_CTX_FLAGS_MASTER) {
-        struct replicate_ts replicate_ts;
+    if (rs) {
+        get_replicate_ts(rs, node, created, updated);
+    }
+    *replset_out = replset;
+
+    return 0;
+}
+
+/*
+ * Request:
+ * id, FLAGS type, field, value [, ... type, field, value]]
+ * N = No root
+ * M = Merge
+ *
+ * The behavior and meaning of `value` depends on `type` (enum SelvaModify_ArgType).
+ *
+ * Response:
+ * [
+ * id,
+ * [err | 0 | 1]
+ * ...
+ * ]
+ *
+ * err = error in parsing or executing the triplet
+ * OK = the triplet made no changes
+ * UPDATED = changes made and replicated
+ */
+int SelvaCommand_Modify(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    SELVA_TRACE_BEGIN_AUTO(cmd_modify);
+    RedisModule_AutoMemory(ctx);
+    SelvaHierarchy *hierarchy;
+    struct bitmap *replset;
+    struct replicate_ts replicate_ts;
+    const int replicate = !!(RedisModule_GetContextFlags(ctx) & REDISMODULE_CTX_FLAGS_MASTER);
+
+    /*
+     * We expect two fixed arguments and a number of [type, field, value] triplets.
+     */
+    if (argc < 6 || (argc - 3) % 3) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModuleString *hkey_name = RedisModule_CreateString(ctx, HIERARCHY_DEFAULT_KEY, sizeof(HIERARCHY_DEFAULT_KEY) - 1);
+    hierarchy = SelvaModify_OpenHierarchy(ctx, hkey_name, REDISMODULE_READ | REDISMODULE_WRITE);
+    if (!hierarchy) {
+        return REDISMODULE_OK;
+    }
 
-        get_replicate_ts(&replicate_ts, node, created, updated);
+    /*
+     * Convert the triplets to modify args.
+     */
+    const size_t nr_args = (argc - 3) / 3;
+    struct modify_arg *args = RedisModule_PoolAlloc(ctx, nr_args * sizeof(struct modify_arg));
+
+    for (size_t i = 0; i < nr_args; i++) {
+        struct modify_arg *arg = &args[i];
+        RedisModuleString *type = argv[3 + 3 * i];
+        RedisModuleString *field = argv[3 + 3 * i + 1];
+        RedisModuleString *value = argv[3 + 3 * i + 2];
+        TO_STR(type);
+
+        arg->type_code = type_str[0]; /* [0] always points to a valid char in RM_String. */
+        arg->field_str = RedisModule_StringPtrLen(field, &arg->field_len);
+        arg->value_str = RedisModule_StringPtrLen(value, &arg->value_len);
+        arg->field = field;
+        arg->value = value;
+    }
+
+    const RedisModuleString *id = argv[1];
+    TO_STR(id);
+
+    if (modify_node(ctx, hierarchy, id_str, id_len, parse_flags(argv[2]), args, nr_args, &replset, replicate ? &replicate_ts : NULL)) {
+        return REDISMODULE_OK;
+    }
+
+    if (replicate) {
         replicateModify(ctx, replset, argv, &replicate_ts);
     }
 
@@ -1906,6 +2017,277 @@ int SelvaCommand_Modify(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
     return REDISMODULE_OK;
 }
 
+/**
+ * Convert the ops of a modify stream record to modify args.
+ */
+static struct modify_arg *stream2args(
+        RedisModuleCtx *ctx,
+        const struct SelvaModifyStream_Field *fields,
+        const struct SelvaModifyStream_Record *rec) {
+    struct modify_arg *args;
+    struct SelvaModifyStream_Op op;
+    size_t off = 0;
+    size_t i = 0;
+
+    args = RedisModule_PoolAlloc(ctx, rec->nr_ops * sizeof(struct modify_arg));
+    while (!SelvaModifyStream_NextOp(rec, &off, &op)) {
+        struct modify_arg *arg = &args[i++];
+
+        arg->type_code = op.type_code;
+        if (op.field_id >= 0) {
+            arg->field_str = fields[op.field_id].name_str;
+            arg->field_len = fields[op.field_id].name_len;
+        } else {
+            arg->field_str = op.field_str;
+            arg->field_len = op.field_len;
+        }
+        arg->value_str = op.value_str;
+        arg->value_len = op.value_len;
+        arg->field = NULL;
+        arg->value = NULL;
+    }
+
+    return args;
+}
+
+/**
+ * Parse the records of a modify stream.
+ * The whole stream is validated before returning.
+ * @returns the number of records parsed; Otherwise a Selva error.
+ */
+static ssize_t parse_batch(
+        RedisModuleCtx *ctx,
+        const struct SelvaModifyStream *stream,
+        struct modify_batch_rec **recs_out) {
+    struct SelvaModifyStream s = *stream;
+    struct SelvaModifyStream_Record rec;
+    struct modify_batch_rec *recs;
+    size_t nr_recs = 0;
+    int err;
+
+    while (!(err = SelvaModifyStream_NextRecord(&s, &rec))) {
+        nr_recs++;
+    }
+    if (err != SELVA_ENOENT) {
+        return err;
+    }
+
+    recs = RedisModule_PoolAlloc(ctx, nr_recs * sizeof(struct modify_batch_rec));
+    memset(recs, 0, nr_recs * sizeof(struct modify_batch_rec));
+
+    s = *stream;
+    for (size_t i = 0; i < nr_recs; i++) {
+        (void)SelvaModifyStream_NextRecord(&s, &recs[i].rec);
+    }
+
+    *recs_out = recs;
+    return (ssize_t)nr_recs;
+}
+
+static int batch_rec_cmp(const void *a, const void *b) {
+    const struct modify_batch_rec *rec_a = *(const struct modify_batch_rec **)a;
+    const struct modify_batch_rec *rec_b = *(const struct modify_batch_rec **)b;
+
+    return memcmp(rec_a->rec.node_id, rec_b->rec.node_id, SELVA_NODE_ID_SIZE);
+}
+
+/**
+ * Warm up the nodes of a batch.
+ * The lookups are made in node id order to share the index tree paths between
+ * consecutive lookups and the node data is prefetched for the actual modify
+ * pass that runs in the original order.
+ */
+static void prefetch_batch_nodes(RedisModuleCtx *ctx, SelvaHierarchy *hierarchy, struct modify_batch_rec *recs, size_t nr_recs) {
+    struct modify_batch_rec **sorted;
+
+    sorted = RedisModule_PoolAlloc(ctx, nr_recs * sizeof(struct modify_batch_rec *));
+    for (size_t i = 0; i < nr_recs; i++) {
+        sorted[i] = &recs[i];
+    }
+
+    qsort(sorted, nr_recs, sizeof(struct modify_batch_rec *), batch_rec_cmp);
+
+    for (size_t i = 0; i < nr_recs; i++) {
+        struct SelvaHierarchyNode *node;
+
+        node = SelvaHierarchy_FindNode(hierarchy, sorted[i]->rec.node_id);
+        if (node) {
+            __builtin_prefetch(SelvaHierarchy_GetNodeObject(node), 1);
+            __builtin_prefetch(SelvaHierarchy_GetNodeMetadataByPtr(node), 1);
+        }
+    }
+}
+
+static char *stream_put_ts_op(char *p, const char *field_str, uint16_t field_len, long long ts) {
+    const uint32_t value_len = sizeof(ts);
+
+    *p++ = SELVA_MODIFY_ARG_LONGLONG;
+    memcpy(p, &field_len, sizeof(field_len));
+    p += sizeof(field_len);
+    memcpy(p, field_str, field_len);
+    p += field_len;
+    memcpy(p, &value_len, sizeof(value_len));
+    p += sizeof(value_len);
+    memcpy(p, &ts, sizeof(ts));
+    p += sizeof(ts);
+
+    return p;
+}
+
+/*
+ * Replicate selva.modify.batch as a single command.
+ * Only the ops that need to be replicated are included in the new stream
+ * and the automatic timestamps are appended to each record.
+ */
+static void replicateModifyBatch(
+        RedisModuleCtx *ctx,
+        RedisModuleString **orig_argv,
+        const struct SelvaModifyStream *stream,
+        const struct modify_batch_rec *recs,
+        size_t nr_recs) {
+    const size_t ts_size = 2 * (1 + sizeof(uint16_t) + sizeof(uint32_t) + sizeof(long long)) + sizeof(SELVA_CREATED_AT_FIELD) + sizeof(SELVA_UPDATED_AT_FIELD);
+    char *buf;
+    char *p;
+
+    buf = RedisModule_PoolAlloc(ctx, stream->len + nr_recs * ts_size);
+
+    /*
+     * Header and the field table are copied as is.
+     */
+    memcpy(buf, stream->buf, stream->off);
+    p = buf + stream->off;
+
+    for (size_t i = 0; i < nr_recs; i++) {
+        const struct modify_batch_rec *rec = &recs[i];
+        const struct replicate_ts *rs = &rec->rs;
+        struct SelvaModifyStream_Op op;
+        const uint8_t flags = (uint8_t)rec->rec.flags;
+        uint32_t nr_ops;
+        size_t off = 0;
+        int j = 0;
+
+        if (!rec->replicate) {
+            continue;
+        }
+
+        nr_ops = (uint32_t)(bitmap_popcount(rec->replset) + rs->created + rs->updated);
+        memcpy(p, rec->rec.node_id, SELVA_NODE_ID_SIZE);
+        p += SELVA_NODE_ID_SIZE;
+        *p++ = flags;
+        memcpy(p, &nr_ops, sizeof(nr_ops));
+        p += sizeof(nr_ops);
+
+        while (!SelvaModifyStream_NextOp(&rec->rec, &off, &op)) {
+            if (bitmap_get(rec->replset, j++)) {
+                memcpy(p, op.raw, op.raw_len);
+                p += op.raw_len;
+            }
+        }
+
+        if (rs->created) {
+            p = stream_put_ts_op(p, SELVA_CREATED_AT_FIELD, sizeof(SELVA_CREATED_AT_FIELD) - 1, rs->created_at);
+        }
+        if (rs->updated) {
+            p = stream_put_ts_op(p, SELVA_UPDATED_AT_FIELD, sizeof(SELVA_UPDATED_AT_FIELD) - 1, rs->updated_at);
+        }
+    }
+
+    if (p == buf + stream->off) {
+        return; /* Skip. */
+    }
+
+    RedisModuleString *argv[] = {
+        orig_argv[0],
+        orig_argv[1],
+        RedisModule_CreateString(ctx, buf, (size_t)(p - buf)),
+    };
+
+    replication_delay();
+    RedisModule_ReplicateVerbatimArgs(ctx, argv, num_elem(argv));
+}
+
+/*
+ * Request:
+ * KEY STREAM
+ *
+ * STREAM is a modify op stream as documented in modify_stream.h.
+ * Each record in the stream modifies a single node the same way as
+ * selva.modify would.
+ *
+ * The records are applied in the given order. Subscription events are sent
+ * once after all the records have been applied and the command is replicated
+ * as a single selva.modify.batch command.
+ *
+ * Response:
+ * [
+ * selva.modify response for the first record,
+ * ...
+ * ]
+ */
+int SelvaCommand_ModifyBatch(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    SELVA_TRACE_BEGIN_AUTO(cmd_modify_batch);
+    RedisModule_AutoMemory(ctx);
+    SelvaHierarchy *hierarchy;
+    struct SelvaModifyStream stream;
+    struct SelvaModifyStream_Field *fields;
+    struct modify_batch_rec *recs = NULL;
+    ssize_t nr_recs;
+    const int replicate = !!(RedisModule_GetContextFlags(ctx) & REDISMODULE_CTX_FLAGS_MASTER);
+    int err;
+
+    const int ARGV_KEY = 1;
+    const int ARGV_STREAM = 2;
+
+    if (argc != 3) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    hierarchy = SelvaModify_OpenHierarchy(ctx, argv[ARGV_KEY], REDISMODULE_READ | REDISMODULE_WRITE);
+    if (!hierarchy) {
+        return REDISMODULE_OK;
+    }
+
+    const RedisModuleString *stream_arg = argv[ARGV_STREAM];
+    TO_STR(stream_arg);
+
+    err = SelvaModifyStream_Init(&stream, stream_arg_str, stream_arg_len);
+    if (err) {
+        return replyWithSelvaErrorf(ctx, err, "Invalid stream header");
+    }
+
+    fields = RedisModule_PoolAlloc(ctx, stream.nr_fields * sizeof(struct SelvaModifyStream_Field));
+    SelvaModifyStream_GetFields(&stream, fields);
+
+    nr_recs = parse_batch(ctx, &stream, &recs);
+    if (nr_recs < 0) {
+        return replyWithSelvaErrorf(ctx, (int)nr_recs, "Invalid stream");
+    }
+
+    prefetch_batch_nodes(ctx, hierarchy, recs, (size_t)nr_recs);
+
+    RedisModule_ReplyWithArray(ctx, nr_recs);
+    for (ssize_t i = 0; i < nr_recs; i++) {
+        struct modify_batch_rec *rec = &recs[i];
+        struct modify_arg *args = stream2args(ctx, fields, &rec->rec);
+
+        if (!modify_node(ctx, hierarchy,
+                         rec->rec.node_id, Selva_NodeIdLen(rec->rec.node_id),
+                         rec->rec.flags,
+                         args, rec->rec.nr_ops,
+                         &rec->replset, replicate ? &rec->rs : NULL)) {
+            rec->replicate = replicate && (bitmap_popcount(rec->replset) > 0 || rec->rs.created || rec->rs.updated);
+        }
+    }
+
+    if (replicate) {
+        replicateModifyBatch(ctx, argv, &stream, recs, (size_t)nr_recs);
+    }
+
+    SelvaSubscriptions_SendDeferredEvents(hierarchy);
+
+    return REDISMODULE_OK;
+}
+
 static int Modify_OnLoad(RedisModuleCtx *ctx) {
     /*
      * Register commands.
@@ -1914,6 +2296,10 @@ static int Modify_OnLoad(RedisModuleCtx *ctx) {
         return REDISMODULE_ERR;
     }
 
+    if (RedisModule_CreateCommand(ctx, "selva.modify.batch", SelvaCommand_ModifyBatch, "write deny-oom no-monitor no-slowlog", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
     return REDISMODULE_OK;
 }
 SELVA_ONLOAD(Modify_OnLoad);
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "selva.h"
+#include "modify_stream.h"
+
+/* TODO Support __ORDER_BIG_ENDIAN__ */
+_Static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Only little endian host is supported");
+
+static int read_u16(const char *buf, size_t len, size_t *off, uint16_t *v) {
+    if (len - *off < sizeof(*v)) {
+        return SELVA_EINVAL;
+    }
+
+    memcpy(v, buf + *off, sizeof(*v));
+    *off += sizeof(*v);
+
+    return 0;
+}
+
+static int read_u32(const char *buf, size_t len, size_t *off, uint32_t *v) {
+    if (len - *off < sizeof(*v)) {
+        return SELVA_EINVAL;
+    }
+
+    memcpy(v, buf + *off, sizeof(*v));
+    *off += sizeof(*v);
+
+    return 0;
+}
+
+/**
+ * Parse an op in place.
+ * @param nr_fields is the size of the field table used for validating field ids.
+ */
+static int parse_op(const char *buf, size_t len, size_t *off, size_t nr_fields, struct SelvaModifyStream_Op *op) {
+    const size_t start = *off;
+    uint16_t field;
+    uint32_t value_len;
+
+    if (*off >= len) {
+        return SELVA_EINVAL;
+    }
+    op->type_code = buf[(*off)++];
+
+    if (read_u16(buf, len, off, &field)) {
+        return SELVA_EINVAL;
+    }
+
+    if (field & SELVA_MODIFY_STREAM_FIELD_ID) {
+        const size_t field_id = field & SELVA_MODIFY_STREAM_FIELD_MASK;
+
+        if (field_id >= nr_fields) {
+            return SELVA_EINVAL;
+        }
+
+        op->field_id = (int)field_id;
+        op->field_str = NULL;
+        op->field_len = 0;
+    } else {
+        if (field == 0 || field > len - *off) {
+            return SELVA_EINVAL;
+        }
+
+        op->field_id = -1;
+        op->field_str = buf + *off;
+        op->field_len = field;
+        *off += field;
+    }
+
+    if (read_u32(buf, len, off, &value_len) || value_len > len - *off) {
+        return SELVA_EINVAL;
+    }
+
+    op->value_str = buf + *off;
+    op->value_len = value_len;
+    *off += value_len;
+
+    op->raw = buf + start;
+    op->raw_len = *off - start;
+
+    return 0;
+}
+
+int SelvaModifyStream_Init(struct SelvaModifyStream *s, const char *buf, size_t len) {
+    size_t off = 0;
+    uint16_t nr_fields = 0;
+
+    if (len < SELVA_MODIFY_STREAM_HEADER_SIZE) {
+        return SELVA_EINVAL;
+    }
+
+    if ((uint8_t)buf[0] != SELVA_MODIFY_STREAM_VERSION) {
+        return SELVA_ENOTSUP;
+    }
+    off += 2 * sizeof(uint8_t); /* Version and reserved. */
+
+    (void)read_u16(buf, len, &off, &nr_fields);
+    if (nr_fields > SELVA_MODIFY_STREAM_FIELD_MASK + 1) {
+        return SELVA_EINVAL;
+    }
+
+    s->buf = buf;
+    s->len = len;
+    s->version = (uint8_t)buf[0];
+    s->nr_fields = nr_fields;
+    s->fields_off = off;
+
+    for (size_t i = 0; i < nr_fields; i++) {
+        uint16_t name_len;
+
+        if (read_u16(buf, len, &off, &name_len) || name_len == 0 || name_len > len - off) {
+            return SELVA_EINVAL;
+        }
+        off += name_len;
+    }
+
+    s->off = off;
+
+    return 0;
+}
+
+void SelvaModifyStream_GetFields(const struct SelvaModifyStream *s, struct SelvaModifyStream_Field *fields) {
+    size_t off = s->fields_off;
+
+    for (size_t i = 0; i < s->nr_fields; i++) {
+        uint16_t name_len = 0;
+
+        (void)read_u16(s->buf, s->len, &off, &name_len);
+        fields[i].name_str = s->buf + off;
+        fields[i].name_len = name_len;
+        off += name_len;
+    }
+}
+
+int SelvaModifyStream_NextRecord(struct SelvaModifyStream *s, struct SelvaModifyStream_Record *rec) {
+    size_t off = s->off;
+    uint32_t nr_ops = 0;
+    size_t ops_off;
+
+    if (off == s->len) {
+        return SELVA_ENOENT;
+    }
+
+    if (s->len - off < SELVA_MODIFY_STREAM_RECORD_HEADER_SIZE) {
+        return SELVA_EINVAL;
+    }
+
+    memcpy(rec->node_id, s->buf + off, SELVA_NODE_ID_SIZE);
+    off += SELVA_NODE_ID_SIZE;
+    rec->flags = (uint8_t)s->buf[off++];
+    (void)read_u32(s->buf, s->len, &off, &nr_ops);
+
+    ops_off = off;
+    for (uint32_t i = 0; i < nr_ops; i++) {
+        struct SelvaModifyStream_Op op;
+        int err;
+
+        err = parse_op(s->buf, s->len, &off, s->nr_fields, &op);
+        if (err) {
+            return err;
+        }
+    }
+
+    rec->nr_ops = nr_ops;
+    rec->ops = s->buf + ops_off;
+    rec->ops_len = off - ops_off;
+    s->off = off;
+
+    return 0;
+}
+
+int SelvaModifyStream_NextOp(const struct SelvaModifyStream_Record *rec, size_t *off, struct SelvaModifyStream_Op *op) {
+    if (*off >= rec->ops_len) {
+        return SELVA_ENOENT;
+    }
+
+    /*
+     * The ops were already validated by SelvaModifyStream_NextRecord() and
+     * the field ids don't need to be checked again.
+     */
+    return parse_op(rec->ops, rec->ops_len, off, SELVA_MODIFY_STREAM_FIELD_MASK + 1, op);
+}
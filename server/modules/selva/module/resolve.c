@@ -12,63 +12,69 @@
 #include "subscriptions.h"
 #include "resolve.h"
 
+/**
+ * Check if a node exists without restoring it if it's detached.
+ */
+static int node_exists(SelvaHierarchy *hierarchy, const Selva_NodeId node_id) {
+    char exists;
+
+    return SelvaHierarchy_NodesExist(hierarchy, (const Selva_NodeId *)node_id, 1, &exists);
+}
+
 int SelvaResolve_NodeId(
-        RedisModuleCtx *ctx,
+        RedisModuleCtx *ctx __unused,
         SelvaHierarchy *hierarchy,
         RedisModuleString **ids,
         size_t nr_ids,
         Selva_NodeId node_id) {
-    RedisModuleKey *aliases_key;
-    int res = SELVA_ENOENT;
-
     if (nr_ids == 0) {
         memcpy(node_id, ROOT_NODE_ID, SELVA_NODE_ID_SIZE);
 
         return 0;
     }
 
-    aliases_key = open_aliases_key(ctx);
-    if (!aliases_key) {
-        return SELVA_EGENERAL;
-    }
-
-    for (size_t i = 0; i < nr_ids; i++) {
-        const RedisModuleString *id = ids[i];
-        TO_STR(id);
+    /*
+     * The nodeIds are looked up in batches but the result is the first
+     * existing node or alias in the order given.
+     */
+    for (size_t batch = 0; batch < nr_ids; batch += HIERARCHY_FIND_BATCH) {
+        const size_t batch_len = min(nr_ids - batch, (size_t)HIERARCHY_FIND_BATCH);
+        Selva_NodeId batch_ids[HIERARCHY_FIND_BATCH];
+        char exists[HIERARCHY_FIND_BATCH];
+
+        for (size_t j = 0; j < batch_len; j++) {
+            const RedisModuleString *id = ids[batch + j];
+            TO_STR(id);
+
+            if (id_len <= SELVA_NODE_ID_SIZE) {
+                Selva_NodeIdCpy(batch_ids[j], id_str);
+            } else {
+                /* Can only be an alias. */
+                memset(batch_ids[j], 0, SELVA_NODE_ID_SIZE);
+            }
+        }
 
-        /* First check if it's a nodeId. */
-        if (id_len <= SELVA_NODE_ID_SIZE) {
-            Selva_NodeIdCpy(node_id, id_str);
+        (void)SelvaHierarchy_NodesExist(hierarchy, (const Selva_NodeId *)batch_ids, batch_len, exists);
 
-            /* We assume that root always exists. */
-            if (!memcmp(node_id, ROOT_NODE_ID, SELVA_NODE_ID_SIZE)) {
-                res = SELVA_RESOLVE_NODE_ID;
-                break;
-            }
+        for (size_t j = 0; j < batch_len; j++) {
+            const RedisModuleString *id = ids[batch + j];
+            TO_STR(id);
 
-            if (SelvaHierarchy_NodeExists(hierarchy, node_id)) {
-                res = SELVA_RESOLVE_NODE_ID;
-                break;
+            /* First check if it's a nodeId. */
+            if (exists[j]) {
+                memcpy(node_id, batch_ids[j], SELVA_NODE_ID_SIZE);
+                return SELVA_RESOLVE_NODE_ID | (int)(batch + j);
             }
-        }
 
-        /* Then check if there is an alias with this string. */
-        RedisModuleString *orig = NULL;
-        if (!RedisModule_HashGet(aliases_key, REDISMODULE_HASH_NONE, id, &orig, NULL)) {
-            if (orig) {
-                TO_STR(orig);
-
-                Selva_NodeIdCpy(node_id, orig_str);
-                if (SelvaHierarchy_NodeExists(hierarchy, node_id)) {
-                    res = SELVA_RESOLVE_ALIAS;
-                    break;
-                }
+            /* Then check if there is an alias with this string. */
+            if (!get_alias(hierarchy, id_str, id_len, node_id) &&
+                node_exists(hierarchy, node_id)) {
+                return SELVA_RESOLVE_ALIAS | (int)(batch + j);
             }
         }
     }
 
-    RedisModule_CloseKey(aliases_key);
-    return res;
+    return SELVA_ENOENT;
 }
 
 /*
@@ -130,11 +136,67 @@ int SelvaResolve_NodeIdCommand(RedisModuleCtx *ctx, RedisModuleString **argv, in
     return REDISMODULE_OK;
 }
 
+/*
+ * HIERARCHY_KEY IDS...
+ * Reply with an array containing the resolved nodeId or null for each id.
+ */
+int SelvaResolve_NodeIdsCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    const int ARGV_REDIS_KEY = 1;
+    const int ARGV_IDS = 2;
+
+    if (argc < ARGV_IDS + 1) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    SelvaHierarchy *hierarchy = SelvaModify_OpenHierarchy(ctx, argv[ARGV_REDIS_KEY], REDISMODULE_READ);
+    if (!hierarchy) {
+        return REDISMODULE_OK;
+    }
+
+    const size_t nr_ids = argc - ARGV_IDS;
+    Selva_NodeId *ids = RedisModule_PoolAlloc(ctx, nr_ids * SELVA_NODE_ID_SIZE);
+    char *exists = RedisModule_PoolAlloc(ctx, nr_ids);
+
+    for (size_t i = 0; i < nr_ids; i++) {
+        const RedisModuleString *id = argv[ARGV_IDS + i];
+        TO_STR(id);
+
+        if (id_len <= SELVA_NODE_ID_SIZE) {
+            Selva_NodeIdCpy(ids[i], id_str);
+        } else {
+            memset(ids[i], 0, SELVA_NODE_ID_SIZE);
+        }
+    }
+
+    (void)SelvaHierarchy_NodesExist(hierarchy, ids, nr_ids, exists);
+
+    RedisModule_ReplyWithArray(ctx, nr_ids);
+    for (size_t i = 0; i < nr_ids; i++) {
+        const RedisModuleString *id = argv[ARGV_IDS + i];
+        TO_STR(id);
+        Selva_NodeId node_id;
+
+        if (exists[i]) {
+            RedisModule_ReplyWithStringBuffer(ctx, ids[i], Selva_NodeIdLen(ids[i]));
+        } else if (!get_alias(hierarchy, id_str, id_len, node_id) &&
+                   node_exists(hierarchy, node_id)) {
+            RedisModule_ReplyWithStringBuffer(ctx, node_id, Selva_NodeIdLen(node_id));
+        } else {
+            RedisModule_ReplyWithNull(ctx);
+        }
+    }
+
+    return REDISMODULE_OK;
+}
+
 static int SelvaResolve_OnLoad(RedisModuleCtx *ctx) {
     /*
      * Register commands.
      */
-    if (RedisModule_CreateCommand(ctx, "selva.resolve.nodeid", SelvaResolve_NodeIdCommand, "readonly", 1, 1, 1) == REDISMODULE_ERR) {
+    if (RedisModule_CreateCommand(ctx, "selva.resolve.nodeid", SelvaResolve_NodeIdCommand, "readonly", 1, 1, 1) == REDISMODULE_ERR ||
+        RedisModule_CreateCommand(ctx, "selva.resolve.nodeids", SelvaResolve_NodeIdsCommand, "readonly", 1, 1, 1) == REDISMODULE_ERR) {
         return REDISMODULE_ERR;
     }
 
@@ -17,6 +17,7 @@
 #include "redismodule.h"
 #include "cstrings.h"
 #include "hierarchy.h"
+#include "selva_memory.h"
 #include "selva_object.h"
 #include "selva_set.h"
 #include "selva_set_ops.h"
@@ -275,7 +276,7 @@ static struct rpn_operand *alloc_rpn_operand(size_t s_size) {
     } else {
         const size_t size = sizeof(struct rpn_operand) - RPN_SMALL_OPERAND_SIZE + s_size;
 
-        v = selva_calloc(1, size);
+        v = selva_arena_calloc(SELVA_ARENA_QUERY, 1, size);
     }
 
     return v;
@@ -325,7 +326,7 @@ static void free_rpn_operand(void *p) {
         small_operand_pool_next = v;
         small_operand_pool_next->next_free = prev;
     } else {
-        selva_free(v);
+        selva_arena_free(SELVA_ARENA_QUERY, v);
     }
 }
 
@@ -1355,6 +1356,40 @@ static enum rpn_error rpn_op_rec_filter(struct RedisModuleCtx *redis_ctx __unuse
     return push(ctx, res);
 }
 
+/**
+ * Copy a string operand into a node id.
+ */
+static int operand2node_id(Selva_NodeId node_id, const struct rpn_operand *o) {
+    const size_t len = OPERAND_GET_S_LEN(o);
+
+    if (o->flags.slvobj || o->flags.slvset || len == 0 || len > SELVA_NODE_ID_SIZE) {
+        return SELVA_EINVAL;
+    }
+
+    memset(node_id, '\0', SELVA_NODE_ID_SIZE);
+    memcpy(node_id, OPERAND_GET_S(o), len);
+
+    return 0;
+}
+
+static enum rpn_error rpn_op_is_descendant(struct RedisModuleCtx *redis_ctx __unused, struct rpn_ctx *ctx) {
+    OPERAND(ctx, a);
+    struct SelvaHierarchyNode *ancestor;
+    Selva_NodeId ancestor_id;
+
+    if (!ctx->hierarchy || !ctx->node) {
+        return RPN_ERR_ILLOPN;
+    }
+
+    if (operand2node_id(ancestor_id, a)) {
+        return RPN_ERR_TYPE;
+    }
+
+    ancestor = SelvaHierarchy_FindNode(ctx->hierarchy, ancestor_id);
+
+    return push_int_result(ctx, ancestor && SelvaHierarchy_IsDescendantOf(ctx->hierarchy, ctx->node, ancestor));
+}
+
 static enum rpn_error rpn_op_union(struct RedisModuleCtx *redis_ctx __unused, struct rpn_ctx *ctx) {
     OPERAND(ctx, a);
     OPERAND(ctx, b);
@@ -1444,7 +1479,7 @@ static rpn_fp funcs[] = {
     rpn_op_str_includes, /* m */
     rpn_op_get_clock_realtime, /* n */
     rpn_op_rec_filter, /* o */
-    rpn_op_abo,     /* p spare */
+    rpn_op_is_descendant, /* p */
     rpn_op_abo,     /* q spare */
     rpn_op_abo,     /* r spare */
     rpn_op_abo,     /* s spare */
@@ -2067,6 +2102,78 @@ end:
     return RPN_ERR_OK;
 }
 
+/**
+ * Test if the token is a call to the function fp.
+ */
+static int is_call(const char *s, rpn_fp fp) {
+    rpn_fp tok_fp;
+
+    if (s[0] != RPN_CODE_CALL) {
+        return 0;
+    }
+
+    memcpy(&tok_fp, s + RPN_CODE_SIZE, sizeof(void *));
+
+    return tok_fp == fp;
+}
+
+/**
+ * Get the operand pushed by a literal or a string register token.
+ */
+static const struct rpn_operand *get_token_operand(struct rpn_ctx *ctx, const struct rpn_expression *expr, const char *s) {
+    uint32_t i;
+
+    memcpy(&i, s + RPN_CODE_SIZE, sizeof(uint32_t));
+
+    if (s[0] == RPN_CODE_GET_LIT) {
+        return expr->literal_reg[i];
+    } else if (s[0] == RPN_CODE_GET_REG_STRING) {
+        /* reg[0] is the current node and it's changing. */
+        return (i > 0 && i < (typeof(i))ctx->nr_reg) ? ctx->reg[i] : NULL;
+    }
+
+    return NULL;
+}
+
+int rpn_get_descendant_constraint(struct rpn_ctx *ctx, const struct rpn_expression *expr, Selva_NodeId node_id) {
+    const rpn_token *it = expr->expression;
+    size_t n = 0;
+    const struct rpn_operand *operand;
+
+    while (**it) {
+        const char *s = *it++;
+
+        /*
+         * Jumps and breaking operators may skip the constraint.
+         */
+        if (s[0] == RPN_CODE_JMP_FWD ||
+            is_call(s, rpn_op_necess) ||
+            is_call(s, rpn_op_possib) ||
+            is_call(s, rpn_op_ret)) {
+            return 0;
+        }
+        n++;
+    }
+
+    if (n == 2) {
+        /* X p */
+        it = expr->expression;
+    } else if (n >= 4 && is_call(expr->expression[n - 1], rpn_op_and)) {
+        /* ... X p M */
+        it = expr->expression + n - 3;
+    } else {
+        return 0;
+    }
+
+    if (!is_call(it[1], rpn_op_is_descendant)) {
+        return 0;
+    }
+
+    operand = get_token_operand(ctx, expr, it[0]);
+
+    return operand && !operand2node_id(node_id, operand);
+}
+
 enum rpn_error rpn_bool(struct RedisModuleCtx *redis_ctx, struct rpn_ctx *ctx, const struct rpn_expression *expr, int *out) {
     struct rpn_operand *res;
     enum rpn_error err;
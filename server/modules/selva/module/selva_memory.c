@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "redismodule.h"
+#include "jemalloc.h"
+#include "selva.h"
+#include "modinfo.h"
+#include "selva_onload.h"
+#include "selva_memory.h"
+
+static const char * const arena_names[SELVA_ARENA_NR] = {
+    [SELVA_ARENA_DEFAULT] = "default",
+    [SELVA_ARENA_HIERARCHY] = "hierarchy",
+    [SELVA_ARENA_OBJECT] = "object",
+    [SELVA_ARENA_SUBSCRIPTIONS] = "subscriptions",
+    [SELVA_ARENA_FIND_INDEX] = "find_index",
+    [SELVA_ARENA_QUERY] = "query",
+};
+
+/**
+ * jemalloc arena index of each arena.
+ * SELVA_ARENA_DEFAULT isn't a real arena and it's not used.
+ */
+static unsigned arena_index[SELVA_ARENA_NR];
+
+/**
+ * mallocx() flags of the main thread.
+ * The main thread has an explicit tcache for each arena.
+ */
+static int arena_flags[SELVA_ARENA_NR];
+
+/**
+ * mallocx() flags of the other threads.
+ * An explicit tcache can't be used by more than one thread, so the other
+ * threads bypass the tcache when allocating from a subsystem arena.
+ */
+static int arena_flags_notcache[SELVA_ARENA_NR];
+
+/**
+ * Set to arena_flags in the main thread.
+ */
+static __thread const int *thread_arena_flags;
+
+static inline int get_flags(enum selva_arena arena) {
+    const int *flags = thread_arena_flags;
+
+    return (flags ? flags : arena_flags_notcache)[arena];
+}
+
+void *selva_arena_malloc(enum selva_arena arena, size_t size) {
+    return selva_mallocx(size ?: 1, get_flags(arena));
+}
+
+void *selva_arena_calloc(enum selva_arena arena, size_t n, size_t size) {
+    size_t total;
+
+    if (__builtin_mul_overflow(n, size, &total)) {
+        /* Let jemalloc handle it like any other failed allocation. */
+        total = SIZE_MAX;
+    }
+
+    return selva_mallocx(total ?: 1, get_flags(arena) | MALLOCX_ZERO);
+}
+
+void *selva_arena_realloc(enum selva_arena arena, void *p, size_t size) {
+    if (!p) {
+        return selva_arena_malloc(arena, size);
+    }
+
+    return selva_rallocx(p, size ?: 1, get_flags(arena));
+}
+
+void selva_arena_free(enum selva_arena arena, void *p) {
+    if (p) {
+        selva_dallocx(p, get_flags(arena));
+    }
+}
+
+/**
+ * Memory statistics of an arena.
+ * All values are in bytes.
+ */
+struct arena_stats {
+    size_t allocated;
+    size_t active;
+    size_t dirty;
+    size_t mapped;
+    size_t resident;
+};
+
+static size_t read_size(const char *name) {
+    size_t v = 0;
+    size_t sz = sizeof(v);
+
+    (void)selva_mallctl(name, &v, &sz, NULL, 0);
+
+    return v;
+}
+
+static size_t read_arena_size(unsigned arena, const char *name) {
+    char buf[80];
+
+    snprintf(buf, sizeof(buf), "stats.arenas.%u.%s", arena, name);
+
+    return read_size(buf);
+}
+
+/**
+ * Refresh the statistics cached by jemalloc.
+ */
+static void refresh_stats(void) {
+    uint64_t epoch = 1;
+    size_t sz = sizeof(epoch);
+
+    (void)selva_mallctl("epoch", &epoch, &sz, &epoch, sz);
+}
+
+/**
+ * Get the statistics of all arenas.
+ * The default arena is whatever is not allocated from the subsystem arenas,
+ * including the memory of all the other modules in the same process.
+ */
+static void get_stats(struct arena_stats stats[SELVA_ARENA_NR]) {
+    const size_t page = read_size("arenas.page");
+    struct arena_stats *def = &stats[SELVA_ARENA_DEFAULT];
+
+    refresh_stats();
+
+    def->allocated = read_size("stats.allocated");
+    def->active = read_size("stats.active");
+    def->mapped = read_size("stats.mapped");
+    def->resident = read_size("stats.resident");
+    def->dirty = read_arena_size(MALLCTL_ARENAS_ALL, "pdirty") * page;
+
+    for (size_t i = 1; i < SELVA_ARENA_NR; i++) {
+        const unsigned arena = arena_index[i];
+        struct arena_stats *s = &stats[i];
+
+        if (!arena_flags[i]) {
+            memset(s, 0, sizeof(*s));
+            continue;
+        }
+
+        s->allocated = read_arena_size(arena, "small.allocated") + read_arena_size(arena, "large.allocated");
+        s->active = read_arena_size(arena, "pactive") * page;
+        s->dirty = read_arena_size(arena, "pdirty") * page;
+        s->mapped = read_arena_size(arena, "mapped");
+        s->resident = read_arena_size(arena, "resident");
+
+#define SUB_DEF(_field) def->_field -= min(def->_field, s->_field)
+        SUB_DEF(allocated);
+        SUB_DEF(active);
+        SUB_DEF(dirty);
+        SUB_DEF(mapped);
+        SUB_DEF(resident);
+#undef SUB_DEF
+    }
+}
+
+static bool has_stats(void) {
+    bool v = false;
+    size_t sz = sizeof(v);
+
+    (void)selva_mallctl("config.stats", &v, &sz, NULL, 0);
+
+    return v;
+}
+
+/**
+ * Reply with the memory usage of each arena.
+ * The fragmentation is the difference between the active and allocated bytes.
+ * SELVA.memory.stats
+ */
+static int SelvaMemory_StatsCommand(RedisModuleCtx *ctx, RedisModuleString **argv __unused, int argc) {
+    struct arena_stats stats[SELVA_ARENA_NR];
+
+    if (argc != 1) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    if (!has_stats()) {
+        return replyWithSelvaErrorf(ctx, SELVA_ENOTSUP, "jemalloc statistics are not enabled");
+    }
+
+    get_stats(stats);
+
+    RedisModule_ReplyWithArray(ctx, 2 * SELVA_ARENA_NR);
+    for (size_t i = 0; i < SELVA_ARENA_NR; i++) {
+        const struct arena_stats *s = &stats[i];
+
+        RedisModule_ReplyWithSimpleString(ctx, arena_names[i]);
+        RedisModule_ReplyWithArray(ctx, 12);
+        RedisModule_ReplyWithSimpleString(ctx, "allocated");
+        RedisModule_ReplyWithLongLong(ctx, (long long)s->allocated);
+        RedisModule_ReplyWithSimpleString(ctx, "active");
+        RedisModule_ReplyWithLongLong(ctx, (long long)s->active);
+        RedisModule_ReplyWithSimpleString(ctx, "fragmentation");
+        RedisModule_ReplyWithLongLong(ctx, (long long)(s->active - min(s->active, s->allocated)));
+        RedisModule_ReplyWithSimpleString(ctx, "dirty");
+        RedisModule_ReplyWithLongLong(ctx, (long long)s->dirty);
+        RedisModule_ReplyWithSimpleString(ctx, "mapped");
+        RedisModule_ReplyWithLongLong(ctx, (long long)s->mapped);
+        RedisModule_ReplyWithSimpleString(ctx, "resident");
+        RedisModule_ReplyWithLongLong(ctx, (long long)s->resident);
+    }
+
+    return REDISMODULE_OK;
+}
+
+static void mod_info(RedisModuleInfoCtx *ctx) {
+    struct arena_stats stats[SELVA_ARENA_NR];
+
+    if (!has_stats()) {
+        return;
+    }
+
+    get_stats(stats);
+
+    for (size_t i = 0; i < SELVA_ARENA_NR; i++) {
+        char name[80];
+
+        snprintf(name, sizeof(name), "%s_allocated", arena_names[i]);
+        (void)RedisModule_InfoAddFieldULongLong(ctx, name, stats[i].allocated);
+        snprintf(name, sizeof(name), "%s_active", arena_names[i]);
+        (void)RedisModule_InfoAddFieldULongLong(ctx, name, stats[i].active);
+    }
+}
+SELVA_MODINFO("memory", mod_info);
+
+static int create_arena(enum selva_arena arena) {
+    unsigned ind, tcache;
+    size_t sz = sizeof(unsigned);
+    int err;
+
+    err = selva_mallctl("arenas.create", &ind, &sz, NULL, 0);
+    if (err) {
+        return err;
+    }
+
+    sz = sizeof(unsigned);
+    err = selva_mallctl("tcache.create", &tcache, &sz, NULL, 0);
+    if (err) {
+        return err;
+    }
+
+    arena_index[arena] = ind;
+    arena_flags[arena] = MALLOCX_ARENA(ind) | MALLOCX_TCACHE(tcache);
+    arena_flags_notcache[arena] = MALLOCX_ARENA(ind) | MALLOCX_TCACHE_NONE;
+
+    return 0;
+}
+
+static int SelvaMemory_OnLoad(RedisModuleCtx *ctx) {
+    for (size_t i = 1; i < SELVA_ARENA_NR; i++) {
+        int err;
+
+        err = create_arena(i);
+        if (err) {
+            SELVA_LOG(SELVA_LOGL_ERR, "Failed to create the %s memory arena: %s\n",
+                      arena_names[i], strerror(err));
+            return REDISMODULE_ERR;
+        }
+    }
+    thread_arena_flags = arena_flags;
+
+    /*
+     * Register commands.
+     */
+    if (RedisModule_CreateCommand(ctx, "selva.memory.stats", SelvaMemory_StatsCommand, "readonly", 0, 0, 0) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    return REDISMODULE_OK;
+}
+SELVA_ONLOAD(SelvaMemory_OnLoad);
@@ -15,6 +15,7 @@
 #include "cstrings.h"
 #include "selva.h"
 #include "rms.h"
+#include "selva_memory.h"
 #include "selva_set.h"
 #include "selva_trace.h"
 #include "svector.h"
@@ -138,7 +139,7 @@ static void init_obj(struct SelvaObject *obj) {
 struct SelvaObject *SelvaObject_New(void) {
     struct SelvaObject *obj;
 
-    obj = selva_malloc(sizeof(*obj));
+    obj = selva_arena_malloc(SELVA_ARENA_OBJECT, sizeof(*obj));
     init_obj(obj);
     obj->flags = SELVA_OBJECT_FLAG_DYNAMIC;
 
@@ -187,7 +188,7 @@ retry:
 static void init_object_array(struct SelvaObjectKey *key, enum SelvaObjectType subtype, size_t size) {
     key->type = SELVA_OBJECT_ARRAY;
     key->subtype = subtype;
-    key->array = selva_calloc(1, sizeof(SVector));
+    key->array = selva_arena_calloc(SELVA_ARENA_OBJECT, 1, sizeof(SVector));
     SVector_Init(key->array, size, NULL);
 }
 
@@ -235,7 +236,7 @@ static void clear_object_array(enum SelvaObjectType subtype, SVector *array) {
     }
 
     SVector_Destroy(array);
-    selva_free(array);
+    selva_arena_free(SELVA_ARENA_OBJECT, array);
 }
 
 static int clear_key_value(struct SelvaObjectKey *key) {
@@ -303,7 +304,7 @@ static struct SelvaObjectKey *alloc_key(struct SelvaObject *obj, size_t name_len
         obj->emb_res &= ~(1 << i); /* Reserve it. */
         key = get_emb_key(obj, i);
     } else {
-        key = selva_malloc(key_size);
+        key = selva_arena_malloc(SELVA_ARENA_OBJECT, key_size);
     }
 
     if (key) {
@@ -325,8 +326,8 @@ static void remove_key(struct SelvaObject *obj, struct SelvaObjectKey *key) {
         /* The key was allocated from the embedded keys. */
         obj->emb_res |= 1 << i; /* Mark it free. */
     } else {
-        /* The key was allocated with RedisModule_Alloc(). */
-        selva_free(key);
+        /* The key was allocated from the object arena. */
+        selva_arena_free(SELVA_ARENA_OBJECT, key);
     }
 }
 
@@ -365,7 +366,7 @@ void SelvaObject_Destroy(struct SelvaObject *obj) {
 #if MEM_DEBUG
         memset(obj, 0, sizeof(*obj));
 #endif
-        selva_free(obj);
+        selva_arena_free(SELVA_ARENA_OBJECT, obj);
     }
 }
 
@@ -406,6 +407,84 @@ size_t SelvaObject_MemUsage(const void *value) {
     return size;
 }
 
+static size_t rms_mem_usage(const RedisModuleString *s) {
+    size_t len;
+
+    (void)RedisModule_StringPtrLen(s, &len);
+
+    return len + 1;
+}
+
+static void array_mem_usage(enum SelvaObjectType subtype, const SVector *array, struct SelvaObjectMemUsage *usage) {
+    struct SVectorIterator it;
+    void *p;
+
+    usage->arrays += sizeof(*array) + SVector_MemUsage(array);
+
+    if (subtype != SELVA_OBJECT_STRING && subtype != SELVA_OBJECT_OBJECT) {
+        return;
+    }
+
+    SVector_ForeachBegin(&it, array);
+    while ((p = SVector_Foreach(&it))) {
+        if (subtype == SELVA_OBJECT_STRING) {
+            usage->strings += rms_mem_usage(p);
+        } else {
+            SelvaObject_MemUsageDetail(p, usage);
+        }
+    }
+}
+
+static void set_mem_usage(const struct SelvaSet *set, struct SelvaObjectMemUsage *usage) {
+    usage->sets += set->size * sizeof(struct SelvaSetElement);
+
+    if (set->type == SELVA_SET_TYPE_RMSTRING) {
+        struct SelvaSetElement *el;
+
+        SELVA_SET_RMS_FOREACH(el, (struct SelvaSet *)set) {
+            usage->strings += rms_mem_usage(el->value_rms);
+        }
+    }
+}
+
+void SelvaObject_MemUsageDetail(const struct SelvaObject *obj, struct SelvaObjectMemUsage *usage) {
+    struct SelvaObjectKey *key;
+
+    usage->objects += sizeof(*obj);
+
+    RB_FOREACH(key, SelvaObjectKeys, &((struct SelvaObject *)obj)->keys_head) {
+        const intptr_t i = ((intptr_t)key - (intptr_t)obj->emb_keys) / EMBEDDED_KEY_SIZE;
+
+        if (i < 0 || i >= NR_EMBEDDED_KEYS) {
+            usage->objects += sizeof(*key) + key->name_len + 1;
+        }
+
+        switch (key->type) {
+        case SELVA_OBJECT_STRING:
+            if (key->value) {
+                usage->strings += rms_mem_usage(key->value);
+            }
+            break;
+        case SELVA_OBJECT_OBJECT:
+            if (key->value) {
+                SelvaObject_MemUsageDetail(key->value, usage);
+            }
+            break;
+        case SELVA_OBJECT_SET:
+            set_mem_usage(&key->selva_set, usage);
+            break;
+        case SELVA_OBJECT_ARRAY:
+            if (key->array) {
+                array_mem_usage(key->subtype, key->array, usage);
+            }
+            break;
+        default:
+            /* The value is embedded in the key or it's opaque. */
+            break;
+        }
+    }
+}
+
 static int insert_new_key(struct SelvaObject *obj, const char *name_str, size_t name_len, struct SelvaObjectKey **key_out) {
     struct SelvaObjectKey *key;
 
@@ -2098,39 +2177,48 @@ static void replyWithLongLong(RedisModuleCtx *ctx, long long value, unsigned fla
     }
 }
 
+/*
+ * The reply functions below know the exact number of elements before anything
+ * is sent, so there is no need to use postponed array lengths. A postponed
+ * length forces Redis to allocate a new reply block for the header and later
+ * patch it in, which is expensive when sending a large number of small nested
+ * arrays.
+ */
+
 static void replyWithSelvaSet(RedisModuleCtx *ctx, struct SelvaSet *set, unsigned flags) {
     struct SelvaSetElement *el;
-    size_t n = 0;
-
-    RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
 
     if (set->type == SELVA_SET_TYPE_RMSTRING) {
+        RedisModule_ReplyWithArray(ctx, set->size);
         SELVA_SET_RMS_FOREACH(el, set) {
             RedisModule_ReplyWithString(ctx, el->value_rms);
-            n++;
         }
     } else if (set->type == SELVA_SET_TYPE_DOUBLE) {
+        RedisModule_ReplyWithArray(ctx, set->size);
         SELVA_SET_DOUBLE_FOREACH(el, set) {
             replyWithDouble(ctx, el->value_d, flags);
-            n++;
         }
     } else if (set->type == SELVA_SET_TYPE_LONGLONG) {
+        RedisModule_ReplyWithArray(ctx, set->size);
         SELVA_SET_LONGLONG_FOREACH(el, set) {
             replyWithLongLong(ctx, el->value_ll, flags);
-            n++;
         }
+    } else {
+        RedisModule_ReplyWithArray(ctx, 0);
     }
-
-    RedisModule_ReplySetArrayLength(ctx, n);
 }
 
 static void replyWithArray(RedisModuleCtx *ctx, RedisModuleString *lang, enum SelvaObjectType subtype, const SVector *array, unsigned flags) {
-    RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
     struct SVectorIterator it;
-    size_t n = 0;
+    /*
+     * The loops below always send at least one element, even if the array is
+     * empty.
+     */
+    const size_t n = max(SVector_Size(array), (size_t)1);
 
     switch (subtype) {
     case SELVA_OBJECT_DOUBLE:
+        RedisModule_ReplyWithArray(ctx, n);
         SVector_ForeachBegin(&it, array);
 
         do {
@@ -2146,12 +2234,10 @@ static void replyWithArray(RedisModuleCtx *ctx, RedisModuleString *lang, enum Se
                 memcpy(&d, &pd, sizeof(double));
                 replyWithDouble(ctx, d, flags);
             }
-
-            n++;
         } while (!SVector_Done(&it));
-        RedisModule_ReplySetArrayLength(ctx, n);
         break;
     case SELVA_OBJECT_LONGLONG:
+        RedisModule_ReplyWithArray(ctx, n);
         SVector_ForeachBegin(&it, array);
 
         do {
@@ -2160,13 +2246,12 @@ static void replyWithArray(RedisModuleCtx *ctx, RedisModuleString *lang, enum Se
 
             p = SVector_Foreach(&it);
 
-            n++;
             ll = (long long)p;
             replyWithLongLong(ctx, ll, flags);
         } while (!SVector_Done(&it));
-        RedisModule_ReplySetArrayLength(ctx, n);
         break;
     case SELVA_OBJECT_STRING:
+        RedisModule_ReplyWithArray(ctx, n);
         SVector_ForeachBegin(&it, array);
 
         do {
@@ -2174,7 +2259,6 @@ static void replyWithArray(RedisModuleCtx *ctx, RedisModuleString *lang, enum Se
 
             str = SVector_Foreach(&it);
 
-            n++;
             if (!str) {
                 RedisModule_ReplyWithNull(ctx);
                 continue;
@@ -2183,9 +2267,9 @@ static void replyWithArray(RedisModuleCtx *ctx, RedisModuleString *lang, enum Se
             RedisModule_ReplyWithString(ctx, str);
         } while (!SVector_Done(&it));
 
-        RedisModule_ReplySetArrayLength(ctx, n);
         break;
     case SELVA_OBJECT_OBJECT:
+        RedisModule_ReplyWithArray(ctx, n);
         SVector_ForeachBegin(&it, array);
 
         do {
@@ -2193,7 +2277,6 @@ static void replyWithArray(RedisModuleCtx *ctx, RedisModuleString *lang, enum Se
 
             o = SVector_Foreach(&it);
 
-            n++;
             if (!o) {
                 RedisModule_ReplyWithNull(ctx);
                 continue;
@@ -2202,11 +2285,10 @@ static void replyWithArray(RedisModuleCtx *ctx, RedisModuleString *lang, enum Se
             replyWithObject(ctx, lang, o, flags, NULL);
         } while (!SVector_Done(&it));
 
-        RedisModule_ReplySetArrayLength(ctx, n);
         break;
     default:
         SELVA_LOG(SELVA_LOGL_ERR, "Unknown array type: %d", subtype);
-        RedisModule_ReplySetArrayLength(ctx, 0);
+        RedisModule_ReplyWithArray(ctx, 0);
         break;
     }
 
@@ -2286,9 +2368,17 @@ static void replyWithKeyValue(RedisModuleCtx *ctx, RedisModuleString *lang, stru
 
 static void replyWithObject(RedisModuleCtx *ctx, RedisModuleString *lang, struct SelvaObject *obj, unsigned flags, const char *excluded) {
     struct SelvaObjectKey *key;
-    size_t n = 0;
+    size_t n = obj->obj_size;
+
+    if (excluded) {
+        RB_FOREACH(key, SelvaObjectKeys, &obj->keys_head) {
+            if (stringlist_searchn(excluded, key->name, key->name_len)) {
+                n--;
+            }
+        }
+    }
 
-    RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+    RedisModule_ReplyWithArray(ctx, 2 * n);
 
     RB_FOREACH(key, SelvaObjectKeys, &obj->keys_head) {
         const char *name_str = key->name;
@@ -2300,11 +2390,7 @@ static void replyWithObject(RedisModuleCtx *ctx, RedisModuleString *lang, struct
 
         RedisModule_ReplyWithStringBuffer(ctx, key->name, key->name_len);
         replyWithKeyValue(ctx, lang, key, flags);
-
-        n += 2;
     }
-
-    RedisModule_ReplySetArrayLength(ctx, n);
 }
 
 int SelvaObject_ReplyWithObjectStr(
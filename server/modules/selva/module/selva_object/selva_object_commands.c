@@ -8,6 +8,8 @@
 #include "typestr.h"
 #include "selva.h"
 #include "hierarchy.h"
+#include "find_cache.h"
+#include "inherit.h"
 #include "selva_onload.h"
 #include "selva_set.h"
 #include "svector.h"
@@ -41,6 +43,12 @@ static struct SelvaObject *SelvaObject_Open(RedisModuleCtx *ctx, RedisModuleStri
         return NULL;
     }
 
+    if (mode & REDISMODULE_WRITE) {
+        /* The caller may change any field. */
+        Inherit_InvalidateCache(hierarchy);
+        SelvaFindCache_InvalidateAll(ctx, hierarchy);
+    }
+
     return SelvaHierarchy_GetNodeObject(node);
 }
 
@@ -56,7 +64,7 @@ int SelvaObject_DelCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int ar
         return RedisModule_WrongArity(ctx);
     }
 
-    obj = SelvaObject_Open(ctx, argv[ARGV_KEY], REDISMODULE_READ);
+    obj = SelvaObject_Open(ctx, argv[ARGV_KEY], REDISMODULE_READ | REDISMODULE_WRITE);
     if (!obj) {
         return REDISMODULE_OK;
     }
@@ -2,6 +2,8 @@
  * Copyright (c) 2022 SAULX
  * SPDX-License-Identifier: MIT
  */
+#include <string.h>
+#include "selva.h"
 #include "hierarchy.h"
 #include "selva_object.h"
 #include "selva_set.h"
@@ -72,6 +74,35 @@ int set_has_cb(union SelvaObjectSetForeachValue value, enum SelvaSetType type, v
     return 0;
 }
 
+/**
+ * Test ancestors and descendants using the hierarchy reachability labels.
+ */
+static int field_has_reach(
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyNode *node,
+        int ancestors,
+        const char *value_str,
+        size_t value_len) {
+    struct SelvaHierarchyNode *other;
+    Selva_NodeId node_id;
+
+    if (value_len > SELVA_NODE_ID_SIZE) {
+        return 0;
+    }
+
+    memset(node_id, '\0', SELVA_NODE_ID_SIZE);
+    memcpy(node_id, value_str, value_len);
+
+    other = SelvaHierarchy_FindNode(hierarchy, node_id);
+    if (!other) {
+        return 0;
+    }
+
+    return ancestors
+        ? SelvaHierarchy_IsDescendantOf(hierarchy, node, other)
+        : SelvaHierarchy_IsDescendantOf(hierarchy, other, node);
+}
+
 int SelvaSet_field_has_string(
         struct RedisModuleCtx *ctx,
         struct SelvaHierarchy *hierarchy,
@@ -80,6 +111,21 @@ int SelvaSet_field_has_string(
         size_t field_len,
         const char *value_str,
         size_t value_len) {
+#define IS_FIELD(name) \
+    (field_len == (sizeof(name) - 1) && !memcmp(field_str, name, sizeof(name) - 1))
+
+    if (hierarchy && node) {
+        /*
+         * No need to traverse the hierarchy for reachability.
+         */
+        if (IS_FIELD(SELVA_ANCESTORS_FIELD)) {
+            return field_has_reach(hierarchy, node, 1, value_str, value_len);
+        } else if (IS_FIELD(SELVA_DESCENDANTS_FIELD)) {
+            return field_has_reach(hierarchy, node, 0, value_str, value_len);
+        }
+    }
+#undef IS_FIELD
+
     struct set_has_cb data = {
         .type = SELVA_SET_TYPE_RMSTRING,
         .found = 0,
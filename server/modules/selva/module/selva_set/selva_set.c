@@ -9,6 +9,7 @@
 #include "jemalloc.h"
 #include "selva.h"
 #include "alias.h"
+#include "selva_memory.h"
 #include "selva_set.h"
 
 int SelvaSet_CompareRms(struct SelvaSetElement *a, struct SelvaSetElement *b) {
@@ -59,7 +60,7 @@ int SelvaSet_AddRms(struct SelvaSet *set, struct RedisModuleString *s) {
         return SELVA_EEXIST;
     }
 
-    el = selva_calloc(1, sizeof(struct SelvaSetElement));
+    el = selva_arena_calloc(SELVA_ARENA_OBJECT, 1, sizeof(struct SelvaSetElement));
     el->value_rms = s;
 
     (void)RB_INSERT(SelvaSetRms, &set->head_rms, el);
@@ -83,7 +84,7 @@ int SelvaSet_AddDouble(struct SelvaSet *set, double d) {
         return SELVA_EEXIST;
     }
 
-    el = selva_calloc(1, sizeof(struct SelvaSetElement));
+    el = selva_arena_calloc(SELVA_ARENA_OBJECT, 1, sizeof(struct SelvaSetElement));
     el->value_d = d;
 
     (void)RB_INSERT(SelvaSetDouble, &set->head_d, el);
@@ -103,7 +104,7 @@ int SelvaSet_AddLongLong(struct SelvaSet *set, long long ll) {
         return SELVA_EEXIST;
     }
 
-    el = selva_calloc(1, sizeof(struct SelvaSetElement));
+    el = selva_arena_calloc(SELVA_ARENA_OBJECT, 1, sizeof(struct SelvaSetElement));
     el->value_ll = ll;
 
     (void)RB_INSERT(SelvaSetLongLong, &set->head_ll, el);
@@ -123,7 +124,7 @@ int SelvaSet_AddNodeId(struct SelvaSet *set, const Selva_NodeId node_id) {
         return SELVA_EEXIST;
     }
 
-    el = selva_calloc(1, sizeof(struct SelvaSetElement));
+    el = selva_arena_calloc(SELVA_ARENA_OBJECT, 1, sizeof(struct SelvaSetElement));
     memcpy(el->value_nodeId, node_id, SELVA_NODE_ID_SIZE);
 
     (void)RB_INSERT(SelvaSetNodeId, &set->head_nodeId, el);
@@ -137,7 +138,7 @@ void SelvaSet_DestroyElement(struct SelvaSetElement *el) {
         return;
     }
 
-    selva_free(el);
+    selva_arena_free(SELVA_ARENA_OBJECT, el);
 }
 
 static void SelvaSet_DestroyRms(struct SelvaSet *set) {
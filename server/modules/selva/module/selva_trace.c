@@ -2,6 +2,19 @@
  * Copyright (c) 2022 SAULX
  * SPDX-License-Identifier: MIT
  */
+#ifndef SELVA_TRACE
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "redismodule.h"
+#include "jemalloc.h"
+#include "queue.h"
+#include "selva.h"
+#include "modinfo.h"
+#include "selva_onload.h"
+#endif
 #include "selva_trace.h"
 
 /*
@@ -26,4 +39,335 @@ __constructor static void init_selva_trace(void) {
 void SelvaTrace_AutoEnd(void *p __unused) {
     __itt_task_end(selva_trace_domain);
 }
+#else
+/*
+ * Latency histograms.
+ *
+ * Each thread records its traces to its own buffer of histograms, so
+ * recording doesn't need any locking. The buffers are only merged when the
+ * histograms are read, and therefore the results can be slightly off while
+ * the other threads are recording. When a thread exits its histograms are
+ * added to a shared buffer of retired threads and its own buffer is freed.
+ *
+ * The histograms are log-linear: each power of two is divided into
+ * HIST_SUB buckets, bounding the relative error of the recorded values.
+ */
+
+#define HIST_SUB (1 << SELVA_TRACE_HIST_SUB_BITS)
+#define HIST_NR_BUCKETS ((SELVA_TRACE_HIST_MAX_BITS - SELVA_TRACE_HIST_SUB_BITS + 1) * HIST_SUB)
+
+struct trace_hist {
+    uint64_t count;
+    uint64_t sum; /*!< [ns] */
+    uint64_t max; /*!< [ns] */
+    uint32_t buckets[HIST_NR_BUCKETS];
+};
+
+struct trace_buf {
+    SLIST_ENTRY(trace_buf) next;
+    struct trace_hist hist[];
+};
+
+SET_DECLARE(selva_trace, struct SelvaTrace);
+
+int selva_trace_enabled = SELVA_TRACE_HIST_ENABLED;
+static size_t nr_traces;
+static pthread_mutex_t trace_bufs_lock = PTHREAD_MUTEX_INITIALIZER;
+static SLIST_HEAD(trace_bufs, trace_buf) trace_bufs = SLIST_HEAD_INITIALIZER(trace_bufs);
+static struct trace_buf *trace_retired; /*!< Histograms of the threads that have exited. */
+static __thread struct trace_buf *trace_tbuf;
+static pthread_key_t trace_tbuf_key; /*!< Frees trace_tbuf when the thread exits. */
+
+static void destroy_trace_buf(void *p);
+
+__constructor static void init_selva_trace(void) {
+    struct SelvaTrace **data_p;
+
+    SET_FOREACH(data_p, selva_trace) {
+        struct SelvaTrace *data = *data_p;
+
+        data->index = nr_traces++;
+    }
+
+    (void)pthread_key_create(&trace_tbuf_key, destroy_trace_buf);
+}
+
+static size_t hist_bucket(uint64_t t) {
+    int e, shift;
+
+    if (t < HIST_SUB) {
+        return (size_t)t;
+    }
+
+    e = 63 - __builtin_clzll(t);
+    if (e >= SELVA_TRACE_HIST_MAX_BITS) {
+        return HIST_NR_BUCKETS - 1;
+    }
+
+    shift = e - SELVA_TRACE_HIST_SUB_BITS;
+    return ((size_t)(shift + 1) << SELVA_TRACE_HIST_SUB_BITS) + ((t >> shift) & (HIST_SUB - 1));
+}
+
+/**
+ * Get the lowest value recorded in bucket i.
+ */
+static uint64_t hist_value(size_t i) {
+    int shift;
+
+    if (i < HIST_SUB) {
+        return (uint64_t)i;
+    }
+
+    shift = (int)(i >> SELVA_TRACE_HIST_SUB_BITS) - 1;
+    return (uint64_t)(HIST_SUB | (i & (HIST_SUB - 1))) << shift;
+}
+
+static void add_hist(struct trace_hist *out, const struct trace_hist *hist) {
+    out->count += hist->count;
+    out->sum += hist->sum;
+    if (hist->max > out->max) {
+        out->max = hist->max;
+    }
+    for (size_t i = 0; i < HIST_NR_BUCKETS; i++) {
+        out->buckets[i] += hist->buckets[i];
+    }
+}
+
+static struct trace_buf *alloc_trace_buf(void) {
+    return selva_calloc(1, sizeof(struct trace_buf) + nr_traces * sizeof(struct trace_hist));
+}
+
+static struct trace_buf *new_trace_buf(void) {
+    struct trace_buf *buf = alloc_trace_buf();
+
+    pthread_mutex_lock(&trace_bufs_lock);
+    SLIST_INSERT_HEAD(&trace_bufs, buf, next);
+    pthread_mutex_unlock(&trace_bufs_lock);
+
+    trace_tbuf = buf;
+    (void)pthread_setspecific(trace_tbuf_key, buf);
+    return buf;
+}
+
+/**
+ * Retire the trace buffer of an exiting thread.
+ */
+static void destroy_trace_buf(void *p) {
+    struct trace_buf *buf = (struct trace_buf *)p;
+
+    pthread_mutex_lock(&trace_bufs_lock);
+    if (!trace_retired) {
+        trace_retired = alloc_trace_buf();
+        SLIST_INSERT_HEAD(&trace_bufs, trace_retired, next);
+    }
+    for (size_t i = 0; i < nr_traces; i++) {
+        add_hist(&trace_retired->hist[i], &buf->hist[i]);
+    }
+    SLIST_REMOVE(&trace_bufs, buf, trace_buf, next);
+    pthread_mutex_unlock(&trace_bufs_lock);
+
+    selva_free(buf);
+}
+
+void SelvaTrace_Record(struct SelvaTrace *trace, int64_t t) {
+    struct trace_buf *buf = trace_tbuf;
+    struct trace_hist *hist;
+    const uint64_t u = t > 0 ? (uint64_t)t : 0;
+
+    if (!buf) {
+        buf = new_trace_buf();
+    }
+
+    hist = &buf->hist[trace->index];
+    hist->count++;
+    hist->sum += u;
+    if (u > hist->max) {
+        hist->max = u;
+    }
+    hist->buckets[hist_bucket(u)]++;
+}
+
+void SelvaTrace_AutoEnd(struct SelvaTraceAuto *p) {
+    SelvaTrace_End(p->trace, p->start);
+}
+
+/**
+ * Merge the histograms of a trace from all threads.
+ */
+static void merge_hist(struct trace_hist *out, size_t index) {
+    struct trace_buf *buf;
+
+    memset(out, 0, sizeof(*out));
+
+    pthread_mutex_lock(&trace_bufs_lock);
+    SLIST_FOREACH(buf, &trace_bufs, next) {
+        add_hist(out, &buf->hist[index]);
+    }
+    pthread_mutex_unlock(&trace_bufs_lock);
+}
+
+static void reset_hists(void) {
+    struct trace_buf *buf;
+
+    pthread_mutex_lock(&trace_bufs_lock);
+    SLIST_FOREACH(buf, &trace_bufs, next) {
+        memset(buf->hist, 0, nr_traces * sizeof(struct trace_hist));
+    }
+    pthread_mutex_unlock(&trace_bufs_lock);
+}
+
+/**
+ * Get the value at a percentile of a histogram.
+ * The result is the highest value of the bucket containing the percentile.
+ */
+static uint64_t hist_percentile(const struct trace_hist *hist, double pct) {
+    const uint64_t target = (uint64_t)((double)hist->count * pct / 100.0 + 0.5);
+    uint64_t n = 0;
+
+    for (size_t i = 0; i < HIST_NR_BUCKETS; i++) {
+        n += hist->buckets[i];
+        if (n >= target && n > 0) {
+            return (i + 1 < HIST_NR_BUCKETS) ? min(hist_value(i + 1) - 1, hist->max) : hist->max;
+        }
+    }
+
+    return hist->max;
+}
+
+static const double percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+static const char *percentile_names[] = { "p50_ns", "p90_ns", "p99_ns", "p999_ns" };
+
+/**
+ * Dump the latency histograms of the traces.
+ * Only the traces recorded at least once are listed.
+ * Reply:
+ * [
+ *   name,
+ *   [
+ *     "count", count,
+ *     "mean_ns", mean,
+ *     "p50_ns", p50,
+ *     "p90_ns", p90,
+ *     "p99_ns", p99,
+ *     "p999_ns", p999,
+ *     "max_ns", max,
+ *   ],
+ *   ...
+ * ]
+ *
+ * SELVA.trace.dump [reset]
+ */
+static int SelvaTrace_DumpCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    struct SelvaTrace **data_p;
+    struct trace_hist *hist;
+    size_t n = 0;
+
+    if (argc > 2) {
+        return RedisModule_WrongArity(ctx);
+    }
+    if (argc == 2 && strcmp(RedisModule_StringPtrLen(argv[1], NULL), "reset")) {
+        return replyWithSelvaErrorf(ctx, SELVA_EINVAL, "Invalid option");
+    }
+
+    hist = selva_malloc(sizeof(*hist));
+
+    RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+    SET_FOREACH(data_p, selva_trace) {
+        const struct SelvaTrace *data = *data_p;
+
+        merge_hist(hist, data->index);
+        if (hist->count == 0) {
+            continue;
+        }
+
+        RedisModule_ReplyWithSimpleString(ctx, data->name);
+        RedisModule_ReplyWithArray(ctx, 6 + 2 * num_elem(percentiles));
+        RedisModule_ReplyWithSimpleString(ctx, "count");
+        RedisModule_ReplyWithLongLong(ctx, (long long)hist->count);
+        RedisModule_ReplyWithSimpleString(ctx, "mean_ns");
+        RedisModule_ReplyWithLongLong(ctx, (long long)(hist->sum / hist->count));
+        for (size_t i = 0; i < num_elem(percentiles); i++) {
+            RedisModule_ReplyWithSimpleString(ctx, percentile_names[i]);
+            RedisModule_ReplyWithLongLong(ctx, (long long)hist_percentile(hist, percentiles[i]));
+        }
+        RedisModule_ReplyWithSimpleString(ctx, "max_ns");
+        RedisModule_ReplyWithLongLong(ctx, (long long)hist->max);
+        n += 2;
+    }
+    RedisModule_ReplySetArrayLength(ctx, n);
+
+    selva_free(hist);
+
+    if (argc == 2) {
+        reset_hists();
+    }
+
+    return REDISMODULE_OK;
+}
+
+/**
+ * Enable or disable the latency histograms.
+ * Replies with the previous state.
+ * SELVA.trace.enable [0|1]
+ */
+static int SelvaTrace_EnableCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    const int old = selva_trace_enabled;
+
+    if (argc == 2) {
+        long long v;
+
+        if (RedisModule_StringToLongLong(argv[1], &v) != REDISMODULE_OK) {
+            return replyWithSelvaError(ctx, SELVA_EINVAL);
+        }
+
+        selva_trace_enabled = !!v;
+    } else if (argc != 1) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    return RedisModule_ReplyWithLongLong(ctx, old);
+}
+
+static void mod_info(RedisModuleInfoCtx *ctx) {
+    struct SelvaTrace **data_p;
+    struct trace_hist *hist;
+
+    (void)RedisModule_InfoAddFieldLongLong(ctx, "enabled", selva_trace_enabled);
+
+    hist = selva_malloc(sizeof(*hist));
+    SET_FOREACH(data_p, selva_trace) {
+        const struct SelvaTrace *data = *data_p;
+        char name[80];
+
+        merge_hist(hist, data->index);
+        if (hist->count == 0) {
+            continue;
+        }
+
+#define ADD_FIELD(_suffix, _value) \
+        snprintf(name, sizeof(name), "%s_" _suffix, data->name); \
+        (void)RedisModule_InfoAddFieldULongLong(ctx, name, (_value))
+
+        ADD_FIELD("count", hist->count);
+        ADD_FIELD("p50_ns", hist_percentile(hist, 50.0));
+        ADD_FIELD("p99_ns", hist_percentile(hist, 99.0));
+        ADD_FIELD("max_ns", hist->max);
+#undef ADD_FIELD
+    }
+    selva_free(hist);
+}
+SELVA_MODINFO("trace", mod_info);
+
+static int SelvaTrace_OnLoad(RedisModuleCtx *ctx) {
+    /*
+     * Register commands.
+     */
+    if (RedisModule_CreateCommand(ctx, "selva.trace.dump", SelvaTrace_DumpCommand, "readonly", 0, 0, 0) == REDISMODULE_ERR ||
+        RedisModule_CreateCommand(ctx, "selva.trace.enable", SelvaTrace_EnableCommand, "admin", 0, 0, 0) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    return REDISMODULE_OK;
+}
+SELVA_ONLOAD(SelvaTrace_OnLoad);
 #endif
@@ -18,8 +18,10 @@
 #include "arg_parser.h"
 #include "async_task.h"
 #include "hierarchy.h"
+#include "inherit.h"
 #include "resolve.h"
 #include "rpn.h"
+#include "selva_memory.h"
 #include "selva_object.h"
 #include "selva_onload.h"
 #include "selva_trace.h"
@@ -276,7 +278,7 @@ __attribute__((nonnull (1))) static void destroy_marker(struct Selva_Subscriptio
         selva_free(marker->ref_field);
     }
     rpn_destroy_expression(marker->filter_expression);
-    selva_free(marker);
+    selva_arena_free(SELVA_ARENA_SUBSCRIPTIONS, marker);
 }
 
 static void remove_sub_missing_accessor_markers(SelvaHierarchy *hierarchy, const struct Selva_Subscription *sub) {
@@ -402,7 +404,7 @@ static void destroy_sub(RedisModuleCtx *ctx, SelvaHierarchy *hierarchy, struct S
 #if MEM_DEBUG
     memset(sub, 0, sizeof(*sub));
 #endif
-    selva_free(sub);
+    selva_arena_free(SELVA_ARENA_SUBSCRIPTIONS, sub);
 }
 
 /*
@@ -601,7 +603,7 @@ static struct Selva_Subscription *create_subscription(
         const Selva_SubscriptionId sub_id) {
     struct Selva_Subscription *sub;
 
-    sub = selva_calloc(1, sizeof(struct Selva_Subscription));
+    sub = selva_arena_calloc(SELVA_ARENA_SUBSCRIPTIONS, 1, sizeof(struct Selva_Subscription));
     memcpy(sub->sub_id, sub_id, sizeof(sub->sub_id));
     SVector_Init(&sub->markers, 1, marker_svector_compare);
 
@@ -610,7 +612,7 @@ static struct Selva_Subscription *create_subscription(
      */
     if (unlikely(RB_INSERT(hierarchy_subscriptions_tree, &hierarchy->subs.head, sub) != NULL)) {
         SVector_Destroy(&sub->markers);
-        selva_free(sub);
+        selva_arena_free(SELVA_ARENA_SUBSCRIPTIONS, sub);
         return NULL;
     }
 
@@ -658,7 +660,7 @@ static int new_marker(
         }
     }
 
-    marker = selva_calloc(1, sizeof(struct Selva_SubscriptionMarker) + (fields_str ? fields_len + 1 : 0));
+    marker = selva_arena_calloc(SELVA_ARENA_SUBSCRIPTIONS, 1, sizeof(struct Selva_SubscriptionMarker) + (fields_str ? fields_len + 1 : 0));
     marker->marker_id = marker_id;
     marker->marker_flags = flags;
     marker->dir = SELVA_HIERARCHY_TRAVERSAL_NONE;
@@ -1136,10 +1138,11 @@ void SelvaSubscriptions_Delete(
     }
 }
 
-void SelvaSubscriptions_ClearAllMarkers(
+static void clear_all_markers(
         RedisModuleCtx *ctx,
         struct SelvaHierarchy *hierarchy,
-        struct SelvaHierarchyNode *node) {
+        struct SelvaHierarchyNode *node,
+        unsigned short flags) {
     struct SelvaHierarchyMetadata *metadata = SelvaHierarchy_GetNodeMetadataByPtr(node);
     const size_t nr_markers = SVector_Size(&metadata->sub_markers.vec);
     struct SVectorIterator it;
@@ -1169,8 +1172,6 @@ void SelvaSubscriptions_ClearAllMarkers(
      */
     SVector_ForeachBegin(&it, &markers);
     while ((marker = SVector_Foreach(&it))) {
-        unsigned short flags = SELVA_SUBSCRIPTION_FLAG_CL_HIERARCHY | SELVA_SUBSCRIPTION_FLAG_CH_HIERARCHY;
-
         assert(marker->sub);
         clear_node_sub(ctx, hierarchy, marker, node_id);
         marker->marker_action(ctx, hierarchy, marker, flags, NULL, 0, node);
@@ -1178,6 +1179,22 @@ void SelvaSubscriptions_ClearAllMarkers(
     SVector_Clear(&metadata->sub_markers.vec);
 }
 
+void SelvaSubscriptions_ClearAllMarkers(
+        RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyNode *node) {
+    clear_all_markers(ctx, hierarchy, node,
+                      SELVA_SUBSCRIPTION_FLAG_CL_HIERARCHY | SELVA_SUBSCRIPTION_FLAG_CH_HIERARCHY);
+}
+
+void SelvaSubscriptions_ClearAllMarkersOnDelete(
+        RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyNode *node) {
+    clear_all_markers(ctx, hierarchy, node,
+                      SELVA_SUBSCRIPTION_FLAG_CL_HIERARCHY | SELVA_SUBSCRIPTION_FLAG_CH_HIERARCHY | SELVA_SUBSCRIPTION_FLAG_CL_DELETE);
+}
+
 void SelvaSubscriptions_DestroyDeferredEvents(struct SelvaHierarchy *hierarchy) {
     struct SelvaSubscriptions_DeferredEvents *def = &hierarchy->subs.deferred_events;
     if (!def) {
@@ -1687,6 +1704,11 @@ void SelvaSubscriptions_DeferFieldChangeEvents(
         struct SelvaHierarchyNode *node,
         const char *field_str,
         size_t field_len) {
+    /*
+     * Any field change may change the result of an inherit.
+     */
+    Inherit_InvalidateCache(hierarchy);
+
     if (memrchr(field_str, '[', field_len)) {
         /* Array */
         /* Detached markers. */
@@ -19,3 +19,11 @@ long long ts_now(void) {
 
     return now;
 }
+
+long long ts_monotonic_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cdefs.h"
+#include "redismodule.h"
+#include "selva.h"
+#include "traversal.h"
+#include "hierarchy.h"
+#include "../hierarchy-utils.h"
+#include "bench.h"
+
+/*
+ * Generated hierarchies.
+ * The tree is a complete tree of TREE_FANOUT^TREE_DEPTH leaves under root.
+ * The DAG has the same nodes but every node below the first level also has a
+ * second parent on the previous level.
+ */
+#define TREE_FANOUT 10
+#define TREE_DEPTH  4
+#define NR_NODES    (10 + 100 + 1000 + 10000)
+
+/*
+ * Random DAG.
+ * Every node has a random earlier node as a parent and some have two.
+ */
+#define NR_RANDOM_NODES 100000
+
+/*
+ * Node lookups.
+ * Every fifth id is missing from the hierarchy.
+ */
+#define NR_LOOKUPS 1000
+
+static SelvaHierarchy *tree;
+static SelvaHierarchy *dag;
+static SelvaHierarchy *random_dag;
+static Selva_NodeId lookup_ids[NR_LOOKUPS];
+static struct SelvaHierarchyNode *lookup_nodes[NR_LOOKUPS];
+static Selva_NodeId node_ids[NR_NODES];
+static size_t level_start[TREE_DEPTH + 1];
+
+static void make_node_id(Selva_NodeId id, size_t i)
+{
+    char buf[SELVA_NODE_ID_SIZE + 1];
+
+    snprintf(buf, sizeof(buf), "ma%08zx", i);
+    memcpy(id, buf, SELVA_NODE_ID_SIZE);
+}
+
+/**
+ * Build a hierarchy of NR_NODES nodes.
+ * @param nr_parents is the number of parents of the nodes below the first level.
+ */
+static SelvaHierarchy *build(size_t nr_parents)
+{
+    SelvaHierarchy *h = SelvaModify_NewHierarchy(NULL);
+    size_t level_size = TREE_FANOUT;
+    size_t i = 0;
+
+    if (!h) {
+        abort();
+    }
+
+    for (size_t level = 0; level < TREE_DEPTH; level++) {
+        level_start[level] = i;
+
+        for (size_t j = 0; j < level_size; j++, i++) {
+            Selva_NodeId parents[2];
+            size_t n = 1;
+
+            make_node_id(node_ids[i], i);
+            if (level == 0) {
+                memcpy(parents[0], ROOT_NODE_ID, SELVA_NODE_ID_SIZE);
+            } else {
+                const size_t prev_start = level_start[level - 1];
+                const size_t prev_size = level_size / TREE_FANOUT;
+
+                memcpy(parents[0], node_ids[prev_start + j / TREE_FANOUT], SELVA_NODE_ID_SIZE);
+                if (nr_parents > 1) {
+                    memcpy(parents[1], node_ids[prev_start + (j / TREE_FANOUT + 1) % prev_size], SELVA_NODE_ID_SIZE);
+                    n = 2;
+                }
+            }
+
+            if (SelvaModify_SetHierarchy(NULL, h, node_ids[i], n, parents, 0, NULL, NULL) < 0) {
+                abort();
+            }
+        }
+
+        level_size *= TREE_FANOUT;
+    }
+    level_start[TREE_DEPTH] = i;
+
+    return h;
+}
+
+static void setup_tree(void)
+{
+    if (!tree) {
+        tree = build(1);
+    }
+}
+
+static void setup_dag(void)
+{
+    if (!dag) {
+        dag = build(2);
+    }
+}
+
+static void setup_random_dag(void)
+{
+    static Selva_NodeId ids[NR_RANDOM_NODES];
+
+    if (random_dag) {
+        return;
+    }
+
+    random_dag = SelvaModify_NewHierarchy(NULL);
+    if (!random_dag) {
+        abort();
+    }
+
+    bench_rand_reset();
+    for (size_t i = 0; i < NR_RANDOM_NODES; i++) {
+        Selva_NodeId parents[2];
+        size_t n = 0;
+
+        make_node_id(ids[i], i);
+        if (i == 0) {
+            memcpy(parents[n++], ROOT_NODE_ID, SELVA_NODE_ID_SIZE);
+        } else {
+            memcpy(parents[n++], ids[bench_rand() % i], SELVA_NODE_ID_SIZE);
+            if (i > 1 && bench_rand() % 4 == 0) {
+                memcpy(parents[n++], ids[bench_rand() % i], SELVA_NODE_ID_SIZE);
+            }
+        }
+
+        if (SelvaModify_SetHierarchy(NULL, random_dag, ids[i], n, parents, 0, NULL, NULL) < 0) {
+            abort();
+        }
+    }
+}
+
+static void setup_lookups(void)
+{
+    setup_tree();
+
+    bench_rand_reset();
+    for (size_t i = 0; i < NR_LOOKUPS; i++) {
+        memcpy(lookup_ids[i], node_ids[bench_rand() % NR_NODES], SELVA_NODE_ID_SIZE);
+        if (i % 5 == 0) {
+            memcpy(lookup_ids[i], "zz", 2);
+        }
+    }
+}
+
+static void setup_empty(void)
+{
+    for (size_t i = 0; i < NR_NODES; i++) {
+        make_node_id(node_ids[i], i);
+    }
+    hierarchy = SelvaModify_NewHierarchy(NULL);
+}
+
+static void teardown_empty(void)
+{
+    SelvaModify_DestroyHierarchy(hierarchy);
+    hierarchy = NULL;
+}
+
+static int count_node_cb(struct RedisModuleCtx *ctx __unused, struct SelvaHierarchy *h __unused, struct SelvaHierarchyNode *node __unused, void *arg)
+{
+    size_t *nr = (size_t *)arg;
+
+    (*nr)++;
+    return 0;
+}
+
+static void traverse(SelvaHierarchy *h, enum SelvaTraversal dir, size_t nr_nodes)
+{
+    size_t nr = 0;
+    const struct SelvaHierarchyCallback cb = {
+        .node_cb = count_node_cb,
+        .node_arg = &nr,
+    };
+
+    SelvaHierarchy_Traverse(NULL, h, ROOT_NODE_ID, dir, &cb);
+    if (nr != nr_nodes + 1) { /* + root */
+        fprintf(stderr, "Visited %zu nodes instead of %zu\n", nr, nr_nodes + 1);
+        abort();
+    }
+}
+
+BENCH(hierarchy_bfs_tree, NR_NODES, setup_tree, NULL)
+{
+    traverse(tree, SELVA_HIERARCHY_TRAVERSAL_BFS_DESCENDANTS, NR_NODES);
+}
+
+BENCH(hierarchy_dfs_tree, NR_NODES, setup_tree, NULL)
+{
+    traverse(tree, SELVA_HIERARCHY_TRAVERSAL_DFS_DESCENDANTS, NR_NODES);
+}
+
+BENCH(hierarchy_bfs_dag, NR_NODES, setup_dag, NULL)
+{
+    traverse(dag, SELVA_HIERARCHY_TRAVERSAL_BFS_DESCENDANTS, NR_NODES);
+}
+
+BENCH(hierarchy_bfs_random_dag, NR_RANDOM_NODES, setup_random_dag, NULL)
+{
+    traverse(random_dag, SELVA_HIERARCHY_TRAVERSAL_BFS_DESCENDANTS, NR_RANDOM_NODES);
+}
+
+BENCH(hierarchy_dfs_random_dag, NR_RANDOM_NODES, setup_random_dag, NULL)
+{
+    traverse(random_dag, SELVA_HIERARCHY_TRAVERSAL_DFS_DESCENDANTS, NR_RANDOM_NODES);
+}
+
+BENCH(hierarchy_find_node, NR_LOOKUPS, setup_lookups, NULL)
+{
+    for (size_t i = 0; i < NR_LOOKUPS; i++) {
+        lookup_nodes[i] = SelvaHierarchy_FindNode(tree, lookup_ids[i]);
+    }
+    bench_keep(lookup_nodes[0]);
+}
+
+BENCH(hierarchy_find_nodes_batch, NR_LOOKUPS, setup_lookups, NULL)
+{
+    bench_keep(SelvaHierarchy_FindNodes(tree, lookup_ids, NR_LOOKUPS, lookup_nodes));
+}
+
+BENCH(hierarchy_add_nodes, NR_NODES, setup_empty, teardown_empty)
+{
+    for (size_t i = 0; i < n; i++) {
+        const Selva_NodeId *parent = (i < TREE_FANOUT) ? (const Selva_NodeId *)ROOT_NODE_ID : &node_ids[i / TREE_FANOUT - 1];
+
+        SelvaModify_SetHierarchy(NULL, hierarchy, node_ids[i], 1, parent, 0, NULL, NULL);
+    }
+}
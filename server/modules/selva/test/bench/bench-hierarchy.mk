@@ -0,0 +1,24 @@
+BENCH_SRC += bench-hierarchy.c
+SRC-hierarchy += ../redis-alloc.c ../redis-timer.c ../hierarchy-utils.c ../hierarchy_inactive-mock.c ../find-index-mock.c ../inherit-mock.c ../find_cache-mock.c ../redis-rdb.c ../rpn-mock.c ../edge-mock.c ../subscriptions-mock.c ../errors-mock.c ../hierarchy_detached-mock.c ../rms_compressor-mock.c
+SRC-hierarchy += ../../lib/rmutil/sds.c
+SRC-hierarchy += ../../lib/util/auto_free.c
+SRC-hierarchy += ../../lib/util/cstrings.c
+SRC-hierarchy += ../../lib/util/mempool.c
+SRC-hierarchy += ../../lib/util/memrchr.c
+SRC-hierarchy += ../../lib/util/svector.c
+SRC-hierarchy += ../../lib/util/trx.c
+SRC-hierarchy += ../../module/alias.c
+SRC-hierarchy += ../../module/arg_parser.c
+SRC-hierarchy += ../../module/config.c
+SRC-hierarchy += ../../module/errors.c
+SRC-hierarchy += ../../module/hierarchy/hierarchy.c
+SRC-hierarchy += ../../module/hierarchy/types.c
+SRC-hierarchy += ../../module/rms/shared.c
+SRC-hierarchy += ../../module/selva_log.c
+SRC-hierarchy += ../../module/selva_object/selva_object.c
+SRC-hierarchy += ../../module/selva_object/selva_object_foreach.c
+SRC-hierarchy += ../../module/selva_set/selva_set.c
+SRC-hierarchy += ../../module/selva_type.c
+SRC-hierarchy += ../../module/timestamp.c
+SRC-hierarchy += ../../module/selva_trace.c
+SRC-hierarchy += ../../module/selva_memory.c
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cdefs.h"
+#include "redismodule.h"
+#include "selva.h"
+#include "svector.h"
+#include "traversal.h"
+#include "hierarchy.h"
+#include "find_index/icb.h"
+#include "../hierarchy-utils.h"
+#include "bench.h"
+
+#define NR_NODES 10000
+
+static struct SelvaHierarchyNode *nodes[NR_NODES];
+static struct SelvaFindIndexControlBlock icb;
+
+static void make_node_id(Selva_NodeId id, size_t i)
+{
+    char buf[SELVA_NODE_ID_SIZE + 1];
+
+    snprintf(buf, sizeof(buf), "ma%08zx", i);
+    memcpy(id, buf, SELVA_NODE_ID_SIZE);
+}
+
+static void setup_nodes(void)
+{
+    if (hierarchy) {
+        return;
+    }
+
+    hierarchy = SelvaModify_NewHierarchy(NULL);
+    if (!hierarchy) {
+        abort();
+    }
+
+    for (size_t i = 0; i < NR_NODES; i++) {
+        Selva_NodeId id;
+
+        make_node_id(id, i);
+        if (SelvaModify_SetHierarchy(NULL, hierarchy, id, 0, NULL, 0, NULL, NULL) < 0) {
+            abort();
+        }
+        nodes[i] = SelvaHierarchy_FindNode(hierarchy, id);
+    }
+}
+
+static void setup_empty(void)
+{
+    setup_nodes();
+    SelvaFindIndexICB_ResInit(&icb);
+}
+
+/**
+ * Create a valid index of all nodes with the dense array built.
+ */
+static void setup_full(void)
+{
+    setup_empty();
+    for (size_t i = 0; i < NR_NODES; i++) {
+        SelvaFindIndexICB_ResAdd(&icb, nodes[i]);
+    }
+    SelvaFindIndexICB_DenseUpdate(&icb);
+}
+
+static void teardown(void)
+{
+    SelvaFindIndexICB_ResDestroy(&icb);
+}
+
+BENCH(icb_res_add, NR_NODES, setup_empty, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        SelvaFindIndexICB_ResAdd(&icb, nodes[bench_rand() % NR_NODES]);
+    }
+}
+
+BENCH(icb_res_has, NR_NODES, setup_full, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        bench_keep(SelvaFindIndexICB_ResHas(&icb, nodes[bench_rand() % NR_NODES]));
+    }
+}
+
+BENCH(icb_res_iterate_svector, NR_NODES, setup_full, teardown)
+{
+    struct SVectorIterator it;
+    struct SelvaHierarchyNode *node;
+
+    SVector_ForeachBegin(&it, &icb.res.set);
+    while ((node = SVector_Foreach(&it))) {
+        bench_keep(node);
+    }
+}
+
+BENCH(icb_res_iterate_dense, NR_NODES, setup_full, teardown)
+{
+    SelvaFindIndexICB_DenseUpdate(&icb);
+    for (size_t i = 0; i < icb.dense.len; i++) {
+        bench_keep(icb.dense.nodes[i]);
+    }
+}
+
+BENCH(icb_res_dense_update, NR_NODES, setup_full, teardown)
+{
+    icb.dense.dirty = 1;
+    SelvaFindIndexICB_DenseUpdate(&icb);
+    bench_keep(icb.dense.len);
+}
@@ -0,0 +1,70 @@
+#include <stdlib.h>
+#include "cdefs.h"
+#include "mempool.h"
+#include "bench.h"
+
+#define SLAB_SIZE   (64 * 1024)
+#define OBJ_SIZE    64
+#define NR_OBJS     10000
+
+static struct mempool pool;
+static void *objs[NR_OBJS];
+
+static void setup(void)
+{
+    mempool_init(&pool, SLAB_SIZE, OBJ_SIZE, sizeof(size_t));
+}
+
+/**
+ * Warm the pool so that the slabs are already allocated.
+ */
+static void setup_warm(void)
+{
+    setup();
+    for (size_t i = 0; i < NR_OBJS; i++) {
+        objs[i] = mempool_get(&pool);
+    }
+    for (size_t i = 0; i < NR_OBJS; i++) {
+        mempool_return(&pool, objs[i]);
+    }
+}
+
+static void teardown(void)
+{
+    mempool_destroy(&pool);
+}
+
+BENCH(mempool_get_cold, NR_OBJS, setup, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        objs[i] = mempool_get(&pool);
+    }
+}
+
+BENCH(mempool_get_return, NR_OBJS, setup_warm, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        objs[i] = mempool_get(&pool);
+    }
+    for (size_t i = 0; i < n; i++) {
+        mempool_return(&pool, objs[i]);
+    }
+}
+
+BENCH(mempool_get_return_random, NR_OBJS, setup_warm, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        objs[i] = mempool_get(&pool);
+    }
+    /* Return in a random order to fragment the free list. */
+    for (size_t i = n - 1; i > 0; i--) {
+        const size_t j = bench_rand() % (i + 1);
+        void *tmp = objs[i];
+
+        objs[i] = objs[j];
+        objs[j] = tmp;
+    }
+    for (size_t i = 0; i < n; i++) {
+        mempool_return(&pool, objs[i]);
+    }
+}
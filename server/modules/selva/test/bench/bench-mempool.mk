@@ -0,0 +1,2 @@
+BENCH_SRC += bench-mempool.c
+SRC-mempool += ../../lib/util/mempool.c
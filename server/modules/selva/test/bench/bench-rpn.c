@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cdefs.h"
+#include "redismodule.h"
+#include "selva.h"
+#include "selva_object.h"
+#include "rpn.h"
+#include "bench.h"
+
+#define NR_REG 4
+
+static struct rpn_ctx *ctx;
+static struct rpn_expression *expr;
+static struct SelvaObject *obj;
+
+static const char expr_reg_str[] = "@1 @2 F";
+static const char expr_field_str[] = "#10 \"value\" g I";
+static const char expr_fields_str[] = "#10 \"value\" g I #3 \"status\" g F M";
+
+static void setup_expr(const char *expr_str)
+{
+    int res;
+
+    ctx = rpn_init(NR_REG);
+    expr = rpn_compile(expr_str);
+    if (!ctx || !expr) {
+        abort();
+    }
+
+    obj = SelvaObject_New();
+    SelvaObject_SetDoubleStr(obj, "value", 5, 42.0);
+    SelvaObject_SetLongLongStr(obj, "status", 6, 3);
+    rpn_set_obj(ctx, obj);
+    rpn_set_reg(ctx, 1, "1", 1, 0);
+    rpn_set_reg(ctx, 2, "1", 1, 0);
+
+    /* Make sure we are not measuring an error path. */
+    if (rpn_bool(NULL, ctx, expr, &res) != RPN_ERR_OK || !res) {
+        fprintf(stderr, "Invalid expression: %s\n", expr_str);
+        abort();
+    }
+}
+
+static void setup_reg(void)
+{
+    setup_expr(expr_reg_str);
+}
+
+static void setup_field(void)
+{
+    setup_expr(expr_field_str);
+}
+
+static void setup_fields(void)
+{
+    setup_expr(expr_fields_str);
+}
+
+static void teardown(void)
+{
+    rpn_destroy_expression(expr);
+    rpn_destroy(ctx);
+    SelvaObject_Destroy(obj);
+    expr = NULL;
+    ctx = NULL;
+    obj = NULL;
+}
+
+static void run_bool(size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        int res;
+
+        rpn_bool(NULL, ctx, expr, &res);
+        bench_keep(res);
+    }
+}
+
+BENCH(rpn_bool_reg, 0, setup_reg, teardown)
+{
+    run_bool(n);
+}
+
+BENCH(rpn_bool_field, 0, setup_field, teardown)
+{
+    run_bool(n);
+}
+
+BENCH(rpn_bool_fields, 0, setup_fields, teardown)
+{
+    run_bool(n);
+}
+
+BENCH(rpn_compile_expr, 0, NULL, NULL)
+{
+    for (size_t i = 0; i < n; i++) {
+        struct rpn_expression *e = rpn_compile(expr_fields_str);
+
+        rpn_destroy_expression(e);
+    }
+}
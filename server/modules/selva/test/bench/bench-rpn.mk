@@ -0,0 +1,26 @@
+BENCH_SRC += bench-rpn.c
+SRC-rpn += ../../lib/rmutil/sds.c
+SRC-rpn += ../../lib/util/cstrings.c
+SRC-rpn += ../../lib/util/mempool.c
+SRC-rpn += ../../lib/util/memrchr.c
+SRC-rpn += ../../lib/util/svector.c
+SRC-rpn += ../../module/errors.c
+SRC-rpn += ../../module/rms/shared.c
+SRC-rpn += ../../module/rpn/rpn.c
+SRC-rpn += ../../module/selva_log.c
+SRC-rpn += ../../module/selva_object/selva_object.c
+SRC-rpn += ../../module/selva_set/field_has.c
+SRC-rpn += ../../module/selva_set/fielda_in_fieldb.c
+SRC-rpn += ../../module/selva_set/fielda_in_setb.c
+SRC-rpn += ../../module/selva_set/selva_set.c
+SRC-rpn += ../../module/selva_set/seta_in_fieldb.c
+SRC-rpn += ../../module/selva_set/seta_in_setb.c
+SRC-rpn += ../../module/selva_type.c
+SRC-rpn += ../../module/timestamp.c
+SRC-rpn += ../errors-mock.c
+SRC-rpn += ../hierarchy-mock.c
+SRC-rpn += ../edge-mock.c
+SRC-rpn += ../redis-alloc.c
+SRC-rpn += ../subscriptions-mock.c
+SRC-rpn += ../../module/selva_trace.c
+SRC-rpn += ../../module/selva_memory.c
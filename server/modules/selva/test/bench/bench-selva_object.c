@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cdefs.h"
+#include "redismodule.h"
+#include "selva.h"
+#include "selva_object.h"
+#include "bench.h"
+
+#define NR_KEYS 64
+
+static struct SelvaObject *obj;
+static char keys[NR_KEYS][16];
+static char nested_keys[NR_KEYS][32];
+
+static void setup(void)
+{
+    obj = SelvaObject_New();
+    if (!obj) {
+        abort();
+    }
+
+    for (size_t i = 0; i < NR_KEYS; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "field%zu", i);
+        snprintf(nested_keys[i], sizeof(nested_keys[i]), "obj%zu.sub.field%zu", i % 8, i);
+    }
+}
+
+static void setup_full(void)
+{
+    setup();
+
+    for (size_t i = 0; i < NR_KEYS; i++) {
+        SelvaObject_SetLongLongStr(obj, keys[i], strlen(keys[i]), (long long)i);
+        SelvaObject_SetLongLongStr(obj, nested_keys[i], strlen(nested_keys[i]), (long long)i);
+    }
+}
+
+static void teardown(void)
+{
+    SelvaObject_Destroy(obj);
+    obj = NULL;
+}
+
+BENCH(selva_object_set_ll, 0, setup, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        const char *key = keys[i % NR_KEYS];
+
+        SelvaObject_SetLongLongStr(obj, key, strlen(key), (long long)i);
+    }
+}
+
+BENCH(selva_object_set_double, 0, setup, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        const char *key = keys[i % NR_KEYS];
+
+        SelvaObject_SetDoubleStr(obj, key, strlen(key), (double)i);
+    }
+}
+
+BENCH(selva_object_set_ll_nested, 0, setup, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        const char *key = nested_keys[i % NR_KEYS];
+
+        SelvaObject_SetLongLongStr(obj, key, strlen(key), (long long)i);
+    }
+}
+
+BENCH(selva_object_get_ll, 0, setup_full, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        const char *key = keys[bench_rand() % NR_KEYS];
+        long long v;
+
+        SelvaObject_GetLongLongStr(obj, key, strlen(key), &v);
+        bench_keep(v);
+    }
+}
+
+BENCH(selva_object_get_ll_nested, 0, setup_full, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        const char *key = nested_keys[bench_rand() % NR_KEYS];
+        long long v;
+
+        SelvaObject_GetLongLongStr(obj, key, strlen(key), &v);
+        bench_keep(v);
+    }
+}
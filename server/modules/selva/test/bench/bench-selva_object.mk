@@ -0,0 +1,15 @@
+BENCH_SRC += bench-selva_object.c
+SRC-selva_object += ../redis-alloc.c ../errors-mock.c
+SRC-selva_object += ../../lib/rmutil/sds.c
+SRC-selva_object += ../../lib/util/cstrings.c
+SRC-selva_object += ../../lib/util/mempool.c
+SRC-selva_object += ../../lib/util/memrchr.c
+SRC-selva_object += ../../lib/util/svector.c
+SRC-selva_object += ../../module/errors.c
+SRC-selva_object += ../../module/rms/shared.c
+SRC-selva_object += ../../module/selva_log.c
+SRC-selva_object += ../../module/selva_object/selva_object.c
+SRC-selva_object += ../../module/selva_set/selva_set.c
+SRC-selva_object += ../../module/selva_type.c
+SRC-selva_object += ../../module/selva_trace.c
+SRC-selva_object += ../../module/selva_memory.c
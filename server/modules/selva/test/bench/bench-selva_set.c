@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cdefs.h"
+#include "redismodule.h"
+#include "selva.h"
+#include "selva_set.h"
+#include "bench.h"
+
+#define NR_ELEMS 10000
+
+static struct SelvaSet set_a;
+static struct SelvaSet set_b;
+static struct SelvaSet set_res;
+static Selva_NodeId node_ids[NR_ELEMS];
+
+static void init_node_ids(void)
+{
+    for (size_t i = 0; i < NR_ELEMS; i++) {
+        char buf[SELVA_NODE_ID_SIZE + 1];
+
+        snprintf(buf, sizeof(buf), "ma%08zx", i * 7919 % NR_ELEMS);
+        memcpy(node_ids[i], buf, SELVA_NODE_ID_SIZE);
+    }
+}
+
+static void setup_empty_ll(void)
+{
+    SelvaSet_Init(&set_a, SELVA_SET_TYPE_LONGLONG);
+}
+
+static void setup_full_ll(void)
+{
+    setup_empty_ll();
+    for (long long i = 0; i < NR_ELEMS; i++) {
+        SelvaSet_Add(&set_a, i);
+    }
+}
+
+static void setup_empty_node_id(void)
+{
+    init_node_ids();
+    SelvaSet_Init(&set_a, SELVA_SET_TYPE_NODEID);
+}
+
+static void setup_full_node_id(void)
+{
+    setup_empty_node_id();
+    for (size_t i = 0; i < NR_ELEMS; i++) {
+        SelvaSet_Add(&set_a, (const char *)node_ids[i]);
+    }
+}
+
+static void setup_union(void)
+{
+    SelvaSet_Init(&set_a, SELVA_SET_TYPE_LONGLONG);
+    SelvaSet_Init(&set_b, SELVA_SET_TYPE_LONGLONG);
+    SelvaSet_Init(&set_res, SELVA_SET_TYPE_LONGLONG);
+
+    /* The sets overlap by half. */
+    for (long long i = 0; i < NR_ELEMS; i++) {
+        SelvaSet_Add(&set_a, i);
+        SelvaSet_Add(&set_b, i + NR_ELEMS / 2);
+    }
+}
+
+static void teardown(void)
+{
+    SelvaSet_Destroy(&set_a);
+}
+
+static void teardown_union(void)
+{
+    SelvaSet_Destroy(&set_a);
+    SelvaSet_Destroy(&set_b);
+    SelvaSet_Destroy(&set_res);
+}
+
+BENCH(selva_set_add_ll, NR_ELEMS, setup_empty_ll, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        SelvaSet_Add(&set_a, (long long)(i * 7919 % NR_ELEMS));
+    }
+}
+
+BENCH(selva_set_has_ll, 0, setup_full_ll, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        bench_keep(SelvaSet_Has(&set_a, (long long)(bench_rand() % (2 * NR_ELEMS))));
+    }
+}
+
+BENCH(selva_set_remove_ll, NR_ELEMS, setup_full_ll, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        SelvaSet_DestroyElement(SelvaSet_Remove(&set_a, (long long)(i * 7919 % NR_ELEMS)));
+    }
+}
+
+BENCH(selva_set_add_node_id, NR_ELEMS, setup_empty_node_id, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        SelvaSet_Add(&set_a, (const char *)node_ids[i]);
+    }
+}
+
+BENCH(selva_set_has_node_id, 0, setup_full_node_id, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        bench_keep(SelvaSet_Has(&set_a, (const char *)node_ids[bench_rand() % NR_ELEMS]));
+    }
+}
+
+BENCH(selva_set_union_ll, NR_ELEMS, setup_union, teardown_union)
+{
+    SelvaSet_Union(&set_res, &set_a, &set_b, NULL);
+}
@@ -0,0 +1,8 @@
+BENCH_SRC += bench-selva_set.c
+SRC-selva_set += ../redis-alloc.c ../errors-mock.c
+SRC-selva_set += ../../lib/rmutil/sds.c
+SRC-selva_set += ../../module/errors.c
+SRC-selva_set += ../../module/selva_set/selva_set.c
+SRC-selva_set += ../../module/selva_type.c
+SRC-selva_set += ../../module/selva_log.c
+SRC-selva_set += ../../module/selva_memory.c
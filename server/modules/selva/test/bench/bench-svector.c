@@ -0,0 +1,135 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cdefs.h"
+#include "svector.h"
+#include "bench.h"
+
+#define NR_SMALL    64  /* Stays in SVECTOR_MODE_ARRAY. */
+#define NR_LARGE    10000 /* Migrates to SVECTOR_MODE_RBTREE. */
+
+struct data {
+    int id;
+};
+
+static struct data data[NR_LARGE];
+static SVector vec;
+
+static int compar(const void ** restrict ap, const void ** restrict bp)
+{
+    const struct data *a = *(const struct data **)ap;
+    const struct data *b = *(const struct data **)bp;
+
+    return a->id - b->id;
+}
+
+static void init_data(void)
+{
+    /* A permutation of 0..NR_LARGE-1 so every id is unique. */
+    for (int i = 0; i < NR_LARGE; i++) {
+        data[i].id = (int)(((long long)i * 7919) % NR_LARGE);
+    }
+}
+
+static void setup_empty_ordered(void)
+{
+    init_data();
+    SVector_Init(&vec, NR_SMALL, compar);
+}
+
+static void setup_empty_unordered(void)
+{
+    init_data();
+    SVector_Init(&vec, NR_SMALL, NULL);
+}
+
+static void fill(size_t nr)
+{
+    for (size_t i = 0; i < nr; i++) {
+        SVector_Insert(&vec, &data[i]);
+    }
+}
+
+static void setup_small(void)
+{
+    setup_empty_ordered();
+    fill(NR_SMALL);
+}
+
+static void setup_large(void)
+{
+    setup_empty_ordered();
+    fill(NR_LARGE);
+}
+
+static void setup_large_unordered(void)
+{
+    setup_empty_unordered();
+    fill(NR_LARGE);
+}
+
+static void teardown(void)
+{
+    SVector_Destroy(&vec);
+}
+
+BENCH(svector_insert_array, NR_SMALL, setup_empty_ordered, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        SVector_Insert(&vec, &data[i]);
+    }
+}
+
+BENCH(svector_insert_rbtree, NR_LARGE, setup_empty_ordered, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        SVector_Insert(&vec, &data[i]);
+    }
+}
+
+BENCH(svector_insert_unordered, NR_LARGE, setup_empty_unordered, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        SVector_Insert(&vec, &data[i]);
+    }
+}
+
+BENCH(svector_search_array, 0, setup_small, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        struct data key = { .id = data[bench_rand() % NR_SMALL].id };
+
+        bench_keep(SVector_Search(&vec, &key));
+    }
+}
+
+BENCH(svector_search_rbtree, 0, setup_large, teardown)
+{
+    for (size_t i = 0; i < n; i++) {
+        struct data key = { .id = (int)(bench_rand() % NR_LARGE) };
+
+        bench_keep(SVector_Search(&vec, &key));
+    }
+}
+
+static void foreach(void)
+{
+    struct SVectorIterator it;
+    const struct data *d;
+    int sum = 0;
+
+    SVector_ForeachBegin(&it, &vec);
+    while ((d = SVector_Foreach(&it))) {
+        sum += d->id;
+    }
+    bench_keep(sum);
+}
+
+BENCH(svector_foreach_array, NR_LARGE, setup_large_unordered, teardown)
+{
+    foreach();
+}
+
+BENCH(svector_foreach_rbtree, NR_LARGE, setup_large, teardown)
+{
+    foreach();
+}
@@ -0,0 +1,5 @@
+BENCH_SRC += bench-svector.c
+SRC-svector += ../redis-alloc.c
+SRC-svector += ../../lib/rmutil/sds.c
+SRC-svector += ../../lib/util/mempool.c
+SRC-svector += ../../lib/util/svector.c
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "bench.h"
+
+/*
+ * A small benchmark harness.
+ *
+ * Each benchmark is first run `warmup` samples that are not recorded and then
+ * `repeat` samples that are recorded. The results are printed to stdout as
+ * JSON, one object per line, with the time per operation of the samples:
+ *
+ * {"suite":"svector","name":"svector_search","commit":"abc","ops":1024,
+ *  "samples":30,"ns_per_op":{"min":..,"mean":..,"stddev":..,"p50":..,
+ *  "p90":..,"p99":..,"max":..}}
+ */
+
+#define BENCH_DEFAULT_WARMUP        3
+#define BENCH_DEFAULT_REPEAT        30
+#define BENCH_DEFAULT_MIN_SAMPLE_US 2000
+#define BENCH_MAX_OPS               ((size_t)1 << 30)
+
+SET_DECLARE(bench, struct bench);
+
+const char * const selva_version = "bench";
+
+static unsigned long long rand_state;
+
+unsigned long long bench_rand(void) {
+    /* splitmix64 */
+    unsigned long long z = (rand_state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void bench_rand_reset(void) {
+    rand_state = 0;
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Run one sample.
+ * @returns the time taken in nanoseconds.
+ */
+static int64_t run_sample(const struct bench *b, size_t n) {
+    int64_t start, end;
+
+    bench_rand_reset();
+    if (b->setup) {
+        b->setup();
+    }
+
+    start = now_ns();
+    b->run(n);
+    end = now_ns();
+
+    if (b->teardown) {
+        b->teardown();
+    }
+
+    return end - start;
+}
+
+/**
+ * Find the number of operations that makes a sample last at least min_ns.
+ */
+static size_t calibrate(const struct bench *b, int64_t min_ns) {
+    size_t n = 1;
+
+    while (n < BENCH_MAX_OPS) {
+        const int64_t t = run_sample(b, n);
+
+        if (t >= min_ns) {
+            break;
+        }
+
+        /* Aim a bit over the target but don't grow too fast. */
+        n = (t > 0) ? min(n * 10, (size_t)((double)n * 1.2 * (double)min_ns / (double)t) + 1) : n * 10;
+    }
+
+    return min(n, BENCH_MAX_OPS);
+}
+
+static int compar_double(const void *a, const void *b) {
+    const double x = *(const double *)a;
+    const double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Get a percentile of sorted samples using the nearest-rank method.
+ */
+static double percentile(const double *sorted, size_t nr, double pct) {
+    size_t rank = (size_t)ceil(pct / 100.0 * (double)nr);
+
+    return sorted[(rank > 0) ? rank - 1 : 0];
+}
+
+static void print_json_str(const char *s) {
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            putchar('\\');
+        }
+        putchar(*s);
+    }
+    putchar('"');
+}
+
+static void run_bench(const char *suite, const char *commit, const struct bench *b, int warmup, int repeat, int64_t min_ns) {
+    const size_t n = b->n ?: calibrate(b, min_ns);
+    double *samples;
+    double sum = 0.0, var = 0.0, mean;
+
+    samples = calloc(repeat, sizeof(double));
+    if (!samples) {
+        abort();
+    }
+
+    for (int i = 0; i < warmup; i++) {
+        (void)run_sample(b, n);
+    }
+    for (int i = 0; i < repeat; i++) {
+        samples[i] = (double)run_sample(b, n) / (double)n;
+        sum += samples[i];
+    }
+
+    mean = sum / repeat;
+    for (int i = 0; i < repeat; i++) {
+        var += (samples[i] - mean) * (samples[i] - mean);
+    }
+    qsort(samples, repeat, sizeof(double), compar_double);
+
+    printf("{\"suite\":");
+    print_json_str(suite);
+    printf(",\"name\":");
+    print_json_str(b->name);
+    printf(",\"commit\":");
+    print_json_str(commit);
+    printf(",\"ops\":%zu,\"samples\":%d,\"ns_per_op\":{", n, repeat);
+    printf("\"min\":%.3f,\"mean\":%.3f,\"stddev\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f}}\n",
+           samples[0], mean, sqrt(var / repeat),
+           percentile(samples, repeat, 50.0),
+           percentile(samples, repeat, 90.0),
+           percentile(samples, repeat, 99.0),
+           samples[repeat - 1]);
+    fflush(stdout);
+
+    free(samples);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "Usage: %s [-l] [-f FILTER] [-w WARMUP] [-r REPEAT] [-t MIN_SAMPLE_US] [-c COMMIT]\n"
+            "  -l  List the benchmarks\n"
+            "  -f  Run only the benchmarks containing FILTER in their name\n"
+            "  -w  Number of warmup samples (default %d)\n"
+            "  -r  Number of recorded samples (default %d)\n"
+            "  -t  Minimum sample time in microseconds (default %d)\n"
+            "  -c  Commit or label included in the results\n",
+            argv0, BENCH_DEFAULT_WARMUP, BENCH_DEFAULT_REPEAT, BENCH_DEFAULT_MIN_SAMPLE_US);
+}
+
+int main(int argc, char *argv[]) {
+    struct bench **bench_p;
+    const char *suite;
+    const char *filter = NULL;
+    const char *commit = "";
+    int list = 0;
+    int warmup = BENCH_DEFAULT_WARMUP;
+    int repeat = BENCH_DEFAULT_REPEAT;
+    long min_us = BENCH_DEFAULT_MIN_SAMPLE_US;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "lf:w:r:t:c:")) != -1) {
+        switch (opt) {
+        case 'l':
+            list = 1;
+            break;
+        case 'f':
+            filter = optarg;
+            break;
+        case 'w':
+            warmup = atoi(optarg);
+            break;
+        case 'r':
+            repeat = atoi(optarg);
+            break;
+        case 't':
+            min_us = atol(optarg);
+            break;
+        case 'c':
+            commit = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (warmup < 0 || repeat < 1 || min_us < 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    suite = strrchr(argv[0], '/');
+    suite = suite ? suite + 1 : argv[0];
+    if (!strncmp(suite, "bench-", 6)) {
+        suite += 6;
+    }
+
+    SET_FOREACH(bench_p, bench) {
+        const struct bench *b = *bench_p;
+
+        if (filter && !strstr(b->name, filter)) {
+            continue;
+        }
+
+        if (list) {
+            printf("%s\n", b->name);
+        } else {
+            run_bench(suite, commit, b, warmup, repeat, min_us * 1000);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <stddef.h>
+#include "cdefs.h"
+#include "linker_set.h"
+
+/**
+ * A benchmark.
+ * Benchmarks are registered with BENCH() and the harness runs every
+ * benchmark linked in the executable.
+ */
+struct bench {
+    const char *name;
+    /**
+     * Number of operations per sample.
+     * If zero the harness picks a number of operations that makes each
+     * sample last at least the minimum sample time.
+     */
+    size_t n;
+    /**
+     * Called before each sample, not included in the time measured.
+     */
+    void (*setup)(void);
+    /**
+     * Called after each sample, not included in the time measured.
+     */
+    void (*teardown)(void);
+    /**
+     * Run n operations.
+     */
+    void (*run)(size_t n);
+};
+
+/**
+ * Define and register a benchmark.
+ * The body following the macro is the run function and it should execute
+ * `n` operations.
+ * @param _name is the name of the benchmark.
+ * @param _n is the fixed number of operations per sample or 0.
+ * @param _setup is a setup function or NULL.
+ * @param _teardown is a teardown function or NULL.
+ */
+#define BENCH(_name, _n, _setup, _teardown) \
+    static void bench_##_name(size_t n); \
+    static struct bench bench_##_name##_desc = { \
+        .name = #_name, \
+        .n = (_n), \
+        .setup = (_setup), \
+        .teardown = (_teardown), \
+        .run = bench_##_name, \
+    }; \
+    DATA_SET(bench, bench_##_name##_desc); \
+    static void bench_##_name(size_t n)
+
+/**
+ * Prevent the compiler from optimizing away a computed value.
+ */
+#define bench_keep(x) do { \
+    __typeof__(x) _bench_keep_v = (x); \
+    __asm__ volatile("" : : "m"(_bench_keep_v) : "memory"); \
+} while (0)
+
+/**
+ * Get a pseudo-random number.
+ * The sequence is the same on every run, so the results are comparable
+ * across runs and commits.
+ */
+unsigned long long bench_rand(void);
+
+/**
+ * Reset the sequence of bench_rand().
+ */
+void bench_rand_reset(void);
+
+#endif /* _BENCH_H_ */
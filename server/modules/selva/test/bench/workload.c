@@ -0,0 +1,662 @@
+/*
+ * Copyright (c) 2022 SAULX
+ * SPDX-License-Identifier: MIT
+ */
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include "cdefs.h"
+#include "redismodule.h"
+#include "selva.h"
+#include "edge.h"
+#include "hierarchy.h"
+#include "rpn.h"
+#include "selva_object.h"
+#include "traversal.h"
+
+/*
+ * A synthetic graph workload.
+ *
+ * Builds a DAG in-process against the hierarchy APIs and then runs a mix of
+ * operations on it, reporting the throughput and the latency distribution
+ * of each operation type. No Redis, client or network is involved, so the
+ * results only reflect the module code.
+ *
+ * The command mix is either given as weights (-m) or replayed from a
+ * recorded command log (-R). A log is either the output of redis-cli MONITOR
+ * or a file with one operation name per line. Only the command names are
+ * used; the arguments are replaced with random nodes of the generated graph.
+ *
+ * The operations:
+ * - modify     Update the fields of a random node or create a new node.
+ * - find       A filtered BFS over the descendants of a random node.
+ * - aggregate  Sum a field over the filtered descendants of a random node.
+ * - sub        Refresh a subscription: the same filtered traversal but it
+ *              also follows an edge field of each node. Real subscription
+ *              markers need the Redis event loop and are not used here.
+ */
+
+#define WORKLOAD_TYPE_PREFIX "ma"
+#define WORKLOAD_EDGE_FIELD "refs"
+
+enum op_type {
+    OP_MODIFY = 0,
+    OP_FIND,
+    OP_AGGREGATE,
+    OP_SUB,
+    NR_OP_TYPES,
+};
+
+static const char *op_names[NR_OP_TYPES] = {
+    [OP_MODIFY] = "modify",
+    [OP_FIND] = "find",
+    [OP_AGGREGATE] = "aggregate",
+    [OP_SUB] = "sub",
+};
+
+/**
+ * Maps recorded command names to operations.
+ */
+static const struct {
+    const char *cmd;
+    enum op_type op;
+} recorded_cmds[] = {
+    { "selva.modify", OP_MODIFY },
+    { "selva.hierarchy.findin", OP_FIND },
+    { "selva.hierarchy.find", OP_FIND },
+    { "selva.hierarchy.aggregatein", OP_AGGREGATE },
+    { "selva.hierarchy.aggregate", OP_AGGREGATE },
+    { "selva.subscriptions.add", OP_SUB },
+    { "selva.subscriptions.refresh", OP_SUB },
+    { "modify", OP_MODIFY },
+    { "find", OP_FIND },
+    { "aggregate", OP_AGGREGATE },
+    { "sub", OP_SUB },
+};
+
+enum fanout_dist {
+    FANOUT_FIXED,
+    FANOUT_UNIFORM,
+    FANOUT_EXP,
+    FANOUT_POWER,
+};
+
+static struct {
+    size_t nr_nodes;
+    double fanout;
+    enum fanout_dist fanout_dist;
+    double multi_parent;
+    int nr_fields;
+    double edge_density;
+    unsigned weights[NR_OP_TYPES];
+    const char *recorded;
+    size_t nr_ops;
+    unsigned long long seed;
+    const char *commit;
+} opts = {
+    .nr_nodes = 100000,
+    .fanout = 8.0,
+    .fanout_dist = FANOUT_EXP,
+    .multi_parent = 0.1,
+    .nr_fields = 8,
+    .edge_density = 1.0,
+    .weights = {
+        [OP_MODIFY] = 50,
+        [OP_FIND] = 30,
+        [OP_AGGREGATE] = 15,
+        [OP_SUB] = 5,
+    },
+    .nr_ops = 100000,
+    .seed = 1,
+    .commit = "",
+};
+
+const char * const selva_version = "workload";
+
+/*
+ * The mocked Redis APIs don't need a context but some functions are declared
+ * nonnull for it.
+ */
+struct RedisModuleCtx *workload_ctx;
+static SelvaHierarchy *graph;
+static struct SelvaHierarchyNode **nodes;
+static size_t nr_nodes;
+static size_t nodes_len;
+static char (*field_names)[16];
+static unsigned long long rand_state;
+
+static unsigned long long rnd(void) {
+    /* splitmix64 */
+    unsigned long long z = (rand_state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Get a uniformly distributed double in [0, 1).
+ */
+static double rnd_double(void) {
+    return (double)(rnd() >> 11) * 0x1.0p-53;
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static size_t draw_fanout(void) {
+    const double mean = opts.fanout;
+    double k;
+
+    switch (opts.fanout_dist) {
+    case FANOUT_FIXED:
+        k = mean;
+        break;
+    case FANOUT_UNIFORM:
+        k = (double)(rnd() % (size_t)(2 * mean + 1));
+        break;
+    case FANOUT_EXP:
+        k = -mean * log(1.0 - rnd_double());
+        break;
+    case FANOUT_POWER:
+        /* Pareto with alpha = 1.5 scaled to the mean, capped. */
+        k = min(mean / 3.0 / pow(1.0 - rnd_double(), 1.0 / 1.5), mean * 1000.0);
+        break;
+    default:
+        abort();
+    }
+
+    return (size_t)(k + 0.5);
+}
+
+static void make_node_id(Selva_NodeId id, size_t i) {
+    char buf[SELVA_NODE_ID_SIZE + 1];
+
+    snprintf(buf, sizeof(buf), WORKLOAD_TYPE_PREFIX "%08zx", i);
+    memcpy(id, buf, SELVA_NODE_ID_SIZE);
+}
+
+static void set_fields(struct SelvaHierarchyNode *node) {
+    struct SelvaObject *obj = SelvaHierarchy_GetNodeObject(node);
+
+    for (int i = 0; i < opts.nr_fields; i++) {
+        SelvaObject_SetDoubleStr(obj, field_names[i], strlen(field_names[i]), (double)(rnd() % 1000));
+    }
+}
+
+static struct SelvaHierarchyNode *new_node(size_t nr_parents, const Selva_NodeId *parents) {
+    struct SelvaHierarchyNode *node;
+    Selva_NodeId id;
+
+    make_node_id(id, nr_nodes);
+    if (SelvaModify_SetHierarchy(NULL, graph, id, nr_parents, parents, 0, NULL, &node) < 0 || !node) {
+        fprintf(stderr, "Failed to create a node\n");
+        abort();
+    }
+
+    if (nr_nodes == nodes_len) {
+        nodes_len = nodes_len ? 2 * nodes_len : 1024;
+        nodes = realloc(nodes, nodes_len * sizeof(*nodes));
+        if (!nodes) {
+            abort();
+        }
+    }
+    nodes[nr_nodes++] = node;
+
+    set_fields(node);
+
+    return node;
+}
+
+static struct SelvaHierarchyNode *random_node(void) {
+    return nodes[rnd() % nr_nodes];
+}
+
+/**
+ * Create a child for `parent` and maybe a second parent.
+ * The second parent is always an older node so the graph stays acyclic.
+ */
+static void new_child(size_t parent) {
+    Selva_NodeId parents[2];
+    size_t n = 1;
+
+    SelvaHierarchy_GetNodeId(parents[0], nodes[parent]);
+    if (parent > 0 && rnd_double() < opts.multi_parent) {
+        SelvaHierarchy_GetNodeId(parents[1], nodes[rnd() % parent]);
+        n = 2;
+    }
+
+    (void)new_node(n, parents);
+}
+
+static void add_edges(struct SelvaHierarchyNode *node) {
+    double d = opts.edge_density;
+
+    /* The fractional part is the probability of one more edge. */
+    while (d >= 1.0 || (d > 0.0 && rnd_double() < d)) {
+        Edge_Add(workload_ctx, graph, EDGE_FIELD_CONSTRAINT_ID_DEFAULT,
+                 WORKLOAD_EDGE_FIELD, sizeof(WORKLOAD_EDGE_FIELD) - 1,
+                 node, random_node());
+        d -= 1.0;
+    }
+}
+
+static void build_graph(void) {
+    size_t parent = 0;
+
+    graph = SelvaModify_NewHierarchy(NULL);
+    if (!graph) {
+        abort();
+    }
+
+    /* The children of root. */
+    nodes_len = opts.nr_nodes;
+    nodes = calloc(nodes_len, sizeof(*nodes));
+    if (!nodes) {
+        abort();
+    }
+    for (size_t i = 0, k = max((size_t)1, draw_fanout()); i < k && nr_nodes < opts.nr_nodes; i++) {
+        (void)new_node(1, (const Selva_NodeId *)ROOT_NODE_ID);
+    }
+
+    /* Expand in BFS order. */
+    while (nr_nodes < opts.nr_nodes) {
+        size_t k = draw_fanout();
+
+        /* Don't let the graph die out. */
+        if (parent == nr_nodes - 1 && k == 0) {
+            k = 1;
+        }
+        for (size_t i = 0; i < k && nr_nodes < opts.nr_nodes; i++) {
+            new_child(parent);
+        }
+        parent++;
+    }
+
+    for (size_t i = 0; i < nr_nodes; i++) {
+        add_edges(nodes[i]);
+    }
+}
+
+struct traversal_args {
+    struct rpn_ctx *rpn_ctx;
+    struct rpn_expression *filter;
+    const char *field;
+    int follow_edges;
+    size_t nr_taken;
+    double sum;
+};
+
+static int node_cb(struct RedisModuleCtx *redis_ctx __unused, struct SelvaHierarchy *hierarchy, struct SelvaHierarchyNode *node, void *arg) {
+    struct traversal_args *args = (struct traversal_args *)arg;
+    struct SelvaObject *obj = SelvaHierarchy_GetNodeObject(node);
+    int take = 0;
+
+    rpn_set_hierarchy_node(args->rpn_ctx, hierarchy, node);
+    rpn_set_obj(args->rpn_ctx, obj);
+    if (rpn_bool(NULL, args->rpn_ctx, args->filter, &take) || !take) {
+        return 0;
+    }
+
+    args->nr_taken++;
+    if (args->field) {
+        double v;
+
+        if (!SelvaObject_GetDoubleStr(obj, args->field, strlen(args->field), &v)) {
+            args->sum += v;
+        }
+    }
+    if (args->follow_edges) {
+        const struct EdgeField *edge_field = Edge_GetField(node, WORKLOAD_EDGE_FIELD, sizeof(WORKLOAD_EDGE_FIELD) - 1);
+
+        if (edge_field) {
+            args->nr_taken += Edge_GetFieldLength(edge_field);
+        }
+    }
+
+    return 0;
+}
+
+static void traverse(struct traversal_args *args) {
+    const struct SelvaHierarchyCallback cb = {
+        .node_cb = node_cb,
+        .node_arg = args,
+    };
+
+    (void)SelvaHierarchy_TraverseBFSDescendants(NULL, graph, random_node(), &cb);
+}
+
+static void run_op(enum op_type op, struct rpn_ctx *rpn_ctx, struct rpn_expression *filter) {
+    struct traversal_args args = {
+        .rpn_ctx = rpn_ctx,
+        .filter = filter,
+    };
+
+    switch (op) {
+    case OP_MODIFY:
+        if (rnd() % 10 == 0) {
+            new_child(rnd() % nr_nodes);
+        } else {
+            set_fields(random_node());
+        }
+        break;
+    case OP_FIND:
+        traverse(&args);
+        break;
+    case OP_AGGREGATE:
+        args.field = field_names[opts.nr_fields > 1];
+        traverse(&args);
+        break;
+    case OP_SUB:
+        args.follow_edges = 1;
+        traverse(&args);
+        break;
+    default:
+        abort();
+    }
+}
+
+/**
+ * Read a recorded command log.
+ * @returns the number of operations read.
+ */
+static size_t read_recorded(const char *path, enum op_type **ops_out) {
+    FILE *fp;
+    char line[4096];
+    enum op_type *ops = NULL;
+    size_t n = 0, len = 0;
+
+    fp = fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        char *s = line;
+
+        /* MONITOR lines look like: 1650000000.000000 [0 127.0.0.1:1234] "selva.modify" ... */
+        if (*s != '"' && strchr(s, '"')) {
+            s = strchr(s, '"');
+        }
+        while (*s == '"' || isspace(*s)) {
+            s++;
+        }
+
+        for (size_t i = 0; i < num_elem(recorded_cmds); i++) {
+            const size_t cmd_len = strlen(recorded_cmds[i].cmd);
+
+            if (!strncasecmp(s, recorded_cmds[i].cmd, cmd_len) &&
+                (s[cmd_len] == '"' || s[cmd_len] == '\0' || isspace(s[cmd_len]))) {
+                if (n == len) {
+                    len = len ? 2 * len : 1024;
+                    ops = realloc(ops, len * sizeof(*ops));
+                    if (!ops) {
+                        abort();
+                    }
+                }
+                ops[n++] = recorded_cmds[i].op;
+                break;
+            }
+        }
+    }
+
+    fclose(fp);
+
+    *ops_out = ops;
+    return n;
+}
+
+static int parse_mix(char *s) {
+    unsigned weights[NR_OP_TYPES] = { 0 };
+    char *tok, *saveptr = NULL;
+
+    for (tok = strtok_r(s, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+        char *sep = strchr(tok, ':');
+        size_t i;
+
+        if (!sep) {
+            return -1;
+        }
+        *sep = '\0';
+
+        for (i = 0; i < NR_OP_TYPES; i++) {
+            if (!strcmp(tok, op_names[i])) {
+                weights[i] = (unsigned)strtoul(sep + 1, NULL, 10);
+                break;
+            }
+        }
+        if (i == NR_OP_TYPES) {
+            return -1;
+        }
+    }
+
+    memcpy(opts.weights, weights, sizeof(weights));
+    return 0;
+}
+
+static enum op_type draw_op(unsigned total_weight) {
+    unsigned r = (unsigned)(rnd() % total_weight);
+
+    for (size_t i = 0; i < NR_OP_TYPES; i++) {
+        if (r < opts.weights[i]) {
+            return (enum op_type)i;
+        }
+        r -= opts.weights[i];
+    }
+
+    abort();
+}
+
+static int compar_i64(const void *a, const void *b) {
+    const int64_t x = *(const int64_t *)a;
+    const int64_t y = *(const int64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int64_t percentile(const int64_t *sorted, size_t nr, double pct) {
+    size_t rank = (size_t)ceil(pct / 100.0 * (double)nr);
+
+    return sorted[(rank > 0) ? rank - 1 : 0];
+}
+
+/**
+ * Print the results of an operation type.
+ * @param time_ns is the time used for the throughput; 0 = the sum of the latencies.
+ */
+static void print_result(const char *name, int64_t *lat, size_t nr, int64_t time_ns) {
+    int64_t sum = 0;
+
+    if (nr == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < nr; i++) {
+        sum += lat[i];
+    }
+    qsort(lat, nr, sizeof(*lat), compar_i64);
+
+    printf("{\"suite\":\"workload\",\"name\":\"%s\",\"commit\":\"%s\",\"nodes\":%zu,\"ops\":%zu,"
+           "\"ops_per_sec\":%.1f,\"latency_ns\":{\"mean\":%.1f,\"p50\":%lld,\"p90\":%lld,\"p99\":%lld,\"p999\":%lld,\"max\":%lld}}\n",
+           name, opts.commit, nr_nodes, nr,
+           (double)nr * 1e9 / (double)((time_ns ?: sum) ?: 1),
+           (double)sum / (double)nr,
+           (long long)percentile(lat, nr, 50.0),
+           (long long)percentile(lat, nr, 90.0),
+           (long long)percentile(lat, nr, 99.0),
+           (long long)percentile(lat, nr, 99.9),
+           (long long)lat[nr - 1]);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "Usage: %s [OPTIONS]\n"
+            "  -n NODES      Number of nodes to generate (default %zu)\n"
+            "  -f FANOUT     Mean number of children per node (default %.1f)\n"
+            "  -d DIST       Fanout distribution: fixed, uniform, exp, power (default exp)\n"
+            "  -p RATIO      Ratio of nodes with a second parent (default %.2f)\n"
+            "  -k FIELDS     Number of numeric fields per node (default %d)\n"
+            "  -e DENSITY    Mean number of edge field arcs per node (default %.1f)\n"
+            "  -m MIX        Operation weights, e.g. modify:50,find:30,aggregate:15,sub:5\n"
+            "  -R FILE       Replay the commands recorded in FILE instead of MIX\n"
+            "  -o OPS        Number of operations to run (default %zu)\n"
+            "  -s SEED       Random seed (default %llu)\n"
+            "  -c COMMIT     Commit or label included in the results\n",
+            argv0, opts.nr_nodes, opts.fanout, opts.multi_parent, opts.nr_fields,
+            opts.edge_density, opts.nr_ops, opts.seed);
+}
+
+int main(int argc, char *argv[]) {
+    enum op_type *recorded = NULL;
+    size_t nr_recorded = 0;
+    unsigned total_weight = 0;
+    int64_t *lat[NR_OP_TYPES];
+    int64_t *lat_all;
+    size_t nr_lat[NR_OP_TYPES] = { 0 };
+    struct rpn_ctx *rpn_ctx;
+    struct rpn_expression *filter;
+    int64_t start, wall_ns;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:f:d:p:k:e:m:R:o:s:c:")) != -1) {
+        switch (opt) {
+        case 'n':
+            opts.nr_nodes = strtoull(optarg, NULL, 10);
+            break;
+        case 'f':
+            opts.fanout = strtod(optarg, NULL);
+            break;
+        case 'd':
+            if (!strcmp(optarg, "fixed")) {
+                opts.fanout_dist = FANOUT_FIXED;
+            } else if (!strcmp(optarg, "uniform")) {
+                opts.fanout_dist = FANOUT_UNIFORM;
+            } else if (!strcmp(optarg, "exp")) {
+                opts.fanout_dist = FANOUT_EXP;
+            } else if (!strcmp(optarg, "power")) {
+                opts.fanout_dist = FANOUT_POWER;
+            } else {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'p':
+            opts.multi_parent = strtod(optarg, NULL);
+            break;
+        case 'k':
+            opts.nr_fields = atoi(optarg);
+            break;
+        case 'e':
+            opts.edge_density = strtod(optarg, NULL);
+            break;
+        case 'm':
+            if (parse_mix(optarg)) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'R':
+            opts.recorded = optarg;
+            break;
+        case 'o':
+            opts.nr_ops = strtoull(optarg, NULL, 10);
+            break;
+        case 's':
+            opts.seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'c':
+            opts.commit = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    for (size_t i = 0; i < NR_OP_TYPES; i++) {
+        total_weight += opts.weights[i];
+    }
+    if (opts.nr_nodes < 1 || opts.fanout < 1.0 || opts.nr_fields < 1 || opts.nr_ops < 1 ||
+        (!opts.recorded && total_weight == 0)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (opts.recorded) {
+        nr_recorded = read_recorded(opts.recorded, &recorded);
+        if (nr_recorded == 0) {
+            fprintf(stderr, "No known commands in %s\n", opts.recorded);
+            return EXIT_FAILURE;
+        }
+    }
+
+    rand_state = opts.seed;
+    field_names = calloc(opts.nr_fields, sizeof(*field_names));
+    for (int i = 0; i < opts.nr_fields; i++) {
+        snprintf(field_names[i], sizeof(field_names[i]), "f%d", i);
+    }
+
+    start = now_ns();
+    build_graph();
+    wall_ns = now_ns() - start;
+    printf("{\"suite\":\"workload\",\"name\":\"build\",\"commit\":\"%s\",\"nodes\":%zu,\"build_ms\":%.1f}\n",
+           opts.commit, nr_nodes, (double)wall_ns / 1e6);
+
+    rpn_ctx = rpn_init(1);
+    filter = rpn_compile("#500 \"f0\" g I"); /* f0 > 500 */
+    if (!rpn_ctx || !filter) {
+        abort();
+    }
+
+    lat_all = calloc(opts.nr_ops, sizeof(int64_t));
+    for (size_t i = 0; i < NR_OP_TYPES; i++) {
+        lat[i] = calloc(opts.nr_ops, sizeof(int64_t));
+        if (!lat[i]) {
+            abort();
+        }
+    }
+    if (!lat_all) {
+        abort();
+    }
+
+    start = now_ns();
+    for (size_t i = 0; i < opts.nr_ops; i++) {
+        const enum op_type op = recorded ? recorded[i % nr_recorded] : draw_op(total_weight);
+        const int64_t t0 = now_ns();
+        int64_t t;
+
+        run_op(op, rpn_ctx, filter);
+        t = now_ns() - t0;
+        lat[op][nr_lat[op]++] = t;
+        lat_all[i] = t;
+    }
+    wall_ns = now_ns() - start;
+
+    print_result("all", lat_all, opts.nr_ops, wall_ns);
+    for (size_t i = 0; i < NR_OP_TYPES; i++) {
+        print_result(op_names[i], lat[i], nr_lat[i], 0);
+    }
+
+    rpn_destroy_expression(filter);
+    rpn_destroy(rpn_ctx);
+    SelvaModify_DestroyHierarchy(graph);
+    for (size_t i = 0; i < NR_OP_TYPES; i++) {
+        free(lat[i]);
+    }
+    free(lat_all);
+    free(nodes);
+    free(field_names);
+    free(recorded);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,34 @@
+TOOL_SRC += workload.c
+SRC-workload += ../redis-alloc.c ../redis-timer.c ../hierarchy-utils.c ../hierarchy_inactive-mock.c ../find-index-mock.c ../inherit-mock.c ../find_cache-mock.c ../redis-rdb.c ../subscriptions-mock.c ../errors-mock.c ../hierarchy_detached-mock.c ../rms_compressor-mock.c
+SRC-workload += ../../lib/rmutil/sds.c
+SRC-workload += ../../lib/util/auto_free.c
+SRC-workload += ../../lib/util/cstrings.c
+SRC-workload += ../../lib/util/mempool.c
+SRC-workload += ../../lib/util/memrchr.c
+SRC-workload += ../../lib/util/svector.c
+SRC-workload += ../../lib/util/trx.c
+SRC-workload += ../../module/alias.c
+SRC-workload += ../../module/arg_parser.c
+SRC-workload += ../../module/comparator.c
+SRC-workload += ../../module/config.c
+SRC-workload += ../../module/edge/edge.c
+SRC-workload += ../../module/edge/edge_constraint.c
+SRC-workload += ../../module/errors.c
+SRC-workload += ../../module/hierarchy/field_set.c
+SRC-workload += ../../module/hierarchy/hierarchy.c
+SRC-workload += ../../module/hierarchy/types.c
+SRC-workload += ../../module/rms/shared.c
+SRC-workload += ../../module/rpn/rpn.c
+SRC-workload += ../../module/selva_log.c
+SRC-workload += ../../module/selva_object/selva_object.c
+SRC-workload += ../../module/selva_object/selva_object_foreach.c
+SRC-workload += ../../module/selva_set/field_has.c
+SRC-workload += ../../module/selva_set/fielda_in_fieldb.c
+SRC-workload += ../../module/selva_set/fielda_in_setb.c
+SRC-workload += ../../module/selva_set/selva_set.c
+SRC-workload += ../../module/selva_set/seta_in_fieldb.c
+SRC-workload += ../../module/selva_set/seta_in_setb.c
+SRC-workload += ../../module/selva_type.c
+SRC-workload += ../../module/timestamp.c
+SRC-workload += ../../module/selva_trace.c
+SRC-workload += ../../module/selva_memory.c
@@ -16,6 +16,10 @@ size_t Edge_Refcount(struct SelvaHierarchyNode *node) {
     return 0;
 }
 
+size_t Edge_MemUsage(const struct SelvaHierarchyNode *node) {
+    return 0;
+}
+
 void Edge_InitEdgeFieldConstraints(struct EdgeFieldConstraints *data) {
     memset(data, 0, sizeof(*data));
 }
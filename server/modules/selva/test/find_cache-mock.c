@@ -0,0 +1,11 @@
+#include "redismodule.h"
+#include "selva.h"
+#include "find_cache.h"
+
+void SelvaFindCache_Init(struct SelvaHierarchy *hierarchy) {
+    return;
+}
+
+void SelvaFindCache_Destroy(struct SelvaHierarchy *hierarchy) {
+    return;
+}
@@ -27,3 +27,14 @@ int SelvaHierarchy_ForeachInField(
         const struct SelvaObjectSetForeachCallback *cb) {
     return 0;
 }
+
+struct SelvaHierarchyNode *SelvaHierarchy_FindNode(SelvaHierarchy *hierarchy, const Selva_NodeId id) {
+    return NULL;
+}
+
+int SelvaHierarchy_IsDescendantOf(
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyNode *node,
+        struct SelvaHierarchyNode *ancestor) {
+    return 0;
+}
@@ -0,0 +1,11 @@
+#include "redismodule.h"
+#include "selva.h"
+#include "inherit.h"
+
+void Inherit_InvalidateCache(struct SelvaHierarchy *hierarchy) {
+    return;
+}
+
+void Inherit_DestroyCache(struct SelvaHierarchy *hierarchy) {
+    return;
+}
@@ -226,6 +226,14 @@ static int _RedisModule_GetContextFlags(RedisModuleCtx *ctx) {
     return redis_mock_ctx_flags;
 }
 
+static int _RedisModule_Fork(RedisModuleForkDoneHandler cb, void *user_data) {
+    return -1;
+}
+
+static int _RedisModule_ExitFromChild(int retcode) {
+    exit(retcode);
+}
+
 static void _RedisModule_LogIOError(RedisModuleIO *io, const char *level, const char *fmt, ...) {
     va_list args;
 
@@ -253,4 +261,6 @@ void (*RedisModule_SaveDouble)(RedisModuleIO *io, double value) = _RedisModule_S
 double (*RedisModule_LoadDouble)(RedisModuleIO *io) = _RedisModule_LoadDouble;
 RedisModuleCtx * (*RedisModule_GetContextFromIO)(RedisModuleIO *io) = _RedisModule_GetContextFromIO;
 int (*RedisModule_GetContextFlags)(RedisModuleCtx *ctx) = _RedisModule_GetContextFlags;
+int (*RedisModule_Fork)(RedisModuleForkDoneHandler cb, void *user_data) = _RedisModule_Fork;
+int (*RedisModule_ExitFromChild)(int retcode) = _RedisModule_ExitFromChild;
 void (*RedisModule_LogIOError)(RedisModuleIO *io, const char *levelstr, const char *fmt, ...) = _RedisModule_LogIOError;
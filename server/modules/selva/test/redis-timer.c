@@ -8,5 +8,20 @@ static int _RedisModule_StopTimerUnsafe(RedisModuleTimerID id, void **data) {
     return 0;
 }
 
+static RedisModuleBlockedClient *_RedisModule_BlockClient(RedisModuleCtx *ctx, RedisModuleCmdFunc reply_callback, RedisModuleCmdFunc timeout_callback, void (*free_privdata)(RedisModuleCtx*,void*), long long timeout_ms) {
+    return NULL;
+}
+
+static int _RedisModule_UnblockClient(RedisModuleBlockedClient *bc, void *privdata) {
+    return REDISMODULE_OK;
+}
+
+static void *_RedisModule_GetBlockedClientPrivateData(RedisModuleCtx *ctx) {
+    return NULL;
+}
+
 RedisModuleTimerID (*RedisModule_CreateTimer)(RedisModuleCtx *ctx, mstime_t period, RedisModuleTimerProc callback, void *data) = _RedisModule_CreateTimer;
 int (*RedisModule_StopTimerUnsafe)(RedisModuleTimerID id, void **data) = _RedisModule_StopTimerUnsafe;
+RedisModuleBlockedClient *(*RedisModule_BlockClient)(RedisModuleCtx *ctx, RedisModuleCmdFunc reply_callback, RedisModuleCmdFunc timeout_callback, void (*free_privdata)(RedisModuleCtx*,void*), long long timeout_ms) = _RedisModule_BlockClient;
+int (*RedisModule_UnblockClient)(RedisModuleBlockedClient *bc, void *privdata) = _RedisModule_UnblockClient;
+void *(*RedisModule_GetBlockedClientPrivateData)(RedisModuleCtx *ctx) = _RedisModule_GetBlockedClientPrivateData;
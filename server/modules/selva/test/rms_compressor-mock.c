@@ -1,5 +1,7 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include "redismodule.h"
+#include "jemalloc.h"
 #include "rms.h"
 
 int rms_compress(struct compressed_rms *out, RedisModuleString *in, double *cratio) {
@@ -22,3 +24,11 @@ void rms_RDBSaveCompressed(RedisModuleIO *io, struct compressed_rms *compressed)
 void rms_RDBLoadCompressed(RedisModuleIO *io, struct compressed_rms *compressed) {
     return;
 }
+
+int rms_fwrite_compressed(const struct compressed_rms *compressed, FILE *fp) {
+    return 0;
+}
+
+int rms_fread_compressed(struct compressed_rms *compressed, FILE *fp) {
+    return 0;
+}
@@ -32,6 +32,13 @@ void SelvaSubscriptions_ClearAllMarkers(
     return;
 }
 
+void SelvaSubscriptions_ClearAllMarkersOnDelete(
+        struct RedisModuleCtx *ctx,
+        struct SelvaHierarchy *hierarchy,
+        struct SelvaHierarchyNode *node) {
+    return;
+}
+
 int SelvaSubscriptions_hasActiveMarkers(const struct SelvaHierarchyMetadata *node_metadata) {
     return 0;
 }
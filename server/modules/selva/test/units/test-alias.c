@@ -0,0 +1,166 @@
+#include <punit.h>
+#include <stdlib.h>
+#include <string.h>
+#include "redismodule.h"
+#include "selva.h"
+#include "hierarchy.h"
+#include "selva_object.h"
+#include "alias.h"
+#include "cdefs.h"
+#include "../hierarchy-utils.h"
+
+static void setup(void)
+{
+    hierarchy = SelvaModify_NewHierarchy(NULL);
+}
+
+static void teardown(void)
+{
+    SelvaModify_DestroyHierarchy(hierarchy);
+    hierarchy = NULL;
+}
+
+static void create_node(const char *id)
+{
+    Selva_NodeId node_id;
+
+    Selva_NodeIdCpy(node_id, id);
+    (void)SelvaModify_SetHierarchy(NULL, hierarchy, node_id, 0, NULL, 0, NULL, NULL);
+}
+
+static struct SelvaObject *get_obj(const char *id)
+{
+    Selva_NodeId node_id;
+
+    Selva_NodeIdCpy(node_id, id);
+    return SelvaHierarchy_GetNodeObject(SelvaHierarchy_FindNode(hierarchy, node_id));
+}
+
+/**
+ * Add an alias like modify does it.
+ */
+static void add_alias(const char *id, const char *name)
+{
+    Selva_NodeId node_id;
+    RedisModuleString *field = RedisModule_CreateString(NULL, SELVA_ALIASES_FIELD, sizeof(SELVA_ALIASES_FIELD) - 1);
+    RedisModuleString *ref = RedisModule_CreateString(NULL, name, strlen(name));
+
+    Selva_NodeIdCpy(node_id, id);
+    SelvaObject_AddStringSet(get_obj(id), field, ref);
+    update_alias(hierarchy, node_id, ref);
+    RedisModule_FreeString(NULL, field);
+}
+
+static int has_node_alias(const char *id, const char *name)
+{
+    RedisModuleString *ref = RedisModule_CreateString(NULL, name, strlen(name));
+    struct SelvaSet *set;
+    int res;
+
+    set = SelvaObject_GetSetStr(get_obj(id), SELVA_ALIASES_FIELD, sizeof(SELVA_ALIASES_FIELD) - 1);
+    res = set && SelvaSet_Has(set, ref);
+    RedisModule_FreeString(NULL, ref);
+
+    return res;
+}
+
+static char * test_get_missing(void)
+{
+    Selva_NodeId node_id;
+
+    pu_assert_equal("not found", get_alias(hierarchy, "nope", 4, node_id), SELVA_ENOENT);
+
+    return NULL;
+}
+
+static char * test_add_and_get(void)
+{
+    Selva_NodeId node_id;
+
+    create_node("ab1");
+    create_node("ab2");
+    add_alias("ab1", "first");
+    add_alias("ab1", "second");
+    add_alias("ab2", "third");
+
+    pu_assert_equal("nr_aliases", hierarchy->aliases.nr_aliases, 3);
+    pu_assert_equal("found", get_alias(hierarchy, "first", 5, node_id), 0);
+    pu_assert_str_equal("ab1", node_id, "ab1");
+    pu_assert_equal("found", get_alias(hierarchy, "second", 6, node_id), 0);
+    pu_assert_str_equal("ab1", node_id, "ab1");
+    pu_assert_equal("found", get_alias(hierarchy, "third", 5, node_id), 0);
+    pu_assert_str_equal("ab2", node_id, "ab2");
+    pu_assert_equal("prefix not found", get_alias(hierarchy, "firs", 4, node_id), SELVA_ENOENT);
+
+    return NULL;
+}
+
+static char * test_move_alias(void)
+{
+    Selva_NodeId node_id;
+
+    create_node("ab1");
+    create_node("ab2");
+    add_alias("ab1", "name");
+    add_alias("ab2", "name");
+
+    pu_assert_equal("nr_aliases", hierarchy->aliases.nr_aliases, 1);
+    pu_assert_equal("found", get_alias(hierarchy, "name", 4, node_id), 0);
+    pu_assert_str_equal("moved", node_id, "ab2");
+    pu_assert("removed from the old node", !has_node_alias("ab1", "name"));
+    pu_assert("added to the new node", has_node_alias("ab2", "name"));
+
+    return NULL;
+}
+
+static char * test_delete_node(void)
+{
+    Selva_NodeId node_id;
+
+    create_node("ab1");
+    create_node("ab2");
+    add_alias("ab1", "a");
+    add_alias("ab1", "b");
+    add_alias("ab2", "c");
+
+    SelvaModify_DelHierarchyNode(NULL, hierarchy, ((Selva_NodeId){ "ab1" }), 0);
+
+    pu_assert_equal("nr_aliases", hierarchy->aliases.nr_aliases, 1);
+    pu_assert_equal("deleted", get_alias(hierarchy, "a", 1, node_id), SELVA_ENOENT);
+    pu_assert_equal("deleted", get_alias(hierarchy, "b", 1, node_id), SELVA_ENOENT);
+    pu_assert_equal("kept", get_alias(hierarchy, "c", 1, node_id), 0);
+    pu_assert_str_equal("ab2", node_id, "ab2");
+
+    return NULL;
+}
+
+static char * test_delete_aliases_owner(void)
+{
+    RedisModuleString *ref = RedisModule_CreateString(NULL, "x", 1);
+    struct SelvaSet set;
+    Selva_NodeId node_id;
+
+    create_node("ab1");
+    add_alias("ab1", "x");
+
+    SelvaSet_Init(&set, SELVA_SET_TYPE_RMSTRING);
+    SelvaSet_Add(&set, ref);
+
+    pu_assert_equal("ok", delete_aliases(hierarchy, ((Selva_NodeId){ "ab2" }), &set), 0);
+    pu_assert_equal("not owned, kept", get_alias(hierarchy, "x", 1, node_id), 0);
+    pu_assert_equal("ok", delete_aliases(hierarchy, ((Selva_NodeId){ "ab1" }), &set), 0);
+    pu_assert_equal("deleted", get_alias(hierarchy, "x", 1, node_id), SELVA_ENOENT);
+
+    SelvaSet_Destroy(&set);
+
+    return NULL;
+}
+
+void all_tests(void)
+{
+    pu_def_test(test_get_missing, PU_RUN);
+    pu_def_test(test_add_and_get, PU_RUN);
+    pu_def_test(test_move_alias, PU_RUN);
+    pu_def_test(test_delete_node, PU_RUN);
+    pu_def_test(test_delete_aliases_owner, PU_RUN);
+}
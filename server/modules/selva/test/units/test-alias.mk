@@ -0,0 +1,24 @@
+TEST_SRC += test-alias.c
+SRC-alias += ../redis-alloc.c ../redis-timer.c ../hierarchy-utils.c ../hierarchy_inactive-mock.c ../find-index-mock.c ../inherit-mock.c ../find_cache-mock.c ../redis-rdb.c ../rpn-mock.c ../edge-mock.c ../subscriptions-mock.c ../errors-mock.c ../hierarchy_detached-mock.c ../rms_compressor-mock.c
+SRC-alias += ../../lib/rmutil/sds.c
+SRC-alias += ../../lib/util/auto_free.c
+SRC-alias += ../../lib/util/cstrings.c
+SRC-alias += ../../lib/util/mempool.c
+SRC-alias += ../../lib/util/memrchr.c
+SRC-alias += ../../lib/util/svector.c
+SRC-alias += ../../lib/util/trx.c
+SRC-alias += ../../module/alias.c
+SRC-alias += ../../module/arg_parser.c
+SRC-alias += ../../module/config.c
+SRC-alias += ../../module/errors.c
+SRC-alias += ../../module/hierarchy/hierarchy.c
+SRC-alias += ../../module/hierarchy/types.c
+SRC-alias += ../../module/rms/shared.c
+SRC-alias += ../../module/selva_log.c
+SRC-alias += ../../module/selva_object/selva_object.c
+SRC-alias += ../../module/selva_object/selva_object_foreach.c
+SRC-alias += ../../module/selva_set/selva_set.c
+SRC-alias += ../../module/selva_type.c
+SRC-alias += ../../module/timestamp.c
+SRC-alias += ../../module/selva_trace.c
+SRC-alias += ../../module/selva_memory.c
@@ -1,9 +1,12 @@
 #include <punit.h>
 #include <stdlib.h>
+#include <string.h>
 #include "hierarchy.h"
 #include "edge.h"
 #include "../hierarchy-utils.h"
 
+static RedisModuleCtx ctx;
+
 static void setup(void)
 {
     hierarchy = SelvaModify_NewHierarchy(NULL);
@@ -36,14 +39,14 @@ static char * test_alter_edge_relationship(void)
     SelvaModify_SetHierarchy(NULL, hierarchy, "grphnode_d", 0, NULL, 0, NULL, NULL);
 
     /* Add edges. */
-    pu_assert("Add edge", !Edge_Add(NULL, hierarchy, 0, "a", 1, SelvaHierarchy_FindNode(hierarchy, "grphnode_a"), SelvaHierarchy_FindNode(hierarchy, "grphnode_c")));
-    pu_assert("Add edge", !Edge_Add(NULL, hierarchy, 0, "a", 1, SelvaHierarchy_FindNode(hierarchy, "grphnode_b"), SelvaHierarchy_FindNode(hierarchy, "grphnode_d")));
+    pu_assert("Add edge", !Edge_Add(&ctx, hierarchy, 0, "a", 1, SelvaHierarchy_FindNode(hierarchy, "grphnode_a"), SelvaHierarchy_FindNode(hierarchy, "grphnode_c")));
+    pu_assert("Add edge", !Edge_Add(&ctx, hierarchy, 0, "a", 1, SelvaHierarchy_FindNode(hierarchy, "grphnode_b"), SelvaHierarchy_FindNode(hierarchy, "grphnode_d")));
 
     pu_assert_equal("a.a has c", Edge_Has(Edge_GetField(SelvaHierarchy_FindNode(hierarchy, "grphnode_a"), "a", 1), SelvaHierarchy_FindNode(hierarchy, "grphnode_c")), 1);
     pu_assert_equal("b.a has d", Edge_Has(Edge_GetField(SelvaHierarchy_FindNode(hierarchy, "grphnode_b"), "a", 1), SelvaHierarchy_FindNode(hierarchy, "grphnode_d")), 1);
 
     /* Alter edges. */
-    pu_assert("Add edge", !Edge_Add(NULL, hierarchy, 0, "a", 1, SelvaHierarchy_FindNode(hierarchy, "grphnode_b"), SelvaHierarchy_FindNode(hierarchy, "grphnode_c")));
+    pu_assert("Add edge", !Edge_Add(&ctx, hierarchy, 0, "a", 1, SelvaHierarchy_FindNode(hierarchy, "grphnode_b"), SelvaHierarchy_FindNode(hierarchy, "grphnode_c")));
 
     pu_assert_equal("a.a has c", Edge_Has(Edge_GetField(SelvaHierarchy_FindNode(hierarchy, "grphnode_a"), "a", 1), SelvaHierarchy_FindNode(hierarchy, "grphnode_c")), 1);
     pu_assert_equal("b.a has c", Edge_Has(Edge_GetField(SelvaHierarchy_FindNode(hierarchy, "grphnode_b"), "a", 1), SelvaHierarchy_FindNode(hierarchy, "grphnode_c")), 1);
@@ -60,8 +63,8 @@ static char * test_delete_edge(void)
     SelvaModify_SetHierarchy(NULL, hierarchy, "grphnode_c", 0, NULL, 0, NULL, NULL);
 
     /* Add edges. */
-    pu_assert("Add edge", !Edge_Add(NULL, hierarchy, 0, "a", 1, SelvaHierarchy_FindNode(hierarchy, "grphnode_a"), SelvaHierarchy_FindNode(hierarchy, "grphnode_b")));
-    pu_assert("Add edge", !Edge_Add(NULL, hierarchy, 0, "a", 1, SelvaHierarchy_FindNode(hierarchy, "grphnode_a"), SelvaHierarchy_FindNode(hierarchy, "grphnode_c")));
+    pu_assert("Add edge", !Edge_Add(&ctx, hierarchy, 0, "a", 1, SelvaHierarchy_FindNode(hierarchy, "grphnode_a"), SelvaHierarchy_FindNode(hierarchy, "grphnode_b")));
+    pu_assert("Add edge", !Edge_Add(&ctx, hierarchy, 0, "a", 1, SelvaHierarchy_FindNode(hierarchy, "grphnode_a"), SelvaHierarchy_FindNode(hierarchy, "grphnode_c")));
 
     /* Delete an edge. */
     struct SelvaHierarchyNode *node_a = SelvaHierarchy_FindNode(hierarchy, "grphnode_a");
@@ -73,8 +76,134 @@ static char * test_delete_edge(void)
     return NULL;
 }
 
+/*
+ *  a.x ---> b.x ---> c.x ---> d
+ *                     \.x --> f
+ *  a.y ---> e.y ------------> d
+ *  g
+ */
+static void create_graph(void)
+{
+    static const char * const ids[] = {
+        "grphnode_a", "grphnode_b", "grphnode_c", "grphnode_d",
+        "grphnode_e", "grphnode_f", "grphnode_g",
+    };
+    static const char * const edges[][3] = {
+        { "grphnode_a", "x", "grphnode_b" },
+        { "grphnode_b", "x", "grphnode_c" },
+        { "grphnode_c", "x", "grphnode_d" },
+        { "grphnode_c", "x", "grphnode_f" },
+        { "grphnode_a", "y", "grphnode_e" },
+        { "grphnode_e", "y", "grphnode_d" },
+    };
+
+    for (size_t i = 0; i < num_elem(ids); i++) {
+        SelvaModify_SetHierarchy(NULL, hierarchy, ids[i], 0, NULL, 0, NULL, NULL);
+    }
+
+    for (size_t i = 0; i < num_elem(edges); i++) {
+        Edge_Add(&ctx, hierarchy, 0, edges[i][1], 1,
+                 SelvaHierarchy_FindNode(hierarchy, edges[i][0]),
+                 SelvaHierarchy_FindNode(hierarchy, edges[i][2]));
+    }
+}
+
+static char *path_to_str(char *buf, SVector *path)
+{
+    struct SVectorIterator it;
+    struct SelvaHierarchyNode *node;
+
+    buf[0] = '\0';
+    SVector_ForeachBegin(&it, path);
+    while ((node = SVector_Foreach(&it))) {
+        Selva_NodeId id;
+
+        SelvaHierarchy_GetNodeId(id, node);
+        strncat(buf, id + 9, 1);
+    }
+
+    return buf;
+}
+
+static char * test_shortest_path(void)
+{
+    static const struct {
+        const char *src;
+        const char *dst;
+        const char *fields;
+        const char *expected;
+    } cases[] = {
+        { "grphnode_a", "grphnode_d", "x", "abcd" },
+        { "grphnode_a", "grphnode_d", "x\ny", "aed" },
+        { "grphnode_a", "grphnode_f", "y\nx", "abcf" },
+        { "grphnode_b", "grphnode_f", "x", "bcf" },
+        { "grphnode_a", "grphnode_a", "x", "a" },
+        { "grphnode_d", "grphnode_a", "x\ny", "" },
+        { "grphnode_a", "grphnode_g", "x\ny", "" },
+        { "grphnode_a", "grphnode_d", "z", "" },
+    };
+    char buf[16];
+
+    create_graph();
+
+    for (size_t i = 0; i < num_elem(cases); i++) {
+        SVECTOR_AUTOFREE(path);
+        int err;
+
+        SVector_Init(&path, 0, NULL);
+        err = SelvaHierarchy_EdgeShortestPath(NULL, hierarchy, cases[i].src, cases[i].dst, cases[i].fields, strlen(cases[i].fields), NULL, NULL, &path);
+        pu_assert_equal("no error", err, 0);
+        pu_assert_str_equal("correct path", path_to_str(buf, &path), cases[i].expected);
+    }
+
+    return NULL;
+}
+
+static int collect_node_cb(struct RedisModuleCtx *ctx, struct SelvaHierarchy *hierarchy, struct SelvaHierarchyNode *node, void *arg) {
+    char *buf = (char *)arg;
+    Selva_NodeId id;
+
+    SelvaHierarchy_GetNodeId(id, node);
+    strncat(buf, id + 9, 1);
+
+    return 0;
+}
+
+static char * test_khop(void)
+{
+    char buf[16];
+    const struct SelvaHierarchyCallback cb = {
+        .node_cb = collect_node_cb,
+        .node_arg = buf,
+    };
+
+    create_graph();
+
+    buf[0] = '\0';
+    pu_assert_equal("no error", SelvaHierarchy_TraverseEdgeFieldsBfs(NULL, hierarchy, "grphnode_a", "x\ny", 3, 0, NULL, NULL, &cb), 0);
+    pu_assert_str_equal("0 hops", buf, "a");
+
+    buf[0] = '\0';
+    pu_assert_equal("no error", SelvaHierarchy_TraverseEdgeFieldsBfs(NULL, hierarchy, "grphnode_a", "x\ny", 3, 1, NULL, NULL, &cb), 0);
+    pu_assert_str_equal("1 hop", buf, "abe");
+
+    buf[0] = '\0';
+    pu_assert_equal("no error", SelvaHierarchy_TraverseEdgeFieldsBfs(NULL, hierarchy, "grphnode_a", "x\ny", 3, 2, NULL, NULL, &cb), 0);
+    pu_assert_str_equal("2 hops", buf, "abecd");
+
+    buf[0] = '\0';
+    pu_assert_equal("no error", SelvaHierarchy_TraverseEdgeFieldsBfs(NULL, hierarchy, "grphnode_a", "x", 1, 10, NULL, NULL, &cb), 0);
+    pu_assert_str_equal("all over x", buf, "abcdf");
+
+    pu_assert_equal("missing node", SelvaHierarchy_TraverseEdgeFieldsBfs(NULL, hierarchy, "grphnode_z", "x", 1, 10, NULL, NULL, &cb), SELVA_HIERARCHY_ENOENT);
+
+    return NULL;
+}
+
 void all_tests(void)
 {
     pu_def_test(test_alter_edge_relationship, PU_RUN);
     pu_def_test(test_delete_edge, PU_RUN);
+    pu_def_test(test_shortest_path, PU_RUN);
+    pu_def_test(test_khop, PU_RUN);
 }
@@ -1,5 +1,5 @@
 TEST_SRC += test-edge.c
-SRC-edge += ../redis-alloc.c ../redis-timer.c ../hierarchy-utils.c ../hierarchy_inactive-mock.c ../find-index-mock.c ../redis-rdb.c ../rpn-mock.c ../subscriptions-mock.c ../errors-mock.c ../hierarchy_detached-mock.c ../rms_compressor-mock.c
+SRC-edge += ../redis-alloc.c ../redis-timer.c ../hierarchy-utils.c ../hierarchy_inactive-mock.c ../find-index-mock.c ../inherit-mock.c ../find_cache-mock.c ../redis-rdb.c ../rpn-mock.c ../subscriptions-mock.c ../errors-mock.c ../hierarchy_detached-mock.c ../rms_compressor-mock.c
 SRC-edge += ../../lib/rmutil/sds.c
 SRC-edge += ../../lib/util/auto_free.c
 SRC-edge += ../../lib/util/cstrings.c
@@ -23,3 +23,5 @@ SRC-edge += ../../module/selva_object/selva_object_foreach.c
 SRC-edge += ../../module/selva_set/selva_set.c
 SRC-edge += ../../module/selva_type.c
 SRC-edge += ../../module/timestamp.c
+SRC-edge += ../../module/selva_trace.c
+SRC-edge += ../../module/selva_memory.c
@@ -0,0 +1,129 @@
+#include <punit.h>
+#include <stdint.h>
+#include <string.h>
+#include "jemalloc.h"
+#include "selva.h"
+#include "traversal.h"
+#include "find_cursor.h"
+
+static struct FindCursor cursor;
+
+static void setup(void)
+{
+    memset(&cursor, 0, sizeof(cursor));
+}
+
+static void teardown(void)
+{
+    FindCursor_Destroy(&cursor);
+}
+
+static char * test_pos(void)
+{
+    char *s;
+    size_t len;
+    int err;
+
+    s = FindCursor_EncodePos(42, 1337, 3, &len);
+    pu_assert("cursor created", s);
+    pu_assert_equal("len", len, strlen(s));
+
+    err = FindCursor_Decode(&cursor, s, len);
+    selva_free(s);
+    pu_assert_equal("decoded", err, 0);
+    pu_assert_equal("type", cursor.type, FIND_CURSOR_TYPE_POS);
+    pu_assert_equal("generation", cursor.generation, 42);
+    pu_assert_equal("state_id", cursor.state_id, 1337);
+    pu_assert_equal("head", cursor.head, 3);
+    pu_assert_ptr_equal("no item", cursor.item, NULL);
+
+    return NULL;
+}
+
+static char * test_key_double(void)
+{
+    struct TraversalOrderItem item = {
+        .type = ORDER_ITEM_TYPE_DOUBLE,
+        .node_id = "ma00000001",
+        .d = 3.14,
+    };
+    char *s;
+    size_t len;
+    int err;
+
+    s = FindCursor_EncodeKey(1, &item, &len);
+    pu_assert("cursor created", s);
+
+    err = FindCursor_Decode(&cursor, s, len);
+    selva_free(s);
+    pu_assert_equal("decoded", err, 0);
+    pu_assert_equal("type", cursor.type, FIND_CURSOR_TYPE_KEY);
+    pu_assert("item", cursor.item);
+    pu_assert_equal("item type", cursor.item->type, ORDER_ITEM_TYPE_DOUBLE);
+    pu_assert_equal("d", cursor.item->d, 3.14);
+    pu_assert("node_id", !memcmp(cursor.item->node_id, "ma00000001", SELVA_NODE_ID_SIZE));
+    pu_assert_str_equal("no data", cursor.item->data, "");
+
+    return NULL;
+}
+
+static char * test_key_text(void)
+{
+    const char text[] = "hello world";
+    struct TraversalOrderItem *item = selva_calloc(1, sizeof(struct TraversalOrderItem) + sizeof(text));
+    char *s;
+    size_t len;
+    int err;
+
+    item->type = ORDER_ITEM_TYPE_TEXT;
+    memcpy(item->node_id, "ma00000002", SELVA_NODE_ID_SIZE);
+    memcpy(item->data, text, sizeof(text));
+
+    s = FindCursor_EncodeKey(1, item, &len);
+    selva_free(item);
+    pu_assert("cursor created", s);
+
+    err = FindCursor_Decode(&cursor, s, len);
+    selva_free(s);
+    pu_assert_equal("decoded", err, 0);
+    pu_assert_equal("type", cursor.type, FIND_CURSOR_TYPE_KEY);
+    pu_assert_equal("item type", cursor.item->type, ORDER_ITEM_TYPE_TEXT);
+    pu_assert("node_id", !memcmp(cursor.item->node_id, "ma00000002", SELVA_NODE_ID_SIZE));
+    pu_assert_str_equal("data", cursor.item->data, text);
+
+    return NULL;
+}
+
+static char * test_invalid(void)
+{
+    char *s;
+    size_t len;
+    int err;
+
+    err = FindCursor_Decode(&cursor, "hello", 5);
+    pu_assert_equal("not base64", err, SELVA_EINVAL);
+
+    err = FindCursor_Decode(&cursor, "AAAA", 4);
+    pu_assert_equal("too short", err, SELVA_EINVAL);
+
+    s = FindCursor_EncodePos(1, 2, 0, &len);
+    s[0] = 'B'; /* Change the version. */
+    err = FindCursor_Decode(&cursor, s, len);
+    pu_assert_equal("invalid version", err, SELVA_ENOTSUP);
+    selva_free(s);
+
+    s = FindCursor_EncodePos(1, 2, 0, &len);
+    err = FindCursor_Decode(&cursor, s, len - 4);
+    pu_assert_equal("truncated", err, SELVA_EINVAL);
+    selva_free(s);
+
+    return NULL;
+}
+
+void all_tests(void)
+{
+    pu_def_test(test_pos, PU_RUN);
+    pu_def_test(test_key_double, PU_RUN);
+    pu_def_test(test_key_text, PU_RUN);
+    pu_def_test(test_invalid, PU_RUN);
+}
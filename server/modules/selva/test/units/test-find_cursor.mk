@@ -0,0 +1,3 @@
+TEST_SRC += test-find_cursor.c
+SRC-find_cursor += ../../lib/util/base64.c
+SRC-find_cursor += ../../module/find_cursor.c
@@ -993,6 +993,410 @@ static char * test_del_node(void)
     return NULL;
 }
 
+static int is_descendant_of(const char *node_str, const char *ancestor_str)
+{
+    Selva_NodeId node_id;
+    Selva_NodeId ancestor_id;
+    struct SelvaHierarchyNode *node;
+    struct SelvaHierarchyNode *ancestor;
+
+    Selva_NodeIdCpy(node_id, node_str);
+    Selva_NodeIdCpy(ancestor_id, ancestor_str);
+    node = SelvaHierarchy_FindNode(hierarchy, node_id);
+    ancestor = SelvaHierarchy_FindNode(hierarchy, ancestor_id);
+    if (!node || !ancestor) {
+        return -1;
+    }
+
+    return SelvaHierarchy_IsDescendantOf(hierarchy, node, ancestor);
+}
+
+static char * test_is_descendant_of(void)
+{
+    /*
+     *  a --> c --> e
+     *     /
+     *  b --> d
+     */
+
+    SelvaModify_SetHierarchy(NULL, hierarchy, "grphnode_a", 0, NULL, 0, NULL, NULL);
+    SelvaModify_SetHierarchy(NULL, hierarchy, "grphnode_b", 0, NULL, 0, NULL, NULL);
+    SelvaModify_SetHierarchy(NULL, hierarchy, "grphnode_c", 2, ((Selva_NodeId []){ "grphnode_a", "grphnode_b" }), 0, NULL, NULL);
+    SelvaModify_SetHierarchy(NULL, hierarchy, "grphnode_d", 1, ((Selva_NodeId []){ "grphnode_b" }), 0, NULL, NULL);
+    SelvaModify_SetHierarchy(NULL, hierarchy, "grphnode_e", 1, ((Selva_NodeId []){ "grphnode_c" }), 0, NULL, NULL);
+
+    pu_assert_equal("c is under a", is_descendant_of("grphnode_c", "grphnode_a"), 1);
+    pu_assert_equal("c is under b", is_descendant_of("grphnode_c", "grphnode_b"), 1);
+    pu_assert_equal("e is under a", is_descendant_of("grphnode_e", "grphnode_a"), 1);
+    pu_assert_equal("e is under b", is_descendant_of("grphnode_e", "grphnode_b"), 1);
+    pu_assert_equal("d is not under a", is_descendant_of("grphnode_d", "grphnode_a"), 0);
+    pu_assert_equal("a is not under c", is_descendant_of("grphnode_a", "grphnode_c"), 0);
+    pu_assert_equal("e is not under d", is_descendant_of("grphnode_e", "grphnode_d"), 0);
+    pu_assert_equal("a is not under a", is_descendant_of("grphnode_a", "grphnode_a"), 0);
+
+    /*
+     *  a     c --> e
+     *     /
+     *  b --> d
+     */
+    SelvaModify_DelHierarchy(NULL, hierarchy, "grphnode_c", 1, ((Selva_NodeId []){ "grphnode_a" }), 0, NULL);
+
+    pu_assert_equal("c is not under a", is_descendant_of("grphnode_c", "grphnode_a"), 0);
+    pu_assert_equal("e is not under a", is_descendant_of("grphnode_e", "grphnode_a"), 0);
+    pu_assert_equal("e is under b", is_descendant_of("grphnode_e", "grphnode_b"), 1);
+
+    /*
+     *  a     c --> e
+     *     /         \
+     *  b --> d <-----
+     */
+    SelvaModify_AddHierarchy(NULL, hierarchy, "grphnode_d", 1, ((Selva_NodeId []){ "grphnode_e" }), 0, NULL);
+
+    pu_assert_equal("d is under c", is_descendant_of("grphnode_d", "grphnode_c"), 1);
+    pu_assert_equal("d is under b", is_descendant_of("grphnode_d", "grphnode_b"), 1);
+    pu_assert_equal("d is not under a", is_descendant_of("grphnode_d", "grphnode_a"), 0);
+
+    /*
+     *  a     c
+     *     /
+     *  b --> d
+     */
+    SelvaModify_DelHierarchyNode(NULL, hierarchy, ((Selva_NodeId){ "grphnode_e" }), 0);
+
+    pu_assert_equal("d is not under c", is_descendant_of("grphnode_d", "grphnode_c"), 0);
+    pu_assert_equal("d is under b", is_descendant_of("grphnode_d", "grphnode_b"), 1);
+
+    return NULL;
+}
+
+static char * test_is_descendant_of_wide(void)
+{
+    const int nr_children = 5000;
+
+    SelvaModify_SetHierarchy(NULL, hierarchy, "grphnode_a", 0, NULL, 0, NULL, NULL);
+    SelvaModify_SetHierarchy(NULL, hierarchy, "grphnode_b", 1, ((Selva_NodeId []){ "grphnode_a" }), 0, NULL, NULL);
+    pu_assert_equal("b is under a", is_descendant_of("grphnode_b", "grphnode_a"), 1);
+
+    for (int i = 0; i < nr_children; i++) {
+        char buf[SELVA_NODE_ID_SIZE + 1];
+
+        snprintf(buf, sizeof(buf), "ma%08d", i);
+        SelvaModify_SetHierarchy(NULL, hierarchy, buf, 1, ((Selva_NodeId []){ "grphnode_b" }), 0, NULL, NULL);
+    }
+
+    pu_assert_equal("labels are not rebuilt", hierarchy->reach.dirty, 0);
+    pu_assert_equal("first child is under a", is_descendant_of("ma00000000", "grphnode_a"), 1);
+    pu_assert_equal("last child is under b", is_descendant_of("ma00004999", "grphnode_b"), 1);
+
+    /*
+     * A rebuild must leave enough free label space for the large subtrees
+     * so that inserting can continue incrementally.
+     */
+    int nr_relabels = 0;
+    hierarchy->reach.dirty = 1;
+    pu_assert_equal("relabeled", is_descendant_of("ma00000000", "grphnode_a"), 1);
+
+    for (int i = nr_children; i < 2 * nr_children; i++) {
+        char buf[SELVA_NODE_ID_SIZE + 1];
+        Selva_NodeId parent;
+
+        snprintf(buf, sizeof(buf), "ma%08d", i);
+        SelvaModify_SetHierarchy(NULL, hierarchy, buf, 1, ((Selva_NodeId []){ "grphnode_b" }), 0, NULL, NULL);
+        snprintf(buf, sizeof(buf), "ma%08d", i - nr_children);
+        memcpy(parent, buf, SELVA_NODE_ID_SIZE);
+        snprintf(buf, sizeof(buf), "mb%08d", i);
+        SelvaModify_SetHierarchy(NULL, hierarchy, buf, 1, &parent, 0, NULL, NULL);
+
+        if (hierarchy->reach.dirty) {
+            nr_relabels++;
+            (void)is_descendant_of(buf, "grphnode_a");
+        }
+    }
+
+    pu_assert_equal("labels are not rebuilt after a relabel", nr_relabels, 0);
+    pu_assert_equal("new child is under b", is_descendant_of("ma00009999", "grphnode_b"), 1);
+    pu_assert_equal("grandchild is under a", is_descendant_of("mb00009999", "grphnode_a"), 1);
+    pu_assert_equal("grandchild is under its parent", is_descendant_of("mb00009999", "ma00004999"), 1);
+    pu_assert_equal("grandchild is not under a sibling", is_descendant_of("mb00009999", "ma00004998"), 0);
+
+    return NULL;
+}
+
+static char * test_is_descendant_of_random(void)
+{
+#define NR_NODES 40
+    Selva_NodeId ids[NR_NODES];
+
+    srand(1);
+
+    for (int i = 0; i < NR_NODES; i++) {
+        char buf[SELVA_NODE_ID_SIZE + 1];
+
+        snprintf(buf, sizeof(buf), "nd%08d", i);
+        memcpy(ids[i], buf, SELVA_NODE_ID_SIZE);
+        SelvaModify_SetHierarchy(NULL, hierarchy, ids[i], 0, NULL, 0, NULL, NULL);
+    }
+
+    for (int round = 0; round < 400; round++) {
+        const int a = rand() % NR_NODES;
+        const int b = rand() % NR_NODES;
+        const int parent = a < b ? a : b;
+        const int child = a < b ? b : a;
+        const int op = rand() % 10;
+
+        if (parent == child) {
+            continue;
+        }
+
+        /* Edges only go from a lower to a higher index to keep it acyclic. */
+        if (op < 6) {
+            SelvaModify_AddHierarchy(NULL, hierarchy, ids[child], 1, &ids[parent], 0, NULL);
+        } else if (op < 9) {
+            SelvaModify_DelHierarchy(NULL, hierarchy, ids[child], 1, &ids[parent], 0, NULL);
+        } else if (SelvaHierarchy_NodeExists(hierarchy, ids[parent])) {
+            SelvaModify_DelHierarchyNode(NULL, hierarchy, ids[parent], 0);
+        }
+
+        if (round % 20 != 0) {
+            continue;
+        }
+
+        for (int i = 0; i < NR_NODES; i++) {
+            struct SelvaHierarchyNode *node = SelvaHierarchy_FindNode(hierarchy, ids[i]);
+            ssize_t nr_ancestors;
+
+            if (!node) {
+                continue;
+            }
+
+            nr_ancestors = SelvaModify_FindAncestors(hierarchy, ids[i], &findRes);
+            pu_assert("ancestors found", nr_ancestors >= 0);
+
+            for (int j = 0; j < NR_NODES; j++) {
+                struct SelvaHierarchyNode *other = SelvaHierarchy_FindNode(hierarchy, ids[j]);
+                int expected = 0;
+
+                if (!other) {
+                    continue;
+                }
+
+                for (ssize_t k = 0; k < nr_ancestors; k++) {
+                    if (!memcmp(findRes[k], ids[j], SELVA_NODE_ID_SIZE)) {
+                        expected = 1;
+                        break;
+                    }
+                }
+
+                pu_assert_equal("reachability matches the traversal",
+                                SelvaHierarchy_IsDescendantOf(hierarchy, node, other), expected);
+            }
+
+            free(findRes);
+            findRes = NULL;
+        }
+    }
+#undef NR_NODES
+
+    return NULL;
+}
+
+static char * test_find_nodes_batch(void)
+{
+#define NR_NODES 1000
+#define NR_LOOKUPS 1000
+    Selva_NodeId *ids = calloc(NR_LOOKUPS, sizeof(Selva_NodeId));
+    struct SelvaHierarchyNode **nodes = calloc(NR_LOOKUPS, sizeof(struct SelvaHierarchyNode *));
+    char *exists = calloc(NR_LOOKUPS, sizeof(char));
+    size_t nr_expected = 0;
+    size_t nr_found;
+
+    srand(2);
+
+    for (int i = 0; i < NR_NODES; i++) {
+        Selva_NodeId id;
+        char buf[SELVA_NODE_ID_SIZE + 1];
+
+        snprintf(buf, sizeof(buf), "ma%08d", i);
+        memcpy(id, buf, SELVA_NODE_ID_SIZE);
+        SelvaModify_SetHierarchy(NULL, hierarchy, id, 0, NULL, 0, NULL, NULL);
+    }
+
+    /* Every fifth id is missing from the hierarchy. */
+    for (int i = 0; i < NR_LOOKUPS; i++) {
+        char buf[SELVA_NODE_ID_SIZE + 1];
+        const int missing = i % 5 == 0;
+
+        snprintf(buf, sizeof(buf), "%s%08d", missing ? "zz" : "ma", rand() % NR_NODES);
+        memcpy(ids[i], buf, SELVA_NODE_ID_SIZE);
+        nr_expected += !missing;
+    }
+
+    nr_found = SelvaHierarchy_FindNodes(hierarchy, ids, NR_LOOKUPS, nodes);
+    pu_assert_equal("found all existing nodes", nr_found, nr_expected);
+
+    for (int i = 0; i < NR_LOOKUPS; i++) {
+        pu_assert_ptr_equal("same result as a single lookup", nodes[i], SelvaHierarchy_FindNode(hierarchy, ids[i]));
+    }
+
+    nr_found = SelvaHierarchy_NodesExist(hierarchy, ids, NR_LOOKUPS, exists);
+    pu_assert_equal("all existing nodes exist", nr_found, nr_expected);
+
+    for (int i = 0; i < NR_LOOKUPS; i++) {
+        pu_assert_equal("exists if found", exists[i], !!nodes[i]);
+    }
+
+    free(ids);
+    free(nodes);
+    free(exists);
+#undef NR_NODES
+#undef NR_LOOKUPS
+
+    return NULL;
+}
+
+struct collect_args {
+    Selva_NodeId *ids;
+    size_t nr_ids;
+    size_t page_size; /*!< Stop after this many nodes; 0 = never stop. */
+    size_t page_left;
+};
+
+static int collect_node_cb(struct RedisModuleCtx *ctx, struct SelvaHierarchy *hierarchy, struct SelvaHierarchyNode *node, void *arg) {
+    struct collect_args *args = (struct collect_args *)arg;
+
+    SelvaHierarchy_GetNodeId(args->ids[args->nr_ids++], node);
+
+    return args->page_size > 0 && --args->page_left == 0;
+}
+
+static char * check_resume(const Selva_NodeId head_id, enum SelvaTraversal dir, size_t nr_nodes)
+{
+    struct collect_args full = {
+        .ids = calloc(nr_nodes, sizeof(Selva_NodeId)),
+    };
+    struct collect_args paged = {
+        .ids = calloc(nr_nodes, sizeof(Selva_NodeId)),
+        .page_size = 7,
+    };
+    const struct SelvaHierarchyCallback full_cb = {
+        .node_cb = collect_node_cb,
+        .node_arg = &full,
+    };
+    const struct SelvaHierarchyCallback paged_cb = {
+        .node_cb = collect_node_cb,
+        .node_arg = &paged,
+    };
+    const struct SelvaHierarchyResumeArgs resume_args = { 0 };
+    struct SelvaHierarchyResumable *state;
+    size_t nr_pages = 0;
+    int res;
+
+    (void)SelvaHierarchy_Traverse(NULL, hierarchy, head_id, dir, &full_cb);
+
+    state = SelvaHierarchy_NewResumable(dir, head_id);
+    pu_assert("state created", state);
+    do {
+        uint64_t id;
+
+        paged.page_left = paged.page_size;
+        res = SelvaHierarchy_TraverseResume(NULL, hierarchy, state, &resume_args, &paged_cb);
+        pu_assert("no error", res >= 0);
+
+        id = SelvaHierarchy_SaveResumable(hierarchy, state);
+        state = SelvaHierarchy_TakeResumable(hierarchy, id);
+        pu_assert("state taken", state);
+        nr_pages++;
+    } while (res == 0);
+    SelvaHierarchy_DestroyResumable(state);
+
+    pu_assert_equal("same number of nodes", paged.nr_ids, full.nr_ids);
+    pu_assert("same order", !memcmp(paged.ids, full.ids, full.nr_ids * sizeof(Selva_NodeId)));
+    pu_assert("paginated", nr_pages > 1);
+
+    free(full.ids);
+    free(paged.ids);
+
+    return NULL;
+}
+
+static char * test_traverse_resume(void)
+{
+    const size_t nr_nodes = 200;
+    const size_t nr_total = nr_nodes + 20 + 1;
+    Selva_NodeId ids[nr_nodes];
+    Selva_NodeId new_id = "ma_new____";
+    struct SelvaHierarchyResumable *state;
+    uint64_t id;
+    uint64_t next_id;
+    char *res;
+
+    srand(4);
+
+    for (size_t i = 0; i < nr_nodes; i++) {
+        char buf[SELVA_NODE_ID_SIZE + 1];
+        Selva_NodeId parents[2];
+        size_t nr_parents = 0;
+
+        snprintf(buf, sizeof(buf), "ma%08x", (unsigned)i);
+        memcpy(ids[i], buf, SELVA_NODE_ID_SIZE);
+
+        if (i == 0) {
+            memcpy(parents[nr_parents++], ROOT_NODE_ID, SELVA_NODE_ID_SIZE);
+        } else {
+            memcpy(parents[nr_parents++], ids[rand() % i], SELVA_NODE_ID_SIZE);
+            if (i > 1 && rand() % 4 == 0) {
+                memcpy(parents[nr_parents++], ids[rand() % i], SELVA_NODE_ID_SIZE);
+            }
+        }
+
+        SelvaModify_SetHierarchy(NULL, hierarchy, ids[i], nr_parents, parents, 0, NULL, NULL);
+    }
+
+    /* Make sure that the first node has more children than fit in a page. */
+    for (int i = 0; i < 20; i++) {
+        char buf[SELVA_NODE_ID_SIZE + 1];
+
+        snprintf(buf, sizeof(buf), "mb%08d", i);
+        SelvaModify_SetHierarchy(NULL, hierarchy, buf, 1, ids, 0, NULL, NULL);
+    }
+
+    res = check_resume(ROOT_NODE_ID, SELVA_HIERARCHY_TRAVERSAL_BFS_DESCENDANTS, nr_total);
+    if (res) {
+        return res;
+    }
+    res = check_resume(ROOT_NODE_ID, SELVA_HIERARCHY_TRAVERSAL_DFS_DESCENDANTS, nr_total);
+    if (res) {
+        return res;
+    }
+    res = check_resume(ids[0], SELVA_HIERARCHY_TRAVERSAL_CHILDREN, nr_total);
+    if (res) {
+        return res;
+    }
+
+    pu_assert_ptr_equal("dfs_full can't be resumed", SelvaHierarchy_NewResumable(SELVA_HIERARCHY_TRAVERSAL_DFS_FULL, ROOT_NODE_ID), NULL);
+
+    SelvaModify_SetHierarchy(NULL, hierarchy, new_id, 0, NULL, 0, NULL, NULL);
+    state = SelvaHierarchy_NewResumable(SELVA_HIERARCHY_TRAVERSAL_BFS_DESCENDANTS, ROOT_NODE_ID);
+    id = SelvaHierarchy_SaveResumable(hierarchy, state);
+    SelvaModify_SetHierarchy(NULL, hierarchy, new_id, 1, ids, 0, NULL, NULL);
+    state = SelvaHierarchy_TakeResumable(hierarchy, id);
+    pu_assert("not expired by an addition", state);
+    SelvaHierarchy_DestroyResumable(state);
+
+    state = SelvaHierarchy_TakeResumable(hierarchy, id);
+    pu_assert("can be retried", state);
+    next_id = SelvaHierarchy_SaveResumable(hierarchy, state);
+    state = SelvaHierarchy_TakeResumable(hierarchy, next_id);
+    pu_assert("next state taken", state);
+    SelvaHierarchy_DestroyResumable(state);
+    pu_assert_ptr_equal("previous state dropped", SelvaHierarchy_TakeResumable(hierarchy, id), NULL);
+
+    SelvaModify_DelHierarchy(NULL, hierarchy, new_id, 1, ids, 0, NULL);
+    pu_assert_ptr_equal("expired by a removal", SelvaHierarchy_TakeResumable(hierarchy, next_id), NULL);
+
+    return NULL;
+}
+
 void all_tests(void)
 {
     pu_def_test(test_insert_one, PU_RUN);
@@ -1020,4 +1424,9 @@ void all_tests(void)
     pu_def_test(test_del_1, PU_RUN);
     pu_def_test(test_del_2, PU_RUN);
     pu_def_test(test_del_node, PU_RUN);
+    pu_def_test(test_is_descendant_of, PU_RUN);
+    pu_def_test(test_is_descendant_of_wide, PU_RUN);
+    pu_def_test(test_is_descendant_of_random, PU_RUN);
+    pu_def_test(test_find_nodes_batch, PU_RUN);
+    pu_def_test(test_traverse_resume, PU_RUN);
 }
@@ -1,5 +1,5 @@
 TEST_SRC += test-hierarchy.c
-SRC-hierarchy += ../redis-alloc.c ../redis-timer.c ../hierarchy-utils.c ../hierarchy_inactive-mock.c ../find-index-mock.c ../redis-rdb.c ../rpn-mock.c ../edge-mock.c ../subscriptions-mock.c ../errors-mock.c ../hierarchy_detached-mock.c ../rms_compressor-mock.c
+SRC-hierarchy += ../redis-alloc.c ../redis-timer.c ../hierarchy-utils.c ../hierarchy_inactive-mock.c ../find-index-mock.c ../inherit-mock.c ../find_cache-mock.c ../redis-rdb.c ../rpn-mock.c ../edge-mock.c ../subscriptions-mock.c ../errors-mock.c ../hierarchy_detached-mock.c ../rms_compressor-mock.c
 SRC-hierarchy += ../../lib/rmutil/sds.c
 SRC-hierarchy += ../../lib/util/auto_free.c
 SRC-hierarchy += ../../lib/util/cstrings.c
@@ -20,3 +20,5 @@ SRC-hierarchy += ../../module/selva_object/selva_object_foreach.c
 SRC-hierarchy += ../../module/selva_set/selva_set.c
 SRC-hierarchy += ../../module/selva_type.c
 SRC-hierarchy += ../../module/timestamp.c
+SRC-hierarchy += ../../module/selva_trace.c
+SRC-hierarchy += ../../module/selva_memory.c
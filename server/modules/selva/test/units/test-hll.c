@@ -0,0 +1,123 @@
+#include <punit.h>
+#include <math.h>
+#include <stdio.h>
+#include "hll.h"
+
+static struct hll a;
+static struct hll b;
+
+static void setup(void)
+{
+    hll_init(&a, 14);
+    hll_init(&b, 14);
+}
+
+static void teardown(void)
+{
+    hll_destroy(&a);
+    hll_destroy(&b);
+}
+
+static void add_range(struct hll *hll, long long start, long long end)
+{
+    for (long long i = start; i < end; i++) {
+        hll_add(hll, &i, sizeof(i));
+    }
+}
+
+static int within(uint64_t est, uint64_t n, double tol)
+{
+    return fabs((double)est - (double)n) <= tol * (double)n;
+}
+
+static char * test_empty(void)
+{
+    pu_assert_equal("empty", hll_count(&a), 0);
+
+    return NULL;
+}
+
+static char * test_sparse(void)
+{
+    add_range(&a, 0, 100);
+    add_range(&a, 0, 100);
+
+    pu_assert_equal("still sparse", a.dense, 0);
+    pu_assert("close to exact", within(hll_count(&a), 100, 0.02));
+
+    return NULL;
+}
+
+static char * test_dense(void)
+{
+    const uint64_t n = 200000;
+    uint64_t est;
+
+    add_range(&a, 0, n);
+    pu_assert_equal("dense", a.dense, 1);
+
+    est = hll_count(&a);
+    pu_assert("within 3 sigma", within(est, n, 3 * 1.04 / sqrt(1 << 14)));
+
+    return NULL;
+}
+
+static char * test_strings(void)
+{
+    char buf[20];
+
+    for (int i = 0; i < 5000; i++) {
+        const int len = snprintf(buf, sizeof(buf), "str%d", i % 1000);
+
+        hll_add(&a, buf, len);
+    }
+
+    pu_assert("distinct strings", within(hll_count(&a), 1000, 0.05));
+
+    return NULL;
+}
+
+static char * test_merge(void)
+{
+    add_range(&a, 0, 30000);
+    add_range(&b, 20000, 50000);
+
+    pu_assert_equal("merge", hll_merge(&a, &b), 0);
+    pu_assert("union", within(hll_count(&a), 50000, 0.05));
+
+    return NULL;
+}
+
+static char * test_merge_sparse_to_dense(void)
+{
+    add_range(&a, 0, 10);
+    add_range(&b, 0, 100000);
+
+    pu_assert_equal("merge", hll_merge(&a, &b), 0);
+    pu_assert_equal("dense", a.dense, 1);
+    pu_assert_equal("same as src", hll_count(&a), hll_count(&b));
+
+    return NULL;
+}
+
+static char * test_merge_precision_mismatch(void)
+{
+    struct hll c;
+
+    hll_init(&c, 10);
+    pu_assert("fails", hll_merge(&a, &c) != 0);
+    hll_destroy(&c);
+
+    return NULL;
+}
+
+void all_tests(void)
+{
+    pu_def_test(test_empty, PU_RUN);
+    pu_def_test(test_sparse, PU_RUN);
+    pu_def_test(test_dense, PU_RUN);
+    pu_def_test(test_strings, PU_RUN);
+    pu_def_test(test_merge, PU_RUN);
+    pu_def_test(test_merge_sparse_to_dense, PU_RUN);
+    pu_def_test(test_merge_precision_mismatch, PU_RUN);
+}
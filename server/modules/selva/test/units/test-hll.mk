@@ -0,0 +1,4 @@
+TEST_SRC += test-hll.c
+SRC-hll += ../redis-alloc.c
+SRC-hll += ../../lib/rmutil/sds.c
+SRC-hll += ../../lib/util/hll.c
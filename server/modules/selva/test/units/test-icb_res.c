@@ -0,0 +1,172 @@
+#include <punit.h>
+#include <stdlib.h>
+#include <string.h>
+#include "redismodule.h"
+#include "selva.h"
+#include "svector.h"
+#include "traversal.h"
+#include "hierarchy.h"
+#include "selva_object.h"
+#include "find_index/icb.h"
+#include "../hierarchy-utils.h"
+
+static struct SelvaFindIndexControlBlock *icb;
+
+static void setup(void)
+{
+    hierarchy = SelvaModify_NewHierarchy(NULL);
+    icb = calloc(1, sizeof(*icb));
+
+    SelvaModify_SetHierarchy(NULL, hierarchy, "ma00000001", 0, NULL, 0, NULL, NULL);
+    SelvaModify_SetHierarchy(NULL, hierarchy, "ma00000002", 0, NULL, 0, NULL, NULL);
+    SelvaModify_SetHierarchy(NULL, hierarchy, "ma00000003", 0, NULL, 0, NULL, NULL);
+}
+
+static void teardown(void)
+{
+    SelvaFindIndexICB_ResDestroy(icb);
+    if (icb->traversal.sort.order_field) {
+        RedisModule_FreeString(NULL, icb->traversal.sort.order_field);
+    }
+    free(icb);
+    icb = NULL;
+
+    SelvaModify_DestroyHierarchy(hierarchy);
+    hierarchy = NULL;
+}
+
+static struct SelvaHierarchyNode *get_node(const char *id)
+{
+    return SelvaHierarchy_FindNode(hierarchy, id);
+}
+
+static int dense_has_id(size_t i, const char *id)
+{
+    Selva_NodeId node_id;
+
+    SelvaHierarchy_GetNodeId(node_id, icb->dense.nodes[i]);
+    return !memcmp(node_id, id, SELVA_NODE_ID_SIZE);
+}
+
+static void init_ordered(void)
+{
+    icb->flags.ordered = 1;
+    icb->traversal.sort.order = SELVA_RESULT_ORDER_ASC;
+    icb->traversal.sort.order_field = RedisModule_CreateString(NULL, "x", 1);
+
+    SelvaObject_SetDoubleStr(SelvaHierarchy_GetNodeObject(get_node("ma00000001")), "x", 1, 3.0);
+    SelvaObject_SetDoubleStr(SelvaHierarchy_GetNodeObject(get_node("ma00000002")), "x", 1, 1.0);
+    SelvaObject_SetDoubleStr(SelvaHierarchy_GetNodeObject(get_node("ma00000003")), "x", 1, 2.0);
+
+    SelvaFindIndexICB_ResInit(icb);
+}
+
+static char * test_unordered_add(void)
+{
+    SelvaFindIndexICB_ResInit(icb);
+
+    pu_assert_equal("add", SelvaFindIndexICB_ResAdd(icb, get_node("ma00000003")), 0);
+    pu_assert_equal("add", SelvaFindIndexICB_ResAdd(icb, get_node("ma00000001")), 0);
+    pu_assert_equal("add", SelvaFindIndexICB_ResAdd(icb, get_node("ma00000002")), 0);
+    pu_assert_equal("add twice", SelvaFindIndexICB_ResAdd(icb, get_node("ma00000001")), 0);
+    pu_assert_equal("dirty", icb->dense.dirty, 1);
+
+    pu_assert_equal("has", SelvaFindIndexICB_ResHas(icb, get_node("ma00000002")), 1);
+
+    SelvaFindIndexICB_DenseUpdate(icb);
+    pu_assert_equal("not dirty", icb->dense.dirty, 0);
+    pu_assert_equal("len", icb->dense.len, 3);
+    pu_assert("node_id order", dense_has_id(0, "ma00000001"));
+    pu_assert("node_id order", dense_has_id(1, "ma00000002"));
+    pu_assert("node_id order", dense_has_id(2, "ma00000003"));
+
+    pu_assert_equal("add twice", SelvaFindIndexICB_ResAdd(icb, get_node("ma00000003")), 0);
+    pu_assert_equal("not dirty after a duplicate", icb->dense.dirty, 0);
+
+    return NULL;
+}
+
+static char * test_unordered_del(void)
+{
+    SelvaFindIndexICB_ResInit(icb);
+
+    SelvaFindIndexICB_ResAdd(icb, get_node("ma00000001"));
+    SelvaFindIndexICB_ResAdd(icb, get_node("ma00000002"));
+    SelvaFindIndexICB_ResAdd(icb, get_node("ma00000003"));
+    SelvaFindIndexICB_DenseUpdate(icb);
+
+    SelvaFindIndexICB_ResDel(icb, get_node("ma00000002"));
+    pu_assert_equal("dirty", icb->dense.dirty, 1);
+    pu_assert_equal("has not", SelvaFindIndexICB_ResHas(icb, get_node("ma00000002")), 0);
+
+    SelvaFindIndexICB_DenseUpdate(icb);
+    pu_assert_equal("len", icb->dense.len, 2);
+    pu_assert("node_id order", dense_has_id(0, "ma00000001"));
+    pu_assert("node_id order", dense_has_id(1, "ma00000003"));
+
+    SelvaFindIndexICB_ResDel(icb, get_node("ma00000002"));
+    pu_assert_equal("not dirty after a missing node", icb->dense.dirty, 0);
+
+    return NULL;
+}
+
+static char * test_ordered_add(void)
+{
+    init_ordered();
+
+    SelvaFindIndexICB_ResAdd(icb, get_node("ma00000001"));
+    SelvaFindIndexICB_ResAdd(icb, get_node("ma00000002"));
+    SelvaFindIndexICB_ResAdd(icb, get_node("ma00000003"));
+
+    SelvaFindIndexICB_DenseUpdate(icb);
+    pu_assert_equal("len", icb->dense.len, 3);
+    pu_assert("field order", dense_has_id(0, "ma00000002"));
+    pu_assert("field order", dense_has_id(1, "ma00000003"));
+    pu_assert("field order", dense_has_id(2, "ma00000001"));
+
+    SelvaFindIndexICB_ResAdd(icb, get_node("ma00000003"));
+    pu_assert_equal("not dirty if the position didn't change", icb->dense.dirty, 0);
+
+    /* Reposition. */
+    SelvaObject_SetDoubleStr(SelvaHierarchy_GetNodeObject(get_node("ma00000001")), "x", 1, 0.0);
+    SelvaFindIndexICB_ResAdd(icb, get_node("ma00000001"));
+    pu_assert_equal("dirty", icb->dense.dirty, 1);
+
+    SelvaFindIndexICB_DenseUpdate(icb);
+    pu_assert_equal("len", icb->dense.len, 3);
+    pu_assert("field order", dense_has_id(0, "ma00000001"));
+    pu_assert("field order", dense_has_id(1, "ma00000002"));
+    pu_assert("field order", dense_has_id(2, "ma00000003"));
+
+    return NULL;
+}
+
+static char * test_ordered_del(void)
+{
+    init_ordered();
+
+    SelvaFindIndexICB_ResAdd(icb, get_node("ma00000001"));
+    SelvaFindIndexICB_ResAdd(icb, get_node("ma00000002"));
+    SelvaFindIndexICB_ResAdd(icb, get_node("ma00000003"));
+    SelvaFindIndexICB_DenseUpdate(icb);
+
+    SelvaFindIndexICB_ResDel(icb, get_node("ma00000003"));
+    pu_assert_equal("dirty", icb->dense.dirty, 1);
+    pu_assert_equal("has not", SelvaFindIndexICB_ResHas(icb, get_node("ma00000003")), 0);
+    pu_assert_equal("has", SelvaFindIndexICB_ResHas(icb, get_node("ma00000001")), 1);
+
+    SelvaFindIndexICB_DenseUpdate(icb);
+    pu_assert_equal("len", icb->dense.len, 2);
+    pu_assert("field order", dense_has_id(0, "ma00000002"));
+    pu_assert("field order", dense_has_id(1, "ma00000001"));
+
+    return NULL;
+}
+
+void all_tests(void)
+{
+    pu_def_test(test_unordered_add, PU_RUN);
+    pu_def_test(test_unordered_del, PU_RUN);
+    pu_def_test(test_ordered_add, PU_RUN);
+    pu_def_test(test_ordered_del, PU_RUN);
+}
@@ -0,0 +1,27 @@
+TEST_SRC += test-icb_res.c
+SRC-icb_res += ../redis-alloc.c ../redis-timer.c ../hierarchy-utils.c ../hierarchy_inactive-mock.c ../find-index-mock.c ../inherit-mock.c ../find_cache-mock.c ../redis-rdb.c ../rpn-mock.c ../edge-mock.c ../subscriptions-mock.c ../errors-mock.c ../hierarchy_detached-mock.c ../rms_compressor-mock.c
+SRC-icb_res += ../../lib/rmutil/sds.c
+SRC-icb_res += ../../lib/util/auto_free.c
+SRC-icb_res += ../../lib/util/cstrings.c
+SRC-icb_res += ../../lib/util/mempool.c
+SRC-icb_res += ../../lib/util/memrchr.c
+SRC-icb_res += ../../lib/util/svector.c
+SRC-icb_res += ../../lib/util/trx.c
+SRC-icb_res += ../../module/alias.c
+SRC-icb_res += ../../module/arg_parser.c
+SRC-icb_res += ../../module/config.c
+SRC-icb_res += ../../module/errors.c
+SRC-icb_res += ../../module/find_index/icb_res.c
+SRC-icb_res += ../../module/hierarchy/hierarchy.c
+SRC-icb_res += ../../module/hierarchy/traversal_order.c
+SRC-icb_res += ../../module/hierarchy/types.c
+SRC-icb_res += ../../module/rms/shared.c
+SRC-icb_res += ../../module/selva_lang.c
+SRC-icb_res += ../../module/selva_log.c
+SRC-icb_res += ../../module/selva_object/selva_object.c
+SRC-icb_res += ../../module/selva_object/selva_object_foreach.c
+SRC-icb_res += ../../module/selva_set/selva_set.c
+SRC-icb_res += ../../module/selva_type.c
+SRC-icb_res += ../../module/timestamp.c
+SRC-icb_res += ../../module/selva_trace.c
+SRC-icb_res += ../../module/selva_memory.c
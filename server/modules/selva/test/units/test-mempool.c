@@ -1,6 +1,7 @@
 #include <punit.h>
 #include <stdalign.h>
 #include <stdint.h>
+#include <string.h>
 #include "mempool.h"
 
 static void setup(void)
@@ -139,10 +140,66 @@ static char * test_allocs(void)
     return NULL;
 }
 
+static char * test_gc_all_slabs(void)
+{
+    const size_t slab_size = 4096;
+    const size_t obj_size = 64;
+    struct mempool pool;
+    static char *p[1000];
+
+    mempool_init(&pool, slab_size, obj_size, alignof(size_t));
+
+    for (size_t i = 0; i < num_elem(p); i++) {
+        p[i] = mempool_get(&pool);
+        pu_assert("got obj", p[i]);
+        memset(p[i], 0xff, obj_size);
+    }
+    for (size_t i = 0; i < num_elem(p); i += 2) {
+        mempool_return(&pool, p[i]);
+    }
+    mempool_gc(&pool);
+    pu_assert("Slabs in use are not freed", !SLIST_EMPTY(&pool.slabs));
+
+    for (size_t i = 1; i < num_elem(p); i += 2) {
+        mempool_return(&pool, p[i]);
+    }
+    mempool_gc(&pool);
+    pu_assert("All slabs were freed", SLIST_EMPTY(&pool.slabs));
+    pu_assert("The free list is empty", LIST_EMPTY(&pool.free_chunks));
+
+    mempool_destroy(&pool);
+
+    return NULL;
+}
+
+static char * test_hugepage(void)
+{
+    const size_t slab_size = 2097152;
+    const size_t obj_size = 256;
+    struct mempool pool;
+
+    mempool_init2(&pool, slab_size, obj_size, alignof(size_t), MEMPOOL_HUGEPAGE_EXPLICIT);
+
+    char *p1 = mempool_get(&pool);
+    pu_assert("got obj", p1);
+    snprintf(p1, obj_size, "Hello world\n");
+    pu_assert_str_equal("p1 has the correct string", p1, "Hello world\n");
+
+    mempool_return(&pool, p1);
+    mempool_gc(&pool);
+    pu_assert("All slabs were freed", SLIST_EMPTY(&pool.slabs));
+
+    mempool_destroy(&pool);
+
+    return NULL;
+}
+
 void all_tests(void)
 {
     pu_def_test(test_simple_allocs, PU_RUN);
     pu_def_test(test_object_reuse, PU_RUN);
     pu_def_test(test_gc, PU_RUN);
     pu_def_test(test_allocs, PU_RUN);
+    pu_def_test(test_gc_all_slabs, PU_RUN);
+    pu_def_test(test_hugepage, PU_RUN);
 }
@@ -0,0 +1,254 @@
+#include <punit.h>
+#include <stdint.h>
+#include <string.h>
+#include "selva.h"
+#include "modify_stream.h"
+
+static char buf[256];
+static size_t buf_len;
+
+static void put(const void *p, size_t len)
+{
+    memcpy(buf + buf_len, p, len);
+    buf_len += len;
+}
+
+static void put_u8(uint8_t v)
+{
+    put(&v, sizeof(v));
+}
+
+static void put_u16(uint16_t v)
+{
+    put(&v, sizeof(v));
+}
+
+static void put_u32(uint32_t v)
+{
+    put(&v, sizeof(v));
+}
+
+static void put_header(uint8_t version, uint16_t nr_fields)
+{
+    put_u8(version);
+    put_u8(0);
+    put_u16(nr_fields);
+}
+
+static void put_record(const char *node_id, uint8_t flags, uint32_t nr_ops)
+{
+    Selva_NodeId id;
+
+    Selva_NodeIdCpy(id, node_id);
+    put(id, SELVA_NODE_ID_SIZE);
+    put_u8(flags);
+    put_u32(nr_ops);
+}
+
+static void put_op(char type, const char *field, const void *value, uint32_t value_len)
+{
+    put_u8(type);
+    put_u16(strlen(field));
+    put(field, strlen(field));
+    put_u32(value_len);
+    put(value, value_len);
+}
+
+static void put_op_id(char type, uint16_t field_id, const void *value, uint32_t value_len)
+{
+    put_u8(type);
+    put_u16(SELVA_MODIFY_STREAM_FIELD_ID | field_id);
+    put_u32(value_len);
+    put(value, value_len);
+}
+
+static void setup(void)
+{
+    memset(buf, 0, sizeof(buf));
+    buf_len = 0;
+}
+
+static void teardown(void)
+{
+}
+
+static char * test_empty_stream(void)
+{
+    struct SelvaModifyStream s;
+    struct SelvaModifyStream_Record rec;
+    int err;
+
+    put_header(SELVA_MODIFY_STREAM_VERSION, 0);
+
+    err = SelvaModifyStream_Init(&s, buf, buf_len);
+    pu_assert_equal("init ok", err, 0);
+    pu_assert_equal("no fields", s.nr_fields, 0);
+
+    err = SelvaModifyStream_NextRecord(&s, &rec);
+    pu_assert_equal("no records", err, SELVA_ENOENT);
+
+    return NULL;
+}
+
+static char * test_invalid_version(void)
+{
+    struct SelvaModifyStream s;
+    int err;
+
+    put_header(SELVA_MODIFY_STREAM_VERSION + 1, 0);
+
+    err = SelvaModifyStream_Init(&s, buf, buf_len);
+    pu_assert_equal("not supported", err, SELVA_ENOTSUP);
+
+    return NULL;
+}
+
+static char * test_truncated_header(void)
+{
+    struct SelvaModifyStream s;
+    int err;
+
+    put_header(SELVA_MODIFY_STREAM_VERSION, 2);
+    put_u16(5);
+    put("title", 5);
+    put_u16(5);
+    put("val", 3);
+
+    err = SelvaModifyStream_Init(&s, buf, buf_len);
+    pu_assert_equal("invalid", err, SELVA_EINVAL);
+
+    err = SelvaModifyStream_Init(&s, buf, 3);
+    pu_assert_equal("invalid", err, SELVA_EINVAL);
+
+    return NULL;
+}
+
+static char * test_records_and_ops(void)
+{
+    struct SelvaModifyStream s;
+    struct SelvaModifyStream_Field fields[2];
+    struct SelvaModifyStream_Record rec;
+    struct SelvaModifyStream_Op op;
+    const long long v = 42;
+    size_t off = 0;
+    int err;
+
+    put_header(SELVA_MODIFY_STREAM_VERSION, 2);
+    put_u16(5);
+    put("title", 5);
+    put_u16(5);
+    put("value", 5);
+    put_record("ma1", SELVA_MODIFY_STREAM_FLAG_NO_ROOT, 2);
+    put_op('0', "title.en", "hello", 5);
+    put_op_id('3', 1, &v, sizeof(v));
+    put_record("ma2", 0, 1);
+    put_op_id('0', 0, "abc", 3);
+
+    err = SelvaModifyStream_Init(&s, buf, buf_len);
+    pu_assert_equal("init ok", err, 0);
+    pu_assert_equal("nr_fields", s.nr_fields, 2);
+
+    SelvaModifyStream_GetFields(&s, fields);
+    pu_assert_equal("field len", fields[0].name_len, 5);
+    pu_assert("field name", !memcmp(fields[0].name_str, "title", 5));
+    pu_assert_equal("field len", fields[1].name_len, 5);
+    pu_assert("field name", !memcmp(fields[1].name_str, "value", 5));
+
+    err = SelvaModifyStream_NextRecord(&s, &rec);
+    pu_assert_equal("got a record", err, 0);
+    pu_assert("node_id", !memcmp(rec.node_id, "ma1\0\0\0\0\0\0\0", SELVA_NODE_ID_SIZE));
+    pu_assert_equal("flags", rec.flags, SELVA_MODIFY_STREAM_FLAG_NO_ROOT);
+    pu_assert_equal("nr_ops", rec.nr_ops, 2);
+
+    err = SelvaModifyStream_NextOp(&rec, &off, &op);
+    pu_assert_equal("got an op", err, 0);
+    pu_assert_equal("type", op.type_code, '0');
+    pu_assert_equal("field_id", op.field_id, -1);
+    pu_assert_equal("field_len", op.field_len, 8);
+    pu_assert("field", !memcmp(op.field_str, "title.en", 8));
+    pu_assert_equal("value_len", op.value_len, 5);
+    pu_assert("value", !memcmp(op.value_str, "hello", 5));
+    pu_assert_ptr_equal("raw", op.raw, rec.ops);
+    pu_assert_equal("raw_len", op.raw_len, 1 + 2 + 8 + 4 + 5);
+
+    err = SelvaModifyStream_NextOp(&rec, &off, &op);
+    pu_assert_equal("got an op", err, 0);
+    pu_assert_equal("type", op.type_code, '3');
+    pu_assert_equal("field_id", op.field_id, 1);
+    pu_assert_equal("value_len", op.value_len, sizeof(v));
+    pu_assert("value", !memcmp(op.value_str, &v, sizeof(v)));
+
+    err = SelvaModifyStream_NextOp(&rec, &off, &op);
+    pu_assert_equal("no more ops", err, SELVA_ENOENT);
+
+    err = SelvaModifyStream_NextRecord(&s, &rec);
+    pu_assert_equal("got a record", err, 0);
+    pu_assert("node_id", !memcmp(rec.node_id, "ma2\0\0\0\0\0\0\0", SELVA_NODE_ID_SIZE));
+    pu_assert_equal("nr_ops", rec.nr_ops, 1);
+
+    err = SelvaModifyStream_NextRecord(&s, &rec);
+    pu_assert_equal("no more records", err, SELVA_ENOENT);
+
+    return NULL;
+}
+
+static char * test_invalid_field_id(void)
+{
+    struct SelvaModifyStream s;
+    struct SelvaModifyStream_Record rec;
+    int err;
+
+    put_header(SELVA_MODIFY_STREAM_VERSION, 1);
+    put_u16(5);
+    put("title", 5);
+    put_record("ma1", 0, 1);
+    put_op_id('0', 1, "abc", 3);
+
+    err = SelvaModifyStream_Init(&s, buf, buf_len);
+    pu_assert_equal("init ok", err, 0);
+
+    err = SelvaModifyStream_NextRecord(&s, &rec);
+    pu_assert_equal("invalid", err, SELVA_EINVAL);
+
+    return NULL;
+}
+
+static char * test_truncated_op(void)
+{
+    struct SelvaModifyStream s;
+    struct SelvaModifyStream_Record rec;
+    int err;
+
+    put_header(SELVA_MODIFY_STREAM_VERSION, 0);
+    put_record("ma1", 0, 2);
+    put_op('0', "title", "abc", 3);
+
+    err = SelvaModifyStream_Init(&s, buf, buf_len);
+    pu_assert_equal("init ok", err, 0);
+
+    err = SelvaModifyStream_NextRecord(&s, &rec);
+    pu_assert_equal("invalid", err, SELVA_EINVAL);
+
+    setup();
+    put_header(SELVA_MODIFY_STREAM_VERSION, 0);
+    put_record("ma1", 0, 1);
+    put_op('0', "title", "abc", 3);
+
+    err = SelvaModifyStream_Init(&s, buf, buf_len - 1);
+    pu_assert_equal("init ok", err, 0);
+
+    err = SelvaModifyStream_NextRecord(&s, &rec);
+    pu_assert_equal("invalid", err, SELVA_EINVAL);
+
+    return NULL;
+}
+
+void all_tests(void)
+{
+    pu_def_test(test_empty_stream, PU_RUN);
+    pu_def_test(test_invalid_version, PU_RUN);
+    pu_def_test(test_truncated_header, PU_RUN);
+    pu_def_test(test_records_and_ops, PU_RUN);
+    pu_def_test(test_invalid_field_id, PU_RUN);
+    pu_def_test(test_truncated_op, PU_RUN);
+}
@@ -0,0 +1,2 @@
+TEST_SRC += test-modify_stream.c
+SRC-modify_stream += ../../module/modify_stream.c
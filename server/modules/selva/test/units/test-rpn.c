@@ -609,6 +609,56 @@ static char * test_swap(void)
     return NULL;
 }
 
+static char * test_descendant_constraint(void)
+{
+    static const char expr_str[][30] = {
+        "\"ma1\" p",
+        "\"ma\" e \"ma1\" p M",
+        "\"ma\" e $1 p M",
+        "\"ma1\" p \"ma\" e M",
+        "\"ma1\" p L",
+        "\"ma\" e \"ma1\" p N",
+        "#1 >1 \"ma1\" p M .1:X",
+        "$0 p",
+        "#1 p",
+    };
+    const char *expected[] = {
+        "ma1",
+        "ma1",
+        "ma2",
+        NULL,
+        NULL,
+        NULL,
+        NULL, /* Jumps are not analyzed. */
+        NULL, /* reg[0] is the current node. */
+        NULL,
+    };
+    static const char reg1[] = "ma2";
+
+    rpn_set_reg(ctx, 1, reg1, sizeof(reg1), 0);
+
+    for (int i = 0; i < num_elem(expected); i++) {
+        Selva_NodeId node_id;
+        int res;
+
+        expr = rpn_compile(expr_str[i]);
+        pu_assert_not_null("Expected to compile", expr);
+
+        res = rpn_get_descendant_constraint(ctx, expr, node_id);
+        rpn_destroy_expression(expr);
+        expr = NULL;
+
+        if (expected[i]) {
+            pu_assert_equal(expr_str[i], res, 1);
+            pu_assert_str_equal("node_id", node_id, expected[i]);
+        } else {
+            pu_assert_equal(expr_str[i], res, 0);
+        }
+    }
+
+    return NULL;
+}
+
 void all_tests(void)
 {
     pu_def_test(test_init_works, PU_RUN);
@@ -634,4 +684,5 @@ void all_tests(void)
     pu_def_test(test_cond_jump, PU_RUN);
     pu_def_test(test_dup, PU_RUN);
     pu_def_test(test_swap, PU_RUN);
+    pu_def_test(test_descendant_constraint, PU_RUN);
 }
@@ -22,3 +22,5 @@ SRC-rpn += ../hierarchy-mock.c
 SRC-rpn += ../edge-mock.c
 SRC-rpn += ../redis-alloc.c
 SRC-rpn += ../subscriptions-mock.c
+SRC-rpn += ../../module/selva_trace.c
+SRC-rpn += ../../module/selva_memory.c
@@ -642,6 +642,35 @@ static char * set_invalid_array_key_2(void)
     return NULL;
 }
 
+static char * mem_usage_detail(void)
+{
+    struct SelvaObjectMemUsage usage = { 0 };
+    RedisModuleString *key_name = RedisModule_CreateString(NULL, "set", 3);
+    int err;
+
+    SelvaObject_MemUsageDetail(root_obj, &usage);
+    pu_assert_equal("empty object", SelvaObject_MemUsageTotal(&usage), usage.objects);
+    pu_assert_equal("no strings", usage.strings, 0);
+
+    err = SelvaObject_SetStringStr(root_obj, "a.b", 3, RedisModule_CreateString(NULL, "hello", 5));
+    pu_assert_equal("no error", err, 0);
+    err = SelvaObject_AddLongLongSet(root_obj, key_name, 1);
+    pu_assert_equal("no error", err, 0);
+    err = SelvaObject_AddLongLongSet(root_obj, key_name, 2);
+    pu_assert_equal("no error", err, 0);
+    err = SelvaObject_InsertArrayStr(root_obj, "arr", 3, SELVA_OBJECT_STRING, RedisModule_CreateString(NULL, "abc", 3));
+    pu_assert_equal("no error", err, 0);
+
+    memset(&usage, 0, sizeof(usage));
+    SelvaObject_MemUsageDetail(root_obj, &usage);
+    pu_assert_equal("strings", usage.strings, sizeof("hello") + sizeof("abc"));
+    pu_assert("sets", usage.sets > 0);
+    pu_assert("arrays", usage.arrays > 0);
+    pu_assert("nested object", usage.objects >= 2 * SELVA_OBJECT_BSIZE);
+
+    return NULL;
+}
+
 void all_tests(void)
 {
     pu_def_test(setget_double, PU_RUN);
@@ -658,4 +687,5 @@ void all_tests(void)
     pu_def_test(pointer_values, PU_RUN);
     pu_def_test(set_invalid_array_key_1, PU_RUN);
     pu_def_test(set_invalid_array_key_2, PU_RUN);
+    pu_def_test(mem_usage_detail, PU_RUN);
 }
@@ -11,3 +11,5 @@ SRC-selva_object += ../../module/selva_log.c
 SRC-selva_object += ../../module/selva_object/selva_object.c
 SRC-selva_object += ../../module/selva_set/selva_set.c
 SRC-selva_object += ../../module/selva_type.c
+SRC-selva_object += ../../module/selva_trace.c
+SRC-selva_object += ../../module/selva_memory.c
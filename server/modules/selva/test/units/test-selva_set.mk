@@ -4,3 +4,5 @@ SRC-selva_set += ../../lib/rmutil/sds.c
 SRC-selva_set += ../../module/errors.c
 SRC-selva_set += ../../module/selva_set/selva_set.c
 SRC-selva_set += ../../module/selva_type.c
+SRC-selva_set += ../../module/selva_log.c
+SRC-selva_set += ../../module/selva_memory.c
@@ -627,6 +627,28 @@ static char * test_pop(void)
     return NULL;
 }
 
+static char * test_pop_rbtree(void)
+{
+    struct data el[SVECTOR_THRESHOLD + 2];
+
+    SVector_Init(&vec, 0, compar);
+    for (size_t i = 0; i < num_elem(el); i++) {
+        el[i].id = i;
+        SVector_Insert(&vec, &el[i]);
+    }
+    pu_assert_equal("rbtree mode", SVector_Mode(&vec), SVECTOR_MODE_RBTREE);
+
+    for (size_t i = num_elem(el); i > 0; i--) {
+        pu_assert_ptr_equal("Pops the last el", SVector_Pop(&vec), &el[i - 1]);
+        pu_assert_equal("Vector size is decremented", SVector_Size(&vec), i - 1);
+    }
+    pu_assert_ptr_equal("Pop empty vector", SVector_Pop(&vec), NULL);
+
+    SVector_Destroy(&vec);
+
+    return NULL;
+}
+
 static char * test_shift(void)
 {
     struct data el[] = { { 1 }, { 2 }, { 3 } };
@@ -765,6 +787,80 @@ static char * test_foreach_extra_large(void)
     return NULL;
 }
 
+static char * test_foreach_after(void)
+{
+    struct data el[] = { { 1 }, { 2 }, { 3 }, { 4 } };
+    struct data key = { 2 };
+    struct SVectorIterator it;
+
+    SVector_Init(&vec, 4, compar);
+    for (size_t i = 0; i < num_elem(el); i++) {
+        SVector_Insert(&vec, &el[i]);
+    }
+
+    SVector_ForeachBeginAfter(&it, &vec, 0, &key);
+    pu_assert_ptr_equal("starts after the key", SVector_Foreach(&it), &el[2]);
+    pu_assert_ptr_equal("continues", SVector_Foreach(&it), &el[3]);
+    pu_assert_ptr_equal("ends", SVector_Foreach(&it), NULL);
+
+    SVector_Remove(&vec, &el[1]);
+    SVector_ForeachBeginAfter(&it, &vec, 0, &key);
+    pu_assert_ptr_equal("removed key", SVector_Foreach(&it), &el[2]);
+
+    key.id = 4;
+    SVector_ForeachBeginAfter(&it, &vec, 0, &key);
+    pu_assert_ptr_equal("last key", SVector_Foreach(&it), NULL);
+
+    return NULL;
+}
+
+static char * test_foreach_after_unordered(void)
+{
+    struct data el[] = { { 3 }, { 1 }, { 2 } };
+    struct SVectorIterator it;
+
+    SVector_Init(&vec, 3, NULL);
+    for (size_t i = 0; i < num_elem(el); i++) {
+        SVector_Insert(&vec, &el[i]);
+    }
+
+    SVector_ForeachBeginAfter(&it, &vec, 2, NULL);
+    pu_assert_ptr_equal("skipped index elements", SVector_Foreach(&it), &el[2]);
+    pu_assert_ptr_equal("ends", SVector_Foreach(&it), NULL);
+
+    SVector_ForeachBeginAfter(&it, &vec, 10, NULL);
+    pu_assert_ptr_equal("index out of bounds", SVector_Foreach(&it), NULL);
+
+    return NULL;
+}
+
+static char * test_foreach_after_rbtree(void)
+{
+    struct data el[SVECTOR_THRESHOLD + 2];
+    struct data key = { 5 };
+    struct SVectorIterator it;
+    struct data *d;
+    size_t i;
+
+    SVector_Init(&vec, 0, compar);
+    for (i = 0; i < num_elem(el); i++) {
+        el[i].id = i;
+        SVector_Insert(&vec, &el[i]);
+    }
+    pu_assert_equal("rbtree mode", SVector_Mode(&vec), SVECTOR_MODE_RBTREE);
+
+    i = 6;
+    SVector_ForeachBeginAfter(&it, &vec, 0, &key);
+    while ((d = SVector_Foreach(&it))) {
+        pu_assert_ptr_equal("correct item", d, &el[i++]);
+    }
+    pu_assert_equal("visited the rest", i, num_elem(el));
+
+    SVector_Destroy(&vec);
+
+    return NULL;
+}
+
 static char * test_get_index(void)
 {
     struct data el[] = { { 1 }, { 2 }, { 3 } };
@@ -781,6 +877,29 @@ static char * test_get_index(void)
     return NULL;
 }
 
+static char * test_mem_usage(void)
+{
+    struct data el[SVECTOR_THRESHOLD + 1];
+
+    SVector_Init(&vec, 0, compar);
+    pu_assert_equal("no memory used", SVector_MemUsage(&vec), 0);
+
+    el[0].id = 0;
+    SVector_Insert(&vec, &el[0]);
+    pu_assert("array memory is used", SVector_MemUsage(&vec) >= sizeof(void *));
+
+    for (size_t i = 1; i < num_elem(el); i++) {
+        el[i].id = i;
+        SVector_Insert(&vec, &el[i]);
+    }
+    pu_assert_equal("rbtree mode", SVector_Mode(&vec), SVECTOR_MODE_RBTREE);
+    pu_assert("rbtree memory is used", SVector_MemUsage(&vec) >= num_elem(el) * sizeof(void *));
+
+    SVector_Destroy(&vec);
+
+    return NULL;
+}
+
 static char * test_sizeof_ctrl(void)
 {
     pu_test_description("Make sure the SVector size doesn't accidentally change when we make changes");
@@ -819,12 +938,17 @@ void all_tests(void)
     pu_def_test(test_remove_all, PU_RUN);
     pu_def_test(test_peek, PU_RUN);
     pu_def_test(test_pop, PU_RUN);
+    pu_def_test(test_pop_rbtree, PU_RUN);
     pu_def_test(test_shift, PU_RUN);
     pu_def_test(test_shift_reset, PU_RUN);
     pu_def_test(test_foreach_small, PU_RUN);
     pu_def_test(test_foreach_large, PU_RUN);
     pu_def_test(test_foreach_large_fast_insert, PU_RUN);
     pu_def_test(test_foreach_extra_large, PU_RUN);
+    pu_def_test(test_foreach_after, PU_RUN);
+    pu_def_test(test_foreach_after_unordered, PU_RUN);
+    pu_def_test(test_foreach_after_rbtree, PU_RUN);
     pu_def_test(test_get_index, PU_RUN);
+    pu_def_test(test_mem_usage, PU_RUN);
     pu_def_test(test_sizeof_ctrl, PU_RUN);
 }
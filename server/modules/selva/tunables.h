@@ -47,6 +47,18 @@
  */
 #define HIERARCHY_SLAB_SIZE 33554432
 
+/**
+ * Huge page backing of the hierarchy node pool slabs.
+ * Huge pages reduce TLB misses in traversals but the BGSAVE and export forks
+ * share the slabs copy-on-write, so with huge pages a write to any node in the
+ * parent copies a whole 2 MiB page instead of 4 KiB. This can multiply the
+ * memory usage and the latency of writes while a fork is running.
+ * 0 = normal pages;
+ * 1 = transparent huge pages;
+ * 2 = explicit huge pages (MAP_HUGETLB) with a fallback to transparent huge pages.
+ */
+#define HIERARCHY_SLAB_HUGEPAGE 0
+
 /**
  * Initial vector lengths for children and parents lists.
  */
@@ -86,10 +98,85 @@
  */
 #define HIERARCHY_AUTO_COMPRESS_INACT_NODES_LEN (4096 / SELVA_NODE_ID_SIZE)
 
+/**
+ * Lazy free timer period.
+ * How often a slice of lazily deleted nodes is freed.
+ */
+#define HIERARCHY_LAZY_FREE_PERIOD_MS 1
+
+/**
+ * Maximum number of lazily deleted nodes freed per timer slice.
+ */
+#define HIERARCHY_LAZY_FREE_SLICE 1000
+
+/**
+ * Maximum number of nodes accounted per timer slice in
+ * SELVA.HIERARCHY.MEMUSAGE.
+ */
+#define HIERARCHY_MEMUSAGE_SLICE 10000
+
+/**
+ * Number of interleaved node index lookups in a batched find.
+ * Each lookup in a batch prefetches its next tree node while the other
+ * lookups proceed.
+ */
+#define HIERARCHY_FIND_BATCH 16
+
+/**
+ * How many nodes ahead the traversal kernels prefetch.
+ * Applies both to the BFS queue and to iterating the adjacent nodes of a node.
+ */
+#define HIERARCHY_TRAVERSAL_PREFETCH_DIST 8
+
+/**
+ * Maximum number of entries in the inherit resolution cache.
+ * The cache is flushed when it gets full.
+ * 0 = disable the cache.
+ */
+#define INHERIT_CACHE_MAX 100000
+
+/**
+ * Maximum number of saved traversals per hierarchy.
+ * A saved traversal holds the BFS queue or the DFS stack of a paginated find
+ * so that the next page can resume where the previous one stopped.
+ * The least recently saved traversal is dropped when the limit is reached.
+ */
+#define HIERARCHY_MAX_RESUMABLE 100
+
 /*
  * Command tunables.
  */
 
+/**
+ * Maximum number of threads used for aggregating a single aggregate command.
+ * 0 or 1 = aggregate on the main thread only.
+ */
+#define AGGREGATE_WORKERS 4
+
+/**
+ * Minimum number of objects aggregated by a single aggregate thread.
+ */
+#define AGGREGATE_WORKER_MIN_NODES 20000
+
+/**
+ * Precision of the HyperLogLog used for the approximate count_unique.
+ * The standard error is 1.04 / sqrt(2^precision) and the dense sketch
+ * takes 2^precision bytes per group.
+ * The value is clamped to [4, 16].
+ */
+#define AGGREGATE_HLL_PRECISION 14
+
+/**
+ * Number of objects whose values are extracted at once before reducing them.
+ */
+#define AGGREGATE_BATCH_SIZE 256
+
+/**
+ * Number of independent accumulators used for reducing values.
+ * Should match the number of doubles fitting in a vector register.
+ */
+#define AGGREGATE_REDUCE_LANES 4
+
 /**
  * Maximum number of update operations on a sinlge command.
  */
@@ -137,6 +224,54 @@
 #define FIND_INDEXING_INTERVAL               60000 /*! How often the set of active indices is decided. */
 #define FIND_INDEXING_POPULARITY_AVE_PERIOD 216000 /*!< [sec] Averaging period for indexing hint demand count. After this period the original value is reduced to 1/e * n. */
 
+/*
+ * Find Query Planner Tunables.
+ * Relative costs used to choose between traversing the hierarchy and using the
+ * valid indices of a find query. The unit is the cost of visiting a node by
+ * traversing the hierarchy.
+ */
+
+#define FIND_PLAN_COST_TRAVERSE                1.0 /*!< Visiting a node by traversing the hierarchy. */
+#define FIND_PLAN_COST_INDEX                   0.2 /*!< Visiting a node from the dense array of an index. */
+#define FIND_PLAN_COST_PROBE                   0.3 /*!< Checking whether a node is in an index. */
+#define FIND_PLAN_COST_FILTER                  0.5 /*!< Executing the filter expression for a node. */
+#define FIND_PLAN_COST_SORT                    0.1 /*!< Sorting the result, multiplied by n log2 n. */
+
+/*
+ * Find Result Cache Tunables.
+ */
+
+/**
+ * Maximum size of the find result cache per hierarchy in bytes.
+ * The least recently used results are evicted when the cache is full.
+ * 0 = disable the cache.
+ */
+#define FIND_CACHE_MAX_BYTES 0
+
+/*
+ * Tracing Tunables.
+ */
+
+/**
+ * Enable the latency histograms of the traces on startup.
+ * The histograms can be also enabled and disabled at runtime with
+ * `selva.trace.enable`.
+ */
+#define SELVA_TRACE_HIST_ENABLED        0
+
+/**
+ * Number of sub-buckets per power of two in the latency histograms as a power
+ * of two. The relative error of a recorded latency is at most
+ * 1 / 2^SELVA_TRACE_HIST_SUB_BITS.
+ */
+#define SELVA_TRACE_HIST_SUB_BITS       4
+
+/**
+ * The longest latency the histograms can record as a power of two ns.
+ * Longer latencies are recorded in the last bucket.
+ */
+#define SELVA_TRACE_HIST_MAX_BITS       40
+
 /*
  * Async_task Tunables.
  */
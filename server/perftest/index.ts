@@ -1,10 +1,12 @@
 import printResult from './util/print-result'
 import testHierarchy from './hierarchy'
+import testModify from './modify'
 import sleep from './util/sleep'
 
 const allTests = [
   testHierarchy.bind(null, 'bfs'),
   testHierarchy.bind(null, 'dfs'),
+  testModify,
 ]
 
 function selectTests() {
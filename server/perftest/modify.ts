@@ -0,0 +1,143 @@
+import { performance } from 'perf_hooks'
+import { promisify } from 'util'
+import { fieldValues } from './util/gen-tree'
+import gc from './util/gc'
+import newRnd, { getRandomInt } from './util/rnd'
+import redis from './util/redis'
+
+const TEST_KEY = '___selva_hierarchy'
+const N = 20000
+const BATCH_SIZE = 500
+
+const MODIFY_STREAM_VERSION = 1
+const MODIFY_STREAM_FIELD_ID = 0x8000
+const FIELDS = ['field', 'published', 'createdAt']
+
+type Node = {
+  id: string
+  field: string
+  published: string
+  createdAt: number
+}
+
+function genNodes(): Node[] {
+  const rnd = newRnd('modify')
+  const nodes = []
+
+  for (let i = 0; i < N; i++) {
+    nodes.push({
+      id: `ma${i.toString(16).padStart(8, '0')}`,
+      field: fieldValues[getRandomInt(rnd, 0, fieldValues.length)],
+      published: rnd() < 0.5 ? 'true' : 'false',
+      createdAt: getRandomInt(rnd, 1561634316, 1719314360),
+    })
+  }
+
+  return nodes
+}
+
+function longLong(v: number): Buffer {
+  const buf = Buffer.alloc(8)
+  buf.writeBigInt64LE(BigInt(v))
+  return buf
+}
+
+function encodeStream(nodes: Node[]): Buffer {
+  const bufs: Buffer[] = []
+  const header = Buffer.alloc(4)
+
+  header.writeUInt8(MODIFY_STREAM_VERSION, 0)
+  header.writeUInt16LE(FIELDS.length, 2)
+  bufs.push(header)
+  for (const name of FIELDS) {
+    const len = Buffer.alloc(2)
+    len.writeUInt16LE(name.length)
+    bufs.push(len, Buffer.from(name))
+  }
+
+  const op = (type: string, fieldId: number, value: Buffer) => {
+    const hdr = Buffer.alloc(1 + 2 + 4)
+    hdr.write(type, 0, 1, 'latin1')
+    hdr.writeUInt16LE(MODIFY_STREAM_FIELD_ID | fieldId, 1)
+    hdr.writeUInt32LE(value.length, 3)
+    bufs.push(hdr, value)
+  }
+
+  for (const node of nodes) {
+    const rec = Buffer.alloc(10 + 1 + 4)
+    rec.write(node.id, 0, 10, 'latin1')
+    rec.writeUInt32LE(3, 11)
+    bufs.push(rec)
+
+    op('0', 0, Buffer.from(node.field))
+    op('0', 1, Buffer.from(node.published))
+    op('3', 2, longLong(node.createdAt))
+  }
+
+  return Buffer.concat(bufs)
+}
+
+export default async function modify() {
+  const modifyCmd = promisify(redis['SELVA.modify']).bind(redis)
+  const modifyBatch = promisify(redis['SELVA.modify.batch']).bind(redis)
+  const flushall = promisify(redis.flushall).bind(redis)
+  const nodes = genNodes()
+  const results = []
+
+  const cases = [
+    async function test_modify() {
+      await flushall()
+
+      const start = performance.now()
+      await Promise.all(
+        nodes.map((node) =>
+          modifyCmd(
+            node.id,
+            '',
+            '0',
+            'field',
+            node.field,
+            '0',
+            'published',
+            node.published,
+            '3',
+            'createdAt',
+            longLong(node.createdAt)
+          )
+        )
+      )
+      const end = performance.now()
+
+      return end - start
+    },
+    async function test_modifyBatch() {
+      await flushall()
+
+      const start = performance.now()
+      const batches = []
+      for (let i = 0; i < nodes.length; i += BATCH_SIZE) {
+        batches.push(
+          modifyBatch(TEST_KEY, encodeStream(nodes.slice(i, i + BATCH_SIZE)))
+        )
+      }
+      await Promise.all(batches)
+      const end = performance.now()
+
+      return end - start
+    },
+  ]
+
+  for (const test of cases) {
+    gc()
+    const tTotal = await test()
+
+    results.push([`${test.name} t_total`, tTotal.toFixed(2), 'ms'])
+    results.push([
+      `${test.name} ops`,
+      Math.round((N / tTotal) * 1000),
+      'nodes/s',
+    ])
+  }
+
+  return results
+}
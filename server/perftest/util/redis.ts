@@ -4,6 +4,8 @@ redis.add_command('SELVA.id')
 redis.add_command('SELVA.HIERARCHY.add')
 redis.add_command('SELVA.HIERARCHY.dump')
 redis.add_command('SELVA.HIERARCHY.find')
+redis.add_command('SELVA.modify')
+redis.add_command('SELVA.modify.batch')
 const r = redis.createClient(6379, '127.0.0.1')
 
 export default r